@@ -94,8 +94,8 @@ set(hdrs
     ${hdrs_dir}/subjective-c/categories/NSDictionary+IM.hh
     # ${hdrs_dir}/subjective-c/categories/NSImage+CGImage.h
     ${hdrs_dir}/subjective-c/categories/NSImage+QuickLook.h
-    # ${hdrs_dir}/subjective-c/categories/NSImage+Resize.h
-    # ${hdrs_dir}/subjective-c/categories/NSImage+ResizeBestFit.h
+    ${hdrs_dir}/subjective-c/categories/NSImage+Resize.h
+    ${hdrs_dir}/subjective-c/categories/NSImage+ResizeBestFit.h
     ${hdrs_dir}/subjective-c/categories/NSString+STL.hh
     ${hdrs_dir}/subjective-c/categories/NSURL+IM.hh
     
@@ -112,10 +112,23 @@ set(hdrs
     ${hdrs_dir}/subjective-c/namespace-im.hh
     ${hdrs_dir}/subjective-c/subjective-c.hh
     ${hdrs_dir}/subjective-c/appkit.hh
+    ${hdrs_dir}/subjective-c/bufferpool.hh
+    ${hdrs_dir}/subjective-c/colors.hh
     ${hdrs_dir}/subjective-c/demangle.hh
+    ${hdrs_dir}/subjective-c/encoder.hh
+    ${hdrs_dir}/subjective-c/forward.hh
+    ${hdrs_dir}/subjective-c/halogen.hh
+    ${hdrs_dir}/subjective-c/imageindex.hh
+    ${hdrs_dir}/subjective-c/json.hh
     ${hdrs_dir}/subjective-c/maptable.hh
+    ${hdrs_dir}/subjective-c/pixels.hh
     ${hdrs_dir}/subjective-c/rehash.hh
+    ${hdrs_dir}/subjective-c/resample.hh
     ${hdrs_dir}/subjective-c/system.hh
+    ${hdrs_dir}/subjective-c/thumbnails.hh
+    ${hdrs_dir}/subjective-c/tiles.hh
+    ${hdrs_dir}/subjective-c/trampoline.hh
+    ${hdrs_dir}/subjective-c/watcher.hh
 
 )
 
@@ -128,21 +141,36 @@ set(srcs
     ${srcs_dir}/categories/NSDictionary+IM.mm
     # ${srcs_dir}/categories/NSImage+CGImage.m
     ${srcs_dir}/categories/NSImage+QuickLook.m
-    # ${srcs_dir}/categories/NSImage+Resize.m
-    # ${srcs_dir}/categories/NSImage+ResizeBestFit.m
+    ${srcs_dir}/categories/NSImage+Resize.mm
+    ${srcs_dir}/categories/NSImage+ResizeBestFit.mm
     ${srcs_dir}/categories/NSString+STL.mm
     ${srcs_dir}/categories/NSURL+IM.mm
     
-    ${srcs_dir}/classes/AXCoreGraphicsImageRep.m
+    ${srcs_dir}/classes/AXCoreGraphicsImageRep.mm
     ${srcs_dir}/classes/AXInterleavedImageRep.mm
     
+    ${srcs_dir}/src/appkit.mm
+    ${srcs_dir}/src/bufferpool.mm
+    ${srcs_dir}/src/colors.mm
     ${srcs_dir}/src/demangle.cc
+    ${srcs_dir}/src/encoder.mm
+    ${srcs_dir}/src/halogen.mm
+    ${srcs_dir}/src/imageindex.mm
+    ${srcs_dir}/src/json.cc
+    ${srcs_dir}/src/json-foundation.mm
     ${srcs_dir}/src/maptable.mm
     ${srcs_dir}/src/namespace-std.mm
+    ${srcs_dir}/src/pixels.mm
+    ${srcs_dir}/src/rehash.cc
+    ${srcs_dir}/src/resample.mm
     ${srcs_dir}/src/selector.mm
     ${srcs_dir}/src/types.mm
     ${srcs_dir}/src/traits.mm
     ${srcs_dir}/src/system.mm
+    ${srcs_dir}/src/thumbnails.mm
+    ${srcs_dir}/src/thumbnails-appkit.mm
+    ${srcs_dir}/src/tiles.mm
+    ${srcs_dir}/src/watcher.mm
 
 )
 
@@ -193,6 +221,8 @@ IF(APPLE)
     FIND_LIBRARY(QUARTZ_LIBRARY Quartz)
     FIND_LIBRARY(APPKIT_LIBRARY AppKit)
     FIND_LIBRARY(QUICKLOOK_LIBRARY QuickLook)
+    FIND_LIBRARY(IMAGEIO_LIBRARY ImageIO)
+    FIND_LIBRARY(ACCELERATE_LIBRARY Accelerate)
     
     MARK_AS_ADVANCED(SYSTEM_LIBRARY
                      COCOA_LIBRARY
@@ -200,7 +230,9 @@ IF(APPLE)
                      COREFOUNDATION_LIBRARY
                      QUARTZ_LIBRARY
                      APPKIT_LIBRARY
-                     QUICKLOOK_LIBRARY)
+                     QUICKLOOK_LIBRARY
+                     IMAGEIO_LIBRARY
+                     ACCELERATE_LIBRARY)
     
     SET(EXTRA_LIBS ${EXTRA_LIBS}
         ${SYSTEM_LIBRARY}
@@ -209,13 +241,37 @@ IF(APPLE)
         ${COREFOUNDATION_LIBRARY}
         ${QUARTZ_LIBRARY}
         ${APPKIT_LIBRARY}
-        ${QUICKLOOK_LIBRARY})
+        ${QUICKLOOK_LIBRARY}
+        ${IMAGEIO_LIBRARY}
+        ${ACCELERATE_LIBRARY})
     
 ENDIF(APPLE)
 
-add_definitions(
+# The directory-wide flags are kept in OBJC_DEFINITIONS, as well as
+# passed to add_definitions(), so the precompiled prefix header can be
+# built with exactly the same ones (q.v. CMakeLists.txt):
+SET(OBJC_DEFINITIONS
     ${OBJCXX_OPTIONS_ARC}
     -Wno-nullability-completeness
     -DWITH_SCHEMA
     -O3 -funroll-loops -mtune=native
     -fstrict-aliasing)
+
+# `#import <Foundation/Foundation.h>` et al. load a prebuilt module
+# (once per configuration, cached in the build directory) instead of
+# textually including several hundred headers into each source:
+if(OBJC_CLANG_MODULES)
+    list(APPEND OBJC_DEFINITIONS
+        -fmodules -fcxx-modules
+        -fmodules-cache-path=${PROJECT_BINARY_DIR}/module-cache)
+endif(OBJC_CLANG_MODULES)
+
+# One Chrome-trace JSON file per object file, next to it -- q.v. the
+# `time-trace` target in CMakeLists.txt and mgmt/time-trace.py:
+if(OBJC_TIME_TRACE)
+    list(APPEND OBJC_DEFINITIONS
+        -ftime-trace
+        -ftime-trace-granularity=1000)
+endif(OBJC_TIME_TRACE)
+
+add_definitions(${OBJC_DEFINITIONS})
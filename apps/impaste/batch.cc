@@ -0,0 +1,142 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <exception>
+
+#include "batch.hh"
+
+namespace objc {
+    
+    namespace batch {
+        
+        namespace {
+            
+            using steady = std::chrono::steady_clock;
+            
+            /// nearest-rank percentile of sorted values:
+            double percentile(std::vector<double> const& sorted, double p) {
+                if (sorted.empty()) { return 0.0; }
+                std::size_t rank = std::size_t(std::ceil(p * double(sorted.size())));
+                return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+            }
+            
+        } /// namespace (anon.)
+        
+        path_reader::path_reader(std::istream& stream)
+            :input(stream)
+            {}
+            
+        bool path_reader::next(std::string& path) {
+            std::lock_guard<std::mutex> lock(mutex);
+            path.clear();
+            while (true) {
+                int ch = input.get();
+                bool ended = ch == std::char_traits<char>::eof();
+                if (!ended && delimiter == -1 && (ch == '\0' || ch == '\n')) { delimiter = ch; }
+                if (ended || ch == delimiter) {
+                    if (delimiter == '\n' && !path.empty() && path.back() == '\r') { path.pop_back(); }
+                    if (!path.empty()) { ++handed; return true; }
+                    if (ended) { return false; }
+                    continue;
+                }
+                path.push_back(char(ch));
+            }
+        }
+        
+        std::size_t path_reader::count() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return handed;
+        }
+        
+        report_t run(path_reader& paths, unsigned workers, task_t const& task) {
+            report_t report;
+            report.workers = workers ? workers : std::max(1u, std::thread::hardware_concurrency());
+            std::mutex mutex;                   /// guards `report` and `latencies`
+            std::vector<double> latencies;
+            auto start = steady::now();
+            
+            auto work = [&](unsigned worker) {
+                std::vector<double> mine;
+                std::vector<std::pair<std::string, std::string>> failures;
+                std::size_t completed = 0;
+                std::string path;
+                while (paths.next(path)) {
+                    auto itemstart = steady::now();
+                    std::string why;
+                    bool ok = false;
+                    try {
+                        ok = task(path, worker, why);
+                    } catch (std::exception const& exc) {
+                        why = exc.what();
+                    } catch (...) {
+                        why = "unknown exception";
+                    }
+                    mine.push_back(std::chrono::duration<double, std::milli>(steady::now() - itemstart).count());
+                    if (ok) {
+                        ++completed;
+                    } else {
+                        failures.emplace_back(path, why.empty() ? "failed" : why);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                report.completed += completed;
+                report.failures.insert(report.failures.end(), failures.begin(), failures.end());
+                latencies.insert(latencies.end(), mine.begin(), mine.end());
+            };
+            
+            std::vector<std::thread> threads;
+            for (unsigned worker = 1; worker < report.workers; ++worker) {
+                threads.emplace_back(work, worker);
+            }
+            work(0);                            /// the calling thread is worker zero
+            for (std::thread& thread : threads) { thread.join(); }
+            
+            report.total = paths.count();
+            report.seconds = std::chrono::duration<double>(steady::now() - start).count();
+            report.per_second = report.seconds > 0.0 ? double(report.completed) / report.seconds : 0.0;
+            std::sort(latencies.begin(), latencies.end());
+            report.latency_p50 = percentile(latencies, 0.50);
+            report.latency_p90 = percentile(latencies, 0.90);
+            report.latency_p99 = percentile(latencies, 0.99);
+            report.latency_max = latencies.empty() ? 0.0 : latencies.back();
+            return report;
+        }
+        
+        std::size_t local_pasteboard::clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            contents.clear();
+            return ++count;
+        }
+        
+        void local_pasteboard::write(std::string const& type, bytevec_t data) {
+            std::lock_guard<std::mutex> lock(mutex);
+            contents[type] = std::move(data);
+        }
+        
+        bool local_pasteboard::read(std::string const& type, bytevec_t& out) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = contents.find(type);
+            if (found == contents.end()) { return false; }
+            out = found->second;
+            return true;
+        }
+        
+        stringvec_t local_pasteboard::types() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            stringvec_t out;
+            for (auto const& entry : contents) { out.push_back(entry.first); }
+            return out;
+        }
+        
+        std::size_t local_pasteboard::changecount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return count;
+        }
+        
+    } /// namespace batch
+    
+} /// namespace objc
@@ -0,0 +1,95 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef APPS_IMPASTE_BATCH_HH_
+#define APPS_IMPASTE_BATCH_HH_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/// The platform-independent half of `impaste --batch`: reading paths,
+/// running them across worker threads, and keeping score -- plus a
+/// stand-in pasteboard, for when there's no pasteboard server to talk to
+/// (or when workers shouldn't be fighting over the one there is). None of
+/// it touches AppKit, so it builds and runs on Linux as it is.
+
+namespace objc {
+    
+    namespace batch {
+        
+        using bytevec_t = std::vector<uint8_t>;
+        using stringvec_t = std::vector<std::string>;
+        
+        /// Paths off of a stream, one at a time, as workers ask for them --
+        /// so a batch gets going before whatever is feeding it has finished.
+        /// The first delimiter seen decides: NUL (as from `find -print0`) or
+        /// newline, in which case a CR before it is dropped. Empty entries are
+        /// skipped. Thread-safe:
+        class path_reader {
+            
+            public:
+                explicit path_reader(std::istream& stream);
+                bool next(std::string& path);   /// false once the stream is done
+                std::size_t count() const;      /// paths handed out so far
+                
+            private:
+                mutable std::mutex mutex;
+                std::istream& input;
+                int delimiter = -1;             /// -1 until decided
+                std::size_t handed = 0;
+        };
+        
+        struct report_t {
+            std::size_t total = 0;
+            std::size_t completed = 0;
+            std::vector<std::pair<std::string, std::string>> failures;     /// path, why
+            unsigned workers = 0;
+            double seconds = 0.0;               /// wall clock
+            double per_second = 0.0;            /// completed items
+            
+            /// per item, successful or not:
+            double latency_p50 = 0.0;           /// milliseconds
+            double latency_p90 = 0.0;
+            double latency_p99 = 0.0;
+            double latency_max = 0.0;
+        };
+        
+        /// `task` gets a path and the index of the worker running it (in
+        /// [0, workers)), and returns false -- with a reason -- on failure.
+        /// Exceptions count as failures too:
+        using task_t = std::function<bool(std::string const& path, unsigned worker,
+                                          std::string& why)>;
+                                          
+        /// Run `task` over every path on `workers` threads (0 meaning one per
+        /// core), each taking the next path as it finishes the last:
+        report_t run(path_reader& paths, unsigned workers, task_t const& task);
+        
+        /// Typed blobs, and a change count that goes up every clear() --
+        /// the bits of NSPasteboard that impaste uses. Thread-safe:
+        class local_pasteboard {
+            
+            public:
+                std::size_t clear();            /// returns the new change count
+                void write(std::string const& type, bytevec_t data);
+                bool read(std::string const& type, bytevec_t& out) const;
+                stringvec_t types() const;
+                std::size_t changecount() const;
+                
+            private:
+                mutable std::mutex mutex;
+                std::map<std::string, bytevec_t> contents;
+                std::size_t count = 0;
+        };
+        
+    } /// namespace batch
+    
+} /// namespace objc
+
+#endif /// APPS_IMPASTE_BATCH_HH_
@@ -53,6 +53,14 @@ extern std::atomic<int>     verbosity;
 - (void) main;
 @end
 
+@interface AXBatchThread : AXThread {}
+- (void) main;
+@end
+
+@interface AXWatchThread : AXThread {}
+- (void) main;
+@end
+
 namespace objc {
     
     /// function templated on an Objective-C type, for the
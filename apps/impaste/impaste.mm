@@ -2,20 +2,29 @@
 /// License: MIT (see COPYING.MIT file)
 
 #include "impaste.hh"
+#include "batch.hh"
 #include <subjective-c/appkit.hh>
+#include <subjective-c/watcher.hh>
 
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
 #include <cstdlib>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
 #include <cmath>
 #include <map>
 
 #include <libimread/ext/filesystem/path.h>
 #include <libimread/serialization.hh> /// for store::detail::join(…)
 #import  <subjective-c/categories/NSString+STL.hh>
+#import  <subjective-c/categories/NSData+IM.hh>
 #import  <subjective-c/categories/NSURL+IM.hh>
+#import  <subjective-c/categories/NSImage+ResizeBestFit.h>
 #include "docopt.h"
+#include "docopt_table.h"
 
 /// return-value as static global (ugh I know I know)
 std::atomic<int> return_value{ EXIT_SUCCESS };
@@ -26,6 +35,46 @@ std::atomic<int> verbosity{ 0 };
 /// string vector
 using stringvec_t = std::vector<std::string>;
 
+namespace {
+    
+    using objc::byte;
+    
+    /// The pasteboard type for an image file type: its UTI, or failing
+    /// that its suffix (which only the local stand-in pasteboards see):
+    std::string board_type(NSBitmapImageFileType type) {
+        std::string uti = objc::image::uti(type);
+        return uti.empty() ? objc::image::suffix(type) : uti;
+    }
+    
+    /// The pasteboard's own data for `type`, if it has some that really
+    /// is that type -- to be written out as-is, with no decode or encode:
+    NSData* native_data(NSPasteboard* board, NSBitmapImageFileType type) {
+        std::string uti = objc::image::uti(type);
+        if (uti.empty()) { return nil; }
+        NSString* boardtype = [NSString stringWithSTLString:uti];
+        if ([board availableTypeFromArray:@[ boardtype ]] == nil) { return nil; }
+        NSData* data = [board dataForType:boardtype];
+        if (data == nil) { return nil; }
+        NSInteger sniffed = objc::image::sniff(static_cast<byte const*>(data.bytes),
+                                               std::min<std::size_t>(data.length, objc::image::sniff_size));
+        return sniffed == static_cast<NSInteger>(type) ? data : nil;
+    }
+    
+    /// What to save as `type` from a pasteboard: its native data when
+    /// there is some, or else the pasted image, encoded once from its best
+    /// existing representation (q.v. -[NSImage dataForImageFileType:]):
+    NSData* pasteboard_data(NSPasteboard* board, NSBitmapImageFileType type, bool& through) {
+        if (NSData* data = native_data(board, type)) {
+            through = true;
+            return data;
+        }
+        through = false;
+        NSImage* pasted = objc::appkit::paste<NSImage>(board);
+        return pasted ? [pasted dataForImageFileType:type] : nil;
+    }
+    
+} /// namespace (anon.)
+
 /// App delegate
 @implementation AXAppDelegate
 - (void) applicationShouldTerminate:(NSApplication*)sender {
@@ -63,7 +112,7 @@ using stringvec_t = std::vector<std::string>;
     
     bool ok = objc::to_bool(
               objc::appkit::can_paste<NSImage>());
-    
+              
     if (ok) {
         
         std::cout << "[impaste] Pasteboard contains useable image data [go nuts!]"
@@ -107,22 +156,37 @@ using stringvec_t = std::vector<std::string>;
             AXTHREADEXIT(EXIT_FAILURE);
         }
         
-        if (!objc::to_bool([inpathurl isImage])) {
-            std::cerr << "[impaste][error] Can't determine input format from filename: "
+        /// Map the input once: the same bytes get sniffed for their
+        /// image type and then handed to NSImage for decoding
+        NSData* indata = [NSData dataWithContentsOfURL:inpathurl
+                                               options:NSDataReadingMappedIfSafe
+                                                 error:nil];
+        NSInteger intype = indata ? objc::image::sniff(*[indata dataSource]) : -1;
+        
+        if (intype == -1) {
+            std::cerr << "[impaste][error] Can't determine input format from file contents: "
                       << inabspath.basename()
                       << std::endl;
             AXTHREADEXIT(EXIT_FAILURE);
         }
         
+        NSString* intypename = [[NSString stringWithSTLString:objc::image::suffix(
+                                 static_cast<NSBitmapImageFileType>(intype))] uppercaseString];
+                                 
         if (verbosity.load() > 0) {
+            if (intype != static_cast<NSInteger>([inpathurl imageFileType])) {
+                std::cout << "[impaste] Input file contents are "
+                          << [intypename STLString]
+                          << " data, whatever its filename says" << std::endl;
+            }
             std::cout << "[impaste] Copying "
-                      << [[inpathurl.pathExtension uppercaseString] STLString]
+                      << [intypename STLString]
                       << " image to pasteboard from "
                       << inabspath.basename()
                       << " (" << inabspath << ") ..."  << std::endl;
         }
         
-        NSImage* copyTarget = [[NSImage alloc] initWithContentsOfURL:inpathurl];
+        NSImage* copyTarget = [[NSImage alloc] initWithData:indata];
         bool copied = objc::appkit::copy(copyTarget);
         
         if (copied) {
@@ -162,22 +226,24 @@ using stringvec_t = std::vector<std::string>;
             AXTHREADEXIT(EXIT_FAILURE);
         }
         
-        NSImage* pasted = objc::appkit::paste<NSImage>();
-        NSBitmapImageRep* bitmap = [[NSBitmapImageRep alloc] initWithData:[pasted TIFFRepresentation]];
-        NSData* data = [bitmap representationUsingType:[outpathurl imageFileType]
-                                            properties:@{}];
-        
+        bool through = false;
+        NSData* data = pasteboard_data([NSPasteboard generalPasteboard],
+                                       [outpathurl imageFileType], through);
+                                       
         if (verbosity.load() > 0) {
             std::cout << "[impaste] Saving "
                       << [[outpathurl.pathExtension uppercaseString] STLString]
                       << " image from pasteboard to "
                       << outabspath.basename()
-                      << " (" << outabspath << ") ..." << std::endl;
+                      << " (" << outabspath << ") ..." << std::endl
+                      << (through ? "[impaste] Writing the pasteboard's own data as-is"
+                                  : "[impaste] Encoding from the pasted image")
+                      << std::endl;
         }
         
         BOOL saved = [data writeToURL:outpathurl
                            atomically:YES];
-        
+                           
         if (objc::to_bool(saved)) {
             std::cout << "[impaste] Image successfully saved! ("
                       << std::round(outabspath.filesize() / 1024) << "kbytes)"
@@ -190,76 +256,280 @@ using stringvec_t = std::vector<std::string>;
         }
         
     }
+    
+}
+@end
 
+@implementation AXBatchThread : AXThread
+- (void) main {
+    
+    bool local = self.options[@"local"] != nil;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    
+    if (NSString* jobstring = self.options[@"jobs"]) {
+        char* end = nullptr;
+        unsigned long requested = std::strtoul(jobstring.UTF8String, &end, 10);
+        if (end == jobstring.UTF8String || *end != '\0') {
+            std::cerr << "[impaste][error] Not a number of workers: "
+                      << [jobstring STLString] << std::endl;
+            AXTHREADEXIT(EXIT_FAILURE);
+        }
+        if (requested > 0) { jobs = static_cast<unsigned>(requested); }
+    }
+    
+    /// With an output directory, each image makes the round trip: copied
+    /// to a pasteboard, pasted back, and saved under its own name there:
+    NSURL* outdirurl = nil;
+    if (NSString* outdirstring = self.options[@"output"]) {
+        outdirurl = [NSURL fileURLWithPath:outdirstring.stringByExpandingTildeInPath
+                               isDirectory:YES];
+        filesystem::path outdirpath = [outdirurl filesystemPath].make_absolute();
+        if (!outdirpath.is_directory()) {
+            std::cerr << "[impaste][error] No such output directory exists: "
+                      << [outdirstring STLString]        << std::endl
+                      << "\t(" << outdirpath << ") ..." << std::endl;
+            AXTHREADEXIT(EXIT_FAILURE);
+        }
+    }
+    
+    /// A pasteboard apiece, so workers never clobber one another (or the
+    /// general pasteboard) -- either a uniquely-named NSPasteboard, or,
+    /// with --local, an in-process stand-in that needs no pasteboard server:
+    NSMutableArray<NSPasteboard*>* boards = [[NSMutableArray alloc] init];
+    std::vector<objc::batch::local_pasteboard> locals(local ? jobs : 0);
+    if (!local) {
+        for (unsigned idx = 0; idx < jobs; ++idx) {
+            [boards addObject:[NSPasteboard pasteboardWithUniqueName]];
+        }
+    }
+    
+    std::mutex outmutex;
+    
+    if (verbosity.load() > 0) {
+        std::cout << "[impaste] Batch: reading paths from stdin, with "
+                  << jobs << (local ? " local" : "") << " pasteboards ..."
+                  << std::endl;
+    }
+    
+    objc::batch::path_reader paths(std::cin);
+    objc::batch::report_t report = objc::batch::run(paths, jobs,
+                                    [&](std::string const& path, unsigned worker, std::string& why) -> bool {
+        @autoreleasepool {
+            NSURL* inpathurl = [NSURL fileURLWithPath:[NSString stringWithSTLString:path].stringByExpandingTildeInPath];
+            NSData* indata = [NSData dataWithContentsOfURL:inpathurl
+                                                   options:NSDataReadingMappedIfSafe
+                                                     error:nil];
+            if (!indata) {
+                why = "No such readable image file exists";
+                return false;
+            }
+            
+            NSInteger intype = objc::image::sniff(*[indata dataSource]);
+            if (intype == -1) {
+                why = "Can't determine input format from file contents";
+                return false;
+            }
+            
+            const NSBitmapImageFileType infiletype = static_cast<NSBitmapImageFileType>(intype);
+            const std::string boardtype = board_type(infiletype);
+            
+            if (local) {
+                byte const* bytes = static_cast<byte const*>(indata.bytes);
+                locals[worker].clear();
+                locals[worker].write(boardtype, { bytes, bytes + indata.length });
+            } else {
+                NSImage* copyTarget = [[NSImage alloc] initWithData:indata];
+                if (!copyTarget || !objc::appkit::copy_to(boards[worker], copyTarget)) {
+                    why = "Failure when reading image data";
+                    return false;
+                }
+            }
+            if (outdirurl == nil) { return true; }
+            
+            NSURL* outpathurl = [outdirurl URLByAppendingPathComponent:inpathurl.lastPathComponent];
+            if (!objc::to_bool([outpathurl isImage])) {
+                outpathurl = [outpathurl URLByAppendingPathExtension:[NSString
+                                              stringWithSTLString:objc::image::suffix(infiletype)]];
+            }
+            filesystem::path outabspath = [outpathurl filesystemPath];
+            if (outabspath.exists()) {
+                why = "File already exists at path: " + outabspath.str();
+                return false;
+            }
+            
+            /// Pasting back: matching types get written straight through,
+            /// anything else is transcoded once:
+            const NSBitmapImageFileType outfiletype = [outpathurl imageFileType];
+            objc::batch::bytevec_t boarddata;
+            NSData* data = nil;
+            
+            if (local) {
+                if (!locals[worker].read(boardtype, boarddata)) {
+                    why = "Nothing on the pasteboard";
+                    return false;
+                }
+                NSData* stored = [NSData dataWithBytesNoCopy:boarddata.data()
+                                                      length:boarddata.size()
+                                                freeWhenDone:NO];
+                data = outfiletype == infiletype ? stored
+                                                 : [[[NSImage alloc] initWithData:stored]
+                                                      dataForImageFileType:outfiletype];
+            } else {
+                bool through = false;
+                data = pasteboard_data(boards[worker], outfiletype, through);
+            }
+            
+            if (!data || !objc::to_bool([data writeToURL:outpathurl atomically:YES])) {
+                why = "Failure when writing image data";
+                return false;
+            }
+            
+            if (verbosity.load() > 0) {
+                std::lock_guard<std::mutex> lock(outmutex);
+                std::cout << "[impaste] Saved " << outabspath.basename()
+                          << " (worker " << worker << ")" << std::endl;
+            }
+            return true;
+        };
+    });
+    
+    for (NSPasteboard* board in boards) {
+        [board releaseGlobally];
+    }
+    
+    for (auto const& failure : report.failures) {
+        std::cerr << "[impaste][error] " << failure.second << ": "
+                  << failure.first << std::endl;
+    }
+    
+    std::cout << std::fixed << std::setprecision(2)
+              << "[impaste] Batch: " << report.completed << " of " << report.total
+              << " images " << (outdirurl ? "saved" : "copied")
+              << " in " << report.seconds << "s ("
+              << report.per_second << " images/sec, "
+              << report.workers << " workers)" << std::endl
+              << "[impaste] Latency per image: p50 " << report.latency_p50
+              << "ms, p90 " << report.latency_p90
+              << "ms, p99 " << report.latency_p99
+              << "ms, max " << report.latency_max << "ms" << std::endl;
+              
+    AXTHREADEXIT(report.failures.empty() ? EXIT_SUCCESS : EXIT_FAILURE);
+    
 }
 @end
 
-/// The docopt help string defines the options available:
-const char USAGE[] = R"([impaste] Paste image data to imgur.com or to a file
+@implementation AXWatchThread : AXThread
+- (void) main {
+    
+    /// With an output directory, each new image is saved there as it turns
+    /// up on the pasteboard -- otherwise changes just get reported:
+    NSURL* outdirurl = nil;
+    if (NSString* outdirstring = self.options[@"output"]) {
+        outdirurl = [NSURL fileURLWithPath:outdirstring.stringByExpandingTildeInPath
+                               isDirectory:YES];
+        filesystem::path outdirpath = [outdirurl filesystemPath].make_absolute();
+        if (!outdirpath.is_directory()) {
+            std::cerr << "[impaste][error] No such output directory exists: "
+                      << [outdirstring STLString]        << std::endl
+                      << "\t(" << outdirpath << ") ..." << std::endl;
+            AXTHREADEXIT(EXIT_FAILURE);
+        }
+    }
+    
+    /// One worker, so images get saved in the order they were copied:
+    objc::appkit::watcher::options watchoptions;
+    watchoptions.workers = 1;
+    NSPasteboard* board = [NSPasteboard generalPasteboard];
+    objc::appkit::watcher watcher(board, watchoptions);
+    
+    watcher.subscribe([board, outdirurl](long changecount, objc::appkit::watcher::types_t const& types) {
+        @autoreleasepool {
+            if (verbosity.load() > 0) {
+                std::cout << "[impaste] Pasteboard changed (" << changecount << "): "
+                          << store::detail::join(types, ", ") << std::endl;
+            }
+            if (outdirurl == nil || !objc::appkit::can_paste<NSImage>(board)) { return; }
+            
+            NSString* filename = [NSString stringWithFormat:@"pasted-%li.png", changecount];
+            NSURL* outpathurl = [outdirurl URLByAppendingPathComponent:filename];
+            filesystem::path outabspath = [outpathurl filesystemPath];
+            if (outabspath.exists()) {
+                std::cerr << "[impaste][error] File already exists at path: "
+                          << outabspath << std::endl;
+                return;
+            }
+            
+            bool through = false;
+            NSData* data = pasteboard_data(board, NSPNGFileType, through);
+            if (!data || !objc::to_bool([data writeToURL:outpathurl atomically:YES])) {
+                std::cerr << "[impaste][error] Failure when writing image data: "
+                          << outabspath << std::endl;
+                return;
+            }
+            std::cout << "[impaste] Saved " << outabspath.basename()
+                      << " (" << std::round(outabspath.filesize() / 1024) << "kbytes)"
+                      << std::endl;
+        };
+    });
+    
+    if (verbosity.load() > 0) {
+        std::cout << "[impaste] Watching the pasteboard"
+                  << (outdirurl ? ", saving images" : "")
+                  << " -- interrupt to stop ..." << std::endl;
+    }
+    
+    /// The watcher does its work on threads of its own --
+    /// this one just sticks around, reporting hourly if asked:
+    watcher.start();
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::hours(1));
+        if (verbosity.load() > 0) {
+            objc::appkit::watcher::stats_t stats = watcher.stats();
+            std::cout << "[impaste] Watch: " << stats.polls << " polls, "
+                      << stats.changes << " changes, "
+                      << stats.notifications << " notifications so far"
+                      << std::endl;
+        }
+    }
+    
+}
+@end
 
-    Usage:
-        impaste         [-c         | --check       ]
-                        [-d         | --dry-run     ]
-                        [-V         | --verbose     ]
-                        [-i FILE    | --input=FILE  ]
-                        [-o FILE    | --output=FILE ]
-        
-        impaste         -h | --help | -v | --version
-    
-    Options:
-        -c --check                  Check and report on the pasteboard contents.
-        -d --dry-run                Don't actually do anything, but pretend.
-        -V --verbose                Print more information.
-        -i FILE --input=FILE        Copy an image to the pasteboard.
-        -o FILE --output=FILE       Save pasteboard image to a file.
-        -h --help                   Show this help screen.
-        -v --version                Show version.
-)";
+/// The docopt help string defines the options available -- it lives in
+/// impaste.docopt, parsed at build time by docopt-compile into USAGE_grammar:
+#include "impaste-usage.hh"
 
 const std::string VERSION = "[impaste]{ subjective-c " + objc::config::version + " }";
 
 int main(int argc, const char** argv) {
-    using value_t = docopt::value;
-    using optmap_t = std::map<std::string, value_t>;
-    using optpair_t = std::pair<std::string, value_t>;
-    value_t truth(1);
-    value_t empty(false);
+    using entry_t = docopt::table::entry;
     bool debug{ IMPASTE_DEBUG };
-    optmap_t args;
-    optmap_t raw_args = docopt::docopt(USAGE, { argv + 1, argv + argc },
-                                       true, /// show help
-                                       VERSION);
-    
-    if (debug) {
-        std::cerr << std::endl
-                  << "[impaste] RAW ARGS:" << std::endl;
-        for (optpair_t const& arg : raw_args) {
-            std::cerr << "\t" << arg.first  << " --> "
-                              << arg.second << std::endl;
-        }
-    }
     
-    /// filter out all docopt parse artifacts,
-    /// leaving only things beginning with "--"
-    std::copy_if(raw_args.begin(),
-                 raw_args.end(),
-                 std::inserter(args, args.begin()),
-              [](optpair_t const& p) { return p.first.substr(0, 1) == "-"; });
+    /// one flat table, viewing straight into argv -- no copies of it all:
+    docopt::table args = docopt::docopt_table(USAGE_grammar, argc - 1, argv + 1,
+                                              true, /// show help
+                                              VERSION);
+                                              
+    /// skip all docopt parse artifacts, leaving
+    /// only things beginning with "-" (or "--")
+    auto is_option = [](entry_t const& arg) { return arg.name.substr(0, 1) == "-"; };
+    auto is_flag = [](entry_t const& arg) { return arg.isLong() && arg.asLong() == 1; };
     
     if (debug) {
         std::cerr << std::endl
-                  << "[impaste] FILTERED ARGS:" << std::endl;
-        for (optpair_t const& arg : args) {
-            std::cerr << "\t" << arg.first  << " --> "
-                              << arg.second << std::endl;
+                  << "[impaste] ARGS:" << std::endl;
+        for (entry_t const& arg : args) {
+            if (!is_option(arg)) { continue; }
+            std::cerr << "\t" << arg.name  << " --> "
+                              << arg << std::endl;
         }
         std::cerr << std::endl;
     }
     
     /// print the value for the truthy option flag
-    for (optpair_t const& arg : args) {
-        if (arg.first == "--verbose" || arg.first == "-V") {
-            verbosity.store(arg.second.asLong() + (int)debug);
+    for (entry_t const& arg : args) {
+        if (arg.name == "--verbose" || arg.name == "-V") {
+            verbosity.store(arg.asLong() + (int)debug);
             if (verbosity.load() > 0) {
                 std::cout << "[impaste] VERBOSITY: " << verbosity.load() << std::endl;
             }
@@ -268,43 +538,60 @@ int main(int argc, const char** argv) {
     
     NSMutableDictionary<NSString*, NSString*>* options = [[NSMutableDictionary alloc] init];
     
-    for (optpair_t const& arg : args) {
-        if (arg.second == truth) {
-            if (arg.first == "--check" || arg.first == "-c") {
+    for (entry_t const& arg : args) {
+        if (!is_option(arg)) { continue; }
+        if (is_flag(arg)) {
+            if (arg.name == "--check" || arg.name == "-c") {
                 /* DO CHECK */
                 objc::run_thread<AXCheckThread>(options);
                 break;
-            } else if (arg.first == "--dry-run" || arg.first == "-d") {
+            } else if (arg.name == "--dry-run" || arg.name == "-d") {
                 /* DO DRY RUN */
                 objc::run_thread<AXDryRunThread>(options);
                 break;
+            } else if (arg.name == "--batch" || arg.name == "-b") {
+                [options setObject:@"yes" forKey:@"batch"];
+            } else if (arg.name == "--local" || arg.name == "-l") {
+                [options setObject:@"yes" forKey:@"local"];
+            } else if (arg.name == "--watch" || arg.name == "-w") {
+                [options setObject:@"yes" forKey:@"watch"];
             }
         }
-        if (arg.second != empty) {
-            std::string path{ NULL_STR };
-            if (arg.second.isString()) {
-                path = arg.second.asString();
-            } else if (arg.second.isStringList()) {
+        if (arg.isString() || arg.isStringList()) {
+            std::string path;
+            if (arg.isString()) {
+                path = arg.asString();
+            } else {
                 /// exactly when the fuck would this be
-                path = store::detail::join(
-                       arg.second.asStringList(), " ");
+                for (std::string_view part : arg.asStringList()) {
+                    if (!path.empty()) { path += " "; }
+                    path += part;
+                }
             }
-            if (path != NULL_STR) {
-                if (arg.first == "--input" || arg.first == "-i") {
+            if (!path.empty()) {
+                if (arg.name == "--input" || arg.name == "-i") {
                     /* DO FILE INPUT */
                     [options setObject:[NSString stringWithSTLString:path]
                                 forKey:@"input"];
                 }
-                if (arg.first == "--output" || arg.first == "-o") {
+                if (arg.name == "--output" || arg.name == "-o") {
                     /* DO FILE OUTPUT */
                     [options setObject:[NSString stringWithSTLString:path]
                                 forKey:@"output"];
                 }
+                if (arg.name == "--jobs" || arg.name == "-j") {
+                    [options setObject:[NSString stringWithSTLString:path]
+                                forKey:@"jobs"];
+                }
             }
         }
     }
     
-    if (options[@"input"] || options[@"output"]) {
+    if (options[@"batch"]) {
+        objc::run_thread<AXBatchThread>(options);
+    } else if (options[@"watch"]) {
+        objc::run_thread<AXWatchThread>(options);
+    } else if (options[@"input"] || options[@"output"]) {
         objc::run_thread<AXImageCopyAndSaveThread>(options);
     }
     
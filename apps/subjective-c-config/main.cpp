@@ -5,31 +5,9 @@
 #include "subjective-c-config.h"
 #include "docopt.h"
 
-static const char USAGE[] = R"([subjective-c-config] Configuration for subjective-c
-
-    Usage:
-      subjective-c-config (--prefix          |
-                           --exec-prefix     |
-                           --includes        |
-                           --libs            |
-                           --cflags          |
-                           --ldflags)
-      subjective-c-config (-h | --help)
-      subjective-c-config --version
-    
-    Options:
-      --prefix        Show install prefix e.g. /usr/local.
-      --exec-prefix   Show exec-prefix; should be same as the prefix.
-      --includes      Show include flags
-                        e.g. -I/usr/include -I/usr/local/include.
-      --libs          Show library link flags
-                        e.g. -limread -lHalide -framework CoreFoundation.
-      --cflags        Show all compiler arguments and include flags.
-      --ldflags       Show all library link flags and linker options.
-      -h --help       Show this help screen.
-      --version       Show version.
-
-)";
+/// The usage string lives in subjective-c-config.docopt, parsed
+/// at build time by docopt-compile into USAGE_grammar:
+#include "subjective-c-config-usage.hh"
 
 const std::string VERSION = "[subjective-c-config]{ subjective-c " + objc::config::version + " }";
 
@@ -39,7 +17,7 @@ int main(int argc, const char** argv) {
     using optpair_t = std::pair<std::string, value_t>;
     value_t truth(true);
     optmap_t args;
-    optmap_t raw_args = docopt::docopt(USAGE, { argv + 1, argv + argc },
+    optmap_t raw_args = docopt::docopt(USAGE_grammar, { argv + 1, argv + argc },
                                        true, /// show help
                                        VERSION);
     
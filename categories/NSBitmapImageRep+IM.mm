@@ -1,9 +1,163 @@
 /// Copyright 2014 Alexander Böhn <fish2000@gmail.com>
 /// License: MIT (see COPYING.MIT file)
 
-#include <cstring>
+#include <array>
+#include <algorithm>
+#import  <objc/runtime.h>
 #include <subjective-c/categories/NSBitmapImageRep+IM.hh>
+#include <subjective-c/halogen.hh>
 #include <libimread/image.hh>
+#include <libimread/errors.hh>
+
+namespace objc {
+    
+    namespace pixels {
+        
+        /// libimread images keep their strides in samples, not bytes --
+        /// they're planar, for the most part, but we don't presume:
+        layout layout_of(Image const& image) {
+            layout out;
+            int bits = image.nbits();
+            
+            bool floating = image.is_floating_point();
+            
+            if (!floating && bits == 8)         { out.kind = sample::u8;  }
+            else if (!floating && bits == 16)   { out.kind = sample::u16; }
+            else if (floating && bits == 32)    { out.kind = sample::f32; }
+            else                                { return out;             }
+            
+            std::ptrdiff_t siz = static_cast<std::ptrdiff_t>(out.kind);
+            byte* origin = image.rowp_as<byte>(0);
+            out.count = image.planes();
+            out.mode = out.count == 2 || out.count > 3 ? alpha::straight : alpha::none;
+            for (std::size_t c = 0; c < std::min(out.count, max_channels); ++c) {
+                out.channels[c] = channel_t{ origin + std::ptrdiff_t(c) * image.stride_or(2, 0) * siz,
+                                                      image.stride_or(0, 1) * siz,
+                                                      image.stride_or(1, image.width()) * siz };
+            }
+            return out;
+        }
+        
+    } /// namespace pixels
+    
+    namespace {
+        
+        /// An im::Image that views an NSBitmapImageRep's samples in place --
+        /// the rep is retained for as long as the view is around:
+        class bitmapview : public im::Image {
+            
+            public:
+                bitmapview(NSBitmapImageRep* r, byte* o, int bits, bool floating,
+                           std::array<int, 3> dimensions,
+                           std::array<int, 3> strides)
+                    :rep(r), origin(o), bitdepth(bits), floatingpoint(floating)
+                    ,dims(dimensions), steps(strides)
+                    {
+                        #if !__has_feature(objc_arc)
+                            [rep retain];
+                        #endif
+                    }
+                    
+                virtual ~bitmapview() {
+                    #if !__has_feature(objc_arc)
+                        [rep release];
+                    #endif
+                }
+                
+                virtual void* rowp(int r) const override {
+                    return origin + std::ptrdiff_t(r) * steps[1] * (bitdepth / 8);
+                }
+                
+                virtual int nbits() const override              { return bitdepth; }
+                virtual int ndims() const override              { return 3; }
+                virtual int dim(int d) const override           { return d < 3 ? dims[d] : 1; }
+                virtual int stride(int d) const override        { return d < 3 ? steps[d] : 0; }
+                virtual bool is_signed() const override         { return floatingpoint; }
+                virtual bool is_floating_point() const override { return floatingpoint; }
+                
+            private:
+                NSBitmapImageRep* rep;
+                byte* origin;
+                int bitdepth;
+                bool floatingpoint;
+                std::array<int, 3> dims;            /// width, height, planes
+                std::array<int, 3> steps;           /// in samples, not bytes
+        };
+        
+        /// An empty rep shaped like `rep`, with `format` and `space` --
+        /// for the copy-with-changes methods, q.v. sub.:
+        NSBitmapImageRep* blank_like(NSBitmapImageRep* rep, NSBitmapFormat format,
+                                     NSColorSpace* space) {
+            NSString* name = [rep colorSpaceName];
+            if ([name isEqualToString:NSCustomColorSpace]) {
+                name = [space colorSpaceModel] == NSRGBColorSpaceModel ? NSCalibratedRGBColorSpace
+                                                                       : NSCalibratedWhiteColorSpace;
+            }
+            NSBitmapImageRep* out = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                            pixelsWide:[rep pixelsWide]
+                                                                            pixelsHigh:[rep pixelsHigh]
+                                                                         bitsPerSample:[rep bitsPerSample]
+                                                                       samplesPerPixel:[rep samplesPerPixel]
+                                                                              hasAlpha:[rep hasAlpha]
+                                                                              isPlanar:NO
+                                                                        colorSpaceName:name
+                                                                          bitmapFormat:format
+                                                                           bytesPerRow:0
+                                                                          bitsPerPixel:0];
+            if (out && ![[out colorSpace] isEqual:space]) {
+                out = [out bitmapImageRepByRetaggingWithColorSpace:space];
+            }
+            [out setSize:[rep size]];
+            return out;
+        }
+        
+        /// Interleaved 8-bit four-channel pixels, alpha (if any) last --
+        /// what the halogen pipelines take:
+        bool halogen_buffer(NSBitmapImageRep* rep, objc::halogen::buffer_t& out) {
+            NSBitmapFormat format = [rep bitmapFormat];
+            if ([rep isPlanar] || [rep bitsPerSample] != 8 ||
+                [rep samplesPerPixel] != 4 || [rep bitsPerPixel] != 32 ||
+                format & (NSAlphaFirstBitmapFormat | NSFloatingPointSamplesBitmapFormat)) { return false; }
+            out.data = [rep bitmapData];
+            out.width = [rep pixelsWide];
+            out.height = [rep pixelsHigh];
+            out.channels = 4;
+            out.rowbytes = [rep bytesPerRow];
+            out.kind = objc::pixels::sample::u8;
+            return true;
+        }
+        
+        /// The color spaces the halogen pipeline converts among, by their
+        /// CoreGraphics names -- spelled out, as the constants for the
+        /// newer ones are missing before 10.12:
+        bool halogen_colorspace(NSColorSpace* space, objc::halogen::colorspace& out) {
+            CGColorSpaceRef colorspace = [space CGColorSpace];
+            CFStringRef name = colorspace ? CGColorSpaceCopyName(colorspace) : nullptr;
+            if (!name) { return false; }
+            bool known = true;
+            if (CFEqual(name, CFSTR("kCGColorSpaceSRGB")))              { out = objc::halogen::colorspace::srgb;        }
+            else if (CFEqual(name, CFSTR("kCGColorSpaceLinearSRGB")))   { out = objc::halogen::colorspace::linear_srgb; }
+            else if (CFEqual(name, CFSTR("kCGColorSpaceDisplayP3")))    { out = objc::halogen::colorspace::display_p3;  }
+            else                                                        { known = false;                                }
+            CFRelease(name);
+            return known;
+        }
+        
+    } /// namespace (anon.)
+    
+} /// namespace objc
+
+/// Keeps a wrapped im::Image alive for as long as the rep viewing its buffers:
+@interface AXImageBufferOwner : NSObject {
+    @public
+        std::shared_ptr<Image> image;
+}
+@end
+
+@implementation AXImageBufferOwner
+@end
+
+static char const AXImageBufferOwnerKey = 0;
 
 @implementation NSBitmapImageRep (AXBitmapImageRepAdditions)
 
@@ -17,6 +171,10 @@
     return [[NSBitmapImageRep alloc] initWithImage:image];
 }
 
++ (instancetype) imageRepWithSharedImage:(std::shared_ptr<Image>)image {
+    return [[NSBitmapImageRep alloc] initWithSharedImage:image];
+}
+
 - initWithByteVector:(bytevec_t const&)byteVector {
     NSData* datum = [[NSData alloc] initWithBytes:(const void*)&byteVector[0]
                                            length:(NSInteger)byteVector.size()];
@@ -24,55 +182,253 @@
 }
 
 - initWithImage:(Image const&)image {
-    BOOL alpha = objc::boolean(image.planes() > 3);
+    objc::pixels::layout source = objc::pixels::layout_of(image);
+    if (!source.count) { return nil; }
+    
     NSInteger width = (NSInteger)image.width();
     NSInteger height = (NSInteger)image.height();
     NSInteger channels = (NSInteger)image.planes();
     NSInteger bps = (NSInteger)image.nbits();
-    int siz = (bps / 8) + bool(bps % 8);
+    NSBitmapFormat format = NSAlphaNonpremultipliedBitmapFormat;
+    if (source.kind == objc::pixels::sample::f32) {
+        format |= NSFloatingPointSamplesBitmapFormat;
+    }
     
     /// Pass `nil` to make NSBitmapImageRep do right by its own allocations:
     /// q.v. http://stackoverflow.com/a/16097891/298171
     /// …and http://stackoverflow.com/a/20526575/298171
+    /// … zero `bytesPerRow` and `bitsPerPixel` let it pad rows as it sees fit,
+    /// which the pixel transfer will respect:
     self = [self initWithBitmapDataPlanes:nil
                                pixelsWide:width
                                pixelsHigh:height
                             bitsPerSample:bps
                           samplesPerPixel:channels
-                                 hasAlpha:alpha
+                                 hasAlpha:objc::boolean(source.mode != objc::pixels::alpha::none)
                                  isPlanar:NO
-                           colorSpaceName:NSCalibratedRGBColorSpace
-                             bitmapFormat:NSAlphaNonpremultipliedBitmapFormat
-                              bytesPerRow:(NSInteger)(image.planes() * image.width())
-                             bitsPerPixel:(NSInteger)(image.planes() * 8)];
-    
-    /// Manually copy the image buffer to [self bitmapData] --
-    std::memcpy([self bitmapData], image.rowp_as<byte* _Nullable>(0),
-                                   siz * height * width * channels);
+                           colorSpaceName:channels > 2 ? NSCalibratedRGBColorSpace
+                                                       : NSCalibratedWhiteColorSpace
+                             bitmapFormat:format
+                              bytesPerRow:0
+                             bitsPerPixel:0];
+    if (!self) { return nil; }
+    
+    /// Copy the image buffer to [self bitmapData], row by row --
+    if (!objc::pixels::transfer(source, [self pixelLayout], width, height)) { return nil; }
     return self;
 }
 
+- initWithSharedImage:(std::shared_ptr<Image>)image {
+    using objc::pixels::max_channels;
+    if (!image) { return nil; }
+    objc::pixels::layout source = objc::pixels::layout_of(*image);
+    std::size_t channels = source.count;
+    
+    /// AppKit can take planes whose rows share one stride, or one plane of
+    /// gapless interleaved pixels -- anything else gets copied:
+    bool packed = source.is_packed();
+    bool planar = !packed && source.is_planar() && channels <= max_channels &&
+                  std::all_of(source.channels.begin(), source.channels.begin() + channels,
+                           [&](objc::pixels::channel_t const& channel) {
+                      return channel.ystride == source.channels[0].ystride;
+                  });
+    if (!channels || !(packed || planar)) { return [self initWithImage:*image]; }
+    
+    unsigned char* planes[max_channels] = { nullptr };
+    for (std::size_t c = 0; c < (planar ? channels : 1); ++c) {
+        planes[c] = source.channels[c].origin;
+    }
+    
+    NSInteger bps = (NSInteger)image->nbits();
+    NSBitmapFormat format = NSAlphaNonpremultipliedBitmapFormat;
+    if (source.kind == objc::pixels::sample::f32) {
+        format |= NSFloatingPointSamplesBitmapFormat;
+    }
+    
+    self = [self initWithBitmapDataPlanes:planes
+                               pixelsWide:(NSInteger)image->width()
+                               pixelsHigh:(NSInteger)image->height()
+                            bitsPerSample:bps
+                          samplesPerPixel:(NSInteger)channels
+                                 hasAlpha:objc::boolean(source.mode != objc::pixels::alpha::none)
+                                 isPlanar:objc::boolean(planar)
+                           colorSpaceName:channels > 2 ? NSCalibratedRGBColorSpace
+                                                       : NSCalibratedWhiteColorSpace
+                             bitmapFormat:format
+                              bytesPerRow:(NSInteger)source.channels[0].ystride
+                             bitsPerPixel:planar ? bps : (NSInteger)source.channels[0].xstride * 8];
+    if (!self) { return nil; }
+    
+    /// The rep doesn't own planes it was handed, so it gets to own the image:
+    AXImageBufferOwner* owner = [[AXImageBufferOwner alloc] init];
+    owner->image = std::move(image);
+    objc_setAssociatedObject(self, &AXImageBufferOwnerKey, owner,
+                             OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    return self;
+}
+
+- (std::unique_ptr<Image>) imageView {
+    objc::pixels::layout source = [self pixelLayout];
+    std::size_t channels = source.count;
+    std::ptrdiff_t siz = static_cast<std::ptrdiff_t>(source.kind);
+    
+    /// libimread images are straight-alpha and color-first, with strides
+    /// in whole samples -- reps that differ get nothing here:
+    if (!channels || source.mode == objc::pixels::alpha::premultiplied) { return nullptr; }
+    if ([self bitmapFormat] & NSAlphaFirstBitmapFormat)                   { return nullptr; }
+    
+    std::ptrdiff_t planestep = channels > 1 ? source.channels[1].origin - source.channels[0].origin : 0;
+    for (std::size_t c = 0; c < channels; ++c) {
+        objc::pixels::channel_t const& channel = source.channels[c];
+        if (channel.origin  != source.channels[0].origin + std::ptrdiff_t(c) * planestep ||
+            channel.xstride != source.channels[0].xstride ||
+            channel.ystride != source.channels[0].ystride ||
+            channel.xstride % siz || channel.ystride % siz || planestep % siz) { return nullptr; }
+    }
+    
+    return std::make_unique<objc::bitmapview>(
+        self, source.channels[0].origin, (int)[self bitsPerSample],
+        source.kind == objc::pixels::sample::f32,
+        std::array<int, 3>{{ (int)[self pixelsWide], (int)[self pixelsHigh], (int)channels }},
+        std::array<int, 3>{{ int(source.channels[0].xstride / siz),
+                             int(source.channels[0].ystride / siz),
+                             int(planestep / siz) }});
+}
+
 - (std::unique_ptr<Image>) imageUsingImageFactory:(ImageFactory*)factory {
     NSInteger height = [self pixelsHigh];
     NSInteger width = [self pixelsWide];
     NSInteger channels = [self samplesPerPixel];
     int bps = (int)[self bitsPerSample];
-    int siz = (bps / 8) + bool(bps % 8);
-    
+    objc::pixels::layout source = [self pixelLayout];
+    imread_assert(source.count != 0,
+                  "NSBitmapImageRep error in imageUsingImageFactory: unsupported sample format",
+                  FF("bitsPerSample = %i, bitmapFormat = %lu", bps, (unsigned long)[self bitmapFormat]));
+                  
     std::unique_ptr<Image> output(
                   factory->create(bps, height, width, channels));
+                  
+    bool transferred = objc::pixels::transfer(source,
+                                              objc::pixels::layout_of(*output),
+                                              width, height);
+    imread_assert(transferred,
+                  "NSBitmapImageRep error in imageUsingImageFactory: pixel transfer failed",
+                  FF("bitsPerSample = %i, samplesPerPixel = %li", bps, (long)channels));
+                  
+    return output;
+}
+
+- (NSBitmapImageRep*) bitmapImageRepByPremultiplyingAlpha {
+    NSBitmapFormat format = [self bitmapFormat];
+    if (![self hasAlpha] || !(format & NSAlphaNonpremultipliedBitmapFormat)) { return [self copy]; }
+    NSBitmapImageRep* out = objc::blank_like(self, format & ~NSAlphaNonpremultipliedBitmapFormat,
+                                                   [self colorSpace]);
+    if (!out) { return nil; }
+    
+    objc::halogen::buffer_t source, destination;
+    if (objc::halogen_buffer(self, source) &&
+        objc::halogen_buffer(out, destination) &&
+        objc::halogen::premultiply(source, destination)) { return out; }
+        
+    /// ... otherwise the pixel transfer premultiplies as it copies:
+    if (!objc::pixels::transfer([self pixelLayout], [out pixelLayout],
+                                [self pixelsWide], [self pixelsHigh])) { return nil; }
+    return out;
+}
+
+- (NSBitmapImageRep*) bitmapImageRepByUnpremultiplyingAlpha {
+    NSBitmapFormat format = [self bitmapFormat];
+    if (![self hasAlpha] || format & NSAlphaNonpremultipliedBitmapFormat) { return [self copy]; }
+    NSBitmapImageRep* out = objc::blank_like(self, format | NSAlphaNonpremultipliedBitmapFormat,
+                                                   [self colorSpace]);
+    if (!out) { return nil; }
     
-    if ([self bitmapFormat] & NSFloatingPointSamplesBitmapFormat) {
-        float* frowp = output->rowp_as<float>(0);
-        std::memcpy(frowp, reinterpret_cast<float*>([self bitmapData]),
-                           siz * height * width * channels);
-    } else {
-        byte* irowp = output->rowp_as<byte>(0);
-        std::memcpy(irowp, static_cast<byte*>([self bitmapData]),
-                           siz * height * width * channels);
+    objc::halogen::buffer_t source, destination;
+    if (objc::halogen_buffer(self, source) &&
+        objc::halogen_buffer(out, destination) &&
+        objc::halogen::unpremultiply(source, destination)) { return out; }
+        
+    if (!objc::pixels::transfer([self pixelLayout], [out pixelLayout],
+                                [self pixelsWide], [self pixelsHigh])) { return nil; }
+    return out;
+}
+
+- (NSBitmapImageRep*) bitmapImageRepByReorderingChannels:(std::array<uint8_t, 4>)order {
+    if ([self samplesPerPixel] != 4) { return nil; }
+    if (std::any_of(order.begin(), order.end(),
+                [](uint8_t channel) { return channel > 3; })) { return nil; }
+    NSBitmapImageRep* out = objc::blank_like(self, [self bitmapFormat], [self colorSpace]);
+    if (!out) { return nil; }
+    
+    objc::halogen::buffer_t source, destination;
+    if (objc::halogen_buffer(self, source) &&
+        objc::halogen_buffer(out, destination) &&
+        objc::halogen::reorder(source, destination, order)) { return out; }
+        
+    /// ... otherwise, transfer from a layout listing our channels in the new order
+    /// (with the destination's alpha mode, so nothing gets premultiplied):
+    objc::pixels::layout permuted = [self pixelLayout];
+    objc::pixels::layout target = [out pixelLayout];
+    if (permuted.count != 4) { return nil; }
+    std::array<objc::pixels::channel_t, objc::pixels::max_channels> channels = permuted.channels;
+    for (std::size_t c = 0; c < 4; ++c) {
+        channels[c] = permuted.channels[order[c]];
+    }
+    permuted.channels = channels;
+    permuted.mode = target.mode;
+    if (!objc::pixels::transfer(permuted, target,
+                                [self pixelsWide], [self pixelsHigh])) { return nil; }
+    return out;
+}
+
+- (NSBitmapImageRep*) bitmapImageRepByMatchingToColorSpace:(NSColorSpace*)colorSpace {
+    objc::halogen::colorspace from, to;
+    objc::halogen::buffer_t source, destination;
+    
+    if ([self hasAlpha] && [self bitmapFormat] & NSAlphaNonpremultipliedBitmapFormat &&
+        objc::halogen_colorspace([self colorSpace], from) &&
+        objc::halogen_colorspace(colorSpace, to) &&
+        objc::halogen_buffer(self, source)) {
+        NSBitmapImageRep* out = objc::blank_like(self, [self bitmapFormat], colorSpace);
+        if (out && objc::halogen_buffer(out, destination) &&
+            objc::halogen::convert(source, destination, from, to)) { return out; }
     }
     
-    return output;
+    /// ... otherwise ColorSync does it:
+    return [self bitmapImageRepByConvertingToColorSpace:colorSpace
+                                        renderingIntent:NSColorRenderingIntentDefault];
+}
+
+- (objc::pixels::layout) pixelLayout {
+    using objc::pixels::layout;
+    using objc::pixels::sample;
+    using objc::pixels::alpha;
+    NSBitmapFormat format = [self bitmapFormat];
+    NSInteger bps = [self bitsPerSample];
+    bool floating = format & NSFloatingPointSamplesBitmapFormat;
+    sample kind;
+    
+    if (!floating && bps == 8)          { kind = sample::u8;  }
+    else if (!floating && bps == 16)    { kind = sample::u16; }
+    else if (floating && bps == 32)     { kind = sample::f32; }
+    else                                { return layout{};    }
+    
+    std::size_t channels = [self samplesPerPixel];
+    bool alphafirst = format & NSAlphaFirstBitmapFormat;
+    alpha mode = ![self hasAlpha] ? alpha::none :
+                  format & NSAlphaNonpremultipliedBitmapFormat ? alpha::straight
+                                                               : alpha::premultiplied;
+                                                               
+    if ([self isPlanar]) {
+        unsigned char* planes[objc::pixels::max_channels] = { nullptr };
+        [self getBitmapDataPlanes:planes];
+        return layout::planar(planes, channels, kind,
+                              [self bytesPerRow], mode, alphafirst);
+    }
+    
+    return layout::interleaved([self bitmapData], channels, kind,
+                               [self bytesPerRow], [self bitsPerPixel] / 8,
+                               mode, alphafirst);
 }
 
 @end
\ No newline at end of file
@@ -2,11 +2,153 @@
 /// License: MIT (see COPYING.MIT file)
 
 #include <array>
+#include <vector>
 #include <algorithm>
+#include <type_traits>
 #include <subjective-c/categories/NSColor+IM.hh>
+#include <subjective-c/colors.hh>
+#import  <Accelerate/Accelerate.h>
 
 using namespace im;
 
+namespace objc {
+    
+    namespace {
+        
+        /// How a span of `Color` lies in memory: `stride` bytes apiece, the
+        /// first `colors` of which are color channels -- after those, alpha, or
+        /// the padding of a three-channel color in a four-byte composite:
+        template <typename Color>
+        struct span_traits {
+            static_assert(sizeof(typename Color::channel_t) == 1,
+                          "span conversions are for 8-bit colors");
+            static_assert(std::is_standard_layout<Color>::value,
+                          "span conversions need the channels at the front");
+            static constexpr std::size_t stride = sizeof(Color);
+            static constexpr std::size_t channels = Color::N;
+            static constexpr std::size_t colors = Color::N == 4 ? 3 : Color::N;
+            static constexpr bool alpha = Color::N == 4;
+            static constexpr NSColorSpaceModel model = colors == 1 ? NSGrayColorSpaceModel
+                                                                   : NSRGBColorSpaceModel;
+        };
+        
+        /// sRGB and linear sRGB, which the objc::colors kernels know how to do:
+        bool curve_for(NSColorSpace* space, objc::colors::curve& out) {
+            CGColorSpaceRef colorspace = [space CGColorSpace];
+            CFStringRef name = colorspace ? CGColorSpaceCopyName(colorspace) : nullptr;
+            if (!name) { return false; }
+            bool known = true;
+            if (CFEqual(name, CFSTR("kCGColorSpaceSRGB")))              { out = objc::colors::curve::srgb;   }
+            else if (CFEqual(name, CFSTR("kCGColorSpaceLinearSRGB")))   { out = objc::colors::curve::linear; }
+            else                                                        { known = false; }
+            CFRelease(name);
+            return known;
+        }
+        
+        template <typename Color>
+        BOOL convert_span(Color const* source, Color* destination, NSUInteger count,
+                          NSColorSpace* from, NSColorSpace* to) {
+            using traits = span_traits<Color>;
+            if (!from || !to || [from colorSpaceModel] != traits::model ||
+                                [to colorSpaceModel] != traits::model) { return NO; }
+            byte const* in = reinterpret_cast<byte const*>(source);
+            byte* out = reinterpret_cast<byte*>(destination);
+            
+            objc::colors::curve fromcurve, tocurve;
+            if ([from isEqual:to]) {
+                objc::colors::recode(in, out, count, traits::stride, traits::colors,
+                                     objc::colors::curve::linear, objc::colors::curve::linear);
+                return YES;
+            }
+            if (curve_for(from, fromcurve) && curve_for(to, tocurve)) {
+                objc::colors::recode(in, out, count, traits::stride, traits::colors,
+                                     fromcurve, tocurve);
+                return YES;
+            }
+            
+            /// ... otherwise, vImage -- which won't necessarily work in place --
+            /// a row of at most 4096 colors at a time:
+            std::vector<byte> copied;
+            if (in == out) {
+                copied.assign(in, in + count * traits::stride);
+                in = copied.data();
+            }
+            const CGBitmapInfo info = traits::alpha ? CGBitmapInfo(kCGImageAlphaLast)
+                                    : traits::stride > traits::channels ? CGBitmapInfo(kCGImageAlphaNoneSkipLast)
+                                                                        : CGBitmapInfo(kCGImageAlphaNone);
+            vImage_CGImageFormat informat = { 8, uint32_t(8 * traits::stride), [from CGColorSpace],
+                                              info, 0, nullptr, kCGRenderingIntentDefault };
+            vImage_CGImageFormat outformat = { 8, uint32_t(8 * traits::stride), [to CGColorSpace],
+                                               info, 0, nullptr, kCGRenderingIntentDefault };
+            vImage_Error error = kvImageNoError;
+            vImageConverterRef converter = vImageConverter_CreateWithCGImageFormat(&informat, &outformat,
+                                                                                   nullptr, kvImageNoFlags,
+                                                                                   &error);
+            if (!converter || error != kvImageNoError) { return NO; }
+            
+            const NSUInteger width = std::min<NSUInteger>(count, 4096);
+            NSUInteger done = 0;
+            while (done < count && error == kvImageNoError) {
+                const NSUInteger rows = std::max<NSUInteger>((count - done) / width, 1);
+                const NSUInteger columns = std::min(width, count - done);
+                vImage_Buffer inbuffer = { const_cast<byte*>(in) + done * traits::stride,
+                                           rows, columns, columns * traits::stride };
+                vImage_Buffer outbuffer = { out + done * traits::stride,
+                                            rows, columns, columns * traits::stride };
+                error = vImageConvert_AnyToAny(converter, &inbuffer, &outbuffer, nullptr, kvImageNoFlags);
+                done += rows * columns;
+            }
+            vImageConverter_Release(converter);
+            return error == kvImageNoError;
+        }
+        
+        template <typename Color>
+        NSArray<NSColor*>* colors_with(Color const* colors, NSUInteger count, NSColorSpace* space) {
+            using traits = span_traits<Color>;
+            if (!space || [space colorSpaceModel] != traits::model) { return nil; }
+            std::vector<float> components(count * traits::stride);
+            objc::colors::decode(reinterpret_cast<byte const*>(colors), components.data(),
+                                 count, traits::stride, traits::colors);
+                                 
+            NSMutableArray<NSColor*>* out = [NSMutableArray arrayWithCapacity:count];
+            std::array<CGFloat, traits::colors + 1> cgcomponents;
+            for (NSUInteger idx = 0; idx < count; ++idx) {
+                float const* color = components.data() + idx * traits::stride;
+                std::copy(color, color + traits::colors, cgcomponents.begin());
+                cgcomponents[traits::colors] = traits::alpha ? CGFloat(color[traits::colors]) : 1.0;
+                [out addObject:[NSColor colorWithColorSpace:space
+                                                 components:cgcomponents.data()
+                                                      count:cgcomponents.size()]];
+            }
+            return out;
+        }
+        
+        template <typename Color>
+        BOOL get_uniform(Color* destination, NSArray<NSColor*>* colors, NSColorSpace* space) {
+            using traits = span_traits<Color>;
+            const NSUInteger count = [colors count];
+            std::vector<float> components(count * traits::stride, 0.0f);
+            std::array<CGFloat, traits::colors + 1> cgcomponents;
+            NSUInteger idx = 0;
+            for (NSColor* color in colors) {
+                NSColor* converted = space ? [color colorUsingColorSpace:space] : color;
+                if (!converted ||
+                    [[converted colorSpace] colorSpaceModel] != traits::model ||
+                    NSUInteger([converted numberOfComponents]) != cgcomponents.size()) { return NO; }
+                [converted getComponents:cgcomponents.data()];
+                float* out = components.data() + idx++ * traits::stride;
+                std::copy(cgcomponents.begin(), cgcomponents.begin() + traits::colors, out);
+                if (traits::alpha) { out[traits::colors] = float(cgcomponents[traits::colors]); }
+            }
+            objc::colors::encode(components.data(), reinterpret_cast<byte*>(destination),
+                                 count, traits::stride, traits::colors);
+            return YES;
+        }
+        
+    } /// namespace (anon.)
+    
+} /// namespace objc
+
 @implementation NSColor (AXColorAdditions)
 
 + (instancetype) colorWithUniformRGBA:(color::RGBA const&)rgba {
@@ -75,4 +217,64 @@ using namespace im;
     return out;
 }
 
++ (BOOL) convertUniformRGBA:(color::RGBA const*)source
+              toUniformRGBA:(color::RGBA*)destination
+                      count:(NSUInteger)count
+             fromColorSpace:(NSColorSpace*)from
+               toColorSpace:(NSColorSpace*)to {
+    return objc::convert_span(source, destination, count, from, to);
+}
+
++ (BOOL) convertUniformRGB:(color::RGB const*)source
+              toUniformRGB:(color::RGB*)destination
+                     count:(NSUInteger)count
+            fromColorSpace:(NSColorSpace*)from
+              toColorSpace:(NSColorSpace*)to {
+    return objc::convert_span(source, destination, count, from, to);
+}
+
++ (BOOL) convertUniformMonochrome:(color::Monochrome const*)source
+              toUniformMonochrome:(color::Monochrome*)destination
+                            count:(NSUInteger)count
+                   fromColorSpace:(NSColorSpace*)from
+                     toColorSpace:(NSColorSpace*)to {
+    return objc::convert_span(source, destination, count, from, to);
+}
+
++ (NSArray<NSColor*>*) colorsWithUniformRGBA:(color::RGBA const*)colors
+                                       count:(NSUInteger)count
+                                  colorSpace:(NSColorSpace*)space {
+    return objc::colors_with(colors, count, space);
+}
+
++ (NSArray<NSColor*>*) colorsWithUniformRGB:(color::RGB const*)colors
+                                      count:(NSUInteger)count
+                                 colorSpace:(NSColorSpace*)space {
+    return objc::colors_with(colors, count, space);
+}
+
++ (NSArray<NSColor*>*) colorsWithUniformMonochrome:(color::Monochrome const*)colors
+                                             count:(NSUInteger)count
+                                        colorSpace:(NSColorSpace*)space {
+    return objc::colors_with(colors, count, space);
+}
+
++ (BOOL) getUniformRGBA:(color::RGBA*)destination
+             fromColors:(NSArray<NSColor*>*)colors
+             colorSpace:(NSColorSpace*)space {
+    return objc::get_uniform(destination, colors, space);
+}
+
++ (BOOL) getUniformRGB:(color::RGB*)destination
+            fromColors:(NSArray<NSColor*>*)colors
+            colorSpace:(NSColorSpace*)space {
+    return objc::get_uniform(destination, colors, space);
+}
+
++ (BOOL) getUniformMonochrome:(color::Monochrome*)destination
+                   fromColors:(NSArray<NSColor*>*)colors
+                   colorSpace:(NSColorSpace*)space {
+    return objc::get_uniform(destination, colors, space);
+}
+
 @end
\ No newline at end of file
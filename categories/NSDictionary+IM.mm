@@ -5,39 +5,29 @@
 #include <subjective-c/categories/NSData+IM.hh>
 #include <subjective-c/categories/NSString+STL.hh>
 #include <subjective-c/categories/NSDictionary+IM.hh>
+#include <subjective-c/json.hh>
 #include <libimread/errors.hh>
 
 using OptionsMap = im::Options;
 
-static const NSJSONReadingOptions readingOptions = static_cast<NSJSONReadingOptions>(0);
 static const NSJSONWritingOptions writingOptions = static_cast<NSJSONWritingOptions>(0);
 
 @implementation NSDictionary (AXDictionaryAdditions)
 
 + (instancetype) dictionaryWithOptionsMap:(OptionsMap const&)optionsMap {
-    NSDictionary* optionsDict;
-    NSError* error;
-    NSData* optionsJSON = [[NSData alloc] initWithSTLString:optionsMap.format()];
-    optionsDict = (NSDictionary*)[NSJSONSerialization JSONObjectWithData:optionsJSON
-                                                                 options:readingOptions
-                                                                   error:&error];
-    imread_assert(optionsDict != nil,
+    objc::json::document optionsJSON = objc::json::document::parse(optionsMap.format());
+    imread_assert(optionsJSON.root().is_object(),
                   "NSDictionary error in dictionaryWithOptionsMap:",
-                  [error.localizedDescription STLString]);
-    return optionsDict;
+                  "options are not a JSON object");
+    return (NSDictionary*)optionsJSON.root().materialize();
 }
 
 - initWithOptionsMap:(OptionsMap const&)optionsMap {
-    NSDictionary* optionsDict;
-    NSError* error;
-    NSData* optionsJSON = [[NSData alloc] initWithSTLString:optionsMap.format()];
-    optionsDict = (NSDictionary*)[NSJSONSerialization JSONObjectWithData:optionsJSON
-                                                                 options:readingOptions
-                                                                   error:&error];
-    imread_assert(optionsDict != nil,
+    objc::json::document optionsJSON = objc::json::document::parse(optionsMap.format());
+    imread_assert(optionsJSON.root().is_object(),
                   "NSDictionary error in initWithOptionsMap:",
-                  [error.localizedDescription STLString]);
-    return [self initWithDictionary:optionsDict];
+                  "options are not a JSON object");
+    return [self initWithDictionary:(NSDictionary*)optionsJSON.root().materialize()];
 }
 
 - (OptionsMap) asOptionsMap {
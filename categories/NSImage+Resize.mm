@@ -0,0 +1,139 @@
+//
+//  NSImage+Resize.m
+//  SIMBL
+//
+//  Created by Nate Parrott on 4/1/15.
+//
+//
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/resample.hh>
+#include <subjective-c/halogen.hh>
+#import  <subjective-c/categories/NSImage+Resize.h>
+
+namespace {
+    
+    objc::resample::filter kernel_for(AXResizeFilter filter) {
+        switch (filter) {
+            case AXResizeFilterBox:         return objc::resample::filter::box;
+            case AXResizeFilterBilinear:    return objc::resample::filter::bilinear;
+            case AXResizeFilterMitchell:    return objc::resample::filter::mitchell;
+            case AXResizeFilterLanczos3:
+            default:                        return objc::resample::filter::lanczos3;
+        }
+    }
+    
+    /// Premultiplied RGBA at both ends -- resampling straight alpha
+    /// would bleed color out of transparent pixels:
+    NSBitmapImageRep* bitmap(NSInteger width, NSInteger height, bool floating) {
+        return [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                       pixelsWide:width
+                                                       pixelsHigh:height
+                                                    bitsPerSample:floating ? 32 : 8
+                                                  samplesPerPixel:4
+                                                         hasAlpha:YES
+                                                         isPlanar:NO
+                                                   colorSpaceName:NSDeviceRGBColorSpace
+                                                     bitmapFormat:floating ? NSFloatingPointSamplesBitmapFormat : 0
+                                                      bytesPerRow:0
+                                                     bitsPerPixel:0];
+    }
+    
+} /// namespace (anon.)
+
+@implementation NSImage (Resize)
+
+#pragma mark Helpers
+
+- (NSImage*) resizeImageToSize:(NSSize)size {
+    return [self imageByResamplingToSize:size
+                                fromRect:NSZeroRect
+                                  filter:AXResizeFilterLanczos3];
+}
+
+- (NSImage*) resizeImageToSize:(NSSize)size
+                        filter:(AXResizeFilter)filter {
+    return [self imageByResamplingToSize:size
+                                fromRect:NSZeroRect
+                                  filter:filter];
+}
+
+- (NSImage*) resizeImageWithMaxDimension:(NSSize)size {
+    CGFloat scale = MIN(size.width * 1.0 / self.size.width,
+                        size.height * 1.0 / self.size.height);
+    return [self resizeImageToSize:NSMakeSize(self.size.width * scale,
+                                              self.size.height * scale)];
+}
+
+- (NSImage*) imageByResamplingToSize:(NSSize)size
+                            fromRect:(NSRect)sourceRect
+                              filter:(AXResizeFilter)filter {
+    const NSInteger width = std::lround(size.width);
+    const NSInteger height = std::lround(size.height);
+    CGImageRef source = [self CGImageForProposedRect:NULL context:nil hints:nil];
+    if (!source || width < 1 || height < 1) { return nil; }
+    
+    const std::size_t sourcewidth = CGImageGetWidth(source);
+    const std::size_t sourceheight = CGImageGetHeight(source);
+    const bool floating = CGImageGetBitmapInfo(source) & kCGBitmapFloatComponents;
+    const std::size_t samplesize = floating ? sizeof(float) : 1;
+    const std::size_t rowbytes = sourcewidth * 4 * samplesize;
+    
+    /// get the source pixels as premultiplied RGBA, in the output's color space:
+    std::vector<objc::byte> pixels(rowbytes * sourceheight);
+    CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(pixels.data(), sourcewidth, sourceheight,
+                                                 samplesize * 8, rowbytes, colorspace,
+                                                 floating ? kCGImageAlphaPremultipliedLast |
+                                                            kCGBitmapFloatComponents |
+                                                            kCGBitmapByteOrder32Host
+                                                          : kCGImageAlphaPremultipliedLast);
+    CGColorSpaceRelease(colorspace);
+    if (!context) { return nil; }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, sourcewidth, sourceheight), source);
+    CGContextRelease(context);
+    
+    /// the source rect, flipped to top-left-origin pixels:
+    objc::resample::options opts;
+    opts.kernel = kernel_for(filter);
+    if (!NSIsEmptyRect(sourceRect) && self.size.width > 0 && self.size.height > 0) {
+        const double sx = double(sourcewidth) / self.size.width;
+        const double sy = double(sourceheight) / self.size.height;
+        const double left   = std::max(0.0, NSMinX(sourceRect) * sx);
+        const double right  = std::min(double(sourcewidth), NSMaxX(sourceRect) * sx);
+        const double top    = std::max(0.0, (self.size.height - NSMaxY(sourceRect)) * sy);
+        const double bottom = std::min(double(sourceheight), (self.size.height - NSMinY(sourceRect)) * sy);
+        if (right <= left || bottom <= top) { return nil; }
+        opts.region = objc::resample::region_t{ left, top, right - left, bottom - top };
+    }
+    
+    NSBitmapImageRep* output = bitmap(width, height, floating);
+    objc::resample::buffer_t in;
+    in.data = pixels.data();
+    in.width = sourcewidth;
+    in.height = sourceheight;
+    in.channels = 4;
+    in.rowbytes = rowbytes;
+    in.kind = floating ? objc::pixels::sample::f32 : objc::pixels::sample::u8;
+    objc::resample::buffer_t out = in;
+    out.data = [output bitmapData];
+    out.width = width;
+    out.height = height;
+    out.rowbytes = [output bytesPerRow];
+    
+    /// the Halide pipeline, if it's built in -- else objc::resample's own kernels:
+    if (!objc::halogen::resize(in, out, opts) &&
+        !objc::resample::resize(in, out, opts)) { return nil; }
+        
+    [output setSize:size];
+    NSImage* image = [[NSImage alloc] initWithSize:size];
+    [image addRepresentation:output];
+    return image;
+}
+
+@end
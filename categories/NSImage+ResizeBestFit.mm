@@ -0,0 +1,101 @@
+//
+//  NSImage+Resize.m
+//  PhotoNoteBook
+//
+//  Created by 안 진섭 on 6/11/12.
+//  Copyright (c) 2012 __MyCompanyName__. All rights reserved.
+//
+
+#import <subjective-c/categories/NSImage+ResizeBestFit.h>
+#import <subjective-c/categories/NSImage+Resize.h>
+#include <subjective-c/encoder.hh>
+
+@implementation NSImage (ResizeImageBestFit)
+
+- (NSImage*) imageByBestFitForSize:(CGSize)targetSize {
+    CGFloat aspectRatio = (float)self.size.width / (float)self.size.height;
+    CGFloat targetHeight = targetSize.height;
+    CGFloat scaledWidth = targetSize.height * aspectRatio;
+    CGFloat targetWidth = (targetSize.width < scaledWidth) ? targetSize.width : scaledWidth;
+    return [self imageByScalingAndCroppingForSize:CGSizeMake(targetWidth, targetHeight)];
+}
+
+- (NSImage*) imageByScalingAndCroppingForSize:(CGSize)targetSize {
+    CGSize imageSize = self.size;
+    CGFloat width = imageSize.width;
+    CGFloat height = imageSize.height;
+    CGFloat targetWidth = targetSize.width;
+    CGFloat targetHeight = targetSize.height;
+    NSRect sourceRect = NSMakeRect(0.0f, 0.0f, width, height);
+    
+    if (CGSizeEqualToSize(imageSize, targetSize) == NO) {
+        CGFloat widthFactor = targetWidth / width;
+        CGFloat heightFactor = targetHeight / height;
+        CGFloat scaleFactor = MAX(widthFactor, heightFactor);
+        
+        // crop whatever overhangs the target, keeping the image centered
+        sourceRect.size.width  = MIN(width, targetWidth / scaleFactor);
+        sourceRect.size.height = MIN(height, targetHeight / scaleFactor);
+        sourceRect.origin.x = (width - sourceRect.size.width) * 0.5f;
+        sourceRect.origin.y = (height - sourceRect.size.height) * 0.5f;
+    }
+    
+    return [self imageByResamplingToSize:NSMakeSize(targetWidth, targetHeight)
+                                fromRect:sourceRect
+                                  filter:AXResizeFilterLanczos3];
+}
+
+- (NSData*) PNGData {
+    CGImageRef image = [self CGImageForProposedRect:NULL context:nil hints:nil];
+    return objc::cg::encoder::local().encode(image, objc::cg::encoding::png, 1.0f);
+}
+
+- (NSData*) JPEGData {
+    return [self JPEGDataWithCompression:1.0f];
+}
+
+- (NSData*) JPEGDataWithCompression:(float)factor {
+    CGImageRef image = [self CGImageForProposedRect:NULL context:nil hints:nil];
+    return objc::cg::encoder::local().encode(image, objc::cg::encoding::jpeg, factor);
+}
+
+- (BOOL) appendPNGDataTo:(NSMutableData*)sink {
+    CGImageRef image = [self CGImageForProposedRect:NULL context:nil hints:nil];
+    return objc::cg::encoder::local().encode(image, objc::cg::encoding::png, 1.0f, sink);
+}
+
+- (BOOL) appendJPEGDataTo:(NSMutableData*)sink compression:(float)factor {
+    CGImageRef image = [self CGImageForProposedRect:NULL context:nil hints:nil];
+    return objc::cg::encoder::local().encode(image, objc::cg::encoding::jpeg, factor, sink);
+}
+
+- (NSBitmapImageRep*) bestBitmapImageRep {
+    NSBitmapImageRep* best = nil;
+    NSInteger bestpixels = 0;
+    for (NSImageRep* rep in [self representations]) {
+        if (![rep isKindOfClass:[NSBitmapImageRep class]]) { continue; }
+        NSInteger pixels = [rep pixelsWide] * [rep pixelsHigh];
+        if (pixels > bestpixels) {
+            best = (NSBitmapImageRep*)rep;
+            bestpixels = pixels;
+        }
+    }
+    return best;
+}
+
+- (NSData*) dataForImageFileType:(NSBitmapImageFileType)type {
+    NSBitmapImageRep* rep = [self bestBitmapImageRep];
+    if (!rep) {
+        CGImageRef image = [self CGImageForProposedRect:NULL context:nil hints:nil];
+        if (!image) { return nil; }
+        rep = [[NSBitmapImageRep alloc] initWithCGImage:image];
+    }
+    switch (type) {
+        case NSPNGFileType:     { return objc::cg::encoder::local().encode([rep CGImage],
+                                                                           objc::cg::encoding::png, 1.0f); }
+        case NSTIFFFileType:    { return [rep TIFFRepresentation]; }
+        default:                { return [rep representationUsingType:type properties:@{}]; }
+    }
+}
+
+@end
@@ -1,8 +1,11 @@
 /// Copyright 2014 Alexander Böhn <fish2000@gmail.com>
 /// License: MIT (see COPYING.MIT file)
 
+#include <cstring>
+#include <algorithm>
 #include <subjective-c/subjective-c.hpp>
 #include <libimread/ext/filesystem/path.h>
+#include <libimread/seekable.hh>
 #import  <subjective-c/categories/NSString+STL.hh>
 #import  <subjective-c/categories/NSURL+IM.hh>
 
@@ -41,28 +44,158 @@ namespace objc {
             }
         }
         
-        NSInteger filetype(std::string const& suffix) {
-            if (suffix == "tiff" || suffix == ".tiff" ||
-                suffix == "tif"  || suffix == ".tif") {
-                return static_cast<NSInteger>(NSTIFFFileType);
-            } else if (suffix == "bmp"   || suffix == ".bmp") {
-                return static_cast<NSInteger>(NSBMPFileType);
-            } else if (suffix == "gif"   || suffix == ".gif") {
-                return static_cast<NSInteger>(NSGIFFileType);
-            } else if (suffix == "jpg"   || suffix == ".jpg" ||
-                       suffix == "jpeg"  || suffix == ".jpeg") {
-                return static_cast<NSInteger>(NSJPEGFileType);
-            } else if (suffix == "png"   || suffix == ".png") {
-                return static_cast<NSInteger>(NSPNGFileType);
-            } else if (suffix == "jp2"   || suffix == ".jp2") {
-                return static_cast<NSInteger>(NSJPEG2000FileType);
-            } else if (suffix == "pvr"   || suffix == ".pvr" ||
-                       suffix == "pvrtc" || suffix == ".pvrtc") {
-                return static_cast<NSInteger>(AXPVRFileType);
-            } else {
-                /// NO MATCH
-                return -1;
+        NSInteger filetype(std::string_view suffix) {
+            return detail::lookup(suffix);
+        }
+        
+        namespace {
+            
+            /// A URL's image type, by its extension -- taken from the file-system
+            /// representation for file URLs, which doesn't allocate; other URLs
+            /// (http:, data: &c.) may not have one, and go by -pathExtension:
+            NSInteger url_filetype(NSURL* url) {
+                if (url.isFileURL) {
+                    char const* representation = url.fileSystemRepresentation;
+                    return representation ? filetype(extension(representation)) : -1;
+                }
+                NSString* pathExtension = url.pathExtension;
+                char const* utf8 = pathExtension.UTF8String;
+                return utf8 ? filetype(std::string_view(utf8)) : -1;
+            }
+            
+        }
+        
+        std::string uti(NSBitmapImageFileType nstype) {
+            switch (nstype) {
+                case NSTIFFFileType:        { return "public.tiff";         }
+                case NSJPEGFileType:        { return "public.jpeg";         }
+                case NSPNGFileType:         { return "public.png";          }
+                case NSGIFFileType:         { return "com.compuserve.gif";  }
+                case NSBMPFileType:         { return "com.microsoft.bmp";   }
+                case NSJPEG2000FileType:    { return "public.jpeg-2000";    }
+                default:                    { return "";                    }
+            }
+        }
+        
+        namespace {
+            
+            /// Magic-byte signatures, as masked little-endian words over the
+            /// first 16 bytes of the file: a match is `(head & mask) == value`
+            /// for both words, which the compiler lowers to a handful of
+            /// wide compares instead of a byte-by-byte memcmp() chain.
+            
+            struct signature_t {
+                uint64_t value[2];
+                uint64_t mask[2];
+                NSBitmapImageFileType typecode;
+            };
+            
+            template <std::size_t N> inline
+            constexpr signature_t signature(char const (&magic)[N],
+                                            NSBitmapImageFileType typecode,
+                                            std::size_t offset = 0) {
+                signature_t out{ { 0, 0 }, { 0, 0 }, typecode };
+                for (std::size_t idx = 0; idx < N - 1; ++idx) {
+                    std::size_t pos = offset + idx;
+                    uint64_t octet = static_cast<unsigned char>(magic[idx]);
+                    out.value[pos / 8] |= octet << (8 * (pos % 8));
+                    out.mask[pos / 8]  |= uint64_t(0xFF) << (8 * (pos % 8));
+                }
+                return out;
+            }
+            
+            constexpr signature_t signatures[] = {
+                signature("\x89PNG\r\n\x1A\n",                      NSPNGFileType),
+                signature("\xFF\xD8\xFF",                           NSJPEGFileType),
+                signature("GIF87a",                                 NSGIFFileType),
+                signature("GIF89a",                                 NSGIFFileType),
+                signature("II*\0",                                  NSTIFFFileType),
+                signature("MM\0*",                                  NSTIFFFileType),
+                signature("II+\0",                                  NSTIFFFileType),
+                signature("MM\0+",                                  NSTIFFFileType),
+                signature("\0\0\0\x0CjP  \r\n\x87\n",               NSJPEG2000FileType),
+                signature("\xFF\x4F\xFF\x51",                       NSJPEG2000FileType),
+                signature("PVR\x03",                                AXPVRFileType),
+                signature("\x03RVP",                                AXPVRFileType)
+            };
+            
+            inline uint64_t load_le64(byte const* bytes) {
+                uint64_t out = 0;
+                for (std::size_t idx = 0; idx < 8; ++idx) {
+                    out |= static_cast<uint64_t>(bytes[idx]) << (8 * idx);
+                }
+                return out;
+            }
+            
+            /// exactly four bytes -- callers check `size` for just those:
+            inline uint32_t load_le32(byte const* bytes) {
+                return static_cast<uint32_t>(bytes[0])         |
+                       static_cast<uint32_t>(bytes[1]) << 8    |
+                       static_cast<uint32_t>(bytes[2]) << 16   |
+                       static_cast<uint32_t>(bytes[3]) << 24;
+            }
+            
+            /// BMP only has a two-byte magic number, so also insist
+            /// on the four reserved (zeroed) bytes that follow the file size:
+            inline bool is_bmp(byte const* head) {
+                return head[0] == 'B' && head[1] == 'M' &&
+                       load_le32(head + 6) == 0;
+            }
+            
+            /// Legacy (v2) PVR headers start with their own size (52 bytes)
+            /// and keep the "PVR!" tag at offset 44 -- past the sniffing window,
+            /// so it's only checked when the caller has that many bytes on hand;
+            /// otherwise the bits-per-pixel field at offset 24 has to do.
+            inline bool is_legacy_pvr(byte const* head, std::size_t size) {
+                if (load_le32(head) != 52) { return false; }
+                if (size >= 48) { return std::memcmp(head + 44, "PVR!", 4) == 0; }
+                switch (load_le32(head + 24)) {
+                    case 2: case 4: case 8: case 16: case 24: case 32:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+            
+        }
+        
+        NSInteger sniff(byte const* head, std::size_t size) {
+            if (head == nullptr) { return -1; }
+            
+            /// short inputs are zero-padded, and signatures reaching
+            /// past the end of the valid bytes are masked out:
+            byte window[16] = { 0 };
+            std::memcpy(window, head, std::min(size, sizeof(window)));
+            uint64_t const head0 = load_le64(window);
+            uint64_t const head1 = load_le64(window + 8);
+            uint64_t const valid0 = size >= 8  ? ~uint64_t(0) : (uint64_t(1) << (8 * size)) - 1;
+            uint64_t const valid1 = size >= 16 ? ~uint64_t(0) : size <= 8 ? 0 :
+                                                 (uint64_t(1) << (8 * (size - 8))) - 1;
+                                                 
+            for (signature_t const& sig : signatures) {
+                if ((sig.mask[0] & ~valid0) | (sig.mask[1] & ~valid1)) { continue; }
+                if (((head0 & sig.mask[0]) == sig.value[0]) &
+                    ((head1 & sig.mask[1]) == sig.value[1])) {
+                    return static_cast<NSInteger>(sig.typecode);
+                }
+            }
+            
+            if (size >= 10 && is_bmp(head))         { return static_cast<NSInteger>(NSBMPFileType); }
+            if (size >= 28 && is_legacy_pvr(head,
+                                            size))  { return static_cast<NSInteger>(AXPVRFileType); }
+            return -1;
+        }
+        
+        NSInteger sniff(im::byte_source& source) {
+            /// mapped sources (files, NSData) hand over their bytes for free --
+            if (byte const* mapped = static_cast<byte const*>(source.readmap())) {
+                return sniff(mapped, std::min(source.size(), sniff_size));
             }
+            /// ... everything else gets one read, rewound when possible:
+            byte head[sniff_size] = { 0 };
+            std::size_t size = source.read(head, sniff_size);
+            if (source.can_seek()) { source.seek_relative(-static_cast<int>(size)); }
+            return sniff(head, size);
         }
         
     }
@@ -108,15 +241,11 @@ namespace objc {
 }
 
 - (BOOL) isImage {
-    return objc::boolean(
-        objc::image::filetype(
-            [[self.pathExtension lowercaseString] STLString]) != -1);
+    return objc::boolean(objc::image::url_filetype(self) != -1);
 }
 
 - (NSBitmapImageFileType) imageFileType {
-    return static_cast<NSBitmapImageFileType>(
-        objc::image::filetype(
-            [[self.pathExtension lowercaseString] STLString]));
+    return static_cast<NSBitmapImageFileType>(objc::image::url_filetype(self));
 }
 
 - (filesystem::path) filesystemPath {
@@ -8,7 +8,10 @@
 // distributed with this project and can also be found at
 // <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
 
+#include <memory>
+#include <algorithm>
 #include <subjective-c/subjective-c.hpp>
+#include <subjective-c/tiles.hh>
 #import  <subjective-c/classes/AXCoreGraphicsImageRep.h>
 #import  <Foundation/Foundation.h>
 #import  <AppKit/NSGraphics.h>
@@ -32,7 +35,11 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
     return out;
 }
 
-@implementation AXCoreGraphicsImageRep : NSImageRep
+@implementation AXCoreGraphicsImageRep : NSImageRep {
+    std::shared_ptr<objc::cg::mip_pyramid> pyramid;
+    std::size_t threshold;
+    BOOL untiled;
+}
 
 + (void) initialize {
     OBJC_INITIALIZE(super);
@@ -46,6 +53,7 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
     cgImage = myImage;
     CGImageRetain(cgImage);
     colorSpaceName = [space copy];
+    threshold = objc::cg::mip_pyramid::default_threshold;
     
     return self;
 }
@@ -61,11 +69,70 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
 }
 
 /// API
+- (CGImageRef) CGImage {
+    return cgImage;
+}
+
 - (void) setImage:(CGImageRef)newImage {
     if (cgImage != newImage) {
         if (cgImage != NULL) { CGImageRelease(cgImage); }
         cgImage = CGImageRetain(newImage);
+        @synchronized(self) {
+            pyramid.reset();
+        }
+    }
+}
+
+- (void) setTiled:(BOOL)tiled {
+    untiled = !tiled;
+    if (untiled) {
+        @synchronized(self) {
+            pyramid.reset();
+        }
+    }
+}
+
+- (BOOL) isTiled {
+    return !untiled;
+}
+
+- (void) setTileThreshold:(NSUInteger)newthreshold {
+    threshold = static_cast<std::size_t>(newthreshold);
+}
+
+- (NSUInteger) tileThreshold {
+    return static_cast<NSUInteger>(threshold);
+}
+
++ (void) setTileCacheBudget:(NSUInteger)budget {
+    objc::cg::tile_cache::shared().budget(static_cast<std::size_t>(budget));
+}
+
++ (NSUInteger) tileCacheBudget {
+    return static_cast<NSUInteger>(objc::cg::tile_cache::shared().budget());
+}
+
+- (BOOL) drawImage:(CGImageRef)image inRect:(CGRect)where {
+    if (image == NULL) { return NO; }
+    CGContextRef context = (CGContextRef)[[NSGraphicsContext currentContext] graphicsPort];
+    const std::size_t tilesize = objc::cg::mip_pyramid::default_tile_size;
+    
+    if (untiled || (CGImageGetWidth(image) <= std::max(threshold, tilesize) &&
+                    CGImageGetHeight(image) <= std::max(threshold, tilesize))) {
+        CGContextDrawImage(context, where, image);
+        return YES;
     }
+    
+    /// hold a reference, in case the image gets replaced mid-draw:
+    std::shared_ptr<objc::cg::mip_pyramid> mip;
+    @synchronized(self) {
+        if (!pyramid || pyramid->base() != image) {
+            pyramid = std::make_shared<objc::cg::mip_pyramid>(image, tilesize);
+        }
+        mip = pyramid;
+    }
+    mip->draw(context, where);
+    return YES;
 }
 
 - (void) setColorSpaceHolder:(id<NSObject, NSCopying>)anObject {
@@ -100,34 +167,26 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
 }
 
 - (BOOL) draw {
-    if (cgImage == NULL) { return NO; }
-    CGRect where = CGRectWithPointAndSize({0, 0},
-                                          CGImageGetWidth(cgImage),
-                                          CGImageGetHeight(cgImage));
-    
-    CGContextDrawImage((CGContextRef)[[NSGraphicsContext currentContext] graphicsPort],
-                       where, cgImage);
-    return YES;
+    CGImageRef image = [self CGImage];
+    if (image == NULL) { return NO; }
+    return [self drawImage:image
+                    inRect:CGRectWithPointAndSize({0, 0},
+                                                  CGImageGetWidth(image),
+                                                  CGImageGetHeight(image))];
 }
 
 - (BOOL) drawAtPoint:(NSPoint)point {
-    if (cgImage == NULL) { return NO; }
-    CGRect where = CGRectWithPointAndSize(point,
-                                          CGImageGetWidth(cgImage),
-                                          CGImageGetHeight(cgImage));
-    
-    CGContextDrawImage((CGContextRef)[[NSGraphicsContext currentContext] graphicsPort],
-                       where, cgImage);
-    return YES;
+    CGImageRef image = [self CGImage];
+    if (image == NULL) { return NO; }
+    return [self drawImage:image
+                    inRect:CGRectWithPointAndSize(point,
+                                                  CGImageGetWidth(image),
+                                                  CGImageGetHeight(image))];
 }
 
 - (BOOL) drawInRect:(NSRect)rect {
-    if (cgImage == NULL) { return NO; }
-    CGRect where = CGRectWithRect(rect);
-    
-    CGContextDrawImage((CGContextRef)[[NSGraphicsContext currentContext] graphicsPort],
-                       where, cgImage);
-    return YES;
+    return [self drawImage:[self CGImage]
+                    inRect:CGRectWithRect(rect)];
 }
 
 - (BOOL) hasAlpha {
@@ -137,7 +196,7 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
         case kCGImageAlphaNoneSkipLast:
         case kCGImageAlphaNoneSkipFirst:
             return NO;
-        
+            
         case kCGImageAlphaPremultipliedLast:
         case kCGImageAlphaPremultipliedFirst:
         case kCGImageAlphaLast:
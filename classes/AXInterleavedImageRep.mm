@@ -1,78 +1,112 @@
 /// Copyright 2012-2015 Alexander Bohn <fish2000@gmail.com>
 /// License: MIT (see COPYING.MIT file)
 
+#include <cstring>
 #include <subjective-c/classes/AXInterleavedImageRep.hh>
 #include <subjective-c/subjective-c.hpp>
+#include <subjective-c/bufferpool.hh>
+#include <libimread/errors.hh>
 
-template <>
-__attribute__((cf_returns_not_retained))
-CGImageRef CGImageFromInterleaved<RGB>(
-    const im::InterleavedImage<RGB>& interleaved,
-    __attribute__((cf_consumed))
-        CGColorSpaceRef colorspace) {
-    CGContextRef context = CGBitmapContextCreate(
-        interleaved.data(),
-        interleaved.width(),
-        interleaved.height(),
-        interleaved.nbits(), /// bits per component
-        interleaved.width(), /// bytes per row
-        colorspace, kCGImageAlphaNone);
+namespace {
     
-    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
-    CGContextSetShouldAntialias(context, NO);
-    CGImageRef imageref = CGBitmapContextCreateImage(context);
-    CGContextRelease(context);
-    CGColorSpaceRelease(colorspace);
+    template <typename Color>
+    std::size_t bytesize(const im::InterleavedImage<Color>& interleaved) {
+        using traits = objc::cg::color_traits<Color>;
+        return std::size_t(interleaved.width()) *
+               std::size_t(interleaved.height()) * traits::channels * traits::bits / 8;
+    }
     
-    return imageref;
-}
+    template <typename Color>
+    CGImageRef CGImageWithProvider(std::size_t width, std::size_t height,
+                                   __attribute__((cf_consumed)) CGDataProviderRef provider,
+                                   __attribute__((cf_consumed)) CGColorSpaceRef colorspace) {
+        using traits = objc::cg::color_traits<Color>;
+        const std::size_t components = traits::channels - std::size_t(traits::alpha);
+        
+        if (!colorspace || CGColorSpaceGetNumberOfComponents(colorspace) != components) {
+            CGColorSpaceRelease(colorspace);
+            colorspace = components == 1 ? CGColorSpaceCreateDeviceGray()
+                                         : CGColorSpaceCreateDeviceRGB();
+        }
+        
+        CGImageRef imageref = CGImageCreate(
+            width, height,
+            traits::bits,                                   /// bits per component
+            traits::bits * traits::channels,                /// bits per pixel
+            width * traits::channels * traits::bits / 8,    /// bytes per row -- not pixels
+            colorspace, traits::info, provider,
+            nullptr, false, kCGRenderingIntentDefault);
+            
+        CGDataProviderRelease(provider);
+        CGColorSpaceRelease(colorspace);
+        return imageref;
+    }
+    
+    template <typename Color>
+    void CGReleaseInterleaved(void* info, void const*, std::size_t) {
+        delete static_cast<std::shared_ptr<im::InterleavedImage<Color>>*>(info);
+    }
+    
+    /// Lazy reps that currently hold a CGImage -- weakly, so a rep
+    /// going away needs no bookkeeping. The first call also starts
+    /// listening for memory-pressure notifications:
+    NSHashTable* materialized() {
+        static NSHashTable* reps = nil;
+        static dispatch_source_t pressure = nil;
+        static dispatch_once_t once;
+        dispatch_once(&once, ^{
+            reps = [NSHashTable weakObjectsHashTable];
+            pressure = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                              DISPATCH_MEMORYPRESSURE_WARN |
+                                              DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                              dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+            dispatch_source_set_event_handler(pressure, ^{
+                [AXInterleavedImageRep evictMaterializedImages];
+            });
+            dispatch_resume(pressure);
+        });
+        return reps;
+    }
+    
+} /// namespace (anon.)
 
-template <>
-__attribute__((cf_returns_not_retained))
-CGImageRef CGImageFromInterleaved<RGBA>(
-    const im::InterleavedImage<RGBA>& interleaved,
+template <typename Color>
+__attribute__((cf_returns_retained))
+CGImageRef CGImageFromInterleaved(
+    const im::InterleavedImage<Color>& interleaved,
     __attribute__((cf_consumed))
         CGColorSpaceRef colorspace) {
-    CGContextRef context = CGBitmapContextCreate(
-        interleaved.data(),
-        interleaved.width(),
-        interleaved.height(),
-        interleaved.nbits(), /// bits per component
-        interleaved.width(), /// bytes per row
-        colorspace, kCGImageAlphaLast);
-    
-    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
-    CGContextSetShouldAntialias(context, NO);
-    CGImageRef imageref = CGBitmapContextCreateImage(context);
-    CGContextRelease(context);
-    CGColorSpaceRelease(colorspace);
-    
-    return imageref;
+    const std::size_t size = bytesize(interleaved);
+    objc::byte* pixels = nullptr;
+    CGDataProviderRef provider = objc::cg::buffer_pool::shared().provider(size, &pixels);
+    std::memcpy(pixels, interleaved.data(), size);
+    return CGImageWithProvider<Color>(interleaved.width(), interleaved.height(),
+                                      provider, colorspace);
 }
 
-template <>
-__attribute__((cf_returns_not_retained))
-CGImageRef CGImageFromInterleaved<Monochrome>(
-    const im::InterleavedImage<Monochrome>& interleaved,
+template <typename Color>
+__attribute__((cf_returns_retained))
+CGImageRef CGImageFromInterleaved(
+    std::shared_ptr<im::InterleavedImage<Color>> interleaved,
     __attribute__((cf_consumed))
         CGColorSpaceRef colorspace) {
-    CGContextRef context = CGBitmapContextCreate(
-        interleaved.data(),
-        interleaved.width(),
-        interleaved.height(),
-        interleaved.nbits(), /// bits per component
-        interleaved.width(), /// bytes per row
-        colorspace, kCGImageAlphaNone);
-    
-    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
-    CGContextSetShouldAntialias(context, NO);
-    CGImageRef imageref = CGBitmapContextCreateImage(context);
-    CGContextRelease(context);
-    CGColorSpaceRelease(colorspace);
-    
-    return imageref;
+    const std::size_t width = interleaved->width();
+    const std::size_t height = interleaved->height();
+    const std::size_t size = bytesize(*interleaved);
+    void const* pixels = interleaved->data();
+    CGDataProviderRef provider = CGDataProviderCreateWithData(
+        new std::shared_ptr<im::InterleavedImage<Color>>(std::move(interleaved)),
+        pixels, size, CGReleaseInterleaved<Color>);
+    return CGImageWithProvider<Color>(width, height, provider, colorspace);
 }
 
+template CGImageRef CGImageFromInterleaved<RGB>(const im::InterleavedImage<RGB>&, CGColorSpaceRef);
+template CGImageRef CGImageFromInterleaved<RGBA>(const im::InterleavedImage<RGBA>&, CGColorSpaceRef);
+template CGImageRef CGImageFromInterleaved<Monochrome>(const im::InterleavedImage<Monochrome>&, CGColorSpaceRef);
+template CGImageRef CGImageFromInterleaved<RGB>(std::shared_ptr<im::InterleavedImage<RGB>>, CGColorSpaceRef);
+template CGImageRef CGImageFromInterleaved<RGBA>(std::shared_ptr<im::InterleavedImage<RGBA>>, CGColorSpaceRef);
+template CGImageRef CGImageFromInterleaved<Monochrome>(std::shared_ptr<im::InterleavedImage<Monochrome>>, CGColorSpaceRef);
+
 @implementation AXInterleavedImageRep : AXCoreGraphicsImageRep
 
 + (void) initialize {
@@ -91,46 +125,137 @@ CGImageRef CGImageFromInterleaved<Monochrome>(
 }
 
 - initWithInterleaved:(const Interleaved&)interleaved {
-    
-    if (!(self = [super init])) { return nil; }
-    interleavedImage = interleaved;
-    
-    CGImageRef imageref = CGImageFromInterleaved(
-        interleaved,
-        CGColorSpaceCreateDeviceRGB());
-    
-    NSString* space = objc::bridge<NSString*>(kCGColorSpaceGenericRGB);
-    
-    return [self initWithImageRef:imageref
-                   colorSpaceName:space];
+    return [self initWithInterleaved:interleaved
+                      colorSpaceName:objc::bridge<NSString*>(kCGColorSpaceGenericRGB)];
 }
 
 - initWithInterleaved:(const Interleaved&)interleaved
        colorSpaceName:(NSString*)space {
+       
+    /// one copy of the pixels, shared by the rep and its CGImage:
+    auto shared = std::make_shared<Interleaved>(interleaved);
+    CGImageRef imageref = CGImageFromInterleaved(shared, CGColorSpaceCreateDeviceRGB());
     
-    if (!(self = [super init])) { return nil; }
-    interleavedImage = interleaved;
-    
-    CGImageRef imageref = CGImageFromInterleaved(
-        interleaved,
-        CGColorSpaceCreateDeviceRGB());
-    
-    return [self initWithImageRef:imageref
-                   colorSpaceName:space];
+    if ((self = [super initWithImageRef:imageref
+                         colorSpaceName:space])) {
+        interleavedImage = std::move(shared);
+        lazy = NO;
+    }
+    CGImageRelease(imageref);
+    return self;
+}
+
++ (instancetype) lazyImageRepWithInterleaved:(std::shared_ptr<Interleaved>)interleaved {
+    return [[AXInterleavedImageRep alloc] initLazilyWithInterleaved:std::move(interleaved)];
+}
+
+- initLazilyWithInterleaved:(std::shared_ptr<Interleaved>)interleaved {
+    return [self initLazilyWithInterleaved:std::move(interleaved)
+                            colorSpaceName:objc::bridge<NSString*>(kCGColorSpaceGenericRGB)];
+}
+
+- initLazilyWithInterleaved:(std::shared_ptr<Interleaved>)interleaved
+             colorSpaceName:(NSString*)space {
+             
+    imread_assert(interleaved.get() != nullptr,
+                  "-[AXInterleavedImageRep initLazilyWithInterleaved:] needs an image");
+    if (!(self = [super initWithImageRef:NULL
+                          colorSpaceName:space])) { return nil; }
+    interleavedImage = std::move(interleaved);
+    lazy = YES;
+    [self setSize:NSMakeSize(interleavedImage->width(),
+                             interleavedImage->height())];
+    return self;
+}
+
++ (void) evictMaterializedImages {
+    NSHashTable* table = materialized();
+    NSArray* reps;
+    @synchronized(table) {
+        reps = [table allObjects];
+        [table removeAllObjects];
+    }
+    for (AXInterleavedImageRep* rep in reps) { [rep evictImage]; }
+}
+
+- (void) evictImage {
+    if (!lazy) { return; }
+    @synchronized(self) {
+        [self setImage:NULL];
+    }
+}
+
+- (BOOL) isLazy {
+    return lazy;
+}
+
+- (BOOL) isMaterialized {
+    @synchronized(self) {
+        return objc::boolean(cgImage != NULL);
+    }
+}
+
+- (CGImageRef) CGImage {
+    if (!lazy) { return [super CGImage]; }
+    @synchronized(self) {
+        if (cgImage == NULL) {
+            CGImageRef imageref = CGImageFromInterleaved(interleavedImage,
+                                                         CGColorSpaceCreateDeviceRGB());
+            [self setImage:imageref];
+            CGImageRelease(imageref);
+            NSHashTable* table = materialized();
+            @synchronized(table) { [table addObject:self]; }
+        }
+        /// autoreleased, so an eviction on another thread
+        /// can't release it out from under a draw in progress:
+        if (cgImage == NULL) { return NULL; }
+        return (CGImageRef)CFAutorelease(CGImageRetain(cgImage));
+    }
 }
 
 - (void) setInterleaved:(const Interleaved&)interleaved {
-    interleavedImage = interleaved;
-    [self setImage:CGImageFromInterleaved(interleaved, CGColorSpaceCreateDeviceRGB())];
+    auto shared = std::make_shared<Interleaved>(interleaved);
+    if (lazy) {
+        @synchronized(self) {
+            interleavedImage = std::move(shared);
+            [self setImage:NULL];
+        }
+    } else {
+        CGImageRef imageref = CGImageFromInterleaved(shared, CGColorSpaceCreateDeviceRGB());
+        interleavedImage = std::move(shared);
+        [self setImage:imageref];
+        CGImageRelease(imageref);
+    }
     [self setColorSpaceName:objc::bridge<NSString*>(kCGColorSpaceGenericRGB)];
+    [self setSize:NSMakeSize(interleavedImage->width(),
+                             interleavedImage->height())];
 }
 
 - (Interleaved const&) interleaved {
-    return interleavedImage;
+    return *interleavedImage;
 }
 
 - (Meta const&) imageMeta {
-    return interleavedImage.getMeta();
+    return interleavedImage->getMeta();
+}
+
+/// NSImageRep attributes -- answered from the interleaved image,
+/// so asking doesn't materialize a lazy rep's CGImage:
+
+- (NSInteger) bitsPerSample {
+    return objc::cg::color_traits<RGB>::bits;
+}
+
+- (BOOL) hasAlpha {
+    return objc::boolean(objc::cg::color_traits<RGB>::alpha);
+}
+
+- (NSInteger) pixelsHigh {
+    return interleavedImage ? interleavedImage->height() : 0;
+}
+
+- (NSInteger) pixelsWide {
+    return interleavedImage ? interleavedImage->width() : 0;
 }
 
 @end
@@ -13,13 +13,11 @@
 #endif
 
 
+// A prepared closure, borrowed from those shared by every block with its signature
+struct MABlockSlot;
+
 @interface MABlockClosure : NSObject {
-    NSMutableArray*     _allocations;
-    ffi_cif             _closureCIF;
-    ffi_cif             _innerCIF;
-    int                 _closureArgCount;
-    ffi_closure*        _closure;
-    void*               _closureFptr;
+    struct MABlockSlot* _slot;
     id                  _block;
 }
 
@@ -27,4 +25,9 @@
 
 - (void*) fptr;
 
+// How many distinct block signatures have been prepared, and how many
+// closures allocated for them -- closures are recycled, never freed
++ (NSUInteger) signatureCount;
++ (NSUInteger) closureCount;
+
 @end
@@ -2,8 +2,10 @@
 #import "MABlockClosure.h"
 
 #import <assert.h>
+#import <pthread.h>
 #import <objc/runtime.h>
 #import <sys/mman.h>
+#import <unistd.h>
 
 #if TARGET_OS_IPHONE
 #import <CoreGraphics/CoreGraphics.h>
@@ -51,46 +53,56 @@ static const char* BlockSig(id blockObj) {
     return descriptor->rest[index];
 }
 
+// Everything that depends only on a block's type encoding -- the ffi_type graph and
+// both CIFs -- is prepared once per distinct encoding, and shared. Each signature also
+// keeps the closures prepared against its CIF: those go back on its free list when
+// their MABlockClosure goes away, so wrapping another block with the same signature
+// costs neither an allocation nor an ffi_prep_closure. Signatures, their ffi_types and
+// their closures live as long as the process does.
+struct MABlockSignature {
+    char*                       encoding;
+    unsigned long               hash;
+    ffi_cif                     closureCIF;
+    ffi_cif                     innerCIF;
+    int                         closureArgCount;
+    struct MABlockSlot*         free;
+    struct MABlockSignature*    next;       // in its bucket of the cache
+};
+
+// One closure, prepared once against its signature's closureCIF -- with the slot
+// itself as userdata, so the closure never has to be written to again
+struct MABlockSlot {
+    ffi_closure*                closure;
+    void*                       fptr;
+    void*                       block;
+    void*                       invoke;
+    struct MABlockSignature*    signature;
+    struct MABlockSlot*         next;       // on its signature's free list
+};
+
+enum { kSignatureBuckets = 64 };
+
+static pthread_mutex_t gCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static struct MABlockSignature* gSignatures[kSignatureBuckets];
+static NSUInteger gSignatureCount = 0;
+static NSUInteger gClosureCount = 0;
+
 static void BlockClosure(ffi_cif* cif, void* ret, void** args, void* userdata) {
-    #if !__has_feature(objc_arc)
-    MABlockClosure* self = userdata;
-    #else
-    MABlockClosure* self = (__bridge MABlockClosure*)userdata;
-    #endif
-    int count = self->_closureArgCount;
-    void** innerArgs = malloc((count + 1) * sizeof(*innerArgs));
-    innerArgs[0] = &self->_block;
+    struct MABlockSlot* slot = userdata;
+    int count = slot->signature->closureArgCount;
+    void* innerArgs[count + 1];
+    innerArgs[0] = &slot->block;
     memcpy(innerArgs + 1, args, count * sizeof(*args));
-    ffi_call(&self->_innerCIF, BlockImpl(self->_block), ret, innerArgs);
-    free(innerArgs);
+    ffi_call(&slot->signature->innerCIF, slot->invoke, ret, innerArgs);
 }
 
-static void* AllocateClosure(void** codePtr) {
-#if USE_LIBFFI_CLOSURE_ALLOC
-    return ffi_closure_alloc(sizeof(ffi_closure), codePtr);
-#else
-    ffi_closure* closure = mmap(NULL, sizeof(ffi_closure), PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-    if (closure == (void*)-1) {
-        perror("mmap");
-        return NULL;
+static void* Allocate(size_t howmuch) {
+    void* out = calloc(1, howmuch);
+    if (!out) {
+        perror("calloc");
+        abort();
     }
-    *codePtr = closure;
-    return closure;
-#endif
-}
-
-static void DeallocateClosure(void* closure) {
-#if USE_LIBFFI_CLOSURE_ALLOC
-    ffi_closure_free(closure);
-#else
-    munmap(closure, sizeof(ffi_closure));
-#endif
-}
-
-- (void*) _allocate:(size_t)howmuch {
-    NSMutableData* data = [NSMutableData dataWithLength: howmuch];
-    [_allocations addObject: data];
-    return [data mutableBytes];
+    return out;
 }
 
 static const char* SizeAndAlignment(const char* str, NSUInteger* sizep, NSUInteger* alignp, int* len) {
@@ -109,7 +121,7 @@ static int ArgCount(const char* str) {
     return argcount;
 }
 
-- (ffi_type*) _ffiArgForEncode:(const char*)str {
+static ffi_type* FFIArgForEncode(const char* str) {
     #define SINT(type) do {                                                                     \
         if (str[0] == @encode(type)[0]) {                                                       \
             if (sizeof(type) == 1) {                                                            \
@@ -160,10 +172,10 @@ static int ArgCount(const char* str) {
     #define STRUCT(structType, ...) do {                                                        \
         if (strncmp(str, @encode(structType), strlen(@encode(structType))) == 0) {              \
             ffi_type* elementsLocal[] = { __VA_ARGS__, NULL };                                  \
-            ffi_type** elements = [self _allocate:sizeof(elementsLocal)];                       \
+            ffi_type** elements = Allocate(sizeof(elementsLocal));                              \
             memcpy(elements, elementsLocal, sizeof(elementsLocal));                             \
                                                                                                 \
-            ffi_type* structType = [self _allocate:sizeof(*structType)];                        \
+            ffi_type* structType = Allocate(sizeof(*structType));                               \
             structType->type = FFI_TYPE_STRUCT;                                                 \
             structType->elements = elements;                                                    \
             return structType;                                                                  \
@@ -212,15 +224,15 @@ static int ArgCount(const char* str) {
     abort();
 }
 
-- (ffi_type**) _argsWithEncodeString:(const char*)str getCount:(int*)outCount {
+static ffi_type** ArgsWithEncodeString(const char* str, int* outCount) {
     int argCount = ArgCount(str);
-    ffi_type** argTypes = [self _allocate:argCount * sizeof(*argTypes)];
+    ffi_type** argTypes = Allocate(argCount * sizeof(*argTypes));
     
     int i = -1;
     while(str && *str) {
         const char* next = SizeAndAlignment(str, NULL, NULL, NULL);
         if(i >= 0) {
-            argTypes[i] = [self _ffiArgForEncode: str];
+            argTypes[i] = FFIArgForEncode(str);
         }
         i++;
         str = next;
@@ -230,81 +242,171 @@ static int ArgCount(const char* str) {
     return argTypes;
 }
 
-- (int) _prepCIF:(ffi_cif*)cif withEncodeString:(const char*)str skipArg:(BOOL)skip {
-    int argCount;
-    ffi_type** argTypes = [self _argsWithEncodeString:str getCount:&argCount];
-    
-    if (skip) {
-        argTypes++;
-        argCount--;
-    }
-    
-    ffi_status status = ffi_prep_cif(cif, FFI_DEFAULT_ABI, argCount, [self _ffiArgForEncode:str], argTypes);
+static void PrepCIF(ffi_cif* cif, int argCount, ffi_type* returnType, ffi_type** argTypes) {
+    ffi_status status = ffi_prep_cif(cif, FFI_DEFAULT_ABI, argCount, returnType, argTypes);
     if (status != FFI_OK) {
         NSLog(@"Got result %ld from ffi_prep_cif", (long)status);
         abort();
     }
-    
-    return argCount;
 }
 
-- (void)_prepClosureCIF {
-    _closureArgCount = [self _prepCIF:&_closureCIF withEncodeString:BlockSig(_block) skipArg:YES];
+static unsigned long HashEncoding(const char* str) {
+    unsigned long hash = 14695981039346656037UL;
+    while (*str) {
+        hash = (hash ^ (unsigned char)*str++) * 1099511628211UL;
+    }
+    return hash;
 }
 
-- (void)_prepInnerCIF {
-    [self _prepCIF:&_innerCIF withEncodeString:BlockSig(_block) skipArg:NO];
+// Call with gCacheLock held
+static struct MABlockSignature* SignatureForEncoding(const char* str) {
+    unsigned long hash = HashEncoding(str);
+    struct MABlockSignature** bucket = &gSignatures[hash % kSignatureBuckets];
+    for (struct MABlockSignature* signature = *bucket; signature; signature = signature->next) {
+        if (signature->hash == hash && strcmp(signature->encoding, str) == 0) {
+            return signature;
+        }
+    }
+    
+    // the block itself is the first argument to its invoke function, and
+    // the closure's first argument is the one after -- so both CIFs share
+    // one array of argument types, and one return type:
+    struct MABlockSignature* signature = Allocate(sizeof(*signature));
+    signature->encoding = strdup(str);
+    signature->hash = hash;
+    
+    int argCount;
+    ffi_type** argTypes = ArgsWithEncodeString(str, &argCount);
+    ffi_type* returnType = FFIArgForEncode(str);
+    PrepCIF(&signature->innerCIF, argCount, returnType, argTypes);
+    PrepCIF(&signature->closureCIF, argCount - 1, returnType, argTypes + 1);
+    signature->closureArgCount = argCount - 1;
+    
+    signature->next = *bucket;
+    *bucket = signature;
+    gSignatureCount++;
+    return signature;
 }
 
-- (void) _prepClosure {
+static void PrepClosure(struct MABlockSlot* slot) {
 #if USE_LIBFFI_CLOSURE_ALLOC
-    ffi_status status = ffi_prep_closure_loc(_closure, &_closureCIF, BlockClosure, self, _closureFptr);
+    ffi_status status = ffi_prep_closure_loc(slot->closure, &slot->signature->closureCIF, BlockClosure, slot, slot->fptr);
+#else
+    ffi_status status = ffi_prep_closure(slot->closure, &slot->signature->closureCIF, BlockClosure, slot);
+#endif
     if (status != FFI_OK) {
         NSLog(@"ffi_prep_closure returned %d", (int)status);
         abort();
     }
+}
+
+// Allocates a slab of closures for a signature -- a page's worth, all mapped at once
+// and made executable with one mprotect -- and puts them on its free list.
+// Call with gCacheLock held
+static void AllocateSlab(struct MABlockSignature* signature) {
+    size_t count = (size_t)getpagesize() / sizeof(ffi_closure);
+    if (count < 1) { count = 1; }
+    struct MABlockSlot* slots = Allocate(count * sizeof(*slots));
+    
+#if USE_LIBFFI_CLOSURE_ALLOC
+    for (size_t i = 0; i < count; i++) {
+        slots[i].signature = signature;
+        slots[i].closure = ffi_closure_alloc(sizeof(ffi_closure), &slots[i].fptr);
+        if (!slots[i].closure) {
+            NSLog(@"ffi_closure_alloc failed");
+            abort();
+        }
+        PrepClosure(&slots[i]);
+    }
 #else
-    #if !__has_feature(objc_arc)
-    ffi_status status = ffi_prep_closure(_closure, &_closureCIF, BlockClosure, self);
-    #else
-    ffi_status status = ffi_prep_closure(_closure, &_closureCIF, BlockClosure, (__bridge void*)self);
-    #endif
-    if (status != FFI_OK) {
-        NSLog(@"ffi_prep_closure returned %d", (int)status);
+    size_t length = count * sizeof(ffi_closure);
+    ffi_closure* closures = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    if (closures == (void*)-1) {
+        perror("mmap");
         abort();
     }
-    
-    if (mprotect(_closure, sizeof(_closure), PROT_READ | PROT_EXEC) == -1) {
+    for (size_t i = 0; i < count; i++) {
+        slots[i].signature = signature;
+        slots[i].closure = &closures[i];
+        slots[i].fptr = &closures[i];
+        PrepClosure(&slots[i]);
+    }
+    if (mprotect(closures, length, PROT_READ | PROT_EXEC) == -1) {
         perror("mprotect");
         abort();
     }
 #endif
+    
+    for (size_t i = count; i > 0; i--) {
+        slots[i - 1].next = signature->free;
+        signature->free = &slots[i - 1];
+    }
+    gClosureCount += count;
+}
+
+// Call with gCacheLock held
+static struct MABlockSlot* TakeSlot(struct MABlockSignature* signature) {
+    if (!signature->free) {
+        AllocateSlab(signature);
+    }
+    struct MABlockSlot* slot = signature->free;
+    signature->free = slot->next;
+    slot->next = NULL;
+    return slot;
+}
+
+// Call with gCacheLock held
+static void ReturnSlot(struct MABlockSlot* slot) {
+    slot->block = NULL;
+    slot->invoke = NULL;
+    slot->next = slot->signature->free;
+    slot->signature->free = slot;
 }
 
 - (id)initWithBlock:(id)block {
     if ((self = [self init])) {
-        _allocations = [[NSMutableArray alloc] init];
         _block = block;
-        _closure = AllocateClosure(&_closureFptr);
-        [self _prepClosureCIF];
-        [self _prepInnerCIF];
-        [self _prepClosure];
+        const char* encoding = BlockSig(block);
+        pthread_mutex_lock(&gCacheLock);
+        _slot = TakeSlot(SignatureForEncoding(encoding));
+        pthread_mutex_unlock(&gCacheLock);
+        #if !__has_feature(objc_arc)
+        _slot->block = block;
+        #else
+        _slot->block = (__bridge void*)block;
+        #endif
+        _slot->invoke = BlockImpl(block);
     }
     return self;
 }
 
 - (void)dealloc {
-    if (_closure) {
-        DeallocateClosure(_closure);
+    if (_slot) {
+        pthread_mutex_lock(&gCacheLock);
+        ReturnSlot(_slot);
+        pthread_mutex_unlock(&gCacheLock);
     }
     #if !__has_feature(objc_arc)
-    [_allocations release];
     [super dealloc];
     #endif
 }
 
 - (void*) fptr {
-    return _closureFptr;
+    return _slot->fptr;
+}
+
++ (NSUInteger) signatureCount {
+    pthread_mutex_lock(&gCacheLock);
+    NSUInteger count = gSignatureCount;
+    pthread_mutex_unlock(&gCacheLock);
+    return count;
+}
+
++ (NSUInteger) closureCount {
+    pthread_mutex_lock(&gCacheLock);
+    NSUInteger count = gClosureCount;
+    pthread_mutex_unlock(&gCacheLock);
+    return count;
 }
 
 @end
@@ -7,6 +7,7 @@
 //
 
 #include "docopt.h"
+#include "docopt_table.h"
 #include "docopt_util.h"
 #include "docopt_private.h"
 
@@ -21,6 +22,8 @@
 #include <iostream>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
+#include <algorithm>
 
 using namespace docopt;
 
@@ -1001,21 +1004,18 @@ static std::pair<Required, std::vector<Option>> create_pattern_tree(std::string
     return { std::move(pattern), std::move(options) };
 }
 
-std::map<std::string, value>
-docopt::docopt_parse(std::string const& doc,
-             std::vector<std::string> const& argv,
-             bool help,
-             bool version,
-             bool options_first)
+// Match argv against a pattern tree -- whether it was parsed just now or precompiled --
+// and hand what matched to 'collect', while the tree is still around to point into
+template <typename Collect>
+static auto match_argv(Required& pattern,
+               std::vector<Option>& options,
+               std::vector<std::string> const& argv,
+               bool help,
+               bool version,
+               bool options_first,
+               bool fixed,
+               Collect&& collect)
 {
-    Required pattern;
-    std::vector<Option> options;
-    try {
-        std::tie(pattern, options) = create_pattern_tree(doc);
-    } catch (Tokens::OptionError const& error) {
-        throw DocoptLanguageError(error.what());
-    }
-
     PatternList argv_patterns;
     try {
         argv_patterns = parse_argv(Tokens(argv), options, options_first);
@@ -1026,20 +1026,22 @@ docopt::docopt_parse(std::string const& doc,
     extras(help, version, argv_patterns);
 
     std::vector<std::shared_ptr<LeafPattern>> collected;
-    bool matched = pattern.fix().match(argv_patterns, collected);
+    if (!fixed) {
+        pattern.fix();
+    }
+    bool matched = pattern.match(argv_patterns, collected);
     if (matched && argv_patterns.empty()) {
-        std::map<std::string, value> ret;
-
         // (a.name, a.value) for a in (pattern.flat() + collected)
+        std::vector<LeafPattern const*> results;
         for (auto* p : pattern.leaves()) {
-            ret[p->name()] = p->getValue();
+            results.push_back(p);
         }
 
         for (auto const& p : collected) {
-            ret[p->name()] = p->getValue();
+            results.push_back(p.get());
         }
 
-        return ret;
+        return collect(results);
     }
 
     if (matched) {
@@ -1050,15 +1052,42 @@ docopt::docopt_parse(std::string const& doc,
     throw DocoptArgumentError("Arguments did not match expected patterns"); // BLEH. Bad error.
 }
 
+// ... into a map, where later results override earlier ones
+static std::map<std::string, value> collect_map(std::vector<LeafPattern const*> const& results)
+{
+    std::map<std::string, value> ret;
+    for (auto const* p : results) {
+        ret[p->name()] = p->getValue();
+    }
+    return ret;
+}
+
 std::map<std::string, value>
-docopt::docopt(std::string const& doc,
-           std::vector<std::string> const& argv,
-           bool help,
-           std::string const& version,
-           bool options_first) noexcept
+docopt::docopt_parse(std::string const& doc,
+             std::vector<std::string> const& argv,
+             bool help,
+             bool version,
+             bool options_first)
 {
+    Required pattern;
+    std::vector<Option> options;
     try {
-        return docopt_parse(doc, argv, help, !version.empty(), options_first);
+        std::tie(pattern, options) = create_pattern_tree(doc);
+    } catch (Tokens::OptionError const& error) {
+        throw DocoptLanguageError(error.what());
+    }
+
+    return match_argv(pattern, options, argv, help, version, options_first, false, collect_map);
+}
+
+// Call a parse function, and exit appropriately if it throws
+template <typename Parse>
+static auto parse_or_exit(std::string const& doc,
+                          std::string const& version,
+                          Parse&& parse) noexcept -> decltype(parse())
+{
+    try {
+        return parse();
     } catch (DocoptExitHelp const&) {
         std::cout << doc << std::endl;
         std::exit(0);
@@ -1076,3 +1105,591 @@ docopt::docopt(std::string const& doc,
         std::exit(-1);
     } /* Any other exception is unexpected: let std::terminate grab it */
 }
+
+std::map<std::string, value>
+docopt::docopt(std::string const& doc,
+           std::vector<std::string> const& argv,
+           bool help,
+           std::string const& version,
+           bool options_first) noexcept
+{
+    return parse_or_exit(doc, version, [&]() {
+        return docopt_parse(doc, argv, help, !version.empty(), options_first);
+    });
+}
+
+#pragma mark -
+#pragma mark Precompiled grammars
+
+static value load_value(grammar::node const& node)
+{
+    switch (node.is) {
+        case grammar::node::is_bool:
+            return value{ node.number != 0 };
+        case grammar::node::is_long:
+            return value{ node.number };
+        case grammar::node::is_string:
+            return value{ std::string(node.text) };
+        case grammar::node::is_strings: {
+            std::vector<std::string> strings;
+            char const* text = node.text;
+            for (long idx = 0; idx < node.number; ++idx) {
+                strings.emplace_back(text);
+                text += strings.back().size() + 1;
+            }
+            return value{ std::move(strings) };
+        }
+        case grammar::node::is_empty:
+        default:
+            return value{};
+    }
+}
+
+static std::string load_string(char const* str)
+{
+    return str ? std::string(str) : std::string();
+}
+
+static Option load_option(grammar::node const& node)
+{
+    Option option{ load_string(node.name), load_string(node.longname), node.argcount };
+    option.setValue(load_value(node));
+    return option;
+}
+
+// Rebuild the subtree rooted at 'node', moving 'node' past it -- keeping every node
+// by its index in 'loaded', for aliases to share
+static std::shared_ptr<Pattern> load_pattern(grammar::node const*& node,
+                                             grammar::node const* first,
+                                             std::vector<std::shared_ptr<Pattern>>& loaded)
+{
+    std::size_t const index = static_cast<std::size_t>(node - first);
+    grammar::node const& here = *node++;
+    std::shared_ptr<Pattern>& ret = loaded[index];
+
+    switch (here.kind) {
+        case grammar::node::alias:
+            assert(here.children < index  &&  "aliases refer back");
+            ret = loaded[here.children];
+            return ret;
+        case grammar::node::argument:
+            ret = std::make_shared<Argument>(here.name, load_value(here));
+            return ret;
+        case grammar::node::command:
+            ret = std::make_shared<Command>(here.name, load_value(here));
+            return ret;
+        case grammar::node::option:
+            ret = std::make_shared<Option>(load_option(here));
+            return ret;
+        default:
+            break;
+    }
+
+    PatternList children;
+    children.reserve(here.children);
+    for (std::size_t idx = 0; idx < here.children; ++idx) {
+        children.emplace_back(load_pattern(node, first, loaded));
+    }
+
+    switch (here.kind) {
+        case grammar::node::optional:
+            ret = std::make_shared<Optional>(std::move(children));
+            break;
+        case grammar::node::options_shortcut:
+            ret = std::make_shared<OptionsShortcut>(std::move(children));
+            break;
+        case grammar::node::one_or_more:
+            ret = std::make_shared<OneOrMore>(std::move(children));
+            break;
+        case grammar::node::either:
+            ret = std::make_shared<Either>(std::move(children));
+            break;
+        case grammar::node::required:
+        default:
+            ret = std::make_shared<Required>(std::move(children));
+            break;
+    }
+    return ret;
+}
+
+// Rebuild the pattern tree and the options from their tables
+static void load_grammar(grammar const& doc, Required& pattern, std::vector<Option>& options)
+{
+    // the root is always a Required (as from parse_pattern)
+    grammar::node const* node = doc.patterns;
+    std::vector<std::shared_ptr<Pattern>> loaded(doc.pattern_count);
+    {
+        PatternList children;
+        grammar::node const& root = *node++;
+        children.reserve(root.children);
+        for (std::size_t idx = 0; idx < root.children; ++idx) {
+            children.emplace_back(load_pattern(node, doc.patterns, loaded));
+        }
+        pattern.setChildren(std::move(children));
+    }
+    assert(node == doc.patterns + doc.pattern_count  &&  "grammar tables are consistent");
+
+    options.reserve(doc.option_count);
+    for (std::size_t idx = 0; idx < doc.option_count; ++idx) {
+        options.emplace_back(load_option(doc.options[idx]));
+    }
+}
+
+std::map<std::string, value>
+docopt::docopt_parse(grammar const& doc,
+             std::vector<std::string> const& argv,
+             bool help,
+             bool version,
+             bool options_first)
+{
+    Required pattern;
+    std::vector<Option> options;
+    load_grammar(doc, pattern, options);
+
+    return match_argv(pattern, options, argv, help, version, options_first, true, collect_map);
+}
+
+std::map<std::string, value>
+docopt::docopt(grammar const& doc,
+           std::vector<std::string> const& argv,
+           bool help,
+           std::string const& version,
+           bool options_first) noexcept
+{
+    return parse_or_exit(doc.doc, version, [&]() {
+        return docopt_parse(doc, argv, help, !version.empty(), options_first);
+    });
+}
+
+// A C++ string literal for 'str', one source line per line of text
+static std::string literal(std::string const& str)
+{
+    std::string ret = "\"";
+    for (char c : str) {
+        switch (c) {
+            case '"':  ret += "\\\""; break;
+            case '\\': ret += "\\\\"; break;
+            case '\t': ret += "\\t";  break;
+            case '\0': ret += "\\0\"\""; break; // so a following digit isn't read as octal
+            case '\n': ret += "\\n\"\n    \""; break;
+            default:   ret.push_back(c); break;
+        }
+    }
+    ret += "\"";
+
+    // no empty literal after a trailing newline
+    std::string const dangling = "\n    \"\"";
+    if (ret.size() > dangling.size() + 1 &&
+        ret.compare(ret.size() - dangling.size(), dangling.size(), dangling) == 0) {
+        ret.erase(ret.size() - dangling.size());
+    }
+    return ret;
+}
+
+static std::string literal_or_null(std::string const& str)
+{
+    return str.empty() ? "nullptr" : literal(str);
+}
+
+static std::string compile_value(value const& val)
+{
+    static std::string const prefix = "docopt::grammar::node::";
+    if (val.isBool()) {
+        return prefix + "is_bool, " + (val.asBool() ? "1" : "0") + ", nullptr";
+    } else if (val.isLong()) {
+        return prefix + "is_long, " + std::to_string(val.asLong()) + "L, nullptr";
+    } else if (val.isString()) {
+        return prefix + "is_string, 0, " + literal(val.asString());
+    } else if (val.isStringList()) {
+        std::string text;
+        for (auto const& str : val.asStringList()) {
+            text += str;
+            text.push_back('\0');
+        }
+        return prefix + "is_strings, " + std::to_string(val.asStringList().size()) + ", " + literal(text);
+    }
+    return prefix + "is_empty, 0, nullptr";
+}
+
+static std::string compile_option(Option const& option)
+{
+    return "{ docopt::grammar::node::option, 0, " +
+           literal_or_null(option.shortOption()) + ", " +
+           literal_or_null(option.longOption()) + ", " +
+           std::to_string(option.argCount()) + ", " +
+           compile_value(option.getValue()) + " }";
+}
+
+// Flatten the subtree rooted at 'pattern' into 'out', depth-first -- nodes the tree
+// shares (as fix() has it) get written out once, then as aliases of that first one
+static void compile_pattern(Pattern const& pattern,
+                            std::vector<std::string>& out,
+                            std::unordered_map<Pattern const*, std::size_t>& seen)
+{
+    if (auto option = dynamic_cast<Option const*>(&pattern)) {
+        out.emplace_back(compile_option(*option));
+        return;
+    }
+
+    if (auto leaf = dynamic_cast<LeafPattern const*>(&pattern)) {
+        char const* kind = dynamic_cast<Command const*>(leaf) ? "command" : "argument";
+        out.emplace_back(std::string("{ docopt::grammar::node::") + kind + ", 0, " +
+                         literal(leaf->name()) + ", nullptr, 0, " +
+                         compile_value(leaf->getValue()) + " }");
+        return;
+    }
+
+    auto const& branch = dynamic_cast<BranchPattern const&>(pattern);
+    char const* kind = dynamic_cast<OptionsShortcut const*>(&pattern) ? "options_shortcut" :
+                       dynamic_cast<Optional const*>(&pattern)        ? "optional" :
+                       dynamic_cast<OneOrMore const*>(&pattern)       ? "one_or_more" :
+                       dynamic_cast<Either const*>(&pattern)          ? "either" : "required";
+    out.emplace_back(std::string("{ docopt::grammar::node::") + kind + ", " +
+                     std::to_string(branch.children().size()) +
+                     ", nullptr, nullptr, 0, docopt::grammar::node::is_empty, 0, nullptr }");
+    for (auto const& child : branch.children()) {
+        auto inserted = seen.emplace(child.get(), out.size());
+        if (!inserted.second) {
+            out.emplace_back("{ docopt::grammar::node::alias, " +
+                             std::to_string(inserted.first->second) +
+                             ", nullptr, nullptr, 0, docopt::grammar::node::is_empty, 0, nullptr }");
+            continue;
+        }
+        compile_pattern(*child, out, seen);
+    }
+}
+
+static std::string compile_table(std::string const& name, std::vector<std::string> const& rows)
+{
+    if (rows.empty()) {
+        return "";
+    }
+    std::string ret = "static docopt::grammar::node const " + name + "[] = {\n";
+    for (auto const& row : rows) {
+        ret += "    " + row + ",\n";
+    }
+    ret += "};\n\n";
+    return ret;
+}
+
+std::string
+docopt::compile(std::string const& doc,
+            std::string const& identifier)
+{
+    Required pattern;
+    std::vector<Option> options;
+    try {
+        std::tie(pattern, options) = create_pattern_tree(doc);
+    } catch (Tokens::OptionError const& error) {
+        throw DocoptLanguageError(error.what());
+    }
+
+    // fixed up now, rather than at every parse
+    pattern.fix();
+
+    std::vector<std::string> patterns;
+    std::unordered_map<Pattern const*, std::size_t> seen;
+    compile_pattern(pattern, patterns, seen);
+
+    std::vector<std::string> optionrows;
+    for (auto const& option : options) {
+        optionrows.emplace_back(compile_option(option));
+    }
+
+    std::string const patterns_name = identifier + "_patterns";
+    std::string const options_name = identifier + "_options";
+
+    std::string ret = "// Generated by docopt-compile -- edit the usage text, not this.\n\n"
+                      "#include \"docopt.h\"\n\n";
+    ret += "static char const " + identifier + "[] =\n    " + literal(doc) + ";\n\n";
+    ret += compile_table(patterns_name, patterns);
+    ret += compile_table(options_name, optionrows);
+    ret += "static docopt::grammar const " + identifier + "_grammar = {\n";
+    ret += "    " + identifier + ",\n";
+    ret += "    " + patterns_name + ", " + std::to_string(patterns.size()) + ",\n";
+    ret += "    " + (optionrows.empty() ? std::string("nullptr") : options_name) + ", " +
+           std::to_string(optionrows.size()) + "\n";
+    ret += "};\n";
+    return ret;
+}
+
+#pragma mark -
+#pragma mark Flat tables
+
+void table::entry::throwIfNotKind(Kind expected) const
+{
+    if (kind == expected)
+        return;
+
+    static char const* const names[] = { "empty", "bool", "long", "string", "string-list" };
+    std::string error = "Illegal cast to ";
+    error += names[static_cast<int>(expected)];
+    error += "; type is actually ";
+    error += names[static_cast<int>(kind)];
+    throw std::runtime_error(std::move(error));
+}
+
+bool table::entry::asBool() const
+{
+    throwIfNotKind(Kind::Bool);
+    return boolValue;
+}
+
+long table::entry::asLong() const
+{
+    // Attempt to convert a string to a long, as docopt::value does
+    if (kind == Kind::String) {
+        return value{ std::string(strValue) }.asLong();
+    }
+    throwIfNotKind(Kind::Long);
+    return longValue;
+}
+
+std::string_view table::entry::asString() const
+{
+    throwIfNotKind(Kind::String);
+    return strValue;
+}
+
+table::strings table::entry::asStringList() const
+{
+    throwIfNotKind(Kind::StringList);
+    return { listValue, static_cast<std::size_t>(longValue) };
+}
+
+value table::entry::toValue() const
+{
+    switch (kind) {
+        case Kind::Bool:
+            return value{ boolValue };
+        case Kind::Long:
+            return value{ longValue };
+        case Kind::String:
+            return value{ std::string(strValue) };
+        case Kind::StringList: {
+            strings list = asStringList();
+            return value{ std::vector<std::string>(list.begin(), list.end()) };
+        }
+        case Kind::Empty:
+        default:
+            return value{};
+    }
+}
+
+table::entry const* table::find(std::string_view name) const
+{
+    auto found = std::lower_bound(fEntries.begin(), fEntries.end(), name,
+                                  [](entry const& e, std::string_view n) { return e.name < n; });
+    if (found == fEntries.end() || found->name != name) {
+        return nullptr;
+    }
+    return &*found;
+}
+
+table::entry const& table::operator[](std::string_view name) const
+{
+    if (entry const* found = find(name)) {
+        return *found;
+    }
+    throw std::out_of_range("No such option or argument: " + std::string(name));
+}
+
+std::map<std::string, value> table::map() const
+{
+    std::map<std::string, value> ret;
+    for (auto const& e : fEntries) {
+        ret.emplace_hint(ret.end(), std::string(e.name), e.toValue());
+    }
+    return ret;
+}
+
+std::ostream& docopt::operator<<(std::ostream& os, table::entry const& e)
+{
+    if (e.isBool()) {
+        os << (e.asBool() ? "true" : "false");
+    } else if (e.isLong()) {
+        os << e.asLong();
+    } else if (e.isString()) {
+        os << '"' << e.asString() << '"';
+    } else if (e.isStringList()) {
+        os << "[";
+        bool first = true;
+        for (auto const& el : e.asStringList()) {
+            if (first) {
+                first = false;
+            } else {
+                os << ", ";
+            }
+            os << '"' << el << '"';
+        }
+        os << "]";
+    } else {
+        os << "null";
+    }
+    return os;
+}
+
+namespace docopt {
+    namespace detail {
+
+        // Fills in a table from match results -- sizing everything on a first pass,
+        // so there's one allocation apiece for the entries, the list strings and
+        // the arena, however many results there are
+        struct table_builder {
+            grammar const& doc;
+            int argc;
+            char const* const* argv;
+
+            // a view of 's' that outlives the parse, if there's one to be had:
+            // argv, where values come from, or the grammar's static text
+            std::string_view lasting(std::string const& s) const {
+                if (s.empty()) {
+                    return { "" };
+                }
+                for (int idx = 0; idx < argc; ++idx) {
+                    std::string_view arg{ argv[idx] };
+                    // whole arguments, and the ends of "--option=value" or "-ovalue"
+                    if (arg.size() >= s.size() &&
+                        arg.compare(arg.size() - s.size(), s.size(), s) == 0) {
+                        return arg.substr(arg.size() - s.size());
+                    }
+                }
+                auto search = [&](grammar::node const* nodes, std::size_t count) -> std::string_view {
+                    for (std::size_t idx = 0; idx < count; ++idx) {
+                        grammar::node const& node = nodes[idx];
+                        for (char const* text : { node.name, node.longname }) {
+                            if (text && s == text) {
+                                return { text };
+                            }
+                        }
+                        // defaults, and lists of them, are NUL-separated
+                        if (node.text) {
+                            char const* text = node.text;
+                            for (long jdx = 0; jdx < std::max(node.number, 1L); ++jdx) {
+                                std::string_view str{ text };
+                                auto found = str.find(s);
+                                if (found != std::string_view::npos) {
+                                    return str.substr(found, s.size());
+                                }
+                                text += str.size() + 1;
+                                if (node.is != grammar::node::is_strings) {
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    return {};
+                };
+                std::string_view found = search(doc.patterns, doc.pattern_count);
+                if (found.data() == nullptr) {
+                    found = search(doc.options, doc.option_count);
+                }
+                return found;
+            }
+
+            table build(std::vector<LeafPattern const*> const& results) const {
+                // by name, with later results overriding earlier ones (as in a map)
+                std::vector<LeafPattern const*> picked(results.begin(), results.end());
+                std::stable_sort(picked.begin(), picked.end(),
+                                 [](LeafPattern const* a, LeafPattern const* b) { return a->name() < b->name(); });
+                auto last = std::unique(picked.rbegin(), picked.rend(),
+                                        [](LeafPattern const* a, LeafPattern const* b) { return a->name() == b->name(); });
+                picked.erase(picked.begin(), last.base());
+
+                // first pass: how much needs a home in the arena
+                std::size_t arenabytes = 0;
+                std::size_t liststrings = 0;
+                auto place = [&](std::string const& s) {
+                    if (lasting(s).data() == nullptr) {
+                        arenabytes += s.size();
+                    }
+                };
+                for (auto const* p : picked) {
+                    place(p->name());
+                    value const& v = p->getValue();
+                    if (v.isString()) {
+                        place(v.asString());
+                    } else if (v.isStringList()) {
+                        liststrings += v.asStringList().size();
+                        for (auto const& s : v.asStringList()) {
+                            place(s);
+                        }
+                    }
+                }
+
+                // second pass: fill it all in
+                table ret;
+                ret.fEntries.reserve(picked.size());
+                ret.fStrings.reserve(liststrings);
+                if (arenabytes) {
+                    ret.fArena.reset(new char[arenabytes]);
+                }
+                char* arena = ret.fArena.get();
+                auto view = [&](std::string const& s) -> std::string_view {
+                    std::string_view found = lasting(s);
+                    if (found.data() != nullptr) {
+                        return found;
+                    }
+                    char* copied = arena;
+                    std::memcpy(copied, s.data(), s.size());
+                    arena += s.size();
+                    return { copied, s.size() };
+                };
+
+                for (auto const* p : picked) {
+                    table::entry e;
+                    e.name = view(p->name());
+                    value const& v = p->getValue();
+                    if (v.isBool()) {
+                        e.kind = table::entry::Kind::Bool;
+                        e.boolValue = v.asBool();
+                    } else if (v.isLong()) {
+                        e.kind = table::entry::Kind::Long;
+                        e.longValue = v.asLong();
+                    } else if (v.isString()) {
+                        e.kind = table::entry::Kind::String;
+                        e.strValue = view(v.asString());
+                    } else if (v.isStringList()) {
+                        e.kind = table::entry::Kind::StringList;
+                        e.listValue = ret.fStrings.data() + ret.fStrings.size();
+                        e.longValue = static_cast<long>(v.asStringList().size());
+                        for (auto const& s : v.asStringList()) {
+                            ret.fStrings.push_back(view(s));
+                        }
+                    }
+                    ret.fEntries.push_back(e);
+                }
+                return ret;
+            }
+        };
+
+    }
+}
+
+table
+docopt::docopt_table_parse(grammar const& doc,
+             int argc, char const* const* argv,
+             bool help,
+             bool version,
+             bool options_first)
+{
+    Required pattern;
+    std::vector<Option> options;
+    load_grammar(doc, pattern, options);
+
+    detail::table_builder builder{ doc, argc, argv };
+    return match_argv(pattern, options, { argv, argv + argc }, help, version, options_first, true,
+                      [&](std::vector<LeafPattern const*> const& results) { return builder.build(results); });
+}
+
+table
+docopt::docopt_table(grammar const& doc,
+           int argc, char const* const* argv,
+           bool help,
+           std::string const& version,
+           bool options_first) noexcept
+{
+    return parse_or_exit(doc.doc, version, [&]() {
+        return docopt_table_parse(doc, argc, argv, help, !version.empty(), options_first);
+    });
+}
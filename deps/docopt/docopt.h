@@ -14,6 +14,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <cstddef>
 
 namespace docopt {
     
@@ -60,6 +61,68 @@ namespace docopt {
                         bool help = true,
                         std::string const& version = {},
                         bool options_first = false) noexcept;
+                        
+    /// A usage string, parsed ahead of time into static tables.
+    ///
+    /// Tables like these are what 'compile' generates (see also docopt_compile.cpp,
+    /// which does so at build time) -- matching against them skips tokenizing and
+    /// parsing the usage string, which is most of what 'docopt_parse' costs.
+    struct grammar {
+        struct node {
+            enum kind_t : unsigned char {
+                required, optional, options_shortcut, one_or_more, either,
+                argument, command, option,
+                alias                   // the same node as the one at index 'children'
+            };
+            enum value_t : unsigned char {
+                is_empty, is_bool, is_long, is_string, is_strings
+            };
+            
+            kind_t kind;
+            std::size_t children;       // branches: how many direct children follow, depth-first
+            char const* name;           // arguments and commands, or an option's short form
+            char const* longname;       // options: the long form
+            int argcount;               // options: how many arguments they take
+            value_t is;                 // leaves: the kind of their default value ...
+            long number;                // ... its bool or long, or how many strings
+            char const* text;           // ... its string, or strings separated by NULs
+        };
+        
+        char const* doc;                // the usage string, for --help
+        node const* patterns;           // the pattern tree, depth-first -- as already fixed up
+                                        // for matching, so nodes that the tree shares recur
+                                        // as aliases
+        std::size_t pattern_count;
+        node const* options;            // every option, as used to parse argv
+        std::size_t option_count;
+    };
+    
+    /// Parse user options against a precompiled grammar.
+    ///
+    /// Works and throws just as 'docopt_parse' does, except that the usage string itself
+    /// has already been checked -- so no DocoptLanguageError.
+    std::map<std::string, value> docopt_parse(grammar const& doc,
+                        std::vector<std::string> const& argv,
+                        bool help = true,
+                        bool version = true,
+                        bool options_first = false);
+                        
+    /// Parse user options against a precompiled grammar, and exit appropriately
+    /// (as 'docopt' does, printing the grammar's usage string where need be).
+    std::map<std::string, value> docopt(grammar const& doc,
+                        std::vector<std::string> const& argv,
+                        bool help = true,
+                        std::string const& version = {},
+                        bool options_first = false) noexcept;
+                        
+    /// Generate C++ source for a precompiled grammar.
+    ///
+    /// The source defines 'identifier' as the usage string, and 'identifier_grammar' as
+    /// a docopt::grammar for it, both static -- it's meant to be generated as a header.
+    ///
+    /// @throws DocoptLanguageError if the doc usage string had errors itself
+    std::string compile(std::string const& doc,
+                        std::string const& identifier);
 }
 
 #endif /* defined(docopt__docopt_h_) */
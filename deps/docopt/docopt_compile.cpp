@@ -0,0 +1,62 @@
+//
+//  docopt_compile.cpp
+//  docopt
+//
+//  Generates a header with a precompiled docopt::grammar for a usage string,
+//  so that programs can skip parsing their usage at startup:
+//
+//      docopt-compile usage.docopt usage.hh USAGE
+//
+//  ... defines USAGE (the usage string) and USAGE_grammar, for docopt::docopt().
+//
+
+#include "docopt.h"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+int main(int argc, const char** argv)
+{
+    if (argc != 4) {
+        std::cerr << "Usage: docopt-compile <usage file> <output header> <identifier>" << std::endl;
+        return 2;
+    }
+
+    std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+    if (!input) {
+        std::cerr << "docopt-compile: can't read " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream doc;
+    doc << input.rdbuf();
+
+    std::string source;
+    try {
+        source = docopt::compile(doc.str(), argv[3]);
+    } catch (docopt::DocoptLanguageError const& error) {
+        std::cerr << argv[1] << ": usage string could not be parsed" << std::endl;
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    // leave an unchanged header alone, so nothing gets rebuilt needlessly --
+    // docopt_grammar() touches a stamp file instead, for make's benefit
+    std::ifstream existing(argv[2], std::ios::in | std::ios::binary);
+    if (existing) {
+        std::stringstream current;
+        current << existing.rdbuf();
+        if (current.str() == source) {
+            return 0;
+        }
+    }
+
+    std::ofstream output(argv[2], std::ios::out | std::ios::binary | std::ios::trunc);
+    output << source;
+    if (!output) {
+        std::cerr << "docopt-compile: can't write " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+//
+//  docopt_table.h
+//  docopt
+//
+//  Parse results as one flat table, sorted by name -- instead of a std::map of
+//  docopt::values, each string of which is a copy on the heap. Names are views
+//  into the precompiled grammar, values are views into argv, and whatever is
+//  neither lives in a single arena owned by the table. (Needs C++17.)
+//
+
+#ifndef docopt__table_h_
+#define docopt__table_h_
+
+#include "docopt.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <iosfwd>
+#include <string_view>
+
+namespace docopt {
+
+    namespace detail {
+        struct table_builder;
+    }
+
+    class table {
+    public:
+        /// A run of strings in the table, as for repeated arguments
+        class strings {
+        public:
+            using const_iterator = std::string_view const*;
+
+            strings() = default;
+            strings(std::string_view const* begin, std::size_t size)
+            : fBegin(begin),
+              fSize(size)
+            {}
+
+            const_iterator begin() const { return fBegin; }
+            const_iterator end() const { return fBegin + fSize; }
+            std::size_t size() const { return fSize; }
+            bool empty() const { return fSize == 0; }
+            std::string_view operator[](std::size_t idx) const { return fBegin[idx]; }
+
+        private:
+            std::string_view const* fBegin = nullptr;
+            std::size_t fSize = 0;
+        };
+
+        /// One name and its value -- with the same accessors as docopt::value
+        class entry {
+        public:
+            std::string_view name;
+
+            explicit operator bool() const { return kind != Kind::Empty; }
+
+            bool isBool()       const { return kind==Kind::Bool; }
+            bool isString()     const { return kind==Kind::String; }
+            bool isLong()       const { return kind==Kind::Long; }
+            bool isStringList() const { return kind==Kind::StringList; }
+
+            // Throws std::runtime_error if the type does not match
+            bool asBool() const;
+            long asLong() const;
+            std::string_view asString() const;
+            strings asStringList() const;
+
+            // A docopt::value with copies of it all
+            value toValue() const;
+
+        private:
+            friend struct detail::table_builder;
+
+            enum class Kind : unsigned char {
+                Empty,
+                Bool,
+                Long,
+                String,
+                StringList
+            };
+
+            void throwIfNotKind(Kind expected) const;
+
+            Kind kind = Kind::Empty;
+            bool boolValue = false;
+            long longValue = 0;             // ... or, for lists, how many strings there are
+            std::string_view strValue;
+            std::string_view const* listValue = nullptr;   // into the table's strings
+        };
+
+        using const_iterator = std::vector<entry>::const_iterator;
+
+        table() = default;
+        table(table&&) = default;
+        table& operator=(table&&) = default;
+
+        // entries point into the table itself, so it moves but doesn't copy
+        table(table const&) = delete;
+        table& operator=(table const&) = delete;
+
+        const_iterator begin() const { return fEntries.begin(); }
+        const_iterator end() const { return fEntries.end(); }
+        std::size_t size() const { return fEntries.size(); }
+        bool empty() const { return fEntries.empty(); }
+
+        /// The entry for a name, or nullptr -- by binary search
+        entry const* find(std::string_view name) const;
+
+        /// The entry for a name; throws std::out_of_range if there's none
+        entry const& operator[](std::string_view name) const;
+
+        /// The table as docopt_parse would have returned it
+        std::map<std::string, value> map() const;
+
+    private:
+        friend struct detail::table_builder;
+
+        std::vector<entry> fEntries;
+        std::vector<std::string_view> fStrings;
+        std::unique_ptr<char[]> fArena;
+    };
+
+    /// Parse user options against a precompiled grammar, into a table.
+    ///
+    /// Works and throws as 'docopt_parse' does for a grammar. The table's values are
+    /// views into 'argv', which has to outlive it -- as main()'s own argv does.
+    table docopt_table_parse(grammar const& doc,
+                        int argc, char const* const* argv,
+                        bool help = true,
+                        bool version = true,
+                        bool options_first = false);
+
+    /// Parse user options against a precompiled grammar into a table, and exit
+    /// appropriately (as 'docopt' does).
+    table docopt_table(grammar const& doc,
+                        int argc, char const* const* argv,
+                        bool help = true,
+                        std::string const& version = {},
+                        bool options_first = false) noexcept;
+
+    /// Write out the value of an entry, as for a docopt::value
+    std::ostream& operator<<(std::ostream&, table::entry const&);
+}
+
+#endif /* defined(docopt__table_h_) */
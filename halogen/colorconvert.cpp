@@ -0,0 +1,93 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include "Halide.h"
+
+namespace {
+    
+    using namespace Halide;
+    
+    /// sRGB transfer functions, encoded to linear and back:
+    Expr srgb_to_linear(Expr v) {
+        return select(v <= 0.04045f, v / 12.92f,
+                                     pow((v + 0.055f) / 1.055f, 2.4f));
+    }
+    
+    Expr linear_to_srgb(Expr v) {
+        return select(v <= 0.0031308f, v * 12.92f,
+                                       1.055f * pow(v, 1.0f / 2.4f) - 0.055f);
+    }
+    
+    /// Convert interleaved 8-bit RGBA (straight alpha, alpha last) between
+    /// RGB color spaces: decode each sample to linear light, apply a 3x3 matrix,
+    /// encode the result -- alpha passes through as-is. `decode` and `encode`
+    /// pick the transfer function on either side, 0 for linear and 1 for sRGB's,
+    /// and `matrix(column, row)` is the linear-RGB transform, source to destination.
+    /// Decoding is a 256-entry table; encoding is a table of `encoding_steps`
+    /// entries, indexed by the linear value, which is enough to get within one
+    /// of the exact result everywhere.
+    
+    class ColorConvert : public Generator<ColorConvert> {
+        
+        public:
+            GeneratorParam<int> encoding_steps{ "encoding_steps", 4096 };
+            Input<Buffer<uint8_t>> input{ "input", 3 };
+            Input<Buffer<float>> matrix{ "matrix", 2 };
+            Input<int32_t> decode{ "decode", 1, 0, 1 };
+            Input<int32_t> encode{ "encode", 1, 0, 1 };
+            Output<Buffer<uint8_t>> output{ "output", 3 };
+            
+            void generate() {
+                const int steps = encoding_steps;
+                Expr unit = cast<float>(i) / 255.0f;
+                decoded(i) = select(decode == 1, srgb_to_linear(unit), unit);
+                
+                Expr level = clamp(cast<float>(j) / float(steps - 1), 0.0f, 1.0f);
+                Expr encoded_level = select(encode == 1, linear_to_srgb(level), level);
+                encoded(j) = cast<uint8_t>(clamp(encoded_level * 255.0f + 0.5f, 0.0f, 255.0f));
+                
+                Expr r = decoded(cast<int32_t>(input(x, y, 0)));
+                Expr g = decoded(cast<int32_t>(input(x, y, 1)));
+                Expr b = decoded(cast<int32_t>(input(x, y, 2)));
+                Expr row = min(c, 2);
+                transformed(x, y, c) = matrix(0, row) * r + matrix(1, row) * g + matrix(2, row) * b;
+                
+                Expr index = clamp(cast<int32_t>(transformed(x, y, c) * float(steps - 1) + 0.5f),
+                                   0, steps - 1);
+                output(x, y, c) = select(c == 3, input(x, y, 3), encoded(index));
+            }
+            
+            void schedule() {
+                input.dim(0).set_stride(4);
+                input.dim(2).set_stride(1).set_bounds(0, 4);
+                output.dim(0).set_stride(4);
+                output.dim(2).set_stride(1).set_bounds(0, 4);
+                matrix.dim(0).set_bounds(0, 3);
+                matrix.dim(1).set_bounds(0, 3);
+                
+                const int lanes = natural_vector_size<float>();
+                
+                /// both tables are built once per call, and are small enough
+                /// to stay in L1 for the lookups -- which are gathers; the decoded
+                /// samples and the matrix product are inlined, once per channel:
+                decoded.compute_root()
+                       .vectorize(i, lanes);
+                encoded.compute_root()
+                       .vectorize(j, lanes);
+                       
+                output.reorder(c, x, y)
+                      .bound(c, 0, 4)
+                      .unroll(c)
+                      .split(y, yo, yi, 64)
+                      .parallel(yo)
+                      .vectorize(x, lanes, TailStrategy::GuardWithIf);
+            }
+            
+        private:
+            Var x{ "x" }, y{ "y" }, c{ "c" }, i{ "i" }, j{ "j" }, yo{ "yo" }, yi{ "yi" };
+            Func decoded{ "decoded" }, encoded{ "encoded" }, transformed{ "transformed" };
+    };
+    
+} /// namespace (anon.)
+
+HALIDE_REGISTER_GENERATOR(ColorConvert, halogen_colorconvert)
@@ -0,0 +1,12 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <iostream>
+#include "Halide.h"
+
+/// The command-line driver for every generator registered in halogen/ --
+/// the same thing as Halide's own tools/GenGen.cpp, which not every
+/// Halide distribution ships:
+int main(int argc, char** argv) {
+    return Halide::Internal::generate_filter_main(argc, argv, std::cerr);
+}
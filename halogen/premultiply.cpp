@@ -0,0 +1,70 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include "Halide.h"
+
+namespace {
+    
+    using namespace Halide;
+    
+    /// Straight to premultiplied alpha (or back, with `inverse=true`), for
+    /// interleaved 8-bit RGBA with alpha last. The arithmetic is that of
+    /// objc::pixels::transfer(), q.v. src/pixels.mm, and the output matches
+    /// it bit-for-bit:
+    ///
+    ///     premultiply:    t = c * a + 128; (t + (t >> 8)) >> 8
+    ///     unpremultiply:  min(255, (c * 255 + a / 2) / a), or 0 if a == 0
+    ///
+    /// ... the division done in float, which is exact for these operands.
+    
+    class Premultiply : public Generator<Premultiply> {
+        
+        public:
+            GeneratorParam<bool> inverse{ "inverse", false };
+            Input<Buffer<uint8_t>> input{ "input", 3 };
+            Output<Buffer<uint8_t>> output{ "output", 3 };
+            
+            void generate() {
+                Expr value = input(x, y, c);
+                Expr alpha = input(x, y, 3);
+                
+                if (inverse) {
+                    Expr numerator = cast<float>(cast<int32_t>(value) * 255 +
+                                                 cast<int32_t>(alpha / 2));
+                    Expr quotient = cast<int32_t>(numerator / cast<float>(alpha));
+                    color(x, y, c) = select(alpha == 0, cast<uint8_t>(0),
+                                            cast<uint8_t>(min(quotient, 255)));
+                } else {
+                    Expr t = cast<uint16_t>(value) * cast<uint16_t>(alpha) + cast<uint16_t>(128);
+                    color(x, y, c) = cast<uint8_t>((t + (t >> 8)) >> 8);
+                }
+                
+                output(x, y, c) = select(c == 3, alpha, color(x, y, c));
+            }
+            
+            void schedule() {
+                /// interleaved in, interleaved out:
+                input.dim(0).set_stride(4);
+                input.dim(2).set_stride(1).set_bounds(0, 4);
+                output.dim(0).set_stride(4);
+                output.dim(2).set_stride(1).set_bounds(0, 4);
+                
+                /// the 16-bit products fill a vector of natural_vector_size<uint16_t>()
+                /// lanes per channel -- sixteen pixels on AVX2, thirty-two on AVX-512:
+                const int lanes = natural_vector_size<uint16_t>();
+                output.reorder(c, x, y)
+                      .bound(c, 0, 4)
+                      .unroll(c)
+                      .split(y, yo, yi, 64)
+                      .parallel(yo)
+                      .vectorize(x, lanes, TailStrategy::GuardWithIf);
+            }
+            
+        private:
+            Var x{ "x" }, y{ "y" }, c{ "c" }, yo{ "yo" }, yi{ "yi" };
+            Func color{ "color" };
+    };
+    
+} /// namespace (anon.)
+
+HALIDE_REGISTER_GENERATOR(Premultiply, halogen_premultiply)
@@ -0,0 +1,57 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include "Halide.h"
+
+namespace {
+    
+    using namespace Halide;
+    
+    /// Swizzle the channels of interleaved 8-bit four-channel pixels:
+    /// output channel `n` comes from input channel `order<n>` (one of `order0`
+    /// through `order3`) -- so RGBA to BGRA is { 2, 1, 0, 3 }, RGBA to ARGB
+    /// is { 3, 0, 1, 2 }, &c.
+    
+    class Reorder : public Generator<Reorder> {
+        
+        public:
+            Input<Buffer<uint8_t>> input{ "input", 3 };
+            Input<int32_t> order0{ "order0", 0, 0, 3 };
+            Input<int32_t> order1{ "order1", 1, 0, 3 };
+            Input<int32_t> order2{ "order2", 2, 0, 3 };
+            Input<int32_t> order3{ "order3", 3, 0, 3 };
+            Output<Buffer<uint8_t>> output{ "output", 3 };
+            
+            void generate() {
+                /// clamped, so bounds inference knows the channels stay within [0, 3]:
+                Expr channel = clamp(select(c == 0, order0,
+                                            c == 1, order1,
+                                            c == 2, order2,
+                                                    order3), 0, 3);
+                output(x, y, c) = input(x, y, channel);
+            }
+            
+            void schedule() {
+                input.dim(0).set_stride(4);
+                input.dim(2).set_stride(1).set_bounds(0, 4);
+                output.dim(0).set_stride(4);
+                output.dim(2).set_stride(1).set_bounds(0, 4);
+                
+                /// with the channel loop unrolled, each output channel is one
+                /// stride-4 load at a runtime offset, which vectorizes as shuffles:
+                const int lanes = natural_vector_size<uint8_t>();
+                output.reorder(c, x, y)
+                      .bound(c, 0, 4)
+                      .unroll(c)
+                      .split(y, yo, yi, 64)
+                      .parallel(yo)
+                      .vectorize(x, lanes, TailStrategy::GuardWithIf);
+            }
+            
+        private:
+            Var x{ "x" }, y{ "y" }, c{ "c" }, yo{ "yo" }, yi{ "yi" };
+    };
+    
+} /// namespace (anon.)
+
+HALIDE_REGISTER_GENERATOR(Reorder, halogen_reorder)
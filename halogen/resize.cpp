@@ -0,0 +1,194 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <type_traits>
+#include "Halide.h"
+
+namespace {
+    
+    using namespace Halide;
+    
+    /// The kernels of objc::resample, q.v. include/subjective-c/resample.hh --
+    /// `kernel` is an objc::resample::filter value, and the supports match:
+    Expr support(Expr kernel) {
+        return select(kernel == 0, 0.5f,
+                      kernel == 1, 1.0f,
+                      kernel == 2, 3.0f,
+                                   2.0f);
+    }
+    
+    Expr sinc(Expr x) {
+        Expr pix = x * float(M_PI);
+        return select(x == 0.0f, 1.0f, sin(pix) / pix);
+    }
+    
+    Expr weight(Expr kernel, Expr x) {
+        const float B = 1.0f / 3.0f;
+        const float C = 1.0f / 3.0f;
+        Expr ax = abs(x);
+        Expr box = select(x >= -0.5f && x < 0.5f, 1.0f, 0.0f);
+        Expr bilinear = max(1.0f - ax, 0.0f);
+        Expr lanczos3 = select(ax < 3.0f, sinc(x) * sinc(x / 3.0f), 0.0f);
+        Expr mitchell = select(ax < 1.0f, ((12.0f - 9.0f * B - 6.0f * C) * ax * ax * ax +
+                                           (-18.0f + 12.0f * B + 6.0f * C) * ax * ax +
+                                           (6.0f - 2.0f * B)) / 6.0f,
+                               ax < 2.0f, ((-B - 6.0f * C) * ax * ax * ax +
+                                           (6.0f * B + 30.0f * C) * ax * ax +
+                                           (-12.0f * B - 48.0f * C) * ax +
+                                           (8.0f * B + 24.0f * C)) / 6.0f,
+                                          0.0f);
+        return select(kernel == 0, box,
+                      kernel == 1, bilinear,
+                      kernel == 2, lanczos3,
+                                   mitchell);
+    }
+    
+    /// Separable resampling of interleaved four-channel pixels, after
+    /// objc::resample::resize() -- the same kernels, widened by the scale when
+    /// shrinking, the same taps, normalized per output pixel -- but with float
+    /// weights throughout, so 8-bit output can differ from the fixed-point
+    /// objc::resample by one. `origin` and `scale` map output pixels onto the
+    /// source: output pixel x is centered at origin_x + (x + 0.5) * scale_x.
+    
+    template <typename T>
+    struct Resampler {
+        
+        Var x{ "x" }, y{ "y" }, c{ "c" }, k{ "k" };
+        Var yo{ "yo" }, yi{ "yi" };
+        Func clamped{ "clamped" };
+        Func raw_x{ "raw_x" }, raw_y{ "raw_y" };
+        Func kernel_x{ "kernel_x" }, kernel_y{ "kernel_y" };
+        Func resized_x{ "resized_x" }, resized_y{ "resized_y" };
+        
+        void define(Func output, GeneratorInput<Buffer<T>>& input, Expr kernel,
+                    Expr origin_x, Expr origin_y, Expr scale_x, Expr scale_y) {
+            clamped = BoundaryConditions::repeat_edge(input);
+            
+            Expr filterscale_x = max(scale_x, 1.0f);
+            Expr filterscale_y = max(scale_y, 1.0f);
+            Expr radius_x = support(kernel) * filterscale_x;
+            Expr radius_y = support(kernel) * filterscale_y;
+            Expr taps_x = cast<int>(ceil(radius_x * 2.0f)) + 1;
+            Expr taps_y = cast<int>(ceil(radius_y * 2.0f)) + 1;
+            
+            Expr center_x = origin_x + (cast<float>(x) + 0.5f) * scale_x;
+            Expr center_y = origin_y + (cast<float>(y) + 0.5f) * scale_y;
+            Expr first_x = clamp(cast<int>(floor(center_x - radius_x + 0.5f)), 0, input.dim(0).extent() - 1);
+            Expr first_y = clamp(cast<int>(floor(center_y - radius_y + 0.5f)), 0, input.dim(1).extent() - 1);
+            Expr last_x = min(cast<int>(floor(center_x + radius_x + 0.5f)), input.dim(0).extent());
+            Expr last_y = min(cast<int>(floor(center_y + radius_y + 0.5f)), input.dim(1).extent());
+            
+            /// taps past the edge of the source weigh nothing:
+            raw_x(x, k) = select(first_x + k < last_x,
+                                 weight(kernel, (cast<float>(first_x + k) - center_x + 0.5f) / filterscale_x),
+                                 0.0f);
+            raw_y(y, k) = select(first_y + k < last_y,
+                                 weight(kernel, (cast<float>(first_y + k) - center_y + 0.5f) / filterscale_y),
+                                 0.0f);
+                                 
+            RDom rx(0, taps_x, "rx");
+            RDom ry(0, taps_y, "ry");
+            Expr total_x = sum(raw_x(x, rx));
+            Expr total_y = sum(raw_y(y, ry));
+            
+            /// nothing within reach -- which the kernels above can't manage
+            /// at any scale -- would make the first tap the only one:
+            kernel_x(x, k) = select(total_x == 0.0f, select(k == 0, 1.0f, 0.0f), raw_x(x, k) / total_x);
+            kernel_y(y, k) = select(total_y == 0.0f, select(k == 0, 1.0f, 0.0f), raw_y(y, k) / total_y);
+            
+            resized_x(x, y, c) = sum(kernel_x(x, rx) * cast<float>(clamped(first_x + rx, y, c)));
+            resized_y(x, y, c) = sum(kernel_y(y, ry) * resized_x(x, first_y + ry, c));
+            
+            if (std::is_same<T, uint8_t>::value) {
+                output(x, y, c) = cast<uint8_t>(clamp(resized_y(x, y, c) + 0.5f, 0.0f, 255.0f));
+            } else {
+                output(x, y, c) = resized_y(x, y, c);
+            }
+        }
+        
+        void schedule(Func output, GeneratorInput<Buffer<T>>& input, Target const& target) {
+            input.dim(0).set_stride(4);
+            input.dim(2).set_stride(1).set_bounds(0, 4);
+            output.output_buffer().dim(0).set_stride(4);
+            output.output_buffer().dim(2).set_stride(1).set_bounds(0, 4);
+            
+            /// eight float lanes on AVX2, sixteen on AVX-512:
+            const int lanes = target.natural_vector_size<float>();
+            
+            /// the weights are per output column and row, so they're computed once
+            /// (with the raw weights and their sums inlined):
+            kernel_x.compute_root()
+                    .reorder(k, x)
+                    .vectorize(x, lanes, TailStrategy::GuardWithIf);
+            kernel_y.compute_root()
+                    .reorder(k, y)
+                    .vectorize(y, lanes, TailStrategy::GuardWithIf);
+                    
+            /// bands of 32 output rows, one per task; each band runs the
+            /// horizontal pass over just the source rows it needs,
+            /// into scratch that stays in cache for the vertical pass:
+            output.reorder(c, x, y)
+                  .bound(c, 0, 4)
+                  .unroll(c)
+                  .split(y, yo, yi, 32)
+                  .parallel(yo)
+                  .vectorize(x, lanes, TailStrategy::GuardWithIf);
+            resized_x.compute_at(output, yo)
+                     .reorder(c, x, y)
+                     .bound(c, 0, 4)
+                     .unroll(c)
+                     .vectorize(x, lanes, TailStrategy::GuardWithIf);
+        }
+    };
+    
+    class ResizeU8 : public Generator<ResizeU8> {
+        
+        public:
+            Input<Buffer<uint8_t>> input{ "input", 3 };
+            Input<int32_t> kernel{ "kernel", 2, 0, 3 };
+            Input<float> origin_x{ "origin_x", 0.0f };
+            Input<float> origin_y{ "origin_y", 0.0f };
+            Input<float> scale_x{ "scale_x", 1.0f };
+            Input<float> scale_y{ "scale_y", 1.0f };
+            Output<Buffer<uint8_t>> output{ "output", 3 };
+            
+            void generate() {
+                resampler.define(output, input, kernel, origin_x, origin_y, scale_x, scale_y);
+            }
+            
+            void schedule() {
+                resampler.schedule(output, input, get_target());
+            }
+            
+        private:
+            Resampler<uint8_t> resampler;
+    };
+    
+    class ResizeF32 : public Generator<ResizeF32> {
+        
+        public:
+            Input<Buffer<float>> input{ "input", 3 };
+            Input<int32_t> kernel{ "kernel", 2, 0, 3 };
+            Input<float> origin_x{ "origin_x", 0.0f };
+            Input<float> origin_y{ "origin_y", 0.0f };
+            Input<float> scale_x{ "scale_x", 1.0f };
+            Input<float> scale_y{ "scale_y", 1.0f };
+            Output<Buffer<float>> output{ "output", 3 };
+            
+            void generate() {
+                resampler.define(output, input, kernel, origin_x, origin_y, scale_x, scale_y);
+            }
+            
+            void schedule() {
+                resampler.schedule(output, input, get_target());
+            }
+            
+        private:
+            Resampler<float> resampler;
+    };
+    
+} /// namespace (anon.)
+
+HALIDE_REGISTER_GENERATOR(ResizeU8, halogen_resize_u8)
+HALIDE_REGISTER_GENERATOR(ResizeF32, halogen_resize_f32)
@@ -4,6 +4,15 @@
 #ifndef SUBJECTIVE_C_APPKIT_HH
 #define SUBJECTIVE_C_APPKIT_HH
 
+#include <mutex>
+#include <tuple>
+#include <string>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <unordered_map>
 #import  <AppKit/AppKit.h>
 #include "types.hh"
 #include "traits.hh"
@@ -12,16 +21,68 @@ namespace objc {
     
     namespace appkit {
         
+        /// What paste<OCTypes...>() hands back: one optional per type, empty
+        /// if nothing on the pasteboard could be read as that type:
+        template <typename ...OCTypes>
+        using pasted_t = std::tuple<std::optional<objc::ocpointer_t<OCTypes>>...>;
+        
+        namespace detail {
+            
+            /// The class array for a set of types, built once per set --
+            /// as is the (empty) options dictionary they're all read with:
+            template <typename ...OCTypes>
+            NSArray<Class>* classes() {
+                static NSArray<Class>* out = @[ [objc::octype_t<OCTypes> class]... ];
+                return out;
+            }
+            
+            inline NSDictionary<NSPasteboardReadingOptionKey, id>* options() {
+                static NSDictionary<NSPasteboardReadingOptionKey, id>* out = @{};
+                return out;
+            }
+            
+            /// Fill `slot` with `object` if it's empty and `object` is an OCType:
+            template <typename OCType, typename Slot>
+            bool take(id object, Slot& slot) {
+                if (slot || ![object isKindOfClass:[objc::octype_t<OCType> class]]) { return false; }
+                slot = static_cast<objc::ocpointer_t<OCType>>(object);
+                return true;
+            }
+            
+            template <typename ...OCTypes, std::size_t ...I>
+            void distribute(NSArray* objects, pasted_t<OCTypes...>& out, std::index_sequence<I...>) {
+                for (id object in objects) {
+                    (void)(detail::take<OCTypes>(object, std::get<I>(out)) || ...);
+                }
+            }
+            
+            /// One readObjectsForClasses: call for the whole set of types:
+            template <typename ...OCTypes>
+            pasted_t<OCTypes...> read(NSPasteboard* board) {
+                static_assert(objc::traits::detail::are_object_pointers<
+                              objc::ocpointer_t<OCTypes>...>::value,
+                             "objc::appkit::paste<...OCTypes> requires Objective-C object types");
+                             
+                if (!board) { board = [NSPasteboard generalPasteboard]; }
+                pasted_t<OCTypes...> out;
+                NSArray* objects = [board readObjectsForClasses:detail::classes<OCTypes...>()
+                                                        options:detail::options()];
+                detail::distribute<OCTypes...>(objects, out, std::index_sequence_for<OCTypes...>{});
+                return out;
+            }
+            
+        } /// namespace detail
+        
         template <typename OCType>
         bool can_paste(NSPasteboard* board = nil) noexcept
         {
             static_assert(objc::traits::is_object<
                           objc::ocpointer_t<OCType>>::value,
                          "objc::appkit::can_paste<OCType> requires an Objective-C object type");
-            
+                         
             if (!board) { board = [NSPasteboard generalPasteboard]; }
-            return objc::to_bool([board canReadObjectForClasses:@[ [objc::octype_t<OCType> class] ]
-                                                        options:@{ }]);
+            return objc::to_bool([board canReadObjectForClasses:detail::classes<OCType>()
+                                                        options:detail::options()]);
         }
         
         template <typename OCType>
@@ -32,17 +93,86 @@ namespace objc {
                           objc::ocpointer_t<OCType>>::value,
                          "objc::appkit::paste<OCType> requires an Objective-C object type");
             
-            if (!board) { board = [NSPasteboard generalPasteboard]; }
-            if (!objc::appkit::can_paste<OCType>(board)) { return nil; }
-            
-            NSArray* out = [board readObjectsForClasses:@[ [objc::octype_t<OCType> class] ]
-                                                options:@{ }];
+            /// nil if there's nothing readable as an OCType:
+            return std::get<0>(detail::read<OCType>(board)).value_or(nil);
+        }
             
-            /// array is nil on error -- but empty if the call to
-            /// `readObjectsForClasses:options:` comes up short… SOOO:
-            return out == nil ? nil : out[0];
+        /// Several types in one pass: a single readObjectsForClasses: call,
+        /// each object landing in the first empty slot whose type it is. As
+        /// NSPasteboard gives each item to the first class that can read it,
+        /// list the most specific types first -- NSURL before NSImage, say:
+        ///
+        ///     auto [url, image] = objc::appkit::paste<NSURL, NSImage>(board);
+        ///     if (url && image) { ... }
+        ///
+        template <typename OCType, typename OCOtherType, typename ...OCTypes>
+        pasted_t<OCType, OCOtherType, OCTypes...> paste(NSPasteboard* board = nil) noexcept
+        {
+            return detail::read<OCType, OCOtherType, OCTypes...>(board);
         }
         
+        /// Opt-in caching for the above: a paste_cache keeps its last read of
+        /// each pasteboard -- by name -- until that pasteboard's changeCount
+        /// moves, and reading it again in the meantime returns the same objects
+        /// without a round trip. Those objects are shared by everything reading
+        /// through the cache, so treat them as read-only (or copy them). The
+        /// pasteboard is never queried with the lock held, and a cache lives
+        /// only as long as its owner does -- clear() lets go of it all sooner:
+        ///
+        ///     objc::appkit::paste_cache<NSURL, NSImage> cache;
+        ///     auto [url, image] = cache.paste(board);
+        ///
+        template <typename ...OCTypes>
+        class paste_cache {
+            
+            public:
+                using pasted_type = pasted_t<OCTypes...>;
+                
+                pasted_type paste(NSPasteboard* board = nil) {
+                    if (!board) { board = [NSPasteboard generalPasteboard]; }
+                    const std::string name = [[board name] UTF8String];
+                    
+                    /// taken before reading: a change in between means the next
+                    /// call misses, rather than stale contents getting cached:
+                    const NSInteger changecount = [board changeCount];
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        auto found = entries.find(name);
+                        if (found != entries.end() && found->second.changecount == changecount) {
+                            return found->second.pasted;
+                        }
+                    }
+                    
+                    pasted_type out = detail::read<OCTypes...>(board);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    entry_t& entry = entries[name];
+                    if (changecount >= entry.changecount) {
+                        entry.changecount = changecount;
+                        entry.pasted = out;
+                    }
+                    return out;
+                }
+                
+                void clear() {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    entries.clear();
+                }
+                
+                std::size_t size() const {                  /// pasteboards held
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return entries.size();
+                }
+                
+            private:
+                struct entry_t {
+                    NSInteger changecount = -1;
+                    pasted_type pasted;
+                };
+                
+                mutable std::mutex mutex;
+                std::unordered_map<std::string, entry_t> entries;
+        };
+        
         template <typename ...OCTypes>
         bool copy_to(NSPasteboard* board, OCTypes... objects) noexcept
         {
@@ -51,7 +181,7 @@ namespace objc {
             static_assert(objc::traits::detail::are_object_pointers<
                           objc::ocpointer_t<OCTypes>...>::value,
                          "objc::appkit::copy_to<...OCTypes> requires Objective-C objects");
-            
+                         
             if (!board) { board = [NSPasteboard generalPasteboard]; }
             NSArray< __kindof NSObject<NSPasteboardWriting>* >* copyables = @[ objects... ];
             
@@ -73,6 +203,67 @@ namespace objc {
             return objc::appkit::copy_to<OCTypes...>(nil, objects...);
         }
         
+        /// Lazy copying: instead of writing out every representation up front,
+        /// copy_lazy() puts a promise on the pasteboard -- a list of types and
+        /// an encoder apiece -- and each encoder runs only when its type is
+        /// first asked for, the result being kept for any asks after that.
+        
+        using encoder_t = std::function<NSData*()>;
+        
+        class promise {
+            
+            public:
+                using encoders_t = std::vector<std::pair<NSPasteboardType, encoder_t>>;
+                
+                explicit promise(encoders_t encoders);      /// in order of preference
+                
+                NSArray<NSPasteboardType>* types() const;
+                NSData* data(NSPasteboardType type);        /// nil for types not promised
+                bool cached(NSPasteboardType type) const;
+                std::size_t encodes() const;                /// encoders run so far
+                
+            private:
+                mutable std::mutex mutex;
+                encoders_t encoders;
+                NSMutableDictionary<NSPasteboardType, NSData*>* cache;
+                std::size_t count = 0;
+        };
+        
+        using promise_ptr = std::shared_ptr<promise>;
+        
+        /// PNG and TIFF, each encoded from the image's best bitmap rep
+        /// (q.v. -[NSImage dataForImageFileType:]):
+        promise_ptr image_promise(NSImage* image);
+        
+        /// An in-process stand-in for NSPasteboard, for tests and headless
+        /// runs -- it holds data and promises, fulfills promises when their
+        /// types are read, and keeps a change count, as NSPasteboard does:
+        class stand_in {
+            
+            public:
+                stand_in();
+                
+                NSInteger clear();                          /// ~ -clearContents
+                void write(NSPasteboardType type, NSData* data);
+                void write(promise_ptr promised);
+                NSData* data(NSPasteboardType type);        /// ~ -dataForType:
+                NSArray<NSPasteboardType>* types() const;   /// ~ -types
+                NSInteger changecount() const;              /// ~ -changeCount
+                
+            private:
+                mutable std::mutex mutex;
+                NSMutableDictionary<NSPasteboardType, NSData*>* contents;
+                std::vector<promise_ptr> promises;
+                NSInteger count = 0;
+        };
+        
+        /// Clear `board` (the general pasteboard, if nil) and put `promised` on it,
+        /// by way of an NSPasteboardItem and its data provider:
+        bool copy_lazy(NSPasteboard* board, promise_ptr promised);
+        bool copy_lazy(NSPasteboard* board, NSImage* image);
+        bool copy_lazy(stand_in& board, promise_ptr promised);
+        bool copy_lazy(stand_in& board, NSImage* image);
+        
     }
     
 }
@@ -0,0 +1,59 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_BUFFERPOOL_HH_
+#define SUBJECTIVE_C_BUFFERPOOL_HH_
+
+#include <memory>
+#include <cstddef>
+#include <subjective-c/subjective-c.hpp>
+#import  <CoreGraphics/CoreGraphics.h>
+
+namespace objc {
+    
+    namespace cg {
+        
+        /// A pool of same-size pixel buffers for CGImages to live in:
+        ///
+        ///     CGDataProviderRef provider = objc::cg::buffer_pool::shared().provider(rowbytes * height, &pixels);
+        ///     /// ... fill `pixels`, CGImageCreate() with `provider`, release `provider` ...
+        ///
+        /// When the last CGImage using a buffer goes away, CoreGraphics hands the buffer
+        /// back via the data provider's release callback, and the next request for
+        /// the same size reuses it -- so a steady stream of same-size frames stops
+        /// hitting malloc()/free() (and the page-fault storm that fresh multi-megabyte
+        /// allocations bring) after the first few. Up to `capacity` idle buffers are kept.
+        /// Buffers may be returned on any thread, and may outlive the pool object itself.
+        
+        class buffer_pool {
+            
+            public:
+                static constexpr std::size_t default_capacity = 8;
+                static buffer_pool& shared();
+                struct state_t;                     /// opaque, shared with outstanding buffers
+                
+            public:
+                explicit buffer_pool(std::size_t capacity = default_capacity);
+                buffer_pool(buffer_pool const&) = delete;
+                buffer_pool& operator=(buffer_pool const&) = delete;
+                virtual ~buffer_pool();
+                
+            public:
+                /// Returns a +1 data provider over a buffer of `size` bytes,
+                /// storing the buffer's address in `*data`:
+                __attribute__((cf_returns_retained))
+                CGDataProviderRef provider(std::size_t size, byte** data);
+                
+                std::size_t idle() const;           /// buffers waiting for reuse
+                std::size_t allocations() const;    /// buffers ever malloc()'ed
+                void clear();
+                
+            private:
+                std::shared_ptr<state_t> state;
+        };
+        
+    } /// namespace cg
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_BUFFERPOOL_HH_
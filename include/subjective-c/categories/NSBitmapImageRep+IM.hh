@@ -4,9 +4,11 @@
 #ifndef LIBIMREAD_EXT_CATEGORIES_NSBITMAPIMAGEREP_PLUS_IM_HH_
 #define LIBIMREAD_EXT_CATEGORIES_NSBITMAPIMAGEREP_PLUS_IM_HH_
 
+#include <array>
 #include <memory>
 #include <subjective-c/subjective-c.hpp>
-#import  <Foundation/Foundation.h>
+#include <subjective-c/pixels.hh>
+#import  <AppKit/AppKit.h>
 
 using objc::byte;
 using objc::bytevec_t;
@@ -19,14 +21,50 @@ namespace im {
 using im::Image;
 using im::ImageFactory;
 
+namespace objc {
+    namespace pixels {
+        /// describe a libimread image's sample storage for objc::pixels::transfer():
+        layout layout_of(Image const& image);
+    }
+}
+
 @interface NSBitmapImageRep (AXBitmapImageRepAdditions)
 
 + (instancetype)           imageRepWithByteVector:(bytevec_t const&)byteVector;
 + (instancetype)           imageRepWithImage:(Image const&)image;
++ (instancetype)           imageRepWithSharedImage:(std::shared_ptr<Image>)image;
 -                          initWithByteVector:(bytevec_t const&)byteVector;
 -                          initWithImage:(Image const&)image;
+
+/// Zero-copy: the rep draws straight from the image's own buffers,
+/// and keeps the image alive for as long as it needs them.
+/// Layouts AppKit can't take as-is fall back to -initWithImage:,
+/// and a null pointer gets you nil:
+-                          initWithSharedImage:(std::shared_ptr<Image>)image;
+
 - (std::unique_ptr<Image>) imageUsingImageFactory:(ImageFactory*)factory;
 
+/// Zero-copy: an im::Image viewing (and retaining) the rep's own samples,
+/// or nullptr for reps libimread can't describe in place -- premultiplied
+/// or alpha-first storage, irregularly-spaced planes -- in which case
+/// -imageUsingImageFactory: will make a copy
+- (std::unique_ptr<Image>) imageView;
+- (objc::pixels::layout)   pixelLayout;
+
+/// Copies with their pixels changed -- by the halogen/ Halide pipelines for
+/// interleaved 8-bit RGBA (q.v. subjective-c/halogen.hh), and otherwise by
+/// objc::pixels::transfer() or ColorSync. Premultiplying an already-premultiplied
+/// rep (or one without alpha) just copies it, and likewise for the reverse;
+/// reordering takes four-sample reps, with channel `n` of the copy coming
+/// from channel `order[n]` of the original; matching converts from the rep's
+/// color space to `colorSpace`, as -bitmapImageRepByConvertingToColorSpace:
+/// renderingIntent: does with the default intent -- the pipeline handles
+/// straight-alpha RGBA among sRGB, linear sRGB and Display P3:
+- (NSBitmapImageRep*)      bitmapImageRepByPremultiplyingAlpha;
+- (NSBitmapImageRep*)      bitmapImageRepByUnpremultiplyingAlpha;
+- (NSBitmapImageRep*)      bitmapImageRepByReorderingChannels:(std::array<uint8_t, 4>)order;
+- (NSBitmapImageRep*)      bitmapImageRepByMatchingToColorSpace:(NSColorSpace*)colorSpace;
+
 @end
 
 #endif /// LIBIMREAD_EXT_CATEGORIES_NSBITMAPIMAGEREP_PLUS_IM_HH_
\ No newline at end of file
@@ -5,7 +5,7 @@
 #define LIBIMREAD_EXT_CATEGORIES_NSCOLOR_PLUS_IM_HH_
 
 #include <subjective-c/subjective-c.hpp>
-#import  <Foundation/Foundation.h>
+#import  <AppKit/AppKit.h>
 #include <libimread/color.hh>
 
 using namespace im;
@@ -17,6 +17,55 @@ using namespace im;
 - (color::RGBA)         uniformRGBA;
 - (color::RGB)          uniformRGB;
 - (color::Monochrome)   uniformMonochrome;
+
+/// Whole spans of uniform colors per call -- a palette, or a buffer of
+/// pixels -- from one color space to another, with no NSColor per entry.
+/// RGB and RGBA convert between RGB spaces, Monochrome between gray ones.
+/// A space to itself, and sRGB to or from linear sRGB, run on the
+/// objc::colors kernels; anything else goes to vImage. Alpha passes through.
+/// Returns NO if a space is of the wrong model, or vImage won't convert.
+/// Source and destination may be the same:
++ (BOOL)                convertUniformRGBA:(color::RGBA const*)source
+                             toUniformRGBA:(color::RGBA*)destination
+                                     count:(NSUInteger)count
+                            fromColorSpace:(NSColorSpace*)from
+                              toColorSpace:(NSColorSpace*)to;
++ (BOOL)                convertUniformRGB:(color::RGB const*)source
+                             toUniformRGB:(color::RGB*)destination
+                                    count:(NSUInteger)count
+                           fromColorSpace:(NSColorSpace*)from
+                             toColorSpace:(NSColorSpace*)to;
++ (BOOL)                convertUniformMonochrome:(color::Monochrome const*)source
+                             toUniformMonochrome:(color::Monochrome*)destination
+                                           count:(NSUInteger)count
+                                  fromColorSpace:(NSColorSpace*)from
+                                    toColorSpace:(NSColorSpace*)to;
+                                    
+/// Palettes as NSColors in `space` (RGB, or gray for Monochrome), with the
+/// components for the whole span computed at once -- RGB and Monochrome
+/// colors come out opaque:
++ (NSArray<NSColor*>*)  colorsWithUniformRGBA:(color::RGBA const*)colors
+                                        count:(NSUInteger)count
+                                   colorSpace:(NSColorSpace*)space;
++ (NSArray<NSColor*>*)  colorsWithUniformRGB:(color::RGB const*)colors
+                                       count:(NSUInteger)count
+                                  colorSpace:(NSColorSpace*)space;
++ (NSArray<NSColor*>*)  colorsWithUniformMonochrome:(color::Monochrome const*)colors
+                                              count:(NSUInteger)count
+                                         colorSpace:(NSColorSpace*)space;
+                                         
+/// ... and back: each color is first converted to `space` (or left in its
+/// own, if `space` is nil), and the whole span quantized at once. Returns
+/// NO if any color can't be converted, or has the wrong number of components:
++ (BOOL)                getUniformRGBA:(color::RGBA*)destination
+                            fromColors:(NSArray<NSColor*>*)colors
+                            colorSpace:(NSColorSpace*)space;
++ (BOOL)                getUniformRGB:(color::RGB*)destination
+                           fromColors:(NSArray<NSColor*>*)colors
+                           colorSpace:(NSColorSpace*)space;
++ (BOOL)                getUniformMonochrome:(color::Monochrome*)destination
+                                  fromColors:(NSArray<NSColor*>*)colors
+                                  colorSpace:(NSColorSpace*)space;
 @end
 
 #endif /// LIBIMREAD_EXT_CATEGORIES_NSCOLOR_PLUS_IM_HH_
\ No newline at end of file
@@ -8,9 +8,29 @@
 
 #import <Cocoa/Cocoa.h>
 
+typedef NS_ENUM(NSInteger, AXResizeFilter) {
+    AXResizeFilterBox,
+    AXResizeFilterBilinear,
+    AXResizeFilterLanczos3,
+    AXResizeFilterMitchell
+};
+
+/// These resample pixels directly (q.v. subjective-c/resample.hh) -- no lockFocus,
+/// no graphics context -- and return an NSImage backed by a single premultiplied
+/// RGBA NSBitmapImageRep, 8-bit or float to match the source, one pixel per point.
+/// The unqualified methods use AXResizeFilterLanczos3.
+
 @interface NSImage (Resize)
 
 - (NSImage*) resizeImageToSize:(NSSize)size;
+- (NSImage*) resizeImageToSize:(NSSize)size
+                        filter:(AXResizeFilter)filter;
 - (NSImage*) resizeImageWithMaxDimension:(NSSize)size;
 
+/// `sourceRect` is in the receiver's coordinates, as with -drawInRect:fromRect:...
+/// NSZeroRect means the whole image:
+- (NSImage*) imageByResamplingToSize:(NSSize)size
+                            fromRect:(NSRect)sourceRect
+                              filter:(AXResizeFilter)filter;
+                              
 @end
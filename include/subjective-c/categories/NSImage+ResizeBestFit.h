@@ -17,4 +17,20 @@
 - (NSData*)  JPEGData;
 - (NSData*)  JPEGDataWithCompression:(float)factor;
 
+/// Encoding with ImageIO, straight from the image's CGImage, on this
+/// thread's objc::cg::encoder -- these append to `sink`, which can be
+/// cleared and reused from one image to the next, and return NO (leaving
+/// `sink` as it was) on failure:
+- (BOOL)     appendPNGDataTo:(NSMutableData*)sink;
+- (BOOL)     appendJPEGDataTo:(NSMutableData*)sink compression:(float)factor;
+
+/// The bitmap representation with the most pixels, or nil if there are
+/// none (as with PDF- or EPS-backed images):
+- (NSBitmapImageRep*) bestBitmapImageRep;
+
+/// Data in `type`, encoded straight from -bestBitmapImageRep -- not by way
+/// of -TIFFRepresentation and a reparse -- or from the image's CGImage when
+/// it has no bitmap representations; PNG goes through objc::cg::encoder:
+- (NSData*)  dataForImageFileType:(NSBitmapImageFileType)type;
+
 @end
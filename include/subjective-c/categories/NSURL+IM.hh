@@ -5,6 +5,8 @@
 #define LIBIMREAD_EXT_CATEGORIES_NSURL_PLUS_IM_HH_
 
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <subjective-c/subjective-c.hpp>
 #import  <AppKit/AppKit.h>
 #import  <Foundation/Foundation.h>
@@ -15,6 +17,10 @@ namespace filesystem {
     class path;
 }
 
+namespace im {
+    class byte_source;
+}
+
 namespace objc {
     
     namespace image {
@@ -41,8 +47,157 @@ namespace objc {
         template <NSBitmapImageFileType nstype>
         constexpr char const* suffix_value = suffix_t<nstype>::endstr;
         
+        namespace detail {
+            
+            /// Compile-time perfect hash over every suffix that `filetype()`
+            /// recognizes -- canonical spellings come from the `suffix_t`
+            /// specializations above, aliases are listed alongside them.
+            /// Lookups fold ASCII case and touch at most one table slot,
+            /// so classifying a path never allocates.
+            
+            struct suffix_entry {
+                char const* endstr;
+                std::size_t size;
+                NSBitmapImageFileType typecode;
+            };
+            
+            template <NSBitmapImageFileType nstype> inline
+            constexpr suffix_entry canonical_entry() {
+                return { suffix_t<nstype>::endstr,
+                         suffix_t<nstype>::N - 1,
+                         suffix_t<nstype>::typecode };
+            }
+            
+            constexpr suffix_entry suffix_entries[] = {
+                canonical_entry<NSTIFFFileType>(),
+                canonical_entry<NSBMPFileType>(),
+                canonical_entry<NSGIFFileType>(),
+                canonical_entry<NSJPEGFileType>(),
+                canonical_entry<NSPNGFileType>(),
+                canonical_entry<NSJPEG2000FileType>(),
+                canonical_entry<AXPVRFileType>(),
+                { "tif",    3, NSTIFFFileType },
+                { "jpeg",   4, NSJPEGFileType },
+                { "pvrtc",  5, AXPVRFileType  }
+            };
+            
+            constexpr std::size_t suffix_count = sizeof(suffix_entries) / sizeof(suffix_entry);
+            constexpr std::size_t suffix_max = 5;
+            constexpr std::size_t suffix_bits = 5;
+            constexpr std::size_t suffix_slots = 1 << suffix_bits;
+            
+            constexpr char fold(char c) {
+                return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+            }
+            
+            /// first character, last character and length uniquely identify
+            /// each entry -- a multiplicative hash spreads them over the slots:
+            constexpr std::size_t suffix_hash(char const* s, std::size_t n, uint32_t seed) {
+                return static_cast<std::size_t>(
+                      ((static_cast<uint32_t>(fold(s[0]))       << 16 |
+                        static_cast<uint32_t>(fold(s[n - 1]))   << 8  |
+                        static_cast<uint32_t>(n)) * seed) >> (32 - suffix_bits));
+            }
+            
+            constexpr bool suffix_seed_ok(uint32_t seed) {
+                bool taken[suffix_slots] = { false };
+                for (std::size_t idx = 0; idx < suffix_count; ++idx) {
+                    std::size_t slot = suffix_hash(suffix_entries[idx].endstr,
+                                                   suffix_entries[idx].size, seed);
+                    if (taken[slot]) { return false; }
+                    taken[slot] = true;
+                }
+                return true;
+            }
+            
+            constexpr uint32_t suffix_find_seed() {
+                for (uint32_t seed = 0x9e3779b1; seed != 1; seed += 2) {
+                    if (suffix_seed_ok(seed)) { return seed; }
+                }
+                return 0;
+            }
+            
+            constexpr uint32_t suffix_seed = suffix_find_seed();
+            static_assert(suffix_seed != 0, "no perfect hash seed for the suffix table");
+            
+            struct suffix_slot {
+                char endstr[suffix_max + 1];
+                std::size_t size;
+                NSInteger typecode;
+            };
+            
+            struct suffix_table_t {
+                suffix_slot slots[suffix_slots];
+            };
+            
+            constexpr suffix_table_t suffix_build_table() {
+                suffix_table_t table{};
+                for (std::size_t slot = 0; slot < suffix_slots; ++slot) {
+                    table.slots[slot].typecode = -1;
+                }
+                for (std::size_t idx = 0; idx < suffix_count; ++idx) {
+                    suffix_entry const& entry = suffix_entries[idx];
+                    suffix_slot& slot = table.slots[suffix_hash(entry.endstr, entry.size, suffix_seed)];
+                    for (std::size_t cdx = 0; cdx < entry.size; ++cdx) {
+                        slot.endstr[cdx] = entry.endstr[cdx];
+                    }
+                    slot.size = entry.size;
+                    slot.typecode = static_cast<NSInteger>(entry.typecode);
+                }
+                return table;
+            }
+            
+            constexpr suffix_table_t suffix_table = suffix_build_table();
+            
+            /// case-insensitive lookup, with or without a leading dot:
+            constexpr NSInteger lookup(std::string_view suffix) {
+                if (!suffix.empty() && suffix.front() == '.') { suffix.remove_prefix(1); }
+                if (suffix.empty() || suffix.size() > suffix_max) { return -1; }
+                suffix_slot const& slot = suffix_table.slots[suffix_hash(suffix.data(),
+                                                                         suffix.size(),
+                                                                         suffix_seed)];
+                if (slot.size != suffix.size()) { return -1; }
+                for (std::size_t idx = 0; idx < slot.size; ++idx) {
+                    if (fold(suffix[idx]) != slot.endstr[idx]) { return -1; }
+                }
+                return slot.typecode;
+            }
+            
+        }
+        
+        /// the extension of the last path component, sans dot --
+        /// a non-allocating stand-in for `-[NSString pathExtension]`:
+        constexpr std::string_view extension(std::string_view path) {
+            std::size_t dot = path.rfind('.');
+            std::size_t slash = path.rfind('/');
+            if (dot == std::string_view::npos) { return {}; }
+            if (slash != std::string_view::npos && dot <= slash + 1) { return {}; }
+            if (slash == std::string_view::npos && dot == 0) { return {}; }
+            return path.substr(dot + 1);
+        }
+        
+        static_assert(detail::lookup("JPEG") == static_cast<NSInteger>(NSJPEGFileType),
+                      "suffix table lookup is broken");
+        static_assert(detail::lookup(".tif") == static_cast<NSInteger>(NSTIFFFileType),
+                      "suffix table lookup is broken");
+        static_assert(detail::lookup("txt")  == -1,
+                      "suffix table lookup is broken");
+                      
         extern std::string suffix(NSBitmapImageFileType nstype);
-        extern NSInteger filetype(std::string const& suffix);
+        extern NSInteger filetype(std::string_view suffix);
+        
+        /// the uniform type identifier -- and so the pasteboard type -- for
+        /// `nstype` (e.g. "public.png"), or "" if it has none:
+        extern std::string uti(NSBitmapImageFileType nstype);
+        
+        /// Content sniffing: identify an image type from its magic bytes,
+        /// looking at no more than the first `sniff_size` bytes.
+        /// Returns -1 when nothing matches, just like `filetype()`.
+        
+        constexpr std::size_t sniff_size = 32;
+        
+        extern NSInteger sniff(objc::byte const* head, std::size_t size);
+        extern NSInteger sniff(im::byte_source& source);
         
     };
     
@@ -20,8 +20,22 @@ inline CGRect CGRectWithPointAndSize(NSPoint point, NSInteger width, NSInteger h
 }
 
 - initWithImageRef:(CGImageRef)myImage colorSpaceName:(NSString*)space;
+- (CGImageRef) CGImage;     /// subclasses may override this to produce the image on demand
 - (void) setColorSpaceHolder:(id<NSObject, NSCopying>)anObject;
 - (void) setImage:(CGImageRef)newImage;
 - (void) setColorSpaceName:(NSString*)space;
 
+/// Images larger than the tile threshold on either side (2048 pixels, unless set
+/// otherwise) are drawn through a lazily-built mip pyramid, one tile at a time
+/// (q.v. subjective-c/tiles.hh) -- unless tiling is off:
+- (void) setTiled:(BOOL)tiled;
+- (BOOL) isTiled;
+- (void) setTileThreshold:(NSUInteger)threshold;
+- (NSUInteger) tileThreshold;
+
+/// The byte budget of the tile cache that all instances share,
+/// which holds their downsampled mip levels:
++ (void) setTileCacheBudget:(NSUInteger)budget;
++ (NSUInteger) tileCacheBudget;
+
 @end
@@ -4,6 +4,8 @@
 #ifndef LIBIMREAD_EXT_CLASSES_AXINTERLEAVEDIMAGEREP_HH_
 #define LIBIMREAD_EXT_CLASSES_AXINTERLEAVEDIMAGEREP_HH_
 
+#include <memory>
+#include <cstddef>
 #include <libimread/color.hh>
 #include <libimread/interleaved.hh>
 #import  <subjective-c/classes/AXCoreGraphicsImageRep.h>
@@ -18,15 +20,74 @@ using im::color::Monochrome;
 using Meta = im::Meta<RGB>;
 using Interleaved = im::InterleavedImage<RGB>;
 
+namespace objc {
+    
+    namespace cg {
+        
+        /// CoreGraphics particulars for each libimread color type --
+        /// specialize this to teach CGImageFromInterleaved() a new one:
+        template <typename Color>
+        struct color_traits;
+        
+        template <>
+        struct color_traits<RGB> {
+            static constexpr std::size_t channels = 3;
+            static constexpr std::size_t bits = 8;
+            static constexpr bool alpha = false;
+            static constexpr CGBitmapInfo info = kCGImageAlphaNone;
+        };
+        
+        template <>
+        struct color_traits<RGBA> {
+            static constexpr std::size_t channels = 4;
+            static constexpr std::size_t bits = 8;
+            static constexpr bool alpha = true;
+            static constexpr CGBitmapInfo info = kCGImageAlphaLast;
+        };
+        
+        template <>
+        struct color_traits<Monochrome> {
+            static constexpr std::size_t channels = 1;
+            static constexpr std::size_t bits = 8;
+            static constexpr bool alpha = false;
+            static constexpr CGBitmapInfo info = kCGImageAlphaNone;
+        };
+        
+    } /// namespace cg
+    
+} /// namespace objc
+
+/// Both of these return a +1 CGImage, and consume the color space
+/// (which gets swapped for a device gray or RGB space, if it has the wrong
+/// number of components for `Color`). Neither one goes through a CGBitmapContext.
+///
+/// This one copies the pixels into a buffer from objc::cg::buffer_pool::shared(),
+/// which gets recycled once the CGImage is released:
 template <typename Color = RGB>
-__attribute__((cf_returns_not_retained))
+__attribute__((cf_returns_retained))
 CGImageRef CGImageFromInterleaved(
     const im::InterleavedImage<Color>& interleaved,
     __attribute__((cf_consumed))
         CGColorSpaceRef colorspace);
+        
+/// ... and this one copies nothing, keeping the image alive
+/// for as long as the CGImage needs its pixels:
+template <typename Color = RGB>
+__attribute__((cf_returns_retained))
+CGImageRef CGImageFromInterleaved(
+    std::shared_ptr<im::InterleavedImage<Color>> interleaved,
+    __attribute__((cf_consumed))
+        CGColorSpaceRef colorspace);
+        
+/// Reps made with -initLazilyWithInterleaved: hold only the interleaved image
+/// until something draws them -- the CGImage gets made (without copying pixels)
+/// on first use, and pixelsWide/pixelsHigh/hasAlpha don't need it at all.
+/// Materialized CGImages are dropped when the system signals memory pressure
+/// (or when -evictImage is called), and get remade on the next draw.
 
 @interface AXInterleavedImageRep : AXCoreGraphicsImageRep {
-    Interleaved interleavedImage;
+    std::shared_ptr<Interleaved> interleavedImage;
+    BOOL lazy;
 }
 
 + (instancetype)        imageRepWithInterleaved:(const Interleaved&)interleaved;
@@ -35,6 +96,14 @@ CGImageRef CGImageFromInterleaved(
 -                       initWithInterleaved:(const Interleaved&)interleaved;
 -                       initWithInterleaved:(const Interleaved&)interleaved
                              colorSpaceName:(NSString*)space;
++ (instancetype)        lazyImageRepWithInterleaved:(std::shared_ptr<Interleaved>)interleaved;
+-                       initLazilyWithInterleaved:(std::shared_ptr<Interleaved>)interleaved;
+-                       initLazilyWithInterleaved:(std::shared_ptr<Interleaved>)interleaved
+                                   colorSpaceName:(NSString*)space;
++ (void)                evictMaterializedImages;
+- (void)                evictImage;
+- (BOOL)                isLazy;
+- (BOOL)                isMaterialized;
 - (void)                setInterleaved:(const Interleaved&)interleaved;
 - (Interleaved const&)  interleaved;
 - (Meta const&)         imageMeta;
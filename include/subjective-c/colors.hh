@@ -0,0 +1,56 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_COLORS_HH_
+#define SUBJECTIVE_C_COLORS_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <subjective-c/subjective-c.hpp>
+
+namespace objc {
+    
+    /// Span-at-a-time color conversion kernels, for palettes and pixels
+    /// alike -- what the NSColor (AXColorAdditions) span methods run on.
+    /// Spans are `count` pixels of `stride` samples each, the first `colors`
+    /// of which are color channels that go through the transfer curve; any
+    /// after that (alpha, or the padding byte of a four-byte RGB) are taken
+    /// linearly:
+    ///
+    ///     /// 8-bit sRGB RGBA -> linear floats, alpha untouched:
+    ///     objc::colors::decode(rgba, floats, count, 4, 3, objc::colors::curve::srgb);
+    ///
+    /// Float-to-8-bit is clamped to [0, 1] and rounded to nearest. The sRGB
+    /// curve goes through tables -- 256 entries decoding, 4096 encoding, as
+    /// in halogen/colorconvert.cpp -- and the linear parts are SSE2 or NEON
+    /// where available, matching the scalar code bit-for-bit.
+    
+    namespace colors {
+        
+        enum class curve : uint8_t {
+            linear,                 /// samples are taken as they are
+            srgb                    /// IEC 61966-2-1, piecewise
+        };
+        
+        /// 8-bit samples to floats in [0, 1], linearizing colors in `from`:
+        void decode(byte const* source, float* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve from = curve::linear);
+                    
+        /// Floats to 8-bit samples, applying `to` to the colors:
+        void encode(float const* source, byte* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve to = curve::linear);
+                    
+        /// 8-bit to 8-bit, from one curve to the other, through a single
+        /// 256-entry table (which does lose shadow detail, going to linear).
+        /// Source and destination may be the same:
+        void recode(byte const* source, byte* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve from, curve to);
+                    
+    } /// namespace colors
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_COLORS_HH_
@@ -0,0 +1,70 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_ENCODER_HH_
+#define SUBJECTIVE_C_ENCODER_HH_
+
+#include <memory>
+#include <cstddef>
+#include <subjective-c/subjective-c.hpp>
+#import  <Foundation/Foundation.h>
+#import  <CoreGraphics/CoreGraphics.h>
+
+namespace objc {
+    
+    namespace cg {
+        
+        enum class encoding : uint8_t { png, jpeg };
+        
+        /// PNG and JPEG encoding straight from a CGImage, with ImageIO --
+        /// no TIFF in between -- and with whatever can be kept between
+        /// encodes kept, per thread:
+        ///
+        ///     objc::cg::encoder& encoder = objc::cg::encoder::local();
+        ///     encoder.encode(image, objc::cg::encoding::jpeg, 0.8f, sink);
+        ///
+        /// The data consumer ImageIO writes through, the encode properties
+        /// (for the last JPEG quality used) and a scratch buffer all live
+        /// as long as the thread does; only the CGImageDestination itself is
+        /// new each time, as ImageIO won't take a second image once one's
+        /// been finalized. Encoding appends to a sink, so a caller encoding
+        /// one image after another into the same (cleared) sink stops
+        /// allocating once the sink's grown big enough. Encoders aren't
+        /// shared between threads -- so there's no locking -- and shouldn't
+        /// be handed from one to another.
+        
+        class encoder {
+            
+            public:
+                static encoder& local();            /// this thread's encoder
+                struct state_t;                     /// opaque
+                
+            public:
+                encoder();
+                encoder(encoder const&) = delete;
+                encoder& operator=(encoder const&) = delete;
+                virtual ~encoder();
+                
+            public:
+                /// Append `image`, encoded, to `sink` -- `quality` (in [0, 1])
+                /// only matters to JPEG. On failure, `sink` is left as it was:
+                bool encode(CGImageRef image, encoding kind, float quality, bytevec_t& sink);
+                bool encode(CGImageRef image, encoding kind, float quality, NSMutableData* sink);
+                
+                /// Encode into the scratch buffer, and copy that out as NSData
+                /// (or return nil) -- one allocation, exactly the right size:
+                NSData* encode(CGImageRef image, encoding kind, float quality);
+                
+                std::size_t encodes() const;        /// successful encodes so far
+                std::size_t growths() const;        /// times a bytevec_t sink had to grow, mid-encode
+                std::size_t capacity() const;       /// the scratch buffer's, in bytes
+                
+            private:
+                std::unique_ptr<state_t> state;
+        };
+        
+    } /// namespace cg
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_ENCODER_HH_
@@ -0,0 +1,77 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_FORWARD_HH_
+#define SUBJECTIVE_C_FORWARD_HH_
+
+/// Forward declarations, for headers that only pass things around by pointer
+/// or by reference -- which is most of them. Foundation alone is some thousand
+/// headers deep, and Cocoa (AppKit, CoreData, CoreImage, QuartzCore ...) is a
+/// good deal more than that; a header that names NSPasteboard* in a signature
+/// needs an @class, not all of those, and the translation units that actually
+/// send messages import the framework themselves.
+
+#import  <objc/objc.h>
+
+#if defined(__OBJC__)
+@class NSObject;
+@class NSString;
+@class NSData;
+@class NSArray;
+@class NSDictionary;
+@class NSNumber;
+@class NSURL;
+@class NSError;
+@class NSImage;
+@class NSBitmapImageRep;
+@class NSColor;
+@class NSPasteboard;
+#endif
+
+namespace objc {
+    
+    template <typename OCType>
+    struct object;
+    
+    struct selector;
+    struct msg;
+    
+    template <typename Return, typename ...Args>
+    struct arguments;
+    
+    template <typename Return, typename ...Args>
+    struct message;
+    
+    namespace traits {
+        
+        template <typename T>
+        struct is_argument_list;
+        
+        template <typename T>
+        struct is_object;
+        
+        template <typename T>
+        struct is_selector;
+        
+        template <typename T>
+        struct is_class;
+        
+    } /* namespace traits */
+    
+    namespace json {
+        
+        class value;
+        class document;
+        struct member;
+        
+    } /// namespace json
+    
+    namespace appkit {
+        
+        class watcher;
+        
+    } /// namespace appkit
+    
+} /* namespace objc */
+
+#endif /// SUBJECTIVE_C_FORWARD_HH_
@@ -0,0 +1,67 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_HALOGEN_HH_
+#define SUBJECTIVE_C_HALOGEN_HH_
+
+#include <array>
+#include <cstdint>
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/resample.hh>
+
+namespace objc {
+    
+    /// The ahead-of-time Halide pipelines from halogen/, compiled for the
+    /// build machine's architecture -- on x86-64, with AVX-512, AVX2 and
+    /// SSE4.1 code paths chosen at runtime (q.v. HALOGEN_TARGETS).
+    /// They all take interleaved four-channel pixels, alpha last, described
+    /// by the same buffer_t as objc::resample -- rows may be padded, but must
+    /// be whole samples apart. Every function returns false (and writes nothing)
+    /// when it can't handle its arguments, or when the library was built without
+    /// the pipelines (q.v. the OBJC_HALOGEN CMake option), so callers can fall
+    /// back to objc::pixels, objc::resample or AppKit:
+    ///
+    ///     if (!objc::halogen::resize(source, destination, opts)) {
+    ///         objc::resample::resize(source, destination, opts);
+    ///     }
+    
+    namespace halogen {
+        
+        using buffer_t = resample::buffer_t;
+        
+        enum class colorspace : uint8_t {
+            srgb,                   /// IEC 61966-2-1
+            linear_srgb,            /// sRGB primaries, linear transfer
+            display_p3              /// P3 primaries, D65 white, sRGB transfer
+        };
+        
+        /// True if the library was built with the pipelines:
+        bool available() noexcept;
+        
+        /// Resample 8-bit or float RGBA, with the kernels of objc::resample --
+        /// in float throughout, so 8-bit output may differ from it by one.
+        /// Threading is Halide's, so `opts.threads` is ignored; `opts.vectorize`
+        /// being false means the caller wants the scalar code, so that's a no:
+        bool resize(buffer_t const& source, buffer_t const& destination,
+                    resample::options const& opts = resample::options{});
+                    
+        /// 8-bit RGBA, straight alpha to premultiplied and back -- both bit-exact
+        /// with objc::pixels::transfer(). Source and destination may be the same:
+        bool premultiply(buffer_t const& source, buffer_t const& destination);
+        bool unpremultiply(buffer_t const& source, buffer_t const& destination);
+        
+        /// 8-bit, four channels: destination channel `n` is source channel `order[n]`
+        /// -- { 2, 1, 0, 3 } swaps RGBA and BGRA. Not in place:
+        bool reorder(buffer_t const& source, buffer_t const& destination,
+                     std::array<uint8_t, 4> const& order);
+                     
+        /// 8-bit RGBA with straight alpha (which passes through) from one
+        /// color space to another -- within one of an exact conversion. Not in place:
+        bool convert(buffer_t const& source, buffer_t const& destination,
+                     colorspace from, colorspace to);
+                     
+    } /// namespace halogen
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_HALOGEN_HH_
@@ -0,0 +1,112 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_IMAGEINDEX_HH_
+#define SUBJECTIVE_C_IMAGEINDEX_HH_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <subjective-c/subjective-c.hpp>
+#import  <subjective-c/categories/NSURL+IM.hh>
+
+namespace objc {
+    
+    namespace image {
+        
+        /// A sorted, columnar index of the image files under a directory:
+        ///
+        ///     auto idx = objc::image::index::scan("/Volumes/Pix");
+        ///     idx.save("/tmp/pix.aximgidx");
+        ///     auto mapped = objc::image::index::map("/tmp/pix.aximgidx");
+        ///     for (std::size_t i = 0; i < mapped.size(); ++i) {
+        ///         mapped.path(i);         /// relative to mapped.root()
+        ///         mapped.typecode(i);     /// an NSBitmapImageFileType
+        ///         mapped.filesize(i);     /// in bytes
+        ///     }
+        ///
+        /// Directories are walked by a pool of worker threads, each of which
+        /// pulls directory entries in bulk (getattrlistbulk() on OS X, and
+        /// readdir()'s buffered getdents() elsewhere) -- no NSURL gets made
+        /// for any of it. Files are classified by the suffix table and/or by
+        /// sniffing magic bytes (q.v. NSURL+IM.hh).
+        ///
+        /// The index itself is one contiguous buffer: a header, the root path,
+        /// then offset, size and type-code columns, then the path arena.
+        /// The same bytes are written by `save()` and mmap()'ed by `map()`.
+        
+        class index {
+            
+            public:
+                enum class classify : uint8_t {
+                    suffix,         /// by filename extension only
+                    contents,       /// by magic bytes only
+                    either          /// by extension, falling back to magic bytes
+                };
+                
+                struct options {
+                    unsigned workers = 0;               /// 0 => hardware concurrency
+                    classify by = classify::suffix;
+                    bool images_only = true;            /// drop unclassifiable files
+                };
+                
+                struct header_t {
+                    char magic[8];
+                    uint32_t version;
+                    uint32_t rootsize;
+                    uint64_t count;
+                    uint64_t arenasize;
+                };
+                
+                static constexpr char const magic[8] = { 'A', 'X', 'I', 'M', 'G', 'I', 'D', 'X' };
+                static constexpr uint32_t version = 1;
+                static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+                
+            public:
+                static index scan(std::string const& root);
+                static index scan(std::string const& root, options const& opts);
+                static index map(std::string const& indexfile);
+                
+            public:
+                index(index const&);
+                index(index&&) noexcept;
+                virtual ~index();
+                index& operator=(index const&);
+                index& operator=(index&&) noexcept;
+                
+            public:
+                bool save(std::string const& indexfile) const;
+                
+                std::size_t size() const noexcept;
+                bool empty() const noexcept;
+                std::size_t bytes() const noexcept;
+                
+                std::string_view root() const noexcept;
+                std::string_view path(std::size_t idx) const noexcept;
+                NSInteger typecode(std::size_t idx) const noexcept;
+                uint64_t filesize(std::size_t idx) const noexcept;
+                
+                /// binary search on the (sorted) relative paths:
+                std::size_t find(std::string_view relpath) const noexcept;
+                
+            protected:
+                index(std::shared_ptr<void> storage, std::size_t length);
+                void attach();
+                
+            protected:
+                std::shared_ptr<void> storage;
+                std::size_t length = 0;
+                header_t const* header = nullptr;
+                char const* rootstr = nullptr;
+                uint64_t const* offsets = nullptr;
+                uint64_t const* sizes = nullptr;
+                int16_t const* types = nullptr;
+                char const* arena = nullptr;
+        };
+        
+    } /// namespace image
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_IMAGEINDEX_HH_
@@ -0,0 +1,301 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_JSON_HH_
+#define SUBJECTIVE_C_JSON_HH_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <libimread/options.hh>
+
+#include <subjective-c/forward.hh>
+
+namespace objc {
+    
+    namespace json {
+        
+        /// A JSON document, parsed in two passes, as simdjson does it:
+        ///
+        ///     auto doc = objc::json::document::parse(text);
+        ///     for (auto const& member : doc.root().members()) {
+        ///         member.key;                     /// a std::string_view
+        ///         member.val.is_array();          /// ... and an objc::json::value
+        ///     }
+        ///     doc.root()["images"][0]["width"].as_integer();
+        ///     doc.root().traverse([](auto const& value, std::string_view key, std::size_t depth) { … });
+        ///     NSDictionary* dict = doc.root().materialize();
+        ///
+        /// The first pass classifies the text 64 bytes at a time with SIMD compares
+        /// (SSE2 or NEON, with a scalar fallback) -- finding escaped characters and the
+        /// insides of strings with bit arithmetic, not branches -- into an index of every
+        /// structural character and the start of every scalar. The second pass walks that
+        /// index, validating as it goes, into a tape: one 64-bit word per value, tagged with
+        /// its type, whose containers know where they end and how many things they hold.
+        /// Strings are unescaped into one buffer, numbers parsed onto the tape itself.
+        ///
+        /// Nothing on the tape is an object: values are cheap views (a document pointer and a
+        /// tape index) to be iterated lazily, traversed with a lambda or a block, or else
+        /// materialized -- into NSDictionary/NSArray/NSString/NSNumber/NSNull, or im::Options --
+        /// when and where they're wanted. Values are good for as long as their document is.
+        /// Malformed JSON (and invalid UTF-8) makes `parse()` throw, via imread_assert.
+        
+        enum class tag : uint8_t {
+            object      = '{',
+            object_end  = '}',
+            array       = '[',
+            array_end   = ']',
+            string      = '"',
+            integer     = 'l',
+            real        = 'd',
+            truth       = 't',
+            falsity     = 'f',
+            null        = 'n'
+        };
+        
+        class document;
+        class value;
+        
+        struct member;
+        
+        class value {
+            
+            public:
+                class iterator;
+                class member_iterator;
+                
+                template <typename Iterator>
+                struct range_t {
+                    Iterator first, last;
+                    Iterator begin() const { return first; }
+                    Iterator end() const { return last; }
+                };
+                
+            public:
+                value() = default;
+                
+                explicit operator bool() const      { return doc != nullptr; }
+                tag type() const;
+                
+                bool is_object() const              { return type() == tag::object; }
+                bool is_array() const               { return type() == tag::array; }
+                bool is_string() const              { return type() == tag::string; }
+                bool is_integer() const             { return type() == tag::integer; }
+                bool is_real() const                { return type() == tag::real; }
+                bool is_number() const              { return is_integer() || is_real(); }
+                bool is_bool() const                { return type() == tag::truth || type() == tag::falsity; }
+                bool is_null() const                { return type() == tag::null; }
+                
+            public:
+                /// These all throw if the value is of the wrong type --
+                /// save for as_double(), which takes integers too:
+                std::string_view as_string() const;
+                int64_t as_integer() const;
+                double as_double() const;
+                bool as_bool() const;
+                
+                /// Members of an object, or elements of an array:
+                std::size_t size() const;
+                range_t<iterator> elements() const;
+                range_t<member_iterator> members() const;
+                
+                /// The value for a key, or a false-y value if there's none --
+                /// or, with operator[], an exception if there's none:
+                value find(std::string_view key) const;
+                value operator[](std::string_view key) const;
+                value operator[](char const* key) const { return (*this)[std::string_view(key)]; }
+                value operator[](std::size_t idx) const;
+                value operator[](int idx) const { return (*this)[std::size_t(idx)]; }
+                
+                /// Calls `visitor(value, key, depth)` on this value and everything in it, in
+                /// document order -- `key` is empty but for object members. Lambdas and
+                /// blocks both work, as does anything else callable that way:
+                template <typename Visitor>
+                void traverse(Visitor&& visitor) const;
+                
+            public:
+                /// The value as compact JSON text:
+                std::string minified() const;
+                
+                #if defined(__OBJC__)
+                /// The value as Foundation objects -- NSDictionary, NSArray,
+                /// NSString, NSNumber or NSNull -- as NSJSONSerialization makes them:
+                id materialize() const;
+                #endif
+                
+                /// An object as im::Options:
+                im::Options options() const;
+                
+            private:
+                friend class document;
+                friend class iterator;
+                friend class member_iterator;
+                
+                value(document const* d, std::size_t i)
+                    :doc(d), idx(i)
+                    {}
+                    
+                uint64_t word() const;
+                uint64_t payload() const;
+                std::size_t closing() const;        /// tape index of a container's end
+                std::size_t after() const;          /// tape index of whatever follows the value
+                void expect(tag expected, char const* what) const;
+                
+                document const* doc = nullptr;
+                std::size_t idx = 0;
+        };
+        
+        struct member {
+            std::string_view key;
+            value val;
+        };
+        
+        class document {
+            
+            public:
+                /// Parses JSON text, or throws at the first thing wrong with it:
+                static document parse(std::string_view json);
+                
+                #if defined(__OBJC__)
+                static document parse(NSData* data);
+                #endif
+                
+                document(document&&) noexcept = default;
+                document& operator=(document&&) noexcept = default;
+                document(document const&) = delete;
+                document& operator=(document const&) = delete;
+                
+                value root() const                  { return value(this, 0); }
+                std::size_t tapesize() const        { return tapelength; }
+                
+            private:
+                friend class value;
+                friend class value::iterator;
+                friend class value::member_iterator;
+                friend struct builder;
+                
+                document() = default;
+                std::string_view string_at(std::size_t idx) const;
+                
+                std::unique_ptr<uint64_t[]> tape;
+                std::size_t tapelength = 0;
+                std::unique_ptr<char[]> strings;    /// each one a uint32_t length, the bytes, and a NUL
+        };
+        
+        class value::iterator {
+            
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = json::value;
+                using difference_type = std::ptrdiff_t;
+                using pointer = json::value const*;
+                using reference = json::value;
+                
+                iterator() = default;
+                iterator(document const* d, std::size_t i)
+                    :current(d, i)
+                    {}
+                    
+                json::value operator*() const       { return current; }
+                iterator& operator++()              { current.idx = current.after(); return *this; }
+                iterator operator++(int)            { iterator out(*this); ++(*this); return out; }
+                bool operator==(iterator const& rhs) const { return current.idx == rhs.current.idx; }
+                bool operator!=(iterator const& rhs) const { return current.idx != rhs.current.idx; }
+                
+            private:
+                json::value current;
+        };
+        
+        class value::member_iterator {
+            
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = json::member;
+                using difference_type = std::ptrdiff_t;
+                using pointer = json::member const*;
+                using reference = json::member;
+                
+                member_iterator() = default;
+                member_iterator(document const* d, std::size_t i)
+                    :doc(d), idx(i)
+                    {}
+                    
+                json::member operator*() const      { return json::member{ doc->string_at(idx), json::value(doc, idx + 1) }; }
+                member_iterator& operator++()       { idx = json::value(doc, idx + 1).after(); return *this; }
+                member_iterator operator++(int)     { member_iterator out(*this); ++(*this); return out; }
+                bool operator==(member_iterator const& rhs) const { return idx == rhs.idx; }
+                bool operator!=(member_iterator const& rhs) const { return idx != rhs.idx; }
+                
+            private:
+                document const* doc = nullptr;
+                std::size_t idx = 0;
+        };
+        
+        inline uint64_t value::word() const         { return doc->tape[idx]; }
+        inline uint64_t value::payload() const      { return word() & ((uint64_t(1) << 56) - 1); }
+        inline tag value::type() const              { return static_cast<tag>(word() >> 56); }
+        inline std::size_t value::closing() const   { return std::size_t(payload() & 0xFFFFFFFF); }
+        
+        inline std::size_t value::after() const {
+            switch (type()) {
+                case tag::object:
+                case tag::array:
+                    return closing() + 1;
+                case tag::integer:
+                case tag::real:
+                    return idx + 2;
+                default:
+                    return idx + 1;
+            }
+        }
+        
+        inline std::string_view document::string_at(std::size_t idx) const {
+            char const* base = strings.get() + (tape[idx] & ((uint64_t(1) << 56) - 1));
+            uint32_t length;
+            std::memcpy(&length, base, sizeof(uint32_t));
+            return std::string_view(base + sizeof(uint32_t), length);
+        }
+        
+        template <typename Visitor> inline
+        void value::traverse(Visitor&& visitor) const {
+            /// one linear pass over the tape -- no recursion, so no depth to worry about:
+            std::vector<bool> objects;
+            std::string_view key;
+            bool keyed = false;
+            std::size_t cursor = idx;
+            const std::size_t last = after();
+            while (cursor < last) {
+                json::value current(doc, cursor);
+                tag const type = current.type();
+                if (type == tag::object_end || type == tag::array_end) {
+                    objects.pop_back();
+                    ++cursor;
+                    continue;
+                }
+                if (!keyed && !objects.empty() && objects.back()) {
+                    key = doc->string_at(cursor);
+                    keyed = true;
+                    ++cursor;
+                    continue;
+                }
+                visitor(current, keyed ? key : std::string_view(), objects.size());
+                keyed = false;
+                if (type == tag::object || type == tag::array) {
+                    objects.push_back(type == tag::object);
+                    ++cursor;
+                } else {
+                    cursor = current.after();
+                }
+            }
+        }
+        
+    } /// namespace json
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_JSON_HH_
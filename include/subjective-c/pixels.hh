@@ -0,0 +1,79 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_PIXELS_HH_
+#define SUBJECTIVE_C_PIXELS_HH_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <subjective-c/subjective-c.hpp>
+
+namespace objc {
+    
+    namespace pixels {
+        
+        /// Sample formats, valued by their size in bytes:
+        enum class sample : uint8_t {
+            u8      = 1,
+            u16     = 2,
+            f32     = 4
+        };
+        
+        enum class alpha : uint8_t {
+            none,                   /// no alpha channel
+            straight,               /// color samples are independent of alpha
+            premultiplied           /// color samples have been scaled by alpha
+        };
+        
+        static constexpr std::size_t max_channels = 5;
+        
+        /// Where to find one channel's samples -- strides are in bytes,
+        /// and may be anything: the row padding in an NSBitmapImageRep,
+        /// the plane-major layout of a libimread Image, whatever:
+        struct channel_t {
+            byte* origin = nullptr;             /// the sample at (0, 0)
+            std::ptrdiff_t xstride = 0;         /// bytes between columns
+            std::ptrdiff_t ystride = 0;         /// bytes between rows
+        };
+        
+        /// Channels are listed in logical order -- color channels first,
+        /// and then alpha (if `mode` isn't alpha::none) as the last channel,
+        /// regardless of where any of them live in memory:
+        struct layout {
+            std::array<channel_t, max_channels> channels;
+            std::size_t count = 0;
+            sample kind = sample::u8;
+            alpha mode = alpha::none;
+            
+            static layout interleaved(byte* data, std::size_t count, sample kind,
+                                      std::ptrdiff_t rowbytes,
+                                      std::ptrdiff_t pixelbytes = 0,
+                                      alpha mode = alpha::none,
+                                      bool alphafirst = false);
+                                      
+            static layout planar(byte* const* planes, std::size_t count, sample kind,
+                                 std::ptrdiff_t rowbytes,
+                                 alpha mode = alpha::none,
+                                 bool alphafirst = false);
+                                 
+            std::size_t samplesize() const noexcept;
+            bool is_packed() const noexcept;    /// interleaved, without gaps or reordering
+            bool is_planar() const noexcept;    /// every channel is contiguous along rows
+        };
+        
+        /// Copy `width` x `height` pixels from one layout to another,
+        /// converting between interleaved and planar storage -- and between
+        /// straight and premultiplied alpha, if both layouts have alpha.
+        /// Returns false (and copies nothing) if the sample formats or
+        /// channel counts don't match. 8-bit rows are moved with SSE2/SSSE3/AVX2
+        /// or NEON kernels where available, unless `vectorize` is false:
+        bool transfer(layout const& source, layout const& destination,
+                      std::size_t width, std::size_t height,
+                      bool vectorize = true);
+                      
+    } /// namespace pixels
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_PIXELS_HH_
@@ -4,27 +4,103 @@
 #ifndef SUBJECTIVE_C_REHASH_HH_
 #define SUBJECTIVE_C_REHASH_HH_
 
+#include <cstdint>
 #include <cstdlib>
+#include <string_view>
 #include <type_traits>
 #include <functional>
 
-/// hashing trick cribbed from boost,
-/// via http://stackoverflow.com/a/23860042/298171 --
-/// the REHASHER() macro provides the actual hash-in implement.
+/// Hashing in one value after another -- originally with the trick cribbed from
+/// boost (via http://stackoverflow.com/a/23860042/298171), which with 64-bit
+/// seeds avalanches poorly: the low bits of its result barely hear from the high
+/// bits of its input, and std::hash of an integer or pointer is often the
+/// identity. These days each step is a 64x64->128-bit multiply, folded (as in
+/// wyhash), which every bit of both words feeds into -- and then an xorshift-
+/// multiply finish (as in xxh3), which evens out what the multiply leaves lopsided.
+///
+/// The REHASHER() macro provides the actual hash-in implement.
 
 #ifndef REHASHER
 #define REHASHER(seed, hasher, value) \
-    seed ^= hasher(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2)
+    seed = static_cast<std::decay_t<decltype(seed)>>(::hash::mix(seed, hasher(value)))
 #endif
 
 namespace hash {
     
+    namespace detail {
+        
+        /// the high and low words of a full 128-bit product, XORed together:
+        inline std::uint64_t fold(std::uint64_t lhs, std::uint64_t rhs) noexcept {
+            #if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+            return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+            #else
+            std::uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+            std::uint64_t hi_lo = (lhs >> 32)        * (rhs & 0xFFFFFFFF);
+            std::uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+            std::uint64_t hi_hi = (lhs >> 32)        * (rhs >> 32);
+            std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+            std::uint64_t high  = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+            return ((cross << 32) | (lo_lo & 0xFFFFFFFF)) ^ high;
+            #endif
+        }
+        
+        inline std::uint64_t avalanche(std::uint64_t h) noexcept {
+            h ^= h >> 37;
+            h *= 0x165667919e3779f9ULL;
+            return h ^ (h >> 32);
+        }
+        
+        /// a little something different for each side:
+        constexpr std::uint64_t left  = 0xa0761d6478bd642fULL;
+        constexpr std::uint64_t right = 0xe7037ed1a0b428dbULL;
+        
+    } /// namespace detail
+    
+    /// Mixes two 64-bit words into one -- order matters:
+    inline std::uint64_t mix(std::uint64_t seed, std::uint64_t value) noexcept {
+        return detail::avalanche(detail::fold(seed ^ detail::left, value ^ detail::right));
+    }
+    
+    /// Hashes a run of bytes: short keys with a couple of multiplies, longer ones
+    /// 48 bytes at a time, and anything past 256 bytes in 64-byte stripes, with SIMD
+    /// where there is some (SSE2 or NEON) -- with the same results either way:
+    std::uint64_t hash_bytes(void const* data, std::size_t length,
+                             std::uint64_t seed = 0) noexcept;
+                             
+    /// The hash of one thingy: strings by their bytes, integers, enums
+    /// and pointers as they are (mix() does the rest), and anything else
+    /// via its std::hash specialization:
+    template <typename T> inline
+    std::uint64_t hash_of(T const& v) {
+        if constexpr (std::is_convertible_v<T const&, std::string_view> &&
+                     !std::is_same_v<std::decay_t<T>, std::nullptr_t>) {
+            std::string_view bytes(v);
+            return hash_bytes(bytes.data(), bytes.size());
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            return static_cast<std::uint64_t>(v);
+        } else if constexpr (std::is_pointer_v<T>) {
+            return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(v));
+        } else {
+            return static_cast<std::uint64_t>(std::hash<std::remove_cv_t<T>>{}(v));
+        }
+    }
+    
+    namespace detail {
+        
+        template <typename T>
+        struct value_hasher {
+            std::uint64_t operator()(T const& v) const { return hash_of(v); }
+        };
+        
+    } /// namespace detail
+    
     /// Calculates the hash value of a thingy and "hashes in"
     /// this value to the seed value, which it modifies in-place
     
     template <typename T> inline
     void rehash(std::size_t& seed, T const& v) {
-        std::hash<T> hasher;
+        detail::value_hasher<T> hasher;
         REHASHER(seed, hasher, v);
     }
     
@@ -37,7 +113,7 @@ namespace hash {
               typename SeedT = std::size_t>
     struct rehasher {
         using seed_t = SeedT;
-        using hasher_t = std::hash<std::remove_cv_t<T>>;
+        using hasher_t = detail::value_hasher<std::remove_cv_t<T>>;
         using hashee_t = std::add_lvalue_reference_t<std::add_const_t<T>>;
         hasher_t hasher; /// default construction
         
@@ -47,8 +123,22 @@ namespace hash {
         }
     };
     
+    /// One hash for any number of thingies, in order -- as for
+    /// the keys of hash tables, made of several values:
+    ///
+    ///     std::size_t operator()(key_t const& key) const noexcept {
+    ///         return hash::combine(key.owner, key.level, key.column, key.row);
+    ///     }
+    
+    template <typename ...T> inline
+    std::size_t combine(T const& ...values) {
+        std::uint64_t seed = 0;
+        ((seed = mix(seed, hash_of(values))), ...);
+        return static_cast<std::size_t>(seed);
+    }
+    
 }
 
 #undef REHASHER
 
-#endif /// SUBJECTIVE_C_REHASH_HH_
\ No newline at end of file
+#endif /// SUBJECTIVE_C_REHASH_HH_
@@ -0,0 +1,72 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_RESAMPLE_HH_
+#define SUBJECTIVE_C_RESAMPLE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/pixels.hh>
+
+namespace objc {
+    
+    namespace resample {
+        
+        enum class filter : uint8_t {
+            box,                    /// area average -- support 0.5
+            bilinear,               /// triangle -- support 1
+            lanczos3,               /// windowed sinc -- support 3
+            mitchell                /// Mitchell-Netravali cubic, B = C = 1/3 -- support 2
+        };
+        
+        double support(filter kernel) noexcept;
+        double weight(filter kernel, double x) noexcept;
+        
+        /// An interleaved image: `channels` samples per pixel, all of one kind
+        /// (8-bit or float -- sample::u16 isn't supported), with rows `rowbytes` apart.
+        /// Alpha gets no special treatment, so premultiply before resampling:
+        struct buffer_t {
+            byte* data = nullptr;
+            std::size_t width = 0;
+            std::size_t height = 0;
+            std::size_t channels = 0;
+            std::ptrdiff_t rowbytes = 0;            /// 0 => width * channels * sample size
+            pixels::sample kind = pixels::sample::u8;
+        };
+        
+        /// The part of the source to resample, in (fractional) source pixels --
+        /// zero width or height means all of it:
+        struct region_t {
+            double x = 0.0;
+            double y = 0.0;
+            double width = 0.0;
+            double height = 0.0;
+        };
+        
+        struct options {
+            filter kernel = filter::lanczos3;
+            unsigned threads = 0;                   /// 0 => hardware concurrency
+            bool vectorize = true;
+            region_t region;
+        };
+        
+        /// Resample `source` (or a region of it) to fill `destination`.
+        /// The work is separable -- a horizontal pass into a per-band scratch buffer,
+        /// then a vertical pass -- and split into bands of output rows, one per thread.
+        /// 8-bit samples use 14-bit fixed-point weights, and SSE2 or NEON kernels
+        /// (four-channel pixels horizontally, any pixels vertically); floats use
+        /// four-wide float vectors. The 8-bit kernels match the scalar code (which runs
+        /// when `vectorize` is false) bit-for-bit, the float ones to within rounding.
+        /// Returns false (and writes nothing) if the buffers don't agree on channel
+        /// count and sample kind, if either one is empty, or if the region
+        /// isn't inside the source:
+        bool resize(buffer_t const& source, buffer_t const& destination);
+        bool resize(buffer_t const& source, buffer_t const& destination,
+                    options const& opts);
+                    
+    } /// namespace resample
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_RESAMPLE_HH_
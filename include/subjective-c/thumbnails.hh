@@ -0,0 +1,123 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_THUMBNAILS_HH_
+#define SUBJECTIVE_C_THUMBNAILS_HH_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <functional>
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/resample.hh>
+
+namespace objc {
+    
+    /// A thumbnail pipeline for lots of files at once -- five stages,
+    /// each on its own threads, joined by bounded queues:
+    ///
+    ///     read -> decode -> resample -> encode -> write
+    ///
+    ///     std::vector<objc::thumbnails::job_t> jobs = { { "in/a.png", "out/a.png" }, ... };
+    ///     objc::thumbnails::report_t report = objc::thumbnails::generate(jobs, codec);
+    ///
+    /// The read stage stays a few files ahead of the decoders (as deep as
+    /// the queues go) and asks the OS to read ahead on the files after
+    /// that. It's also where the memory budget bites: a file gets read,
+    /// measured, and then waits until its decoded pixels fit in the budget
+    /// alongside everything else in flight -- later stages never wait on
+    /// the budget, so the pipeline always drains. Resampling is done by
+    /// objc::resample, one image per thread; codecs are plain functions, so
+    /// none of this needs AppKit -- or a display, or a Mac.
+    
+    namespace thumbnails {
+        
+        /// Packed 8-bit RGBA, premultiplied, rows `width * 4` bytes apart:
+        struct frame_t {
+            bytevec_t pixels;
+            std::size_t width = 0;
+            std::size_t height = 0;
+        };
+        
+        /// `measure` is optional: it reports an encoded image's size without
+        /// decoding it, so the budget can account for the pixels to come
+        /// before they're allocated. Without it, each file is charged for its
+        /// decoded pixels after the fact. All three get called from more than
+        /// one thread at once, and shouldn't throw (but it's caught if they do):
+        struct codec_t {
+            std::function<bool(bytevec_t const&, std::size_t&, std::size_t&)> measure;
+            std::function<bool(bytevec_t const&, frame_t&)> decode;
+            std::function<bool(frame_t const&, bytevec_t&)> encode;
+        };
+        
+        struct job_t {
+            std::string source;
+            std::string destination;
+        };
+        
+        struct options {
+            std::size_t size = 256;                 /// thumbnails fit in size x size, never enlarged
+            resample::filter kernel = resample::filter::lanczos3;
+            std::size_t budget = 256 * 1024 * 1024; /// bytes in flight, all stages
+            std::size_t depth = 4;                  /// items per queue
+            std::size_t readahead = 8;              /// files hinted to the OS ahead of the reader
+            unsigned decoders = 0;                  /// 0 => hardware concurrency
+            unsigned resamplers = 0;                /// 0 => hardware concurrency
+            unsigned encoders = 0;                  /// 0 => hardware concurrency
+        };
+        
+        struct report_t {
+            std::size_t completed = 0;
+            std::vector<std::pair<std::string, std::string>> failures;     /// source, why
+            std::size_t bytes_read = 0;
+            std::size_t bytes_written = 0;
+            double input_megapixels = 0.0;
+            double seconds = 0.0;                   /// wall clock, start to finish
+            double per_second = 0.0;                /// completed thumbnails
+            
+            /// per thumbnail, from the read starting to the write finishing:
+            double latency_p50 = 0.0;               /// milliseconds
+            double latency_p90 = 0.0;
+            double latency_p99 = 0.0;
+            double latency_max = 0.0;
+            
+            /// summed over each stage's threads:
+            double read_seconds = 0.0;
+            double decode_seconds = 0.0;
+            double resample_seconds = 0.0;
+            double encode_seconds = 0.0;
+            double write_seconds = 0.0;
+            
+            std::size_t peak_bytes = 0;             /// most held in flight at once
+        };
+        
+        /// Run every job through the pipeline, returning once they're all
+        /// written (or have failed -- which doesn't stop the others):
+        report_t generate(std::vector<job_t> const& jobs, codec_t const& codec,
+                          options const& opts = options{});
+                          
+        /// The size a `width` x `height` image gets scaled to, to fit in
+        /// `size` x `size` -- never larger than it was, never smaller than 1x1:
+        std::pair<std::size_t, std::size_t> fit(std::size_t width, std::size_t height,
+                                                std::size_t size) noexcept;
+                                                
+        /// A codec for PAM files (netpbm's P7, with TUPLTYPE RGB_ALPHA or RGB)
+        /// that needs nothing beyond the standard library. PAM alpha is straight,
+        /// so it's premultiplied on the way in and back out on the way out:
+        codec_t pam_codec();
+        
+        #if defined(__APPLE__)
+        
+        /// ImageIO to decode, and objc::cg::encoder (the encoder behind -[NSImage PNGData]
+        /// and -[NSImage JPEGDataWithCompression:]) to encode -- `quality` is only used for JPEG:
+        enum class format : uint8_t { png, jpeg };
+        codec_t appkit_codec(format kind, float quality = 0.8f);
+        
+        #endif /// __APPLE__
+        
+    } /// namespace thumbnails
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_THUMBNAILS_HH_
@@ -0,0 +1,158 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_TILES_HH_
+#define SUBJECTIVE_C_TILES_HH_
+
+#include <list>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <unordered_map>
+#include <subjective-c/subjective-c.hpp>
+#import  <CoreGraphics/CoreGraphics.h>
+
+namespace objc {
+    
+    namespace cg {
+        
+        /// A least-recently-used cache of rendered images, bounded by the
+        /// total size of their pixels -- images are keyed by whoever owns
+        /// them, mip level, column and row. Mip pyramids (q.v. sub.) keep
+        /// their rendered levels here, whole, as column 0 and row 0:
+        ///
+        ///     objc::cg::tile_cache cache(16 * 1024 * 1024);
+        ///     cache.insert({ owner, 0, 3, 2 }, tile);
+        ///     CGImageRef cached = cache.copy({ owner, 0, 3, 2 });    /// +1, or nullptr
+        ///
+        /// Inserting past the budget evicts tiles, least recently used first.
+        
+        class tile_cache {
+            
+            public:
+                static constexpr std::size_t default_budget = 64 * 1024 * 1024;
+                static tile_cache& shared();
+                
+                struct key_t {
+                    void const* owner;
+                    std::size_t level;
+                    std::size_t column;
+                    std::size_t row;
+                    bool operator==(key_t const&) const noexcept;
+                };
+                
+                struct hasher_t {
+                    std::size_t operator()(key_t const&) const noexcept;
+                };
+                
+            public:
+                explicit tile_cache(std::size_t budget = default_budget);
+                tile_cache(tile_cache const&) = delete;
+                tile_cache& operator=(tile_cache const&) = delete;
+                virtual ~tile_cache();
+                
+            public:
+                __attribute__((cf_returns_retained))
+                CGImageRef copy(key_t const& key);
+                void insert(key_t const& key, CGImageRef tile);
+                void purge(void const* owner);
+                void clear();
+                
+                std::size_t size() const;           /// tiles held
+                std::size_t bytes() const;          /// total bytes of tiles held
+                std::size_t budget() const;
+                void budget(std::size_t newbudget);
+                std::size_t hits() const;
+                std::size_t misses() const;
+                
+            protected:
+                void trim();                        /// call with the mutex held
+                
+            protected:
+                struct entry_t {
+                    key_t key;
+                    CGImageRef tile;
+                    std::size_t bytes;
+                };
+                using lru_t = std::list<entry_t>;
+                
+                mutable std::mutex mutex;
+                lru_t entries;                      /// most recently used first
+                std::unordered_map<key_t, lru_t::iterator, hasher_t> lookup;
+                std::size_t limit;
+                std::size_t total = 0;
+                std::size_t hitcount = 0;
+                std::size_t misscount = 0;
+        };
+        
+        /// A downsampled mip pyramid over one CGImage, for drawing it in tiles:
+        ///
+        ///     objc::cg::mip_pyramid pyramid(imageref);
+        ///     pyramid.draw(context, destination);     /// like CGContextDrawImage()
+        ///
+        /// Level 0 is the image itself; each level after that is half the size
+        /// of the one before, down to the first one that fits in a single tile.
+        /// Those other levels are rendered on first use, into the tile cache --
+        /// so they count against its budget, and may be evicted (and rendered
+        /// again) whenever. The pyramid itself holds on to nothing but level 0.
+        /// Tiles, of any level, alias their level's pixels (they share its data
+        /// provider), and cost next to nothing to make, so they aren't cached.
+        /// `draw()` picks the smallest level that still has at least as many
+        /// pixels as the destination covers on the device, and draws only the
+        /// tiles that intersect the context's clip.
+        
+        class mip_pyramid {
+            
+            public:
+                static constexpr std::size_t default_tile_size = 256;
+                
+                /// images no bigger than this on either side draw quickly enough
+                /// as they are (q.v. -[AXCoreGraphicsImageRep setTileThreshold:]):
+                static constexpr std::size_t default_threshold = 2048;
+                
+            public:
+                explicit mip_pyramid(CGImageRef base,
+                                     std::size_t tilesize = default_tile_size,
+                                     tile_cache& cache = tile_cache::shared());
+                mip_pyramid(mip_pyramid const&) = delete;
+                mip_pyramid& operator=(mip_pyramid const&) = delete;
+                virtual ~mip_pyramid();
+                
+            public:
+                std::size_t levels() const noexcept;
+                std::size_t level_for(double scale) const noexcept;
+                std::size_t width(std::size_t level) const noexcept;
+                std::size_t height(std::size_t level) const noexcept;
+                std::size_t columns(std::size_t level) const noexcept;
+                std::size_t rows(std::size_t level) const noexcept;
+                std::size_t tilesize() const noexcept;
+                
+                CGImageRef base() const noexcept;                   /// +0, level 0
+                __attribute__((cf_returns_retained))
+                CGImageRef level(std::size_t level);
+                __attribute__((cf_returns_retained))
+                CGImageRef tile(std::size_t level, std::size_t column, std::size_t row);
+                
+                /// Returns the number of tiles drawn:
+                std::size_t draw(CGContextRef context, CGRect destination);
+                
+            protected:
+                __attribute__((cf_returns_retained))
+                CGImageRef crop(CGImageRef source, std::size_t level,
+                                std::size_t column, std::size_t row) const;
+                                
+            protected:
+                std::mutex mutex;                   /// held while rendering levels
+                CGImageRef image;
+                std::vector<std::size_t> widths;    /// one per level
+                
+                std::vector<std::size_t> heights;
+                std::size_t side;
+                tile_cache& cache;
+        };
+        
+    } /// namespace cg
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_TILES_HH_
@@ -4,7 +4,6 @@
 #ifndef SUBJECTIVE_C_TRAITS_HH
 #define SUBJECTIVE_C_TRAITS_HH
 
-#import  <Cocoa/Cocoa.h>
 #import  <objc/message.h>
 #import  <objc/runtime.h>
 #include "types.hh"
@@ -95,42 +94,29 @@ namespace objc {
             
             #pragma clang diagnostic pop
             
-            /// All of this following hoohah is a SFINAE-compatible reimplementation
-            /// of std::common_type<T>, taken right from this document:
-            ///     http://open-std.org/jtc1/sc22/wg21/docs/papers/2014/n3843.pdf
-            template <typename T, typename U>
-            using ct2 = decltype(std::declval<bool>() ? std::declval<T>() : std::declval<U>());
-            
-            template <typename T>
-            using void_t = std::conditional_t<true, void, T>;
-            
-            template <class, class...>
-            struct ct {};
-            template <class T>
-            struct ct<void, T> { using type = std::decay_t<T>; };
-            template <class T, class U, class ...V>
-            struct ct<void_t<ct2<T, U>>, T, U, V...> : ct<void, ct2<T, U>, V...> {};
-            
-            template <typename ...Types>
-            struct common_type : ct<void, Types...> {};
-            
-            template <class, class = void>
-            struct has_type_member : std::false_type {};
-            template <class T>
-            struct has_type_member<T, void_t<typename T::type>> : std::true_type {};
-            
-            template <typename ...Types>
-            using common_type_t = typename common_type<Types...>::type;
-            template <typename ...Types>
-            using has_common_type = has_type_member<common_type<Types...>>;
-            
-            /// objc::traits::detail::is_object_pointer<T> checks using
-            /// objc::traits::detail::has_common_type<T, objc::types::ID>
+            /// objc::traits::detail::is_object_pointer<T> asks the compiler whether T
+            /// converts to `id` -- which pointers to Objective-C objects and classes do,
+            /// and nothing else does -- via one intrinsic, where the SFINAE-friendly
+            /// std::common_type<T> we used to use (q.v. N3843) was a half-dozen
+            /// class templates deep, for every type it was ever asked about:
             template <typename Target>
-            using is_object_pointer = has_common_type<objc::types::ID, std::decay_t<Target>>;
+            constexpr bool is_object_pointer_v = __is_convertible_to(std::decay_t<Target>, ::id);
+            
+            template <typename Target>
+            using is_object_pointer = std::integral_constant<bool, is_object_pointer_v<Target>>;
+            
+            /// detail::all(...) is true if none of its arguments are false --
+            /// a fold expression, for the C++14 code (e.g. subjective-c-config)
+            /// that includes this header too:
+            template <typename ...Bools>
+            constexpr bool all(Bools... values) noexcept {
+                bool const list[] = { true, values... };
+                for (bool value : list) { if (!value) { return false; } }
+                return true;
+            }
             
             template <typename ...Targets>
-            using are_object_pointers = has_common_type<objc::types::ID, Targets...>;
+            using are_object_pointers = std::integral_constant<bool, detail::all(is_object_pointer_v<Targets>...)>;
         
         } /* namespace detail */
         
@@ -147,53 +133,32 @@ namespace objc {
             }
         };
         
-        /// compile-time tests for objective-c primitives:
+        /// compile-time tests for objective-c primitives --
+        /// each one a constexpr bool first, with a std::integral_constant
+        /// wrapped around it for anything that wants ::value or ::type:
         
         /// test for an object-pointer instance (NSObject* and descendants)
-        /// ... uses std::is_pointer<T> to enable_if itself properly,
-        /// ... and objc::traits::detail::is_object_pointer<T> to make the call
-        template <typename T, typename V = bool>
-        struct is_object : std::false_type {};
         template <typename T>
-        struct is_object<T,
-            typename std::enable_if_t<
-                 std::is_pointer<T>::value,
-                 bool>> : detail::is_object_pointer<T> {};
+        constexpr bool is_object_v = std::is_pointer<T>::value && detail::is_object_pointer_v<T>;
         
         template <typename T>
-        constexpr bool is_object_v = is_object<T>::value;
-        
-        // template <typename ...Types, typename V = bool>
-        // struct are_objects : std::false_type {};
-        // template <typename ...Types>
-        // struct are_objects<Types...,
-        //     typename std::enable_if_t<
-        //         detail::are_object_pointers<Types...>::value,
-        //         bool>> : std::true_type {};
+        struct is_object : std::integral_constant<bool, is_object_v<T>> {};
         
         /// test for a selector struct
-        template <typename T, typename V = bool>
-        struct is_selector : std::false_type {};
         template <typename T>
-        struct is_selector<T,
-            typename std::enable_if_t<
-                std::is_same<T, objc::types::selector>::value,
-                bool>> : std::true_type {};
+        constexpr bool is_selector_v = std::is_same<std::remove_cv_t<T>, objc::types::selector>::value;
         
         template <typename T>
-        constexpr bool is_selector_v = is_selector<T>::value;
+        struct is_selector : std::integral_constant<bool, is_selector_v<T>> {};
         
-        /// test for the objective-c class struct type
-        template <typename T, typename V = bool>
-        struct is_class : std::false_type {};
+        /// test for the objective-c class type -- by name, as `Class` points
+        /// to a struct that's opaque in the Objective-C 2.0 runtime, which
+        /// detail::has_superclass<T> can't inherit from, let alone inspect:
         template <typename T>
-        struct is_class<T,
-            typename std::enable_if_t<
-                detail::has_superclass<T>::value,
-                bool>> : std::true_type {};
+        constexpr bool is_class_v = std::is_same<std::remove_cv_t<T>, objc::types::cls>::value;
         
         template <typename T>
-        constexpr bool is_class_v = is_class<T>::value;
+        struct is_class : std::integral_constant<bool, is_class_v<T>> {};
         
         } /* namespace traits */
     
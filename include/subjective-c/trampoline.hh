@@ -0,0 +1,166 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_TRAMPOLINE_HH_
+#define SUBJECTIVE_C_TRAMPOLINE_HH_
+
+#include <mutex>
+#include <utility>
+#include <cstddef>
+#include <Block.h>
+#include <subjective-c/types.hh>
+#import  <MABlockClosure.h>
+
+namespace objc {
+    
+    namespace detail {
+        
+        /// The thunks for one signature: `Capacity` plain C functions,
+        /// generated from `thunk<I>()`, each of which calls whatever block
+        /// is in slot I -- as a direct block call, with no libffi in sight.
+        /// Slots are handed out and taken back under the pool's lock;
+        /// the thunks themselves read their slot without it.
+        
+        template <std::size_t Capacity, typename R, typename ...Args>
+        struct thunk_pool {
+            
+            using blockptr_t = R(^)(Args...);
+            using fptr_t = R(*)(Args...);
+            
+            static inline void const* slots[Capacity] = {};
+            static inline std::size_t freed[Capacity] = {};
+            static inline std::size_t freecount = 0;
+            static inline std::size_t highwater = 0;
+            static inline std::mutex mutex;
+            
+            /// The slot's block is held by its trampoline, so it's called
+            /// through an unretained pointer -- a strong one would have ARC
+            /// retain and release the block around every single call:
+            template <std::size_t I>
+            static R thunk(Args... args) {
+                blockptr_t __unsafe_unretained block = (__bridge blockptr_t)slots[I];
+                return block(std::forward<Args>(args)...);
+            }
+            
+            template <std::size_t ...I> inline
+            static fptr_t thunk_at(std::size_t idx, std::index_sequence<I...>) {
+                static constexpr fptr_t thunks[] = { &thunk<I>... };
+                return thunks[idx];
+            }
+            
+            static fptr_t thunk_at(std::size_t idx) {
+                return thunk_at(idx, std::make_index_sequence<Capacity>());
+            }
+            
+            /// Returns the slot for `block`, or `Capacity` if they're all taken:
+            static std::size_t acquire(void const* block) {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::size_t idx;
+                if (freecount > 0) {
+                    idx = freed[--freecount];
+                } else if (highwater < Capacity) {
+                    idx = highwater++;
+                } else {
+                    return Capacity;
+                }
+                slots[idx] = block;
+                return idx;
+            }
+            
+            static void release(std::size_t idx) {
+                std::lock_guard<std::mutex> lock(mutex);
+                slots[idx] = nullptr;
+                freed[freecount++] = idx;
+            }
+            
+            static std::size_t available() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return freecount + (Capacity - highwater);
+            }
+            
+        };
+        
+    } /// namespace detail
+    
+    template <typename Signature, std::size_t Capacity = 64>
+    class block_trampoline;
+    
+    /// A C function pointer for a block whose signature is known at compile time:
+    ///
+    ///     objc::block_trampoline<void(const Node*, Type, NodeType)> trampoline(
+    ///         ^(const Node* node, Type jt, NodeType jnt) { ... });
+    ///     dict.traverse(trampoline.fptr());
+    ///
+    /// The function pointer is one of the thunks in the signature's pool, which calls
+    /// the block as C++ would -- MABlockClosure, by contrast, goes through ffi_call() on
+    /// every call. Only once all `Capacity` thunks for a signature are taken does the
+    /// trampoline fall back to an MABlockClosure; blocks whose signatures are only known
+    /// at runtime should use MABlockClosure (or BlockFptr()) directly. The trampoline
+    /// holds a copy of the block, and the function pointer is good for as long as it lives.
+    
+    template <typename R, typename ...Args, std::size_t Capacity>
+    class block_trampoline<R(Args...), Capacity> {
+        
+        using pool_t = detail::thunk_pool<Capacity, R, Args...>;
+        
+        public:
+            using blockptr_t = typename pool_t::blockptr_t;
+            using fptr_t = typename pool_t::fptr_t;
+            
+        public:
+            explicit block_trampoline(blockptr_t block)
+                :copied(_Block_copy(objc::bridge<void const*>(block)))
+                ,slot(pool_t::acquire(copied))
+                {
+                    if (slot < Capacity) {
+                        function = pool_t::thunk_at(slot);
+                    } else {
+                        MABlockClosure* closure = [[MABlockClosure alloc] initWithBlock:objc::bridge<id>(copied)];
+                        function = reinterpret_cast<fptr_t>([closure fptr]);
+                        fallback = objc::bridgeretain<void*>(closure);
+                    }
+                }
+                
+            block_trampoline(block_trampoline&& other) noexcept
+                :copied(std::exchange(other.copied, nullptr))
+                ,slot(std::exchange(other.slot, Capacity))
+                ,function(std::exchange(other.function, nullptr))
+                ,fallback(std::exchange(other.fallback, nullptr))
+                {}
+                
+            block_trampoline& operator=(block_trampoline&& other) noexcept {
+                if (this != &other) {
+                    std::swap(copied, other.copied);
+                    std::swap(slot, other.slot);
+                    std::swap(function, other.function);
+                    std::swap(fallback, other.fallback);
+                }
+                return *this;
+            }
+            
+            block_trampoline(block_trampoline const&) = delete;
+            block_trampoline& operator=(block_trampoline const&) = delete;
+            
+            ~block_trampoline() {
+                if (slot < Capacity) { pool_t::release(slot); }
+                if (fallback) { CFRelease(fallback); }
+                if (copied) { _Block_release(copied); }
+            }
+            
+        public:
+            fptr_t fptr() const noexcept        { return function; }
+            bool pooled() const noexcept        { return slot < Capacity; }
+            
+            /// thunks for this signature not yet taken:
+            static std::size_t available()      { return pool_t::available(); }
+            
+        private:
+            void const* copied = nullptr;
+            std::size_t slot = Capacity;
+            fptr_t function = nullptr;
+            void* fallback = nullptr;           /// +1 MABlockClosure, once the pool runs out
+    };
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_TRAMPOLINE_HH_
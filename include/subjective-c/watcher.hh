@@ -0,0 +1,128 @@
+/// Copyright 2012-2017 Alexander Bohn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#ifndef SUBJECTIVE_C_WATCHER_HH_
+#define SUBJECTIVE_C_WATCHER_HH_
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+#include <subjective-c/forward.hh>
+
+namespace objc {
+    
+    namespace appkit {
+        
+        #if defined(__OBJC__)
+        class stand_in;
+        #endif
+        
+        /// Calls back when a pasteboard changes, rather than having to be
+        /// asked. A timer thread polls the change count -- quickly just after
+        /// a change, backing off by `backoff` per quiet poll down to `slowest`
+        /// when nothing happens -- and a burst of changes, as when something
+        /// copies one type after another, comes out as one notification once
+        /// the count has held still for `settle` (or `patience` has run out).
+        /// Callbacks run on a small worker pool, with the change count and
+        /// the types on the pasteboard by then -- and stopping mid-burst
+        /// reports the burst before the workers are let go:
+        ///
+        ///     objc::appkit::watcher watcher([NSPasteboard generalPasteboard]);
+        ///     watcher.subscribe([](long changecount, auto const& types) { ... });
+        ///     watcher.start();
+        ///
+        /// Notifications can overtake one another on the way through the
+        /// pool, so callbacks that care should skip change counts older
+        /// than ones they've seen. The pasteboard side is two functions,
+        /// so anything with a change count can be watched -- NSPasteboard
+        /// and objc::appkit::stand_in have constructors of their own.
+        
+        class watcher {
+            
+            public:
+                using types_t = std::vector<std::string>;
+                using callback_t = std::function<void(long changecount, types_t const& types)>;
+                using counter_t = std::function<long()>;
+                using typer_t = std::function<types_t()>;
+                using ms_t = std::chrono::milliseconds;
+                
+                struct options {
+                    ms_t fastest{ 20 };                 /// poll interval just after a change
+                    ms_t slowest{ 2000 };               /// ... backed off to, when idle
+                    double backoff = 1.5;               /// interval growth per quiet poll
+                    ms_t settle{ 100 };                 /// quiet time that ends a burst
+                    ms_t patience{ 1000 };              /// longest a burst gets put off
+                    unsigned workers = 2;               /// callback threads
+                };
+                
+                struct stats_t {
+                    std::size_t polls = 0;              /// change counts read
+                    std::size_t changes = 0;            /// ... that differed from the last
+                    std::size_t notifications = 0;      /// bursts reported
+                    std::size_t callbacks = 0;          /// callbacks run to completion
+                    ms_t interval{ 0 };                 /// the poll interval, as of now
+                };
+                
+                watcher(counter_t counter, typer_t typer);
+                watcher(counter_t counter, typer_t typer, options opts);
+                
+                #if defined(__OBJC__)
+                explicit watcher(NSPasteboard* board);
+                watcher(NSPasteboard* board, options opts);
+                explicit watcher(stand_in& board);
+                watcher(stand_in& board, options opts);
+                #endif
+                
+                watcher(watcher const&) = delete;
+                watcher& operator=(watcher const&) = delete;
+                ~watcher();                             /// stops, after running what's queued
+                
+                std::size_t subscribe(callback_t callback);
+                void unsubscribe(std::size_t token);
+                
+                void start();                           /// no-op if running
+                void stop();                            /// ... or if not
+                bool running() const;
+                
+                /// Poll now, and go back to polling fast -- for when
+                /// something else has hinted that a change is coming:
+                void poke();
+                
+                stats_t stats() const;
+                
+            private:
+                void poll(long baseline);
+                void work();
+                void notify(long changecount);
+                
+                counter_t counter;
+                typer_t typer;
+                options opts;
+                
+                mutable std::mutex mutex;               /// guards everything below
+                std::condition_variable wakeup;         /// for the poll thread
+                std::condition_variable ready;          /// for the workers
+                std::map<std::size_t, callback_t> callbacks;
+                std::size_t next_token = 0;
+                std::deque<std::function<void()>> tasks;
+                std::thread poller;
+                std::vector<std::thread> workers;
+                bool stopping = false;                  /// tells the poll thread to finish
+                bool retiring = false;                  /// ... and the workers, once it has
+                bool poked = false;
+                stats_t counts;
+        };
+        
+    } /// namespace appkit
+    
+} /// namespace objc
+
+#endif /// SUBJECTIVE_C_WATCHER_HH_
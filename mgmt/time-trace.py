@@ -0,0 +1,114 @@
+#!/usr/bin/env python
+#
+#       time-trace.py
+#
+#       Total up the -ftime-trace output of a build (q.v. OBJC_TIME_TRACE
+#       in CMakeLists.txt): the slowest sources, the headers and template
+#       instantiations that cost the most over all of them -- and how that
+#       all compares to the last time around, if there was one
+#       (c) 2017 Alexander Bohn, All Rights Reserved
+#
+#       Usage: time-trace.py <object directory> [<summary JSON file>]
+#
+
+from __future__ import print_function
+from collections import defaultdict
+from os import walk
+from os.path import exists, join, relpath
+import json
+import sys
+
+LIMIT = 20
+
+def load_traces(objdir):
+    """ Yield (source, events) for each trace file under `objdir` --
+        clang writes one next to each object file, as in `foo.mm.json`
+        for `foo.mm.o` """
+    for root, dirs, files in walk(objdir):
+        for filename in sorted(files):
+            if not filename.endswith('.json'):
+                continue
+            with open(join(root, filename)) as handle:
+                try:
+                    trace = json.load(handle)
+                except ValueError:
+                    continue
+            if 'traceEvents' in trace:
+                yield relpath(join(root, filename[:-5]), objdir), trace['traceEvents']
+
+def summarize(objdir):
+    """ Times are in milliseconds. Header times are inclusive -- a header's
+        time includes that of everything it includes in turn -- and summed
+        over all the sources that include the header """
+    sources = {}
+    totals = defaultdict(float)
+    headers = defaultdict(float)
+    counts = defaultdict(int)
+    instantiations = defaultdict(float)
+    for source, events in load_traces(objdir):
+        for event in events:
+            name = event.get('name', '')
+            duration = event.get('dur', 0) / 1000.0
+            detail = event.get('args', {}).get('detail', '')
+            if name == 'Total ExecuteCompiler':
+                sources[source] = duration
+            if name.startswith('Total '):
+                totals[name[6:]] += duration
+            elif name == 'Source':
+                headers[detail] += duration
+                counts[detail] += 1
+            elif name in ('InstantiateClass', 'InstantiateFunction'):
+                instantiations[detail] += duration
+    return {
+        'sources'           : sources,
+        'totals'            : dict(totals),
+        'headers'           : dict(headers),
+        'counts'            : dict(counts),
+        'instantiations'    : dict(instantiations) }
+
+def delta(now, then, key):
+    if then is None or key not in then:
+        return ''
+    return '  (%+.0fms)' % (now - then[key])
+
+def report(summary, previous):
+    def section(title, table, previous_table, counts=None):
+        print()
+        print(title)
+        ranked = sorted(table.items(), key=lambda item: item[1], reverse=True)
+        for name, ms in ranked[:LIMIT]:
+            times = '  x%d' % counts[name] if counts else ''
+            print('%10.0fms%s  %s%s' % (ms, times, name, delta(ms, previous_table, name)))
+
+    def get(key):
+        return previous[key] if previous else None
+
+    overall = sum(summary['sources'].values())
+    before = { 'all' : sum(previous['sources'].values()) } if previous else None
+    print('%d sources, %.1fs in all%s' % (
+        len(summary['sources']), overall / 1000.0, delta(overall, before, 'all')))
+    section('Phases:',              summary['totals'],          get('totals'))
+    section('Slowest sources:',     summary['sources'],         get('sources'))
+    section('Costliest headers:',   summary['headers'],         get('headers'), summary['counts'])
+    section('Costliest instantiations:', summary['instantiations'], get('instantiations'))
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: time-trace.py <object directory> [<summary JSON file>]')
+        sys.exit(1)
+
+    summary = summarize(sys.argv[1])
+    if not summary['sources']:
+        print('No -ftime-trace output in %s -- was it built with OBJC_TIME_TRACE?' % sys.argv[1])
+        sys.exit(1)
+
+    previous = None
+    if len(sys.argv) > 2 and exists(sys.argv[2]):
+        with open(sys.argv[2]) as handle:
+            previous = json.load(handle)
+
+    report(summary, previous)
+
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as handle:
+            json.dump(summary, handle, indent=1, sort_keys=True)
@@ -0,0 +1,167 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <algorithm>
+#include <subjective-c/appkit.hh>
+#import  <subjective-c/categories/NSImage+ResizeBestFit.h>
+#import  <objc/runtime.h>
+
+/// Fulfills a promise for the pasteboard, as types get asked for:
+@interface AXPasteboardPromiseProvider : NSObject <NSPasteboardItemDataProvider> {
+    @public
+        objc::appkit::promise_ptr promised;
+}
+@end
+
+@implementation AXPasteboardPromiseProvider
+
+- (void) pasteboard:(NSPasteboard*)board
+               item:(NSPasteboardItem*)item
+ provideDataForType:(NSPasteboardType)type {
+    if (!promised) { return; }
+    if (NSData* data = promised->data(type)) {
+        [item setData:data forType:type];
+    }
+}
+
+- (void) pasteboardFinishedWithDataProvider:(NSPasteboard*)board {
+    promised.reset();
+}
+
+@end
+
+/// NSPasteboardItem may or may not hang onto its provider -- this makes sure:
+static char const AXPasteboardPromiseProviderKey = 0;
+
+namespace objc {
+    
+    namespace appkit {
+        
+        promise::promise(encoders_t e)
+            :encoders(std::move(e))
+            ,cache([[NSMutableDictionary alloc] init])
+            {}
+            
+        NSArray<NSPasteboardType>* promise::types() const {
+            NSMutableArray<NSPasteboardType>* out = [NSMutableArray arrayWithCapacity:encoders.size()];
+            for (auto const& encoder : encoders) {
+                [out addObject:encoder.first];
+            }
+            return out;
+        }
+        
+        NSData* promise::data(NSPasteboardType type) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (NSData* hit = cache[type]) { return hit; }
+            auto found = std::find_if(encoders.begin(), encoders.end(),
+                                   [type](auto const& encoder) { return [encoder.first isEqualToString:type]; });
+            if (found == encoders.end()) { return nil; }
+            
+            /// encoding under the lock, so each type gets encoded once at most:
+            NSData* data = found->second();
+            ++count;
+            if (data) { cache[type] = data; }
+            return data;
+        }
+        
+        bool promise::cached(NSPasteboardType type) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cache[type] != nil;
+        }
+        
+        std::size_t promise::encodes() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return count;
+        }
+        
+        promise_ptr image_promise(NSImage* image) {
+            if (!image) { return nullptr; }
+            return std::make_shared<promise>(promise::encoders_t{
+                { NSPasteboardTypePNG,  [image]() { return [image dataForImageFileType:NSPNGFileType];  } },
+                { NSPasteboardTypeTIFF, [image]() { return [image dataForImageFileType:NSTIFFFileType]; } }
+            });
+        }
+        
+        stand_in::stand_in()
+            :contents([[NSMutableDictionary alloc] init])
+            {}
+            
+        NSInteger stand_in::clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            [contents removeAllObjects];
+            promises.clear();
+            return ++count;
+        }
+        
+        void stand_in::write(NSPasteboardType type, NSData* data) {
+            std::lock_guard<std::mutex> lock(mutex);
+            contents[type] = data;
+        }
+        
+        void stand_in::write(promise_ptr promised) {
+            std::lock_guard<std::mutex> lock(mutex);
+            promises.push_back(std::move(promised));
+        }
+        
+        NSData* stand_in::data(NSPasteboardType type) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (NSData* data = contents[type]) { return data; }
+            for (promise_ptr const& promised : promises) {
+                if ([promised->types() containsObject:type]) {
+                    /// once fulfilled, a promise's data stays put -- as with NSPasteboard:
+                    NSData* data = promised->data(type);
+                    if (data) { contents[type] = data; }
+                    return data;
+                }
+            }
+            return nil;
+        }
+        
+        NSArray<NSPasteboardType>* stand_in::types() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            NSMutableOrderedSet<NSPasteboardType>* out = [NSMutableOrderedSet orderedSetWithArray:contents.allKeys];
+            for (promise_ptr const& promised : promises) {
+                [out addObjectsFromArray:promised->types()];
+            }
+            return out.array;
+        }
+        
+        NSInteger stand_in::changecount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return count;
+        }
+        
+        bool copy_lazy(NSPasteboard* board, promise_ptr promised) {
+            if (!promised) { return false; }
+            if (!board) { board = [NSPasteboard generalPasteboard]; }
+            
+            AXPasteboardPromiseProvider* provider = [[AXPasteboardPromiseProvider alloc] init];
+            provider->promised = std::move(promised);
+            NSPasteboardItem* item = [[NSPasteboardItem alloc] init];
+            if (![item setDataProvider:provider forTypes:provider->promised->types()]) { return false; }
+            objc_setAssociatedObject(item, &AXPasteboardPromiseProviderKey, provider,
+                                     OBJC_ASSOCIATION_RETAIN);
+                                     
+            __attribute__((__unused__))
+            NSInteger changecount = [board clearContents];
+            return objc::to_bool([board writeObjects:@[ item ]]);
+        }
+        
+        bool copy_lazy(NSPasteboard* board, NSImage* image) {
+            return copy_lazy(board, image_promise(image));
+        }
+        
+        bool copy_lazy(stand_in& board, promise_ptr promised) {
+            if (!promised) { return false; }
+            board.clear();
+            board.write(std::move(promised));
+            return true;
+        }
+        
+        bool copy_lazy(stand_in& board, NSImage* image) {
+            return copy_lazy(board, image_promise(image));
+        }
+        
+    } /// namespace appkit
+    
+} /// namespace objc
@@ -0,0 +1,123 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <subjective-c/bufferpool.hh>
+#include <libimread/errors.hh>
+
+namespace objc {
+    
+    namespace cg {
+        
+        struct buffer_pool::state_t {
+            std::mutex mutex;
+            std::unordered_map<std::size_t, std::vector<void*>> buffers;
+            std::size_t capacity;
+            std::size_t count = 0;
+            std::size_t allocated = 0;
+            
+            explicit state_t(std::size_t cap)
+                :capacity(cap)
+                {}
+                
+            ~state_t() {
+                for (auto& bucket : buffers) {
+                    for (void* buffer : bucket.second) { std::free(buffer); }
+                }
+            }
+            
+            void* acquire(std::size_t size) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto bucket = buffers.find(size);
+                    if (bucket != buffers.end() && !bucket->second.empty()) {
+                        void* buffer = bucket->second.back();
+                        bucket->second.pop_back();
+                        --count;
+                        return buffer;
+                    }
+                    ++allocated;
+                }
+                return std::malloc(size);
+            }
+            
+            void relinquish(void* buffer, std::size_t size) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (count < capacity) {
+                        buffers[size].push_back(buffer);
+                        ++count;
+                        return;
+                    }
+                }
+                std::free(buffer);
+            }
+        };
+        
+        namespace {
+            
+            /// The data provider's `info` -- holding the pool state,
+            /// so buffers can find their way home after the pool is gone:
+            struct lease_t {
+                std::shared_ptr<buffer_pool::state_t> state;
+                std::size_t size;
+            };
+            
+            void release_lease(void* info, void const* data, std::size_t) {
+                lease_t* lease = static_cast<lease_t*>(info);
+                lease->state->relinquish(const_cast<void*>(data), lease->size);
+                delete lease;
+            }
+            
+        } /// namespace (anon.)
+        
+        constexpr std::size_t buffer_pool::default_capacity;
+        
+        buffer_pool& buffer_pool::shared() {
+            /// never destroyed: CGImages may return buffers during exit-time teardown
+            static buffer_pool* pool = new buffer_pool();
+            return *pool;
+        }
+        
+        buffer_pool::buffer_pool(std::size_t capacity)
+            :state(std::make_shared<state_t>(capacity))
+            {}
+            
+        buffer_pool::~buffer_pool() {}
+        
+        CGDataProviderRef buffer_pool::provider(std::size_t size, byte** data) {
+            void* buffer = state->acquire(size);
+            imread_assert(buffer != nullptr,
+                          "objc::cg::buffer_pool::provider(): allocation failed",
+                          FF("size = %zu", size));
+            *data = static_cast<byte*>(buffer);
+            return CGDataProviderCreateWithData(new lease_t{ state, size },
+                                                buffer, size, release_lease);
+        }
+        
+        std::size_t buffer_pool::idle() const {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            return state->count;
+        }
+        
+        std::size_t buffer_pool::allocations() const {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            return state->allocated;
+        }
+        
+        void buffer_pool::clear() {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            for (auto& bucket : state->buffers) {
+                for (void* buffer : bucket.second) { std::free(buffer); }
+            }
+            state->buffers.clear();
+            state->count = 0;
+        }
+        
+    } /// namespace cg
+    
+} /// namespace objc
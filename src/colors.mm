@@ -0,0 +1,262 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#include <subjective-c/colors.hh>
+
+#if defined(__SSE2__)
+#define OBJC_COLORS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OBJC_COLORS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace objc {
+    
+    namespace colors {
+        
+        namespace {
+            
+            constexpr std::size_t encode_steps = 4096;
+            constexpr float inverse255 = 1.0f / 255.0f;
+            
+            double srgb_to_linear(double c) {
+                return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            }
+            
+            double linear_to_srgb(double l) {
+                return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            }
+            
+            /// All the tables, built on first use:
+            struct tables_t {
+                std::array<float, 256> linear;              /// 8-bit -> float, as is
+                std::array<float, 256> decode;              /// 8-bit sRGB -> linear float
+                std::array<byte, encode_steps> encode;      /// quantized linear float -> 8-bit sRGB
+                std::array<byte, 256> to_linear;            /// 8-bit sRGB -> 8-bit linear
+                std::array<byte, 256> to_srgb;              /// 8-bit linear -> 8-bit sRGB
+                
+                tables_t() {
+                    for (std::size_t idx = 0; idx < 256; ++idx) {
+                        linear[idx] = float(idx) * inverse255;
+                        decode[idx] = float(srgb_to_linear(idx / 255.0));
+                        to_linear[idx] = byte(std::lround(srgb_to_linear(idx / 255.0) * 255.0));
+                        to_srgb[idx] = byte(std::lround(linear_to_srgb(idx / 255.0) * 255.0));
+                    }
+                    for (std::size_t idx = 0; idx < encode_steps; ++idx) {
+                        encode[idx] = byte(std::lround(linear_to_srgb(double(idx) / (encode_steps - 1)) * 255.0));
+                    }
+                }
+            };
+            
+            tables_t const& tables() {
+                static const tables_t out;
+                return out;
+            }
+            
+            /// clamp to [0, 1] -- NaN going to zero -- then scale and round half up:
+            inline uint32_t quantize(float value, float scale) noexcept {
+                value = value > 0.0f ? value : 0.0f;
+                value = value < 1.0f ? value : 1.0f;
+                return uint32_t(value * scale + 0.5f);
+            }
+            
+            /// Vector kernels: each does as many whole vectors' worth of
+            /// samples as it can, and returns how many that was.
+            
+#if defined(OBJC_COLORS_SSE2)
+            
+            std::size_t widen_sse2(byte const* s, float* d, std::size_t n) noexcept {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128 scale = _mm_set1_ps(inverse255);
+                std::size_t idx = 0;
+                for (; idx + 16 <= n; idx += 16) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + idx));
+                    __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+                    _mm_storeu_ps(d + idx,      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+                    _mm_storeu_ps(d + idx + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+                    _mm_storeu_ps(d + idx + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+                    _mm_storeu_ps(d + idx + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+                }
+                return idx;
+            }
+            
+            /// quantize(), four at a time -- maxps gives its second operand
+            /// for NaN, which is the zero we want:
+            inline __m128i quantize_sse2(float const* s, __m128 scale) noexcept {
+                __m128 v = _mm_max_ps(_mm_loadu_ps(s), _mm_setzero_ps());
+                v = _mm_min_ps(v, _mm_set1_ps(1.0f));
+                return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), _mm_set1_ps(0.5f)));
+            }
+            
+            std::size_t narrow_sse2(float const* s, byte* d, std::size_t n) noexcept {
+                const __m128 scale = _mm_set1_ps(255.0f);
+                std::size_t idx = 0;
+                for (; idx + 16 <= n; idx += 16) {
+                    __m128i a = quantize_sse2(s + idx, scale),     b = quantize_sse2(s + idx + 4, scale);
+                    __m128i c = quantize_sse2(s + idx + 8, scale), e = quantize_sse2(s + idx + 12, scale);
+                    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + idx), packed);
+                }
+                return idx;
+            }
+            
+            std::size_t steps_sse2(float const* s, uint16_t* d, std::size_t n) noexcept {
+                const __m128 scale = _mm_set1_ps(float(encode_steps - 1));
+                std::size_t idx = 0;
+                for (; idx + 8 <= n; idx += 8) {
+                    __m128i a = quantize_sse2(s + idx, scale), b = quantize_sse2(s + idx + 4, scale);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + idx), _mm_packs_epi32(a, b));
+                }
+                return idx;
+            }
+            
+#elif defined(OBJC_COLORS_NEON)
+            
+            std::size_t widen_neon(byte const* s, float* d, std::size_t n) noexcept {
+                const float32x4_t scale = vdupq_n_f32(inverse255);
+                std::size_t idx = 0;
+                for (; idx + 16 <= n; idx += 16) {
+                    uint8x16_t v = vld1q_u8(s + idx);
+                    uint16x8_t lo = vmovl_u8(vget_low_u8(v)), hi = vmovl_u8(vget_high_u8(v));
+                    vst1q_f32(d + idx,      vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+                    vst1q_f32(d + idx + 4,  vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+                    vst1q_f32(d + idx + 8,  vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+                    vst1q_f32(d + idx + 12, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+                }
+                return idx;
+            }
+            
+            /// quantize(), four at a time -- selecting by comparison, so NaN
+            /// (which compares false) goes to zero:
+            inline uint32x4_t quantize_neon(float const* s, float32x4_t scale) noexcept {
+                const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+                float32x4_t v = vld1q_f32(s);
+                v = vbslq_f32(vcgtq_f32(v, zero), v, zero);
+                v = vbslq_f32(vcltq_f32(v, one), v, one);
+                return vcvtq_u32_f32(vaddq_f32(vmulq_f32(v, scale), vdupq_n_f32(0.5f)));
+            }
+            
+            std::size_t narrow_neon(float const* s, byte* d, std::size_t n) noexcept {
+                const float32x4_t scale = vdupq_n_f32(255.0f);
+                std::size_t idx = 0;
+                for (; idx + 16 <= n; idx += 16) {
+                    uint16x8_t lo = vcombine_u16(vmovn_u32(quantize_neon(s + idx, scale)),
+                                                 vmovn_u32(quantize_neon(s + idx + 4, scale)));
+                    uint16x8_t hi = vcombine_u16(vmovn_u32(quantize_neon(s + idx + 8, scale)),
+                                                 vmovn_u32(quantize_neon(s + idx + 12, scale)));
+                    vst1q_u8(d + idx, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+                }
+                return idx;
+            }
+            
+            std::size_t steps_neon(float const* s, uint16_t* d, std::size_t n) noexcept {
+                const float32x4_t scale = vdupq_n_f32(float(encode_steps - 1));
+                std::size_t idx = 0;
+                for (; idx + 8 <= n; idx += 8) {
+                    vst1q_u16(d + idx, vcombine_u16(vmovn_u32(quantize_neon(s + idx, scale)),
+                                                    vmovn_u32(quantize_neon(s + idx + 4, scale))));
+                }
+                return idx;
+            }
+            
+#endif
+            
+            /// 8-bit to float, all samples linear:
+            void widen(byte const* s, float* d, std::size_t n) noexcept {
+                std::size_t idx = 0;
+                #if defined(OBJC_COLORS_SSE2)
+                    idx = widen_sse2(s, d, n);
+                #elif defined(OBJC_COLORS_NEON)
+                    idx = widen_neon(s, d, n);
+                #endif
+                for (; idx < n; ++idx) { d[idx] = float(s[idx]) * inverse255; }
+            }
+            
+            /// float to 8-bit, all samples linear:
+            void narrow(float const* s, byte* d, std::size_t n) noexcept {
+                std::size_t idx = 0;
+                #if defined(OBJC_COLORS_SSE2)
+                    idx = narrow_sse2(s, d, n);
+                #elif defined(OBJC_COLORS_NEON)
+                    idx = narrow_neon(s, d, n);
+                #endif
+                for (; idx < n; ++idx) { d[idx] = byte(quantize(s[idx], 255.0f)); }
+            }
+            
+            /// float to indices into the encode table:
+            void steps(float const* s, uint16_t* d, std::size_t n) noexcept {
+                std::size_t idx = 0;
+                #if defined(OBJC_COLORS_SSE2)
+                    idx = steps_sse2(s, d, n);
+                #elif defined(OBJC_COLORS_NEON)
+                    idx = steps_neon(s, d, n);
+                #endif
+                for (; idx < n; ++idx) { d[idx] = uint16_t(quantize(s[idx], float(encode_steps - 1))); }
+            }
+            
+        } /// namespace (anon.)
+        
+        void decode(byte const* source, float* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve from) {
+            colors = std::min(colors, stride);
+            if (from == curve::linear || !colors) {
+                widen(source, destination, count * stride);
+                return;
+            }
+            
+            tables_t const& t = tables();
+            for (std::size_t idx = 0; idx < count; ++idx, source += stride, destination += stride) {
+                for (std::size_t c = 0; c < colors; ++c) { destination[c] = t.decode[source[c]]; }
+                for (std::size_t c = colors; c < stride; ++c) { destination[c] = t.linear[source[c]]; }
+            }
+        }
+        
+        void encode(float const* source, byte* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve to) {
+            const std::size_t total = count * stride;
+            narrow(source, destination, total);
+            colors = std::min(colors, stride);
+            if (to == curve::linear || !colors) { return; }
+            
+            /// ... then the colors again, through the table, a block at a time:
+            tables_t const& t = tables();
+            constexpr std::size_t block = 1024;
+            uint16_t indices[block];
+            for (std::size_t start = 0; start < total; start += block) {
+                const std::size_t n = std::min(block, total - start);
+                steps(source + start, indices, n);
+                for (std::size_t idx = 0; idx < n; ++idx) {
+                    if ((start + idx) % stride < colors) {
+                        destination[start + idx] = t.encode[indices[idx]];
+                    }
+                }
+            }
+        }
+        
+        void recode(byte const* source, byte* destination,
+                    std::size_t count, std::size_t stride, std::size_t colors,
+                    curve from, curve to) {
+            colors = std::min(colors, stride);
+            if (from == to || !colors) {
+                if (source != destination) { std::memmove(destination, source, count * stride); }
+                return;
+            }
+            tables_t const& t = tables();
+            byte const* table = to == curve::linear ? t.to_linear.data() : t.to_srgb.data();
+            for (std::size_t idx = 0; idx < count; ++idx, source += stride, destination += stride) {
+                for (std::size_t c = 0; c < colors; ++c) { destination[c] = table[source[c]]; }
+                for (std::size_t c = colors; c < stride; ++c) { destination[c] = source[c]; }
+            }
+        }
+        
+    } /// namespace colors
+    
+} /// namespace objc
@@ -0,0 +1,130 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <subjective-c/encoder.hh>
+#import  <ImageIO/ImageIO.h>
+
+namespace objc {
+    
+    namespace cg {
+        
+        struct encoder::state_t {
+            CGDataConsumerRef consumer = nullptr;
+            bytevec_t scratch;
+            NSDictionary* jpegproperties = nil;     /// for `jpegquality`
+            float jpegquality = -1.0f;
+            std::size_t encodes = 0;
+            std::size_t growths = 0;
+            
+            /// where the consumer writes, for the encode in progress:
+            bytevec_t* vector = nullptr;
+            NSMutableData* data = nil;
+            
+            NSDictionary* properties(encoding kind, float quality) {
+                if (kind == encoding::png) { return @{}; }
+                if (quality != jpegquality || !jpegproperties) {
+                    jpegquality = quality;
+                    jpegproperties = @{ (__bridge NSString*)kCGImageDestinationLossyCompressionQuality : @(quality) };
+                }
+                return jpegproperties;
+            }
+        };
+        
+        namespace {
+            
+            std::size_t put_bytes(void* info, void const* buffer, std::size_t count) {
+                encoder::state_t* state = static_cast<encoder::state_t*>(info);
+                byte const* bytes = static_cast<byte const*>(buffer);
+                if (state->vector) {
+                    bytevec_t& vector = *state->vector;
+                    if (vector.size() + count > vector.capacity()) { ++state->growths; }
+                    vector.insert(vector.end(), bytes, bytes + count);
+                } else if (state->data) {
+                    [state->data appendBytes:bytes length:count];
+                } else {
+                    return 0;
+                }
+                return count;
+            }
+            
+            CFStringRef type_for(encoding kind) {
+                return kind == encoding::jpeg ? CFSTR("public.jpeg") : CFSTR("public.png");
+            }
+            
+            /// the consumer -- and with it, the encoder's state -- has to be
+            /// pointed at a sink before this, and away from it after:
+            bool encode_through(encoder::state_t* state, CGImageRef image,
+                                encoding kind, float quality) {
+                if (!image) { return false; }
+                CGImageDestinationRef destination = CGImageDestinationCreateWithDataConsumer(state->consumer,
+                                                                                             type_for(kind),
+                                                                                             1, nullptr);
+                if (!destination) { return false; }
+                CGImageDestinationAddImage(destination, image,
+                                           (__bridge CFDictionaryRef)state->properties(kind, quality));
+                bool ok = CGImageDestinationFinalize(destination);
+                CFRelease(destination);
+                return ok;
+            }
+            
+        } /// namespace (anon.)
+        
+        encoder& encoder::local() {
+            static thread_local encoder instance;
+            return instance;
+        }
+        
+        encoder::encoder()
+            :state(new state_t)
+            {
+                CGDataConsumerCallbacks callbacks = { put_bytes, nullptr };
+                state->consumer = CGDataConsumerCreate(state.get(), &callbacks);
+            }
+            
+        encoder::~encoder() {
+            if (state->consumer) { CGDataConsumerRelease(state->consumer); }
+        }
+        
+        bool encoder::encode(CGImageRef image, encoding kind, float quality, bytevec_t& sink) {
+            const std::size_t original = sink.size();
+            state->vector = &sink;
+            bool ok = encode_through(state.get(), image, kind, quality);
+            state->vector = nullptr;
+            if (!ok) {
+                sink.resize(original);
+                return false;
+            }
+            ++state->encodes;
+            return true;
+        }
+        
+        bool encoder::encode(CGImageRef image, encoding kind, float quality, NSMutableData* sink) {
+            if (!sink) { return false; }
+            const NSUInteger original = sink.length;
+            state->data = sink;
+            bool ok = encode_through(state.get(), image, kind, quality);
+            state->data = nil;
+            if (!ok) {
+                sink.length = original;
+                return false;
+            }
+            ++state->encodes;
+            return true;
+        }
+        
+        NSData* encoder::encode(CGImageRef image, encoding kind, float quality) {
+            /// clear() keeps the capacity, so after the first few encodes
+            /// the scratch buffer's as big as it needs to be:
+            state->scratch.clear();
+            if (!encode(image, kind, quality, state->scratch)) { return nil; }
+            return [NSData dataWithBytes:state->scratch.data()
+                                  length:state->scratch.size()];
+        }
+        
+        std::size_t encoder::encodes() const    { return state->encodes; }
+        std::size_t encoder::growths() const    { return state->growths; }
+        std::size_t encoder::capacity() const   { return state->scratch.capacity(); }
+        
+    } /// namespace cg
+    
+} /// namespace objc
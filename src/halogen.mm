@@ -0,0 +1,207 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <limits>
+#include <algorithm>
+#include <subjective-c/halogen.hh>
+
+#if defined(OBJC_HALOGEN)
+#include <HalideRuntime.h>
+#include "halogen_resize_u8.h"
+#include "halogen_resize_f32.h"
+#include "halogen_colorconvert.h"
+#include "halogen_premultiply.h"
+#include "halogen_unpremultiply.h"
+#include "halogen_reorder.h"
+#endif
+
+namespace objc {
+    
+    namespace halogen {
+    
+#if defined(OBJC_HALOGEN)
+        
+        namespace {
+            
+            std::ptrdiff_t rowbytes_of(buffer_t const& buffer) {
+                return buffer.rowbytes ? buffer.rowbytes
+                                       : std::ptrdiff_t(buffer.width * buffer.channels *
+                                                        static_cast<std::size_t>(buffer.kind));
+            }
+            
+            /// Four channels of 8-bit or float samples, with rows a whole number
+            /// of samples apart -- and small enough for Halide's int32 extents:
+            bool acceptable(buffer_t const& buffer) {
+                constexpr std::size_t limit = std::numeric_limits<int32_t>::max();
+                const std::ptrdiff_t size = static_cast<std::ptrdiff_t>(buffer.kind);
+                const std::ptrdiff_t rowbytes = rowbytes_of(buffer);
+                return buffer.data && buffer.channels == 4 &&
+                       buffer.kind != pixels::sample::u16 &&
+                       buffer.width && buffer.height &&
+                       buffer.width < limit / 4 && buffer.height < limit &&
+                       rowbytes % size == 0 &&
+                       rowbytes / size >= std::ptrdiff_t(buffer.width * 4) &&
+                       rowbytes / size < std::ptrdiff_t(limit);
+            }
+            
+            bool agree(buffer_t const& source, buffer_t const& destination) {
+                return acceptable(source) && acceptable(destination) &&
+                       source.kind == destination.kind;
+            }
+            
+            /// A halide_buffer_t over a buffer_t's samples, as (x, y, channel):
+            struct view_t {
+                halide_dimension_t dims[3];
+                halide_buffer_t buffer = {};
+                
+                explicit view_t(buffer_t const& source) {
+                    const int32_t size = static_cast<int32_t>(source.kind);
+                    dims[0] = halide_dimension_t(0, int32_t(source.width), 4);
+                    dims[1] = halide_dimension_t(0, int32_t(source.height),
+                                                    int32_t(rowbytes_of(source) / size));
+                    dims[2] = halide_dimension_t(0, 4, 1);
+                    buffer.host = source.data;
+                    buffer.type = source.kind == pixels::sample::f32 ? halide_type_t(halide_type_float, 32)
+                                                                     : halide_type_t(halide_type_uint, 8);
+                    buffer.dimensions = 3;
+                    buffer.dim = dims;
+                }
+                
+                view_t(view_t const&) = delete;             /// `buffer.dim` points at `dims`
+                view_t& operator=(view_t const&) = delete;
+            };
+            
+            /// A 3x3 matrix, as (column, row):
+            struct matrix_t {
+                float values[9];
+                halide_dimension_t dims[2] = { halide_dimension_t(0, 3, 1),
+                                               halide_dimension_t(0, 3, 3) };
+                halide_buffer_t buffer = {};
+                
+                explicit matrix_t(float const (&m)[9]) {
+                    std::copy(m, m + 9, values);
+                    buffer.host = reinterpret_cast<uint8_t*>(values);
+                    buffer.type = halide_type_t(halide_type_float, 32);
+                    buffer.dimensions = 2;
+                    buffer.dim = dims;
+                }
+                
+                matrix_t(matrix_t const&) = delete;
+                matrix_t& operator=(matrix_t const&) = delete;
+            };
+            
+            /// Linear-light RGB to RGB, both with D65 whites, by row:
+            constexpr float identity[9]     = {  1.0f,        0.0f,        0.0f,
+                                                 0.0f,        1.0f,        0.0f,
+                                                 0.0f,        0.0f,        1.0f };
+            constexpr float srgb_to_p3[9]   = {  0.8224621f,  0.1775380f,  0.0f,
+                                                 0.0331941f,  0.9668058f,  0.0f,
+                                                 0.0170827f,  0.0723974f,  0.9105199f };
+            constexpr float p3_to_srgb[9]   = {  1.2249401f, -0.2249404f,  0.0f,
+                                                -0.0420569f,  1.0420571f,  0.0f,
+                                                -0.0196376f, -0.0786361f,  1.0982735f };
+                                                
+            bool overlapping(buffer_t const& source, buffer_t const& destination) {
+                byte const* begin = source.data;
+                byte const* end = source.data + rowbytes_of(source) * source.height;
+                byte const* otherbegin = destination.data;
+                byte const* otherend = destination.data + rowbytes_of(destination) * destination.height;
+                return begin < otherend && otherbegin < end;
+            }
+            
+        } /// namespace (anon.)
+        
+        bool available() noexcept { return true; }
+        
+        bool resize(buffer_t const& source, buffer_t const& destination,
+                    resample::options const& opts) {
+            if (!opts.vectorize || !agree(source, destination)) { return false; }
+            
+            resample::region_t region = opts.region;
+            if (region.width <= 0.0 || region.height <= 0.0) {
+                region = resample::region_t{ 0.0, 0.0, double(source.width), double(source.height) };
+            }
+            if (region.x < 0.0 || region.y < 0.0 ||
+                region.x + region.width > double(source.width) ||
+                region.y + region.height > double(source.height)) { return false; }
+                
+            view_t in(source), out(destination);
+            const int32_t kernel = static_cast<int32_t>(opts.kernel);
+            const float scale_x = float(region.width / double(destination.width));
+            const float scale_y = float(region.height / double(destination.height));
+            
+            if (source.kind == pixels::sample::u8) {
+                return halogen_resize_u8(&in.buffer, kernel,
+                                         float(region.x), float(region.y),
+                                         scale_x, scale_y, &out.buffer) == 0;
+            }
+            return halogen_resize_f32(&in.buffer, kernel,
+                                      float(region.x), float(region.y),
+                                      scale_x, scale_y, &out.buffer) == 0;
+        }
+        
+        /// each output sample depends only on its own input sample and that
+        /// pixel's alpha, which is left alone -- so these work in place:
+        bool premultiply(buffer_t const& source, buffer_t const& destination) {
+            if (!agree(source, destination) || source.kind != pixels::sample::u8 ||
+                source.width != destination.width ||
+                source.height != destination.height) { return false; }
+            view_t in(source), out(destination);
+            return halogen_premultiply(&in.buffer, &out.buffer) == 0;
+        }
+        
+        bool unpremultiply(buffer_t const& source, buffer_t const& destination) {
+            if (!agree(source, destination) || source.kind != pixels::sample::u8 ||
+                source.width != destination.width ||
+                source.height != destination.height) { return false; }
+            view_t in(source), out(destination);
+            return halogen_unpremultiply(&in.buffer, &out.buffer) == 0;
+        }
+        
+        bool reorder(buffer_t const& source, buffer_t const& destination,
+                     std::array<uint8_t, 4> const& order) {
+            if (!agree(source, destination) || source.kind != pixels::sample::u8 ||
+                source.width != destination.width ||
+                source.height != destination.height ||
+                overlapping(source, destination)) { return false; }
+            if (std::any_of(order.begin(), order.end(),
+                        [](uint8_t channel) { return channel > 3; })) { return false; }
+            view_t in(source), out(destination);
+            return halogen_reorder(&in.buffer, order[0], order[1], order[2], order[3],
+                                   &out.buffer) == 0;
+        }
+        
+        bool convert(buffer_t const& source, buffer_t const& destination,
+                     colorspace from, colorspace to) {
+            if (!agree(source, destination) || source.kind != pixels::sample::u8 ||
+                source.width != destination.width ||
+                source.height != destination.height ||
+                overlapping(source, destination)) { return false; }
+                
+            const bool wide_from = from == colorspace::display_p3;
+            const bool wide_to = to == colorspace::display_p3;
+            matrix_t matrix(wide_from == wide_to ? identity :
+                            wide_from            ? p3_to_srgb
+                                                 : srgb_to_p3);
+            view_t in(source), out(destination);
+            return halogen_colorconvert(&in.buffer, &matrix.buffer,
+                                        from != colorspace::linear_srgb,
+                                        to != colorspace::linear_srgb,
+                                        &out.buffer) == 0;
+        }
+        
+#else
+        
+        bool available() noexcept { return false; }
+        
+        bool resize(buffer_t const&, buffer_t const&, resample::options const&) { return false; }
+        bool premultiply(buffer_t const&, buffer_t const&) { return false; }
+        bool unpremultiply(buffer_t const&, buffer_t const&) { return false; }
+        bool reorder(buffer_t const&, buffer_t const&, std::array<uint8_t, 4> const&) { return false; }
+        bool convert(buffer_t const&, buffer_t const&, colorspace, colorspace) { return false; }
+        
+#endif /// OBJC_HALOGEN
+    
+    } /// namespace halogen
+    
+} /// namespace objc
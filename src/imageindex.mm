@@ -0,0 +1,508 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#if defined(__APPLE__)
+#include <sys/attr.h>
+#include <sys/vnode.h>
+#endif
+
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+
+#include <subjective-c/imageindex.hh>
+#include <libimread/errors.hh>
+
+namespace objc {
+    
+    namespace image {
+        
+        constexpr char const index::magic[8];
+        constexpr uint32_t index::version;
+        constexpr std::size_t index::npos;
+        
+        namespace {
+            
+            constexpr std::size_t align8(std::size_t n) {
+                return (n + 7) & ~std::size_t(7);
+            }
+            
+            /// One worker's findings: relative paths are packed end-to-end
+            /// into a private arena, so a scan does one allocation per
+            /// arena growth rather than one per file.
+            
+            struct record_t {
+                uint64_t offset;
+                uint32_t length;
+                int16_t typecode;
+                uint64_t filesize;
+            };
+            
+            struct findings_t {
+                std::string arena;
+                std::vector<record_t> records;
+                
+                void add(std::string const& dir, char const* name,
+                         NSInteger typecode, uint64_t filesize) {
+                    uint64_t offset = arena.size();
+                    if (!dir.empty()) { arena.append(dir); arena.push_back('/'); }
+                    arena.append(name);
+                    records.push_back({ offset,
+                                        static_cast<uint32_t>(arena.size() - offset),
+                                        static_cast<int16_t>(typecode),
+                                        filesize });
+                }
+                
+                std::string_view at(record_t const& record) const {
+                    return std::string_view(arena.data() + record.offset, record.length);
+                }
+            };
+            
+            struct entry_t {
+                char const* name;
+                bool directory;
+                bool regular;
+                uint64_t filesize;
+            };
+            
+            NSInteger classify_file(int dirfd, char const* name, index::classify by) {
+                NSInteger typecode = -1;
+                if (by != index::classify::contents) {
+                    typecode = filetype(extension(name));
+                }
+                if (typecode == -1 && by != index::classify::suffix) {
+                    int fd = ::openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+                    if (fd != -1) {
+                        byte head[sniff_size];
+                        ssize_t got = ::pread(fd, head, sniff_size, 0);
+                        if (got > 0) { typecode = sniff(head, static_cast<std::size_t>(got)); }
+                        ::close(fd);
+                    }
+                }
+                return typecode;
+            }
+            
+            /// Call `each(entry_t const&)` for every entry in an open directory,
+            /// fetching entries (with their types and sizes) in bulk.
+            
+            template <typename Function> inline
+            void enumerate(int dirfd, Function&& each) {
+                #if defined(__APPLE__)
+                    struct attrlist attrs;
+                    std::memset(&attrs, 0, sizeof(attrs));
+                    attrs.bitmapcount = ATTR_BIT_MAP_COUNT;
+                    attrs.commonattr  = ATTR_CMN_RETURNED_ATTRS |
+                                        ATTR_CMN_NAME           |
+                                        ATTR_CMN_ERROR          |
+                                        ATTR_CMN_OBJTYPE;
+                    attrs.fileattr    = ATTR_FILE_DATALENGTH;
+                    
+                    std::unique_ptr<char[]> buffer = std::make_unique<char[]>(128 * 1024);
+                    int count;
+                    
+                    while ((count = ::getattrlistbulk(dirfd, &attrs, buffer.get(),
+                                                      128 * 1024, 0)) > 0) {
+                        char* entry = buffer.get();
+                        for (int idx = 0; idx < count; ++idx) {
+                            char* field = entry;
+                            uint32_t entrylength = *reinterpret_cast<uint32_t*>(field);
+                            field += sizeof(uint32_t);
+                            attribute_set_t returned = *reinterpret_cast<attribute_set_t*>(field);
+                            field += sizeof(attribute_set_t);
+                            uint32_t error = 0;
+                            if (returned.commonattr & ATTR_CMN_ERROR) {
+                                error = *reinterpret_cast<uint32_t*>(field);
+                                field += sizeof(uint32_t);
+                            }
+                            attrreference_t* nameref = reinterpret_cast<attrreference_t*>(field);
+                            char const* name = field + nameref->attr_dataoffset;
+                            field += sizeof(attrreference_t);
+                            fsobj_type_t objtype = *reinterpret_cast<fsobj_type_t*>(field);
+                            field += sizeof(fsobj_type_t);
+                            uint64_t filesize = 0;
+                            if (objtype == VREG && (returned.fileattr & ATTR_FILE_DATALENGTH)) {
+                                filesize = static_cast<uint64_t>(*reinterpret_cast<off_t*>(field));
+                            }
+                            if (!error) {
+                                each(entry_t{ name, objtype == VDIR, objtype == VREG, filesize });
+                            }
+                            entry += entrylength;
+                        }
+                    }
+                #else
+                    int ownfd = ::dup(dirfd);
+                    if (ownfd == -1) { return; }
+                    DIR* directory = ::fdopendir(ownfd);
+                    if (!directory) { ::close(ownfd); return; }
+                    while (struct dirent* dent = ::readdir(directory)) {
+                        if (dent->d_name[0] == '.' && (dent->d_name[1] == '\0' ||
+                           (dent->d_name[1] == '.' && dent->d_name[2] == '\0'))) { continue; }
+                        struct stat st;
+                        bool directory_entry = dent->d_type == DT_DIR;
+                        bool regular = dent->d_type == DT_REG;
+                        uint64_t filesize = 0;
+                        if (dent->d_type == DT_UNKNOWN || regular) {
+                            if (::fstatat(dirfd, dent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) { continue; }
+                            directory_entry = S_ISDIR(st.st_mode);
+                            regular = S_ISREG(st.st_mode);
+                            filesize = static_cast<uint64_t>(st.st_size);
+                        }
+                        each(entry_t{ dent->d_name, directory_entry, regular, filesize });
+                    }
+                    ::closedir(directory);
+                #endif
+            }
+            
+            /// directory work queue, shared by all workers --
+            /// `pending` counts directories queued or still being read,
+            /// and the walk is over when it drops to zero.
+            
+            struct walk_t {
+                std::mutex mutex;
+                std::condition_variable ready;
+                std::vector<std::string> directories;
+                std::size_t pending = 0;
+            };
+            
+            void worker(int rootfd, walk_t& walk,
+                        index::options const& opts,
+                        findings_t& findings) {
+                std::vector<std::string> subdirectories;
+                for (;;) {
+                    std::string dir;
+                    {
+                        std::unique_lock<std::mutex> lock(walk.mutex);
+                        walk.ready.wait(lock, [&walk]() {
+                            return !walk.directories.empty() || walk.pending == 0;
+                        });
+                        if (walk.directories.empty()) { return; }
+                        dir = std::move(walk.directories.back());
+                        walk.directories.pop_back();
+                    }
+                    
+                    int dirfd = ::openat(rootfd, dir.empty() ? "." : dir.c_str(),
+                                         O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                    if (dirfd != -1) {
+                        enumerate(dirfd, [&](entry_t const& entry) {
+                            if (entry.directory) {
+                                subdirectories.push_back(dir.empty() ? std::string(entry.name)
+                                                                     : dir + "/" + entry.name);
+                            } else if (entry.regular) {
+                                NSInteger typecode = classify_file(dirfd, entry.name, opts.by);
+                                if (typecode != -1 || !opts.images_only) {
+                                    findings.add(dir, entry.name, typecode, entry.filesize);
+                                }
+                            }
+                        });
+                        ::close(dirfd);
+                    }
+                    
+                    bool wake;
+                    {
+                        std::lock_guard<std::mutex> lock(walk.mutex);
+                        walk.pending += subdirectories.size();
+                        walk.pending -= 1;
+                        wake = walk.pending == 0 || !subdirectories.empty();
+                        for (std::string& subdirectory : subdirectories) {
+                            walk.directories.push_back(std::move(subdirectory));
+                        }
+                    }
+                    if (wake) { walk.ready.notify_all(); }
+                    subdirectories.clear();
+                }
+            }
+            
+        } /// namespace (anon.)
+        
+        index index::scan(std::string const& root) {
+            return index::scan(root, options{});
+        }
+        
+        index index::scan(std::string const& root, options const& opts) {
+            int rootfd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            imread_assert(rootfd != -1,
+                          "objc::image::index::scan(): can't open directory", root);
+                          
+            unsigned workers = opts.workers ? opts.workers
+                                            : std::max(1u, std::thread::hardware_concurrency());
+            std::vector<findings_t> findings(workers);
+            walk_t walk;
+            walk.directories.emplace_back("");
+            walk.pending = 1;
+            
+            {
+                std::vector<std::thread> threads;
+                threads.reserve(workers);
+                for (unsigned idx = 0; idx < workers; ++idx) {
+                    threads.emplace_back(worker, rootfd, std::ref(walk),
+                                                 std::cref(opts),
+                                                 std::ref(findings[idx]));
+                }
+                for (std::thread& thread : threads) { thread.join(); }
+            }
+            ::close(rootfd);
+            
+            /// merge and sort everything the workers found:
+            using ref_t = std::pair<findings_t const*, record_t const*>;
+            std::vector<ref_t> refs;
+            std::size_t arenasize = 0;
+            for (findings_t const& found : findings) {
+                for (record_t const& record : found.records) {
+                    refs.emplace_back(&found, &record);
+                    arenasize += record.length + 1;
+                }
+            }
+            std::sort(refs.begin(), refs.end(), [](ref_t const& lhs, ref_t const& rhs) {
+                return lhs.first->at(*lhs.second) < rhs.first->at(*rhs.second);
+            });
+            
+            /// lay out the columns in one buffer, exactly as they'll be saved:
+            std::size_t count = refs.size();
+            std::size_t rootsize = root.size();
+            std::size_t length = sizeof(header_t)
+                               + align8(rootsize + 1)
+                               + (count + 1) * sizeof(uint64_t)
+                               + count * sizeof(uint64_t)
+                               + align8(count * sizeof(int16_t))
+                               + arenasize;
+                               
+            std::shared_ptr<void> storage(::operator new(length),
+                                          [](void* p) { ::operator delete(p); });
+            byte* cursor = static_cast<byte*>(storage.get());
+            std::memset(cursor, 0, length);
+            
+            header_t* header = reinterpret_cast<header_t*>(cursor);
+            std::memcpy(header->magic, index::magic, sizeof(index::magic));
+            header->version = index::version;
+            header->rootsize = static_cast<uint32_t>(rootsize);
+            header->count = count;
+            header->arenasize = arenasize;
+            cursor += sizeof(header_t);
+            
+            std::memcpy(cursor, root.data(), rootsize);
+            cursor += align8(rootsize + 1);
+            
+            uint64_t* offsets = reinterpret_cast<uint64_t*>(cursor);
+            cursor += (count + 1) * sizeof(uint64_t);
+            uint64_t* sizes = reinterpret_cast<uint64_t*>(cursor);
+            cursor += count * sizeof(uint64_t);
+            int16_t* types = reinterpret_cast<int16_t*>(cursor);
+            cursor += align8(count * sizeof(int16_t));
+            char* arena = reinterpret_cast<char*>(cursor);
+            
+            uint64_t offset = 0;
+            for (std::size_t idx = 0; idx < count; ++idx) {
+                std::string_view relpath = refs[idx].first->at(*refs[idx].second);
+                offsets[idx] = offset;
+                sizes[idx] = refs[idx].second->filesize;
+                types[idx] = refs[idx].second->typecode;
+                std::memcpy(arena + offset, relpath.data(), relpath.size());
+                offset += relpath.size() + 1;
+            }
+            offsets[count] = offset;
+            
+            return index(std::move(storage), length);
+        }
+        
+        index index::map(std::string const& indexfile) {
+            int fd = ::open(indexfile.c_str(), O_RDONLY | O_CLOEXEC);
+            imread_assert(fd != -1,
+                          "objc::image::index::map(): can't open index file", indexfile);
+                          
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(header_t)) {
+                ::close(fd);
+                imread_assert(false,
+                              "objc::image::index::map(): truncated index file", indexfile);
+            }
+            
+            std::size_t length = static_cast<std::size_t>(st.st_size);
+            void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            imread_assert(mapped != MAP_FAILED,
+                          "objc::image::index::map(): mmap() failed for", indexfile);
+                          
+            return index(std::shared_ptr<void>(mapped, [length](void* p) { ::munmap(p, length); }),
+                         length);
+        }
+        
+        index::index(std::shared_ptr<void> buffer, std::size_t size)
+            :storage(std::move(buffer)), length(size)
+            {
+                attach();
+            }
+            
+        index::index(index const& other)
+            :storage(other.storage), length(other.length)
+            {
+                attach();
+            }
+            
+        /// Moving takes the columns along as they are -- they were checked
+        /// when the buffer was first attached -- and leaves `other` empty:
+        index::index(index&& other) noexcept
+            :storage(std::move(other.storage))
+            ,length(std::exchange(other.length, 0))
+            ,header(std::exchange(other.header, nullptr))
+            ,rootstr(std::exchange(other.rootstr, nullptr))
+            ,offsets(std::exchange(other.offsets, nullptr))
+            ,sizes(std::exchange(other.sizes, nullptr))
+            ,types(std::exchange(other.types, nullptr))
+            ,arena(std::exchange(other.arena, nullptr))
+            {}
+            
+        index::~index() {}
+        
+        index& index::operator=(index const& other) {
+            if (&other != this) {
+                storage = other.storage;
+                length = other.length;
+                attach();
+            }
+            return *this;
+        }
+        
+        index& index::operator=(index&& other) noexcept {
+            if (&other != this) {
+                storage = std::move(other.storage);
+                length  = std::exchange(other.length, 0);
+                header  = std::exchange(other.header, nullptr);
+                rootstr = std::exchange(other.rootstr, nullptr);
+                offsets = std::exchange(other.offsets, nullptr);
+                sizes   = std::exchange(other.sizes, nullptr);
+                types   = std::exchange(other.types, nullptr);
+                arena   = std::exchange(other.arena, nullptr);
+            }
+            return *this;
+        }
+        
+        void index::attach() {
+            if (!storage) {
+                header = nullptr;
+                rootstr = arena = nullptr;
+                offsets = sizes = nullptr;
+                types = nullptr;
+                return;
+            }
+            
+            imread_assert(length >= sizeof(header_t),
+                          "objc::image::index: truncated header");
+            byte const* cursor = static_cast<byte const*>(storage.get());
+            header = reinterpret_cast<header_t const*>(cursor);
+            imread_assert(std::memcmp(header->magic, index::magic, sizeof(index::magic)) == 0 &&
+                          header->version == index::version,
+                          "objc::image::index: bad magic number or version");
+                          
+            /// every size in the header comes from the file, so none of them
+            /// get to overflow on their way to adding up to its length:
+            const std::size_t count = header->count;
+            std::size_t slots, offsetbytes, sizebytes;
+            std::size_t expected = sizeof(header_t) + align8(std::size_t(header->rootsize) + 1);
+            const bool overflows = __builtin_add_overflow(count, std::size_t(1), &slots)
+                                || __builtin_mul_overflow(slots, sizeof(uint64_t), &offsetbytes)
+                                || __builtin_add_overflow(expected, offsetbytes, &expected)
+                                || __builtin_mul_overflow(count, sizeof(uint64_t), &sizebytes)
+                                || __builtin_add_overflow(expected, sizebytes, &expected)
+                                || __builtin_add_overflow(expected, align8(count * sizeof(int16_t)), &expected)
+                                || __builtin_add_overflow(expected, std::size_t(header->arenasize), &expected);
+            imread_assert(!overflows && expected == length,
+                          "objc::image::index: column sizes don't add up");
+                          
+            cursor += sizeof(header_t);
+            rootstr = reinterpret_cast<char const*>(cursor);
+            cursor += align8(std::size_t(header->rootsize) + 1);
+            offsets = reinterpret_cast<uint64_t const*>(cursor);
+            cursor += offsetbytes;
+            sizes = reinterpret_cast<uint64_t const*>(cursor);
+            cursor += sizebytes;
+            types = reinterpret_cast<int16_t const*>(cursor);
+            cursor += align8(count * sizeof(int16_t));
+            arena = reinterpret_cast<char const*>(cursor);
+            
+            /// ... and the strings have to stay inside their columns -- path()
+            /// and friends take all of this on trust, once it's attached:
+            imread_assert(rootstr[header->rootsize] == '\0',
+                          "objc::image::index: root path isn't NUL-terminated");
+            imread_assert(offsets[0] == 0 && offsets[count] == header->arenasize,
+                          "objc::image::index: path offsets don't span the arena");
+            for (std::size_t idx = 0; idx < count; ++idx) {
+                imread_assert(offsets[idx] < offsets[idx + 1] && arena[offsets[idx + 1] - 1] == '\0',
+                              "objc::image::index: bad path offset or terminator at", idx);
+            }
+        }
+        
+        bool index::save(std::string const& indexfile) const {
+            if (!storage) { return false; }
+            int fd = ::open(indexfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd == -1) { return false; }
+            byte const* cursor = static_cast<byte const*>(storage.get());
+            std::size_t remaining = length;
+            while (remaining > 0) {
+                ssize_t written = ::write(fd, cursor, remaining);
+                if (written <= 0) { ::close(fd); return false; }
+                cursor += written;
+                remaining -= static_cast<std::size_t>(written);
+            }
+            return ::close(fd) == 0;
+        }
+        
+        std::size_t index::size() const noexcept {
+            return header ? static_cast<std::size_t>(header->count) : 0;
+        }
+        
+        bool index::empty() const noexcept {
+            return size() == 0;
+        }
+        
+        std::size_t index::bytes() const noexcept {
+            return length;
+        }
+        
+        std::string_view index::root() const noexcept {
+            if (!header) { return {}; }
+            return std::string_view(rootstr, header->rootsize);
+        }
+        
+        std::string_view index::path(std::size_t idx) const noexcept {
+            if (idx >= size()) { return {}; }
+            return std::string_view(arena + offsets[idx],
+                                    offsets[idx + 1] - offsets[idx] - 1);
+        }
+        
+        NSInteger index::typecode(std::size_t idx) const noexcept {
+            if (idx >= size()) { return -1; }
+            return static_cast<NSInteger>(types[idx]);
+        }
+        
+        uint64_t index::filesize(std::size_t idx) const noexcept {
+            if (idx >= size()) { return 0; }
+            return sizes[idx];
+        }
+        
+        std::size_t index::find(std::string_view relpath) const noexcept {
+            std::size_t lo = 0, hi = size();
+            while (lo < hi) {
+                std::size_t mid = lo + (hi - lo) / 2;
+                int cmp = path(mid).compare(relpath);
+                if (cmp == 0)       { return mid; }
+                else if (cmp < 0)   { lo = mid + 1; }
+                else                { hi = mid; }
+            }
+            return npos;
+        }
+        
+    } /// namespace image
+    
+} /// namespace objc
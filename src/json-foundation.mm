@@ -0,0 +1,111 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <subjective-c/json.hh>
+#include <libimread/errors.hh>
+#import  <Foundation/Foundation.h>
+
+namespace objc {
+    
+    namespace json {
+        
+        namespace {
+            
+            /// Builds Foundation objects from a document's tape -- children go onto one
+            /// shared stack, from which each container is made in one go (and then popped),
+            /// and every distinct key becomes an NSString once, however often it appears:
+            struct materializer {
+                
+                std::vector<id> values;
+                std::vector<id> keys;
+                std::unordered_map<std::string_view, NSString*> keycache;
+                
+                static NSString* string_for(std::string_view string) {
+                    return [[NSString alloc] initWithBytes:string.data()
+                                                    length:string.size()
+                                                  encoding:NSUTF8StringEncoding];
+                }
+                
+                NSString* key_for(std::string_view key) {
+                    auto found = keycache.find(key);
+                    if (found != keycache.end()) { return found->second; }
+                    NSString* out = string_for(key);
+                    keycache.emplace(key, out);
+                    return out;
+                }
+                
+                id operator()(value const& current) {
+                    switch (current.type()) {
+                        case tag::object: {
+                            const std::size_t base = values.size();
+                            for (member const& m : current.members()) {
+                                id object = (*this)(m.val);
+                                keys.push_back(key_for(m.key));
+                                values.push_back(object);
+                            }
+                            NSDictionary* out = [NSDictionary dictionaryWithObjects:values.data() + base
+                                                                            forKeys:keys.data() + base
+                                                                              count:values.size() - base];
+                            values.resize(base);
+                            keys.resize(base);
+                            return out;
+                        }
+                        case tag::array: {
+                            const std::size_t base = values.size();
+                            for (value element : current.elements()) {
+                                /// keep the two stacks level, for the objects above us:
+                                id object = (*this)(element);
+                                keys.push_back(nil);
+                                values.push_back(object);
+                            }
+                            NSArray* out = [NSArray arrayWithObjects:values.data() + base
+                                                               count:values.size() - base];
+                            values.resize(base);
+                            keys.resize(base);
+                            return out;
+                        }
+                        case tag::string:
+                            return string_for(current.as_string());
+                        case tag::integer:
+                            return [NSNumber numberWithLongLong:current.as_integer()];
+                        case tag::real:
+                            return [NSNumber numberWithDouble:current.as_double()];
+                        case tag::truth:
+                            return @YES;
+                        case tag::falsity:
+                            return @NO;
+                        case tag::null:
+                            return [NSNull null];
+                        default:
+                            imread_assert(false,
+                                          "objc::json: unexpected tag on tape: ",
+                                          char(current.type()));
+                            return nil;
+                    }
+                }
+                
+            };
+            
+        } /// namespace (anon.)
+        
+        document document::parse(NSData* data) {
+            imread_assert(data != nil,
+                          "objc::json: no data to parse");
+            return parse(std::string_view(static_cast<char const*>(data.bytes),
+                                          data.length));
+        }
+        
+        id value::materialize() const {
+            imread_assert(doc != nullptr,
+                          "objc::json: can't materialize an empty value");
+            materializer make;
+            return make(*this);
+        }
+        
+    } /// namespace json
+    
+} /// namespace objc
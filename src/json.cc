@@ -0,0 +1,777 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <locale.h>
+#include <xlocale.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <subjective-c/json.hh>
+#include <libimread/errors.hh>
+
+namespace objc {
+    
+    namespace json {
+        
+        namespace {
+            
+            /// bytes of spaces after the text: enough for the last 64-byte block,
+            /// and for string copies and number parsing to read past their ends
+            constexpr std::size_t padding = 64;
+            constexpr std::size_t max_depth = 1024;
+            constexpr uint64_t count_max = 0xFFFFFF;
+            
+            inline uint64_t tape_word(tag t, uint64_t payload) {
+                return (uint64_t(t) << 56) | payload;
+            }
+            
+            /// numbers are read and written in the "C" locale, whatever
+            /// LC_NUMERIC says -- JSON has no decimal commas:
+            locale_t c_locale() {
+                static const locale_t locale = ::newlocale(LC_ALL_MASK, "C", nullptr);
+                return locale;
+            }
+            
+            __attribute__((noinline, cold))
+            void fail(char const* what, std::size_t offset) {
+                imread_assert(false,
+                              "objc::json: ", what, " (at byte ", offset, ")");
+                __builtin_unreachable();
+            }
+            
+            inline bool is_digit(uint8_t c) { return c >= '0' && c <= '9'; }
+            
+            /// whitespace and operators -- the only things that may follow a scalar:
+            inline bool is_terminator(uint8_t c) {
+                switch (c) {
+                    case ' ': case '\t': case '\n': case '\r':
+                    case '{': case '}': case '[': case ']':
+                    case ':': case ',':
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+            
+            /// One 64-byte block, as bitmasks: a bit per byte
+            struct masks_t {
+                uint64_t backslash  = 0;
+                uint64_t quote      = 0;
+                uint64_t op         = 0;        /// { } [ ] : ,
+                uint64_t space      = 0;
+                uint64_t high       = 0;        /// non-ASCII
+            };
+            
+            #if defined(__SSE2__)
+            
+            inline masks_t classify(uint8_t const* block) {
+                masks_t out;
+                const __m128i backslash = _mm_set1_epi8('\\');
+                const __m128i quote = _mm_set1_epi8('"');
+                const __m128i lower = _mm_set1_epi8(0x20);
+                const __m128i brace = _mm_set1_epi8('{');       /// '[' | 0x20 == '{'
+                const __m128i endbrace = _mm_set1_epi8('}');    /// ']' | 0x20 == '}'
+                const __m128i colon = _mm_set1_epi8(':');
+                const __m128i comma = _mm_set1_epi8(',');
+                const __m128i space = _mm_set1_epi8(' ');
+                const __m128i tab = _mm_set1_epi8('\t');
+                const __m128i newline = _mm_set1_epi8('\n');
+                const __m128i cr = _mm_set1_epi8('\r');
+                for (int k = 0; k < 4; ++k) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block + 16 * k));
+                    const __m128i folded = _mm_or_si128(v, lower);
+                    const int shift = 16 * k;
+                    out.backslash   |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+                    out.quote       |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+                    out.op          |= uint64_t(uint32_t(_mm_movemask_epi8(
+                                            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, brace),
+                                                                      _mm_cmpeq_epi8(folded, endbrace)),
+                                                         _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                                                                      _mm_cmpeq_epi8(v, comma)))))) << shift;
+                    out.space       |= uint64_t(uint32_t(_mm_movemask_epi8(
+                                            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                                                      _mm_cmpeq_epi8(v, tab)),
+                                                         _mm_or_si128(_mm_cmpeq_epi8(v, newline),
+                                                                      _mm_cmpeq_epi8(v, cr)))))) << shift;
+                    out.high        |= uint64_t(uint32_t(_mm_movemask_epi8(v))) << shift;
+                }
+                return out;
+            }
+            
+            #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            
+            /// NEON has no movemask: weight each lane's bit, and add pairwise, thrice
+            inline uint64_t movemask(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+                const uint8x16_t weights = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                             0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+                uint8x16_t sum0 = vpaddq_u8(vandq_u8(a, weights), vandq_u8(b, weights));
+                uint8x16_t sum1 = vpaddq_u8(vandq_u8(c, weights), vandq_u8(d, weights));
+                sum0 = vpaddq_u8(sum0, sum1);
+                sum0 = vpaddq_u8(sum0, sum0);
+                return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+            }
+            
+            inline masks_t classify(uint8_t const* block) {
+                masks_t out;
+                uint8x16_t v[4], backslash[4], quote[4], op[4], space[4], high[4];
+                for (int k = 0; k < 4; ++k) {
+                    v[k] = vld1q_u8(block + 16 * k);
+                    const uint8x16_t folded = vorrq_u8(v[k], vdupq_n_u8(0x20));
+                    backslash[k] = vceqq_u8(v[k], vdupq_n_u8('\\'));
+                    quote[k] = vceqq_u8(v[k], vdupq_n_u8('"'));
+                    op[k] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')),
+                                              vceqq_u8(folded, vdupq_n_u8('}'))),
+                                     vorrq_u8(vceqq_u8(v[k], vdupq_n_u8(':')),
+                                              vceqq_u8(v[k], vdupq_n_u8(','))));
+                    space[k] = vorrq_u8(vorrq_u8(vceqq_u8(v[k], vdupq_n_u8(' ')),
+                                                 vceqq_u8(v[k], vdupq_n_u8('\t'))),
+                                        vorrq_u8(vceqq_u8(v[k], vdupq_n_u8('\n')),
+                                                 vceqq_u8(v[k], vdupq_n_u8('\r'))));
+                    high[k] = vcgeq_u8(v[k], vdupq_n_u8(0x80));
+                }
+                out.backslash   = movemask(backslash[0], backslash[1], backslash[2], backslash[3]);
+                out.quote       = movemask(quote[0], quote[1], quote[2], quote[3]);
+                out.op          = movemask(op[0], op[1], op[2], op[3]);
+                out.space       = movemask(space[0], space[1], space[2], space[3]);
+                out.high        = movemask(high[0], high[1], high[2], high[3]);
+                return out;
+            }
+            
+            #else
+            
+            inline masks_t classify(uint8_t const* block) {
+                masks_t out;
+                for (int k = 0; k < 64; ++k) {
+                    const uint8_t c = block[k];
+                    const uint64_t bit = uint64_t(1) << k;
+                    if (c == '\\') { out.backslash |= bit; }
+                    if (c == '"') { out.quote |= bit; }
+                    if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') { out.op |= bit; }
+                    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') { out.space |= bit; }
+                    if (c >= 0x80) { out.high |= bit; }
+                }
+                return out;
+            }
+            
+            #endif
+            
+            /// Characters escaped by a backslash -- those ending odd-length runs of
+            /// backslashes -- carrying a run that ends one block over into the next:
+            inline uint64_t escaped_characters(uint64_t backslash, uint64_t& carry) {
+                const uint64_t even_bits = 0x5555555555555555ULL;
+                const uint64_t odd_bits = ~even_bits;
+                const uint64_t starts = backslash & ~(backslash << 1);
+                const uint64_t even_start_mask = even_bits ^ carry;
+                const uint64_t even_starts = starts & even_start_mask;
+                const uint64_t odd_starts = starts & ~even_start_mask;
+                const uint64_t even_carries = backslash + even_starts;
+                uint64_t odd_carries;
+                const bool ends_odd = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+                odd_carries |= carry;
+                carry = ends_odd ? 1 : 0;
+                const uint64_t even_carry_ends = even_carries & ~backslash;
+                const uint64_t odd_carry_ends = odd_carries & ~backslash;
+                return (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+            }
+            
+            /// Each bit the XOR of itself and every bit below it -- which, over the
+            /// quotes, sets every bit from an opening quote up to its closing one:
+            inline uint64_t prefix_xor(uint64_t bits) {
+                bits ^= bits << 1;
+                bits ^= bits << 2;
+                bits ^= bits << 4;
+                bits ^= bits << 8;
+                bits ^= bits << 16;
+                bits ^= bits << 32;
+                return bits;
+            }
+            
+            /// the offset of the first byte that isn't valid UTF-8, or `length`:
+            std::size_t invalid_utf8(uint8_t const* bytes, std::size_t length) {
+                std::size_t pos = 0;
+                while (pos < length) {
+                    if (pos + 8 <= length) {
+                        uint64_t chunk;
+                        std::memcpy(&chunk, bytes + pos, sizeof(chunk));
+                        if ((chunk & 0x8080808080808080ULL) == 0) { pos += 8; continue; }
+                    }
+                    const uint8_t lead = bytes[pos];
+                    if (lead < 0x80) { ++pos; continue; }
+                    std::size_t extra;
+                    uint32_t minimum, point;
+                    if ((lead & 0xE0) == 0xC0) {
+                        extra = 1; minimum = 0x80; point = lead & 0x1F;
+                    } else if ((lead & 0xF0) == 0xE0) {
+                        extra = 2; minimum = 0x800; point = lead & 0x0F;
+                    } else if ((lead & 0xF8) == 0xF0) {
+                        extra = 3; minimum = 0x10000; point = lead & 0x07;
+                    } else {
+                        return pos;
+                    }
+                    if (pos + extra >= length + 1) { return pos; }
+                    for (std::size_t k = 1; k <= extra; ++k) {
+                        if ((bytes[pos + k] & 0xC0) != 0x80) { return pos; }
+                        point = (point << 6) | (bytes[pos + k] & 0x3F);
+                    }
+                    if (point < minimum || point > 0x10FFFF ||
+                       (point >= 0xD800 && point <= 0xDFFF)) { return pos; }
+                    pos += extra + 1;
+                }
+                return length;
+            }
+            
+            /// exact powers of ten, for the fast path in parsing reals:
+            constexpr double powers[] = {
+                1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            
+        } /// namespace (anon.)
+        
+        /// Stage one indexes the structurals, stage two builds the tape from them
+        struct builder {
+            
+            struct frame {
+                std::size_t start;          /// tape index of the opening word
+                std::size_t count;
+                bool object;
+            };
+            
+            uint8_t const* buf;
+            std::size_t length;
+            std::unique_ptr<uint32_t[]> indexes;
+            std::size_t indexcount = 0;
+            std::size_t stringcount = 0;
+            
+            document& doc;
+            uint64_t* tape = nullptr;
+            char* strings = nullptr;
+            std::size_t used = 0;
+            std::vector<frame> stack;
+            
+            builder(uint8_t const* b, std::size_t l, document& d)
+                :buf(b), length(l), doc(d)
+                {}
+                
+            void push(uint64_t word) {
+                tape[doc.tapelength++] = word;
+            }
+            
+            void index_structurals() {
+                /// (with slack for the unrolled writes below)
+                indexes.reset(new uint32_t[length + 64]);
+                uint32_t* cursor = indexes.get();
+                uint64_t escapecarry = 0;
+                uint64_t insidecarry = 0;
+                uint64_t scalarcarry = 0;
+                uint64_t high = 0;
+                
+                for (std::size_t base = 0; base < length; base += 64) {
+                    const masks_t masks = classify(buf + base);
+                    const uint64_t quotes = masks.quote & ~escaped_characters(masks.backslash, escapecarry);
+                    const uint64_t inside = prefix_xor(quotes) ^ insidecarry;
+                    insidecarry = uint64_t(int64_t(inside) >> 63);
+                    
+                    /// scalars start wherever something neither space nor operator
+                    /// (nor in a string, nor a quote) follows something that is:
+                    const uint64_t scalar = ~(masks.op | masks.space | quotes | inside);
+                    const uint64_t scalarstarts = scalar & ~((scalar << 1) | scalarcarry);
+                    scalarcarry = scalar >> 63;
+                    
+                    const uint64_t openquotes = quotes & inside;
+                    uint64_t structurals = (masks.op & ~inside) | openquotes | scalarstarts;
+                    stringcount += std::size_t(__builtin_popcountll(openquotes));
+                    high |= masks.high;
+                    
+                    /// eight at a time, past the end if need be, then back up --
+                    /// one hard-to-predict branch per eight structurals, not per one:
+                    uint32_t* const next = cursor + __builtin_popcountll(structurals);
+                    while (structurals) {
+                        for (int k = 0; k < 8; ++k) {
+                            cursor[k] = uint32_t(base + std::size_t(__builtin_ctzll(structurals | (uint64_t(1) << 63))));
+                            structurals &= structurals - 1;
+                        }
+                        cursor += 8;
+                    }
+                    cursor = next;
+                }
+                
+                indexcount = std::size_t(cursor - indexes.get());
+                if (insidecarry) { fail("unclosed string", length); }
+                if (high) {
+                    const std::size_t invalid = invalid_utf8(buf, length);
+                    if (invalid != length) { fail("invalid UTF-8", invalid); }
+                }
+            }
+            
+            void build_tape() {
+                if (indexcount == 0) { fail("empty document", length); }
+                
+                /// every structural makes at most two tape words,
+                /// and every string at most five more bytes than its text:
+                doc.tape.reset(new uint64_t[indexcount * 2]);
+                tape = doc.tape.get();
+                doc.strings.reset(new char[length + 5 * stringcount + padding]);
+                strings = doc.strings.get();
+                
+                std::size_t pos = 0;
+                parse_value(pos);
+                
+                while (!stack.empty()) {
+                    if (pos >= indexcount) { fail("unexpected end of document", length); }
+                    frame& top = stack.back();
+                    uint8_t c = buf[indexes[pos]];
+                    const char closer = top.object ? '}' : ']';
+                    
+                    if (c == closer) {
+                        close_container();
+                        ++pos;
+                        continue;
+                    }
+                    if (top.count > 0) {
+                        if (c != ',') { fail(top.object ? "expected ',' or '}'" : "expected ',' or ']'", indexes[pos]); }
+                        if (++pos >= indexcount) { fail("unexpected end of document", length); }
+                        c = buf[indexes[pos]];
+                    }
+                    ++top.count;
+                    
+                    if (top.object) {
+                        if (c != '"') { fail("expected a string key", indexes[pos]); }
+                        parse_string(indexes[pos]);
+                        if (++pos >= indexcount || buf[indexes[pos]] != ':') {
+                            fail("expected ':'", pos < indexcount ? indexes[pos] : length);
+                        }
+                        if (++pos >= indexcount) { fail("unexpected end of document", length); }
+                    }
+                    parse_value(pos);
+                }
+                
+                if (pos != indexcount) { fail("unexpected content after the document", indexes[pos]); }
+            }
+            
+            void parse_value(std::size_t& pos) {
+                const std::size_t offset = indexes[pos++];
+                uint8_t const* p = buf + offset;
+                switch (*p) {
+                    case '{':
+                    case '[':
+                        if (stack.size() >= max_depth) { fail("nested too deeply", offset); }
+                        stack.push_back(frame{ doc.tapelength, 0, *p == '{' });
+                        push(0);
+                        return;
+                    case '"':
+                        parse_string(offset);
+                        return;
+                    case 't':
+                        if (std::memcmp(p, "true", 4) != 0 || !is_terminator(p[4])) { fail("expected 'true'", offset); }
+                        push(tape_word(tag::truth, 0));
+                        return;
+                    case 'f':
+                        if (std::memcmp(p, "false", 5) != 0 || !is_terminator(p[5])) { fail("expected 'false'", offset); }
+                        push(tape_word(tag::falsity, 0));
+                        return;
+                    case 'n':
+                        if (std::memcmp(p, "null", 4) != 0 || !is_terminator(p[4])) { fail("expected 'null'", offset); }
+                        push(tape_word(tag::null, 0));
+                        return;
+                    case '-':
+                    case '0': case '1': case '2': case '3': case '4':
+                    case '5': case '6': case '7': case '8': case '9':
+                        parse_number(offset);
+                        return;
+                    default:
+                        fail("unexpected character", offset);
+                }
+            }
+            
+            void close_container() {
+                const frame top = stack.back();
+                stack.pop_back();
+                const std::size_t end = doc.tapelength;
+                const tag opener = top.object ? tag::object : tag::array;
+                const tag closer = top.object ? tag::object_end : tag::array_end;
+                tape[top.start] = tape_word(opener, (std::min<uint64_t>(top.count, count_max) << 32) | end);
+                push(tape_word(closer, top.start));
+            }
+            
+            void parse_string(std::size_t offset) {
+                uint8_t const* src = buf + offset + 1;
+                char* const base = strings + used;
+                char* dst = base + sizeof(uint32_t);
+                
+                for (;;) {
+                    #if defined(__SSE2__)
+                    /// copy sixteen bytes at a time, up to the first that needs a look:
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+                    const __m128i special = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                        _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)));
+                    const int mask = _mm_movemask_epi8(special);
+                    if (mask == 0) {
+                        src += 16;
+                        dst += 16;
+                        continue;
+                    }
+                    const int skip = __builtin_ctz(unsigned(mask));
+                    src += skip;
+                    dst += skip;
+                    #else
+                    if (*src != '"' && *src != '\\' && *src >= 0x20) {
+                        *dst++ = char(*src++);
+                        continue;
+                    }
+                    #endif
+                    
+                    const uint8_t c = *src;
+                    if (c == '"') { break; }
+                    if (c < 0x20) { fail("unescaped control character in string", std::size_t(src - buf)); }
+                    
+                    /// a backslash:
+                    switch (src[1]) {
+                        case '"':  *dst++ = '"';  src += 2; break;
+                        case '\\': *dst++ = '\\'; src += 2; break;
+                        case '/':  *dst++ = '/';  src += 2; break;
+                        case 'b':  *dst++ = '\b'; src += 2; break;
+                        case 'f':  *dst++ = '\f'; src += 2; break;
+                        case 'n':  *dst++ = '\n'; src += 2; break;
+                        case 'r':  *dst++ = '\r'; src += 2; break;
+                        case 't':  *dst++ = '\t'; src += 2; break;
+                        case 'u':  dst = parse_unicode_escape(src, dst); break;
+                        default:
+                            fail("bad escape in string", std::size_t(src - buf));
+                    }
+                }
+                
+                const uint32_t size = uint32_t(dst - (base + sizeof(uint32_t)));
+                std::memcpy(base, &size, sizeof(uint32_t));
+                *dst++ = '\0';
+                push(tape_word(tag::string, used));
+                used = std::size_t(dst - strings);
+            }
+            
+            uint32_t parse_hex4(uint8_t const* hex) {
+                uint32_t out = 0;
+                for (int k = 0; k < 4; ++k) {
+                    const uint8_t c = hex[k];
+                    uint32_t digit;
+                    if (c >= '0' && c <= '9')       { digit = c - '0'; }
+                    else if (c >= 'a' && c <= 'f')  { digit = c - 'a' + 10; }
+                    else if (c >= 'A' && c <= 'F')  { digit = c - 'A' + 10; }
+                    else { fail("bad \\u escape in string", std::size_t(hex - buf)); }
+                    out = (out << 4) | digit;
+                }
+                return out;
+            }
+            
+            /// decodes "\uXXXX" (or a surrogate pair of them) at `src`, as UTF-8:
+            char* parse_unicode_escape(uint8_t const*& src, char* dst) {
+                uint32_t point = parse_hex4(src + 2);
+                src += 6;
+                if (point >= 0xD800 && point <= 0xDBFF) {
+                    if (src[0] != '\\' || src[1] != 'u') { fail("unpaired surrogate in string", std::size_t(src - buf)); }
+                    const uint32_t low = parse_hex4(src + 2);
+                    if (low < 0xDC00 || low > 0xDFFF) { fail("unpaired surrogate in string", std::size_t(src - buf)); }
+                    point = 0x10000 + ((point - 0xD800) << 10) + (low - 0xDC00);
+                    src += 6;
+                } else if (point >= 0xDC00 && point <= 0xDFFF) {
+                    fail("unpaired surrogate in string", std::size_t(src - buf));
+                }
+                if (point < 0x80) {
+                    *dst++ = char(point);
+                } else if (point < 0x800) {
+                    *dst++ = char(0xC0 | (point >> 6));
+                    *dst++ = char(0x80 | (point & 0x3F));
+                } else if (point < 0x10000) {
+                    *dst++ = char(0xE0 | (point >> 12));
+                    *dst++ = char(0x80 | ((point >> 6) & 0x3F));
+                    *dst++ = char(0x80 | (point & 0x3F));
+                } else {
+                    *dst++ = char(0xF0 | (point >> 18));
+                    *dst++ = char(0x80 | ((point >> 12) & 0x3F));
+                    *dst++ = char(0x80 | ((point >> 6) & 0x3F));
+                    *dst++ = char(0x80 | (point & 0x3F));
+                }
+                return dst;
+            }
+            
+            void parse_number(std::size_t offset) {
+                uint8_t const* const start = buf + offset;
+                uint8_t const* p = start;
+                const bool negative = (*p == '-');
+                if (negative) { ++p; }
+                if (!is_digit(*p)) { fail("bad number", offset); }
+                
+                uint64_t mantissa = 0;
+                int digits = 0;                 /// significant ones, that is
+                int64_t exponent = 0;
+                bool real = false;
+                
+                if (*p == '0') {
+                    ++p;
+                    if (is_digit(*p)) { fail("leading zero in number", offset); }
+                } else {
+                    while (is_digit(*p)) {
+                        mantissa = mantissa * 10 + (*p++ - '0');
+                        ++digits;
+                    }
+                }
+                if (*p == '.') {
+                    real = true;
+                    ++p;
+                    if (!is_digit(*p)) { fail("bad fraction in number", offset); }
+                    while (is_digit(*p)) {
+                        const uint8_t digit = *p++ - '0';
+                        if (mantissa != 0 || digit != 0) { ++digits; }
+                        mantissa = mantissa * 10 + digit;
+                        --exponent;
+                    }
+                }
+                if (*p == 'e' || *p == 'E') {
+                    real = true;
+                    ++p;
+                    bool negexp = false;
+                    if (*p == '+' || *p == '-') { negexp = (*p++ == '-'); }
+                    if (!is_digit(*p)) { fail("bad exponent in number", offset); }
+                    int64_t given = 0;
+                    while (is_digit(*p)) {
+                        if (given < 100000) { given = given * 10 + (*p - '0'); }
+                        ++p;
+                    }
+                    exponent += negexp ? -given : given;
+                }
+                if (!is_terminator(*p)) { fail("bad number", offset); }
+                
+                if (!real && digits <= 19) {
+                    /// nineteen digits always fit in a uint64_t -- but maybe not an int64_t:
+                    const uint64_t limit = uint64_t(INT64_MAX) + (negative ? 1 : 0);
+                    if (mantissa <= limit) {
+                        const int64_t integer = negative ? int64_t(0 - mantissa) : int64_t(mantissa);
+                        push(tape_word(tag::integer, 0));
+                        push(uint64_t(integer));
+                        return;
+                    }
+                }
+                
+                double number;
+                if (digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+                    /// both exactly representable, so one rounding -- as strtod() would do:
+                    number = double(mantissa);
+                    number = exponent < 0 ? number / powers[-exponent] : number * powers[exponent];
+                    if (negative) { number = -number; }
+                } else {
+                    number = ::strtod_l(reinterpret_cast<char const*>(start), nullptr, c_locale());
+                    if (std::isinf(number)) { fail("number out of range", offset); }
+                }
+                uint64_t bits;
+                std::memcpy(&bits, &number, sizeof(bits));
+                push(tape_word(tag::real, 0));
+                push(bits);
+            }
+            
+        };
+        
+        document document::parse(std::string_view json) {
+            /// a padded copy: so the last block, and the reads past
+            /// the ends of strings and numbers, stay in bounds
+            std::unique_ptr<uint8_t[]> padded(new uint8_t[json.size() + padding]);
+            std::memcpy(padded.get(), json.data(), json.size());
+            std::memset(padded.get() + json.size(), ' ', padding);
+            
+            document out;
+            builder build(padded.get(), json.size(), out);
+            build.index_structurals();
+            build.build_tape();
+            return out;
+        }
+        
+        void value::expect(tag expected, char const* what) const {
+            imread_assert(doc != nullptr && type() == expected,
+                          "objc::json: value is not ", what);
+        }
+        
+        std::string_view value::as_string() const {
+            expect(tag::string, "a string");
+            return doc->string_at(idx);
+        }
+        
+        int64_t value::as_integer() const {
+            expect(tag::integer, "an integer");
+            return int64_t(doc->tape[idx + 1]);
+        }
+        
+        double value::as_double() const {
+            if (doc && type() == tag::integer) { return double(int64_t(doc->tape[idx + 1])); }
+            expect(tag::real, "a number");
+            double out;
+            std::memcpy(&out, &doc->tape[idx + 1], sizeof(out));
+            return out;
+        }
+        
+        bool value::as_bool() const {
+            imread_assert(doc != nullptr && is_bool(),
+                          "objc::json: value is not a boolean");
+            return type() == tag::truth;
+        }
+        
+        std::size_t value::size() const {
+            imread_assert(doc != nullptr && (is_object() || is_array()),
+                          "objc::json: value is neither object nor array");
+            const std::size_t count = std::size_t((payload() >> 32) & count_max);
+            if (count < count_max) { return count; }
+            return is_object() ? std::distance(members().begin(), members().end())
+                               : std::distance(elements().begin(), elements().end());
+        }
+        
+        value::range_t<value::iterator> value::elements() const {
+            expect(tag::array, "an array");
+            return { iterator(doc, idx + 1), iterator(doc, closing()) };
+        }
+        
+        value::range_t<value::member_iterator> value::members() const {
+            expect(tag::object, "an object");
+            return { member_iterator(doc, idx + 1), member_iterator(doc, closing()) };
+        }
+        
+        value value::find(std::string_view key) const {
+            for (member const& m : members()) {
+                if (m.key == key) { return m.val; }
+            }
+            return value();
+        }
+        
+        value value::operator[](std::string_view key) const {
+            value out = find(key);
+            imread_assert(bool(out),
+                          "objc::json: no such key: ", std::string(key));
+            return out;
+        }
+        
+        value value::operator[](std::size_t position) const {
+            std::size_t count = 0;
+            for (value element : elements()) {
+                if (count++ == position) { return element; }
+            }
+            imread_assert(false,
+                          "objc::json: index out of range: ", position);
+            __builtin_unreachable();
+        }
+        
+        namespace {
+            
+            void append_quoted(std::string& out, std::string_view string) {
+                static const char hex[] = "0123456789abcdef";
+                out += '"';
+                for (char c : string) {
+                    switch (c) {
+                        case '"':  out += "\\\""; break;
+                        case '\\': out += "\\\\"; break;
+                        case '\n': out += "\\n";  break;
+                        case '\r': out += "\\r";  break;
+                        case '\t': out += "\\t";  break;
+                        default:
+                            if (uint8_t(c) < 0x20) {
+                                out += "\\u00";
+                                out += hex[uint8_t(c) >> 4];
+                                out += hex[uint8_t(c) & 0xF];
+                            } else {
+                                out += c;
+                            }
+                    }
+                }
+                out += '"';
+            }
+            
+        } /// namespace (anon.)
+        
+        std::string value::minified() const {
+            /// one walk down the tape, keeping count of what's
+            /// in each open container, for the commas:
+            std::string out;
+            std::vector<bool> objects;
+            std::vector<std::size_t> counts;
+            const std::size_t last = after();
+            std::size_t cursor = idx;
+            bool keyed = false;
+            while (cursor < last) {
+                const value current(doc, cursor);
+                const tag type = current.type();
+                if (type == tag::object_end || type == tag::array_end) {
+                    out += char(type);
+                    objects.pop_back();
+                    counts.pop_back();
+                    ++cursor;
+                    continue;
+                }
+                if (!objects.empty() && !keyed) {
+                    if (counts.back()++ > 0) { out += ','; }
+                    if (objects.back()) {
+                        append_quoted(out, doc->string_at(cursor));
+                        out += ':';
+                        keyed = true;
+                        ++cursor;
+                        continue;
+                    }
+                }
+                keyed = false;
+                switch (type) {
+                    case tag::object:
+                    case tag::array:
+                        out += char(type);
+                        objects.push_back(type == tag::object);
+                        counts.push_back(0);
+                        break;
+                    case tag::string:
+                        append_quoted(out, current.as_string());
+                        break;
+                    case tag::integer:
+                        out += std::to_string(current.as_integer());
+                        break;
+                    case tag::real: {
+                        /// the shortest of %.15g and %.17g that reads back the same,
+                        /// with a ".0" on whole numbers so reals stay reals:
+                        char buffer[40];
+                        const double number = current.as_double();
+                        ::snprintf_l(buffer, sizeof(buffer), c_locale(), "%.15g", number);
+                        if (::strtod_l(buffer, nullptr, c_locale()) != number) {
+                            ::snprintf_l(buffer, sizeof(buffer), c_locale(), "%.17g", number);
+                        }
+                        out += buffer;
+                        if (!std::strpbrk(buffer, ".eE")) { out += ".0"; }
+                        break;
+                    }
+                    case tag::truth:
+                        out += "true";
+                        break;
+                    case tag::falsity:
+                        out += "false";
+                        break;
+                    case tag::null:
+                        out += "null";
+                        break;
+                    default:
+                        break;
+                }
+                cursor = (type == tag::object || type == tag::array) ? cursor + 1 : current.after();
+            }
+            return out;
+        }
+        
+        im::Options value::options() const {
+            expect(tag::object, "an object");
+            return im::Options::parse(minified());
+        }
+        
+    } /// namespace json
+    
+} /// namespace objc
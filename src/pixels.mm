@@ -0,0 +1,634 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cstring>
+#include <algorithm>
+
+#include <subjective-c/pixels.hh>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBJC_PIXELS_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OBJC_PIXELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace objc {
+    
+    namespace pixels {
+        
+        namespace {
+            
+            /// Scalar sample access -- memcpy() keeps oddly-strided loads legal,
+            /// and compiles down to a plain move:
+            template <typename T> inline
+            T load(byte const* p) noexcept {
+                T out;
+                std::memcpy(&out, p, sizeof(T));
+                return out;
+            }
+            
+            template <typename T> inline
+            void store(byte* p, T value) noexcept {
+                std::memcpy(p, &value, sizeof(T));
+            }
+            
+            /// Scalar alpha arithmetic: the integer versions are correctly rounded,
+            /// and the vector kernels below reproduce them bit-for-bit:
+            inline uint8_t premultiply(uint8_t c, uint8_t a) noexcept {
+                uint32_t t = uint32_t(c) * a + 128;
+                return uint8_t((t + (t >> 8)) >> 8);
+            }
+            
+            inline uint16_t premultiply(uint16_t c, uint16_t a) noexcept {
+                uint32_t t = uint32_t(c) * a + 32768;
+                return uint16_t((t + (t >> 16)) >> 16);
+            }
+            
+            inline float premultiply(float c, float a) noexcept {
+                return c * a;
+            }
+            
+            inline uint8_t unpremultiply(uint8_t c, uint8_t a) noexcept {
+                if (!a) { return 0; }
+                return uint8_t(std::min<uint32_t>(255, (uint32_t(c) * 255 + (a >> 1)) / a));
+            }
+            
+            inline uint16_t unpremultiply(uint16_t c, uint16_t a) noexcept {
+                if (!a) { return 0; }
+                return uint16_t(std::min<uint64_t>(65535, (uint64_t(c) * 65535 + (a >> 1)) / a));
+            }
+            
+            inline float unpremultiply(float c, float a) noexcept {
+                return a == 0.0f ? 0.0f : c / a;
+            }
+            
+            /// One row's worth of channel pointers:
+            struct row_t {
+                std::array<byte*, max_channels> at;
+                std::array<std::ptrdiff_t, max_channels> step;
+                
+                row_t(layout const& l, std::size_t y) noexcept {
+                    for (std::size_t c = 0; c < l.count; ++c) {
+                        at[c] = l.channels[c].origin + std::ptrdiff_t(y) * l.channels[c].ystride;
+                        step[c] = l.channels[c].xstride;
+                    }
+                }
+            };
+            
+            template <typename T>
+            void copy_scalar(row_t const& src, row_t const& dst,
+                             std::size_t count, std::size_t x0, std::size_t width) noexcept {
+                for (std::size_t c = 0; c < count; ++c) {
+                    byte const* s = src.at[c] + std::ptrdiff_t(x0) * src.step[c];
+                    byte* d = dst.at[c] + std::ptrdiff_t(x0) * dst.step[c];
+                    for (std::size_t x = x0; x < width; ++x, s += src.step[c], d += dst.step[c]) {
+                        store<T>(d, load<T>(s));
+                    }
+                }
+            }
+            
+            template <typename T>
+            void alpha_scalar(row_t const& row, std::size_t count,
+                              std::size_t x0, std::size_t width, bool premultiplying) noexcept {
+                std::size_t const ac = count - 1;
+                for (std::size_t x = x0; x < width; ++x) {
+                    T a = load<T>(row.at[ac] + std::ptrdiff_t(x) * row.step[ac]);
+                    for (std::size_t c = 0; c < ac; ++c) {
+                        byte* p = row.at[c] + std::ptrdiff_t(x) * row.step[c];
+                        store<T>(p, premultiplying ? premultiply(load<T>(p), a)
+                                                   : unpremultiply(load<T>(p), a));
+                    }
+                }
+            }
+            
+            /// Vector kernels: each one handles as many whole vectors' worth
+            /// of pixels as it can, and returns how many pixels that was --
+            /// the scalar loops above pick up the remainder.
+            
+#if defined(OBJC_PIXELS_X86)
+            
+            struct cpu_t {
+                bool ssse3 = false;
+                bool avx2 = false;
+                
+                cpu_t() noexcept {
+                    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+                    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return; }
+                    ssse3 = ecx & bit_SSSE3;
+                    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) { return; }
+                    uint32_t xcr0lo = 0, xcr0hi = 0;
+                    __asm__ volatile("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+                    if ((xcr0lo & 0x6) != 0x6) { return; }      /// OS saves YMM state?
+                    if (__get_cpuid_max(0, nullptr) < 7) { return; }
+                    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                    avx2 = ebx & bit_AVX2;
+                }
+            };
+            
+            cpu_t const& cpu() noexcept {
+                static const cpu_t features;
+                return features;
+            }
+            
+            /// pshufb masks for 3-channel (de)interleaving, 16 pixels at a time:
+            struct shuffles3_t {
+                alignas(16) int8_t interleave[3][3][16];        /// [output vector][channel][byte]
+                alignas(16) int8_t deinterleave[3][3][16];      /// [channel][input vector][byte]
+            };
+            
+            constexpr shuffles3_t make_shuffles3() {
+                shuffles3_t out{};
+                for (int v = 0; v < 3; ++v) {
+                    for (int k = 0; k < 3; ++k) {
+                        for (int j = 0; j < 16; ++j) {
+                            int J = 16 * v + j;
+                            out.interleave[v][k][j] = J % 3 == k ? int8_t(J / 3) : int8_t(-128);
+                            int P = 3 * j + v;
+                            out.deinterleave[v][k][j] = P / 16 == k ? int8_t(P % 16) : int8_t(-128);
+                        }
+                    }
+                }
+                return out;
+            }
+            
+            constexpr shuffles3_t shuffles3 = make_shuffles3();
+            
+            inline __m128i loadu(byte const* p) noexcept {
+                return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+            }
+            
+            inline void storeu(byte* p, __m128i v) noexcept {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+            }
+            
+            inline __m128i aligned(int8_t const* p) noexcept {
+                return _mm_load_si128(reinterpret_cast<__m128i const*>(p));
+            }
+            
+            std::size_t interleave4_sse2(byte* const* s, byte* d, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    __m128i r = loadu(s[0] + x), g = loadu(s[1] + x);
+                    __m128i b = loadu(s[2] + x), a = loadu(s[3] + x);
+                    __m128i rglo = _mm_unpacklo_epi8(r, g), rghi = _mm_unpackhi_epi8(r, g);
+                    __m128i balo = _mm_unpacklo_epi8(b, a), bahi = _mm_unpackhi_epi8(b, a);
+                    byte* out = d + 4 * x;
+                    storeu(out,      _mm_unpacklo_epi16(rglo, balo));
+                    storeu(out + 16, _mm_unpackhi_epi16(rglo, balo));
+                    storeu(out + 32, _mm_unpacklo_epi16(rghi, bahi));
+                    storeu(out + 48, _mm_unpackhi_epi16(rghi, bahi));
+                }
+                return x;
+            }
+            
+            std::size_t deinterleave4_sse2(byte const* s, byte* const* d, std::size_t width) noexcept {
+                __m128i const mask = _mm_set1_epi32(0xFF);
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    byte const* in = s + 4 * x;
+                    __m128i v0 = loadu(in),      v1 = loadu(in + 16);
+                    __m128i v2 = loadu(in + 32), v3 = loadu(in + 48);
+                    for (int k = 0; k < 4; ++k) {
+                        __m128i shift = _mm_cvtsi32_si128(8 * k);
+                        __m128i c0 = _mm_and_si128(_mm_srl_epi32(v0, shift), mask);
+                        __m128i c1 = _mm_and_si128(_mm_srl_epi32(v1, shift), mask);
+                        __m128i c2 = _mm_and_si128(_mm_srl_epi32(v2, shift), mask);
+                        __m128i c3 = _mm_and_si128(_mm_srl_epi32(v3, shift), mask);
+                        storeu(d[k] + x, _mm_packus_epi16(_mm_packs_epi32(c0, c1),
+                                                          _mm_packs_epi32(c2, c3)));
+                    }
+                }
+                return x;
+            }
+            
+            __attribute__((target("ssse3")))
+            std::size_t interleave3_ssse3(byte* const* s, byte* d, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    __m128i const in[3] = { loadu(s[0] + x), loadu(s[1] + x), loadu(s[2] + x) };
+                    for (int v = 0; v < 3; ++v) {
+                        auto const& mask = shuffles3.interleave[v];
+                        storeu(d + 3 * x + 16 * v,
+                               _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in[0], aligned(mask[0])),
+                                                         _mm_shuffle_epi8(in[1], aligned(mask[1]))),
+                                                         _mm_shuffle_epi8(in[2], aligned(mask[2]))));
+                    }
+                }
+                return x;
+            }
+            
+            __attribute__((target("ssse3")))
+            std::size_t deinterleave3_ssse3(byte const* s, byte* const* d, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    byte const* p = s + 3 * x;
+                    __m128i const in[3] = { loadu(p), loadu(p + 16), loadu(p + 32) };
+                    for (int k = 0; k < 3; ++k) {
+                        auto const& mask = shuffles3.deinterleave[k];
+                        storeu(d[k] + x,
+                               _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in[0], aligned(mask[0])),
+                                                         _mm_shuffle_epi8(in[1], aligned(mask[1]))),
+                                                         _mm_shuffle_epi8(in[2], aligned(mask[2]))));
+                    }
+                }
+                return x;
+            }
+            
+            /// (t + 128 + ((t + 128) >> 8)) >> 8, for eight 16-bit products t:
+            inline __m128i div255_epu16(__m128i t) noexcept {
+                t = _mm_add_epi16(t, _mm_set1_epi16(128));
+                return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+            }
+            
+            /// Multiply two RGBA pixels (as 16-bit lanes) by their own alpha,
+            /// using 255 as the multiplier for the alpha lanes themselves:
+            inline __m128i premultiply_rgba16(__m128i px) noexcept {
+                __m128i const alphalanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, 0xFF), 0xFF);
+                __m128i m = _mm_or_si128(_mm_andnot_si128(alphalanes, a),
+                                         _mm_and_si128(alphalanes, _mm_set1_epi16(255)));
+                return div255_epu16(_mm_mullo_epi16(px, m));
+            }
+            
+            std::size_t premultiply_rgba_sse2(byte* p, std::size_t width) noexcept {
+                __m128i const zero = _mm_setzero_si128();
+                std::size_t x = 0;
+                for (; x + 4 <= width; x += 4) {
+                    __m128i px = loadu(p + 4 * x);
+                    storeu(p + 4 * x, _mm_packus_epi16(premultiply_rgba16(_mm_unpacklo_epi8(px, zero)),
+                                                       premultiply_rgba16(_mm_unpackhi_epi8(px, zero))));
+                }
+                return x;
+            }
+            
+            /// (no lambdas in here -- they wouldn't inherit the target attribute)
+            __attribute__((target("avx2")))
+            inline __m256i premultiply_rgba16_avx2(__m256i px) noexcept {
+                __m256i const alphalanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0,
+                                                            -1, 0, 0, 0, -1, 0, 0, 0);
+                __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, 0xFF), 0xFF);
+                __m256i m = _mm256_or_si256(_mm256_andnot_si256(alphalanes, a),
+                                            _mm256_and_si256(alphalanes, _mm256_set1_epi16(255)));
+                __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px, m), _mm256_set1_epi16(128));
+                return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+            }
+            
+            __attribute__((target("avx2")))
+            std::size_t premultiply_rgba_avx2(byte* p, std::size_t width) noexcept {
+                __m256i const zero = _mm256_setzero_si256();
+                std::size_t x = 0;
+                for (; x + 8 <= width; x += 8) {
+                    __m256i* at = reinterpret_cast<__m256i*>(p + 4 * x);
+                    __m256i px = _mm256_loadu_si256(at);
+                    /// unpack and pack both work within 128-bit lanes, so pixel order survives:
+                    _mm256_storeu_si256(at, _mm256_packus_epi16(premultiply_rgba16_avx2(_mm256_unpacklo_epi8(px, zero)),
+                                                                premultiply_rgba16_avx2(_mm256_unpackhi_epi8(px, zero))));
+                }
+                return x;
+            }
+            
+            std::size_t premultiply_planar_sse2(byte* c, byte const* a, std::size_t width) noexcept {
+                __m128i const zero = _mm_setzero_si128();
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    __m128i cv = loadu(c + x), av = loadu(a + x);
+                    __m128i lo = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(cv, zero),
+                                                              _mm_unpacklo_epi8(av, zero)));
+                    __m128i hi = div255_epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(cv, zero),
+                                                              _mm_unpackhi_epi8(av, zero)));
+                    storeu(c + x, _mm_packus_epi16(lo, hi));
+                }
+                return x;
+            }
+            
+            /// (c * 255 + a / 2) / a, for four 32-bit lanes, via float division --
+            /// which is exact here: numerators stay below 2^24, and a correctly-rounded
+            /// quotient can't cross an integer when the divisor is at most 255.
+            /// Lanes where a == 0 come out as INT_MIN, which the saturating packs
+            /// used by the callers turn into zero:
+            inline __m128i unpremultiply_epi32(__m128i c, __m128i a) noexcept {
+                __m128 num = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(255.0f)),
+                                        _mm_cvtepi32_ps(_mm_srli_epi32(a, 1)));
+                return _mm_cvttps_epi32(_mm_div_ps(num, _mm_cvtepi32_ps(a)));
+            }
+            
+            std::size_t unpremultiply_rgba_sse2(byte* p, std::size_t width) noexcept {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const alphalane = _mm_set_epi32(-1, 0, 0, 0);
+                auto pixel = [&](__m128i px) {
+                    __m128i q = unpremultiply_epi32(px, _mm_shuffle_epi32(px, 0xFF));
+                    return _mm_or_si128(_mm_andnot_si128(alphalane, q), _mm_and_si128(alphalane, px));
+                };
+                std::size_t x = 0;
+                for (; x + 4 <= width; x += 4) {
+                    __m128i px = loadu(p + 4 * x);
+                    __m128i lo = _mm_unpacklo_epi8(px, zero), hi = _mm_unpackhi_epi8(px, zero);
+                    __m128i p0 = pixel(_mm_unpacklo_epi16(lo, zero)), p1 = pixel(_mm_unpackhi_epi16(lo, zero));
+                    __m128i p2 = pixel(_mm_unpacklo_epi16(hi, zero)), p3 = pixel(_mm_unpackhi_epi16(hi, zero));
+                    storeu(p + 4 * x, _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+                }
+                return x;
+            }
+            
+            std::size_t unpremultiply_planar_sse2(byte* c, byte const* a, std::size_t width) noexcept {
+                __m128i const zero = _mm_setzero_si128();
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    __m128i cv = loadu(c + x), av = loadu(a + x);
+                    __m128i clo = _mm_unpacklo_epi8(cv, zero), chi = _mm_unpackhi_epi8(cv, zero);
+                    __m128i alo = _mm_unpacklo_epi8(av, zero), ahi = _mm_unpackhi_epi8(av, zero);
+                    __m128i q0 = unpremultiply_epi32(_mm_unpacklo_epi16(clo, zero), _mm_unpacklo_epi16(alo, zero));
+                    __m128i q1 = unpremultiply_epi32(_mm_unpackhi_epi16(clo, zero), _mm_unpackhi_epi16(alo, zero));
+                    __m128i q2 = unpremultiply_epi32(_mm_unpacklo_epi16(chi, zero), _mm_unpacklo_epi16(ahi, zero));
+                    __m128i q3 = unpremultiply_epi32(_mm_unpackhi_epi16(chi, zero), _mm_unpackhi_epi16(ahi, zero));
+                    storeu(c + x, _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3)));
+                }
+                return x;
+            }
+            
+            std::size_t interleave(byte* const* s, byte* d, std::size_t count, std::size_t width) noexcept {
+                if (count == 4)                     { return interleave4_sse2(s, d, width); }
+                if (count == 3 && cpu().ssse3)      { return interleave3_ssse3(s, d, width); }
+                return 0;
+            }
+            
+            std::size_t deinterleave(byte const* s, byte* const* d, std::size_t count, std::size_t width) noexcept {
+                if (count == 4)                     { return deinterleave4_sse2(s, d, width); }
+                if (count == 3 && cpu().ssse3)      { return deinterleave3_ssse3(s, d, width); }
+                return 0;
+            }
+            
+            std::size_t premultiply_rgba(byte* p, std::size_t width) noexcept {
+                std::size_t x = cpu().avx2 ? premultiply_rgba_avx2(p, width) : 0;
+                return x + premultiply_rgba_sse2(p + 4 * x, width - x);
+            }
+            
+            std::size_t unpremultiply_rgba(byte* p, std::size_t width) noexcept {
+                return unpremultiply_rgba_sse2(p, width);
+            }
+            
+            std::size_t premultiply_planar(byte* c, byte const* a, std::size_t width) noexcept {
+                return premultiply_planar_sse2(c, a, width);
+            }
+            
+            std::size_t unpremultiply_planar(byte* c, byte const* a, std::size_t width) noexcept {
+                return unpremultiply_planar_sse2(c, a, width);
+            }
+            
+#elif defined(OBJC_PIXELS_NEON)
+            
+            /// vraddhn(t, vrshr(t, 8)) == (t + 128 + ((t + 128) >> 8)) >> 8:
+            inline uint8x16_t premultiply16(uint8x16_t c, uint8x16_t a) noexcept {
+                uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+                uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+                return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                                   vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+            }
+            
+#if defined(__aarch64__)
+            /// Same float-division approach as the SSE2 version (q.v. comment sub.),
+            /// although here a == 0 lanes saturate high and have to be masked off:
+            inline uint16x4_t unpremultiply4(uint16x4_t c, uint16x4_t a) noexcept {
+                uint32x4_t c32 = vmovl_u16(c), a32 = vmovl_u16(a);
+                float32x4_t num = vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(c32), 255.0f),
+                                            vcvtq_f32_u32(vshrq_n_u32(a32, 1)));
+                return vqmovn_u32(vcvtq_u32_f32(vdivq_f32(num, vcvtq_f32_u32(a32))));
+            }
+            
+            inline uint8x16_t unpremultiply16(uint8x16_t c, uint8x16_t a) noexcept {
+                uint16x8_t clo = vmovl_u8(vget_low_u8(c)), chi = vmovl_u8(vget_high_u8(c));
+                uint16x8_t alo = vmovl_u8(vget_low_u8(a)), ahi = vmovl_u8(vget_high_u8(a));
+                uint16x8_t lo = vcombine_u16(unpremultiply4(vget_low_u16(clo), vget_low_u16(alo)),
+                                             unpremultiply4(vget_high_u16(clo), vget_high_u16(alo)));
+                uint16x8_t hi = vcombine_u16(unpremultiply4(vget_low_u16(chi), vget_low_u16(ahi)),
+                                             unpremultiply4(vget_high_u16(chi), vget_high_u16(ahi)));
+                return vbicq_u8(vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)), vceqq_u8(a, vdupq_n_u8(0)));
+            }
+#endif /// __aarch64__
+            
+            std::size_t interleave(byte* const* s, byte* d, std::size_t count, std::size_t width) noexcept {
+                std::size_t x = 0;
+                if (count == 4) {
+                    for (; x + 16 <= width; x += 16) {
+                        uint8x16x4_t px = {{ vld1q_u8(s[0] + x), vld1q_u8(s[1] + x),
+                                             vld1q_u8(s[2] + x), vld1q_u8(s[3] + x) }};
+                        vst4q_u8(d + 4 * x, px);
+                    }
+                } else if (count == 3) {
+                    for (; x + 16 <= width; x += 16) {
+                        uint8x16x3_t px = {{ vld1q_u8(s[0] + x), vld1q_u8(s[1] + x),
+                                             vld1q_u8(s[2] + x) }};
+                        vst3q_u8(d + 3 * x, px);
+                    }
+                }
+                return x;
+            }
+            
+            std::size_t deinterleave(byte const* s, byte* const* d, std::size_t count, std::size_t width) noexcept {
+                std::size_t x = 0;
+                if (count == 4) {
+                    for (; x + 16 <= width; x += 16) {
+                        uint8x16x4_t px = vld4q_u8(s + 4 * x);
+                        for (int k = 0; k < 4; ++k) { vst1q_u8(d[k] + x, px.val[k]); }
+                    }
+                } else if (count == 3) {
+                    for (; x + 16 <= width; x += 16) {
+                        uint8x16x3_t px = vld3q_u8(s + 3 * x);
+                        for (int k = 0; k < 3; ++k) { vst1q_u8(d[k] + x, px.val[k]); }
+                    }
+                }
+                return x;
+            }
+            
+            std::size_t premultiply_rgba(byte* p, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    uint8x16x4_t px = vld4q_u8(p + 4 * x);
+                    for (int k = 0; k < 3; ++k) { px.val[k] = premultiply16(px.val[k], px.val[3]); }
+                    vst4q_u8(p + 4 * x, px);
+                }
+                return x;
+            }
+            
+            std::size_t premultiply_planar(byte* c, byte const* a, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    vst1q_u8(c + x, premultiply16(vld1q_u8(c + x), vld1q_u8(a + x)));
+                }
+                return x;
+            }
+            
+#if defined(__aarch64__)
+            std::size_t unpremultiply_rgba(byte* p, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    uint8x16x4_t px = vld4q_u8(p + 4 * x);
+                    for (int k = 0; k < 3; ++k) { px.val[k] = unpremultiply16(px.val[k], px.val[3]); }
+                    vst4q_u8(p + 4 * x, px);
+                }
+                return x;
+            }
+            
+            std::size_t unpremultiply_planar(byte* c, byte const* a, std::size_t width) noexcept {
+                std::size_t x = 0;
+                for (; x + 16 <= width; x += 16) {
+                    vst1q_u8(c + x, unpremultiply16(vld1q_u8(c + x), vld1q_u8(a + x)));
+                }
+                return x;
+            }
+#else
+            std::size_t unpremultiply_rgba(byte*, std::size_t) noexcept { return 0; }
+            std::size_t unpremultiply_planar(byte*, byte const*, std::size_t) noexcept { return 0; }
+#endif /// __aarch64__
+
+#else
+            
+            std::size_t interleave(byte* const*, byte*, std::size_t, std::size_t) noexcept { return 0; }
+            std::size_t deinterleave(byte const*, byte* const*, std::size_t, std::size_t) noexcept { return 0; }
+            std::size_t premultiply_rgba(byte*, std::size_t) noexcept { return 0; }
+            std::size_t unpremultiply_rgba(byte*, std::size_t) noexcept { return 0; }
+            std::size_t premultiply_planar(byte*, byte const*, std::size_t) noexcept { return 0; }
+            std::size_t unpremultiply_planar(byte*, byte const*, std::size_t) noexcept { return 0; }
+            
+#endif /// OBJC_PIXELS_X86 / OBJC_PIXELS_NEON
+            
+            template <typename Function>
+            void dispatch(sample kind, Function&& function) {
+                switch (kind) {
+                    case sample::u8:    function(uint8_t{});    break;
+                    case sample::u16:   function(uint16_t{});   break;
+                    case sample::f32:   function(float{});      break;
+                }
+            }
+            
+            void copy_row(layout const& src, layout const& dst,
+                          row_t const& s, row_t const& d,
+                          std::size_t width, bool vectorize) noexcept {
+                std::size_t const count = src.count;
+                if (src.is_packed() && dst.is_packed()) {
+                    std::memcpy(d.at[0], s.at[0], width * count * src.samplesize());
+                    return;
+                }
+                std::size_t x = 0;
+                if (vectorize && src.kind == sample::u8) {
+                    if (src.is_planar() && dst.is_packed()) {
+                        x = interleave(s.at.data(), d.at[0], count, width);
+                    } else if (src.is_packed() && dst.is_planar()) {
+                        x = deinterleave(s.at[0], d.at.data(), count, width);
+                    }
+                }
+                dispatch(src.kind, [&](auto t) {
+                    copy_scalar<decltype(t)>(s, d, count, x, width);
+                });
+            }
+            
+            void alpha_row(layout const& dst, row_t const& d,
+                           std::size_t width, bool premultiplying, bool vectorize) noexcept {
+                std::size_t const count = dst.count;
+                std::size_t x = 0;
+                if (vectorize && dst.kind == sample::u8) {
+                    if (count == 4 && dst.is_packed()) {
+                        x = premultiplying ? premultiply_rgba(d.at[0], width)
+                                           : unpremultiply_rgba(d.at[0], width);
+                    } else if (dst.is_planar()) {
+                        x = width;
+                        for (std::size_t c = 0; c < count - 1; ++c) {
+                            x = std::min(x, premultiplying ? premultiply_planar(d.at[c], d.at[count - 1], width)
+                                                           : unpremultiply_planar(d.at[c], d.at[count - 1], width));
+                        }
+                    }
+                }
+                dispatch(dst.kind, [&](auto t) {
+                    alpha_scalar<decltype(t)>(d, count, x, width, premultiplying);
+                });
+            }
+            
+        } /// namespace (anon.)
+        
+        layout layout::interleaved(byte* data, std::size_t count, sample kind,
+                                   std::ptrdiff_t rowbytes,
+                                   std::ptrdiff_t pixelbytes,
+                                   alpha mode,
+                                   bool alphafirst) {
+            layout out;
+            out.count = count;
+            out.kind = kind;
+            out.mode = mode;
+            std::ptrdiff_t const siz = static_cast<std::ptrdiff_t>(kind);
+            if (!pixelbytes) { pixelbytes = std::ptrdiff_t(count) * siz; }
+            bool const rotate = alphafirst && mode != alpha::none;
+            for (std::size_t c = 0; c < std::min(count, max_channels); ++c) {
+                std::size_t slot = rotate ? (c + 1) % count : c;
+                out.channels[c] = channel_t{ data + std::ptrdiff_t(slot) * siz, pixelbytes, rowbytes };
+            }
+            return out;
+        }
+        
+        layout layout::planar(byte* const* planes, std::size_t count, sample kind,
+                              std::ptrdiff_t rowbytes,
+                              alpha mode,
+                              bool alphafirst) {
+            layout out;
+            out.count = count;
+            out.kind = kind;
+            out.mode = mode;
+            std::ptrdiff_t const siz = static_cast<std::ptrdiff_t>(kind);
+            bool const rotate = alphafirst && mode != alpha::none;
+            for (std::size_t c = 0; c < std::min(count, max_channels); ++c) {
+                std::size_t slot = rotate ? (c + 1) % count : c;
+                out.channels[c] = channel_t{ planes[slot], siz, rowbytes };
+            }
+            return out;
+        }
+        
+        std::size_t layout::samplesize() const noexcept {
+            return static_cast<std::size_t>(kind);
+        }
+        
+        bool layout::is_packed() const noexcept {
+            std::ptrdiff_t const siz = static_cast<std::ptrdiff_t>(kind);
+            for (std::size_t c = 0; c < count; ++c) {
+                if (channels[c].xstride != std::ptrdiff_t(count) * siz ||
+                    channels[c].ystride != channels[0].ystride ||
+                    channels[c].origin  != channels[0].origin + std::ptrdiff_t(c) * siz) { return false; }
+            }
+            return true;
+        }
+        
+        bool layout::is_planar() const noexcept {
+            std::ptrdiff_t const siz = static_cast<std::ptrdiff_t>(kind);
+            for (std::size_t c = 0; c < count; ++c) {
+                if (channels[c].xstride != siz) { return false; }
+            }
+            return true;
+        }
+        
+        bool transfer(layout const& source, layout const& destination,
+                      std::size_t width, std::size_t height,
+                      bool vectorize) {
+            if (source.kind  != destination.kind  ||
+                source.count != destination.count ||
+                source.count == 0 || source.count > max_channels) { return false; }
+                
+            bool const converting = source.count > 1 &&
+                                    source.mode != alpha::none &&
+                                    destination.mode != alpha::none &&
+                                    source.mode != destination.mode;
+                                    
+            for (std::size_t y = 0; y < height; ++y) {
+                row_t s(source, y), d(destination, y);
+                copy_row(source, destination, s, d, width, vectorize);
+                if (converting) {
+                    alpha_row(destination, d, width,
+                              destination.mode == alpha::premultiplied, vectorize);
+                }
+            }
+            return true;
+        }
+        
+    } /// namespace pixels
+    
+} /// namespace objc
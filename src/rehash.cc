@@ -0,0 +1,201 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <subjective-c/rehash.hh>
+
+namespace hash {
+    
+    namespace {
+        
+        /// the keys, drawn from splitmix64 -- for stripe N of a block,
+        /// the accumulators are keyed with words N through N+7:
+        struct secret_t {
+            std::uint64_t words[24];
+        };
+        
+        constexpr secret_t make_secret() {
+            secret_t out{};
+            std::uint64_t state = 0x9e3779b97f4a7c15ULL;
+            for (std::uint64_t& word : out.words) {
+                std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                word = z ^ (z >> 31);
+            }
+            return out;
+        }
+        
+        alignas(64) constexpr secret_t secret = make_secret();
+        constexpr std::uint64_t const* s = secret.words;
+        
+        constexpr std::size_t stripe = 64;
+        constexpr std::size_t stripes_per_block = 16;
+        constexpr std::size_t block = stripe * stripes_per_block;
+        
+        inline std::uint64_t r8(std::uint8_t const* p) noexcept {
+            std::uint64_t out;
+            std::memcpy(&out, p, sizeof(out));
+            return out;
+        }
+        
+        inline std::uint64_t r4(std::uint8_t const* p) noexcept {
+            std::uint32_t out;
+            std::memcpy(&out, p, sizeof(out));
+            return out;
+        }
+        
+        /// one to three bytes -- the first, the middle and the last:
+        inline std::uint64_t r3(std::uint8_t const* p, std::size_t k) noexcept {
+            return (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[k >> 1]) << 8) | p[k - 1];
+        }
+        
+        /// both halves of the 128-bit product, in place:
+        inline void multiply(std::uint64_t& lhs, std::uint64_t& rhs) noexcept {
+            #if defined(__SIZEOF_INT128__)
+            unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+            lhs = static_cast<std::uint64_t>(product);
+            rhs = static_cast<std::uint64_t>(product >> 64);
+            #else
+            std::uint64_t folded = detail::fold(lhs, rhs);
+            lhs *= rhs;
+            rhs = folded ^ lhs;
+            #endif
+        }
+        
+        /// Adds one 64-byte stripe into the eight accumulators: each word of data,
+        /// keyed, has its halves multiplied together into its own lane, and goes
+        /// as-is into its neighbor's -- as xxh3 does it, so nothing cancels out:
+        inline void accumulate(std::uint64_t* __restrict acc,
+                               std::uint8_t const* __restrict p,
+                               std::uint64_t const* __restrict key) noexcept {
+            #if defined(__SSE2__)
+            __m128i* const lanes = reinterpret_cast<__m128i*>(acc);
+            for (int idx = 0; idx < 4; ++idx) {
+                __m128i data    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p) + idx);
+                __m128i keyed   = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<__m128i const*>(key) + idx));
+                __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                lanes[idx] = _mm_add_epi64(lanes[idx], _mm_add_epi64(product, swapped));
+            }
+            #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            for (int idx = 0; idx < 4; ++idx) {
+                uint64x2_t data    = vreinterpretq_u64_u8(vld1q_u8(p + idx * 16));
+                uint64x2_t keyed   = veorq_u64(data, vld1q_u64(key + idx * 2));
+                uint64x2_t product = vmull_u32(vmovn_u64(keyed), vshrn_n_u64(keyed, 32));
+                uint64x2_t swapped = vextq_u64(data, data, 1);
+                vst1q_u64(acc + idx * 2, vaddq_u64(vld1q_u64(acc + idx * 2),
+                                                   vaddq_u64(product, swapped)));
+            }
+            #else
+            for (int idx = 0; idx < 8; ++idx) {
+                std::uint64_t data  = r8(p + idx * 8);
+                std::uint64_t keyed = data ^ key[idx];
+                acc[idx ^ 1] += data;
+                acc[idx] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+            #endif
+        }
+        
+        /// Once per block, so the accumulators' high bits make it down to the low ones:
+        inline void scramble(std::uint64_t* acc, std::uint64_t const* key) noexcept {
+            for (int idx = 0; idx < 8; ++idx) {
+                std::uint64_t a = acc[idx];
+                a ^= a >> 47;
+                a ^= key[idx];
+                acc[idx] = a * 0x9e3779b1ULL;
+            }
+        }
+        
+        std::uint64_t hash_long(std::uint8_t const* p, std::size_t length, std::uint64_t seed) noexcept {
+            alignas(16) std::uint64_t acc[8] = {
+                s[0] ^ seed, s[1], s[2], s[3],
+                s[4] ^ seed, s[5], s[6], s[7]
+            };
+            
+            const std::size_t blocks = (length - 1) / block;
+            for (std::size_t idx = 0; idx < blocks; ++idx) {
+                std::uint8_t const* base = p + idx * block;
+                for (std::size_t n = 0; n < stripes_per_block; ++n) {
+                    accumulate(acc, base + n * stripe, s + n);
+                }
+                scramble(acc, s + stripes_per_block);
+            }
+            
+            /// what's left of the last block, and then its last 64 bytes,
+            /// which may overlap what came before -- keyed differently:
+            std::uint8_t const* base = p + blocks * block;
+            const std::size_t stripes = (length - 1 - blocks * block) / stripe;
+            for (std::size_t n = 0; n < stripes; ++n) {
+                accumulate(acc, base + n * stripe, s + n);
+            }
+            accumulate(acc, p + length - stripe, s + 9);
+            
+            std::uint64_t out = length * s[23];
+            for (int idx = 0; idx < 8; idx += 2) {
+                out += detail::fold(acc[idx] ^ s[10 + idx], acc[idx + 1] ^ s[11 + idx]);
+            }
+            return detail::avalanche(out);
+        }
+        
+    } /// namespace (anon.)
+    
+    std::uint64_t hash_bytes(void const* data, std::size_t length, std::uint64_t seed) noexcept {
+        std::uint8_t const* p = static_cast<std::uint8_t const*>(data);
+        std::uint64_t a, b;
+        seed ^= detail::fold(seed ^ s[0], s[1]);
+        
+        if (length <= 16) {
+            /// two overlapping reads of four bytes from either end, or else one to three bytes:
+            if (length >= 4) {
+                const std::size_t middle = (length >> 3) << 2;
+                a = (r4(p) << 32) | r4(p + middle);
+                b = (r4(p + length - 4) << 32) | r4(p + length - 4 - middle);
+            } else if (length > 0) {
+                a = r3(p, length);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else if (length <= 256) {
+            /// three independent chains over 48 bytes at a time,
+            /// then 16 at a time, then the last 16 (which may overlap):
+            std::size_t remaining = length;
+            if (remaining > 48) {
+                std::uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = detail::fold(r8(p)      ^ s[1], r8(p + 8)  ^ seed);
+                    see1 = detail::fold(r8(p + 16) ^ s[2], r8(p + 24) ^ see1);
+                    see2 = detail::fold(r8(p + 32) ^ s[3], r8(p + 40) ^ see2);
+                    p += 48;
+                    remaining -= 48;
+                } while (remaining > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (remaining > 16) {
+                seed = detail::fold(r8(p) ^ s[1], r8(p + 8) ^ seed);
+                p += 16;
+                remaining -= 16;
+            }
+            a = r8(p + remaining - 16);
+            b = r8(p + remaining - 8);
+        } else {
+            seed = hash_long(p, length, seed);
+            a = r8(p + length - 16);
+            b = r8(p + length - 8);
+        }
+        
+        a ^= s[1];
+        b ^= seed;
+        multiply(a, b);
+        return detail::fold(a ^ s[0] ^ length, b ^ s[1]);
+    }
+    
+} /// namespace hash
@@ -0,0 +1,497 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/resample.hh>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBJC_RESAMPLE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OBJC_RESAMPLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace objc {
+    
+    namespace resample {
+        
+        namespace {
+            
+            /// 8-bit weights are fixed-point, summing to exactly 1 << precision --
+            /// small enough for int16 lanes, and for int32 sums of 255 * weight:
+            constexpr int precision = 14;
+            constexpr int32_t half = 1 << (precision - 1);
+            
+            double sinc(double x) noexcept {
+                if (x == 0.0) { return 1.0; }
+                x *= M_PI;
+                return std::sin(x) / x;
+            }
+            
+            /// Per output pixel (or row): the first source pixel (or row) it draws from,
+            /// how many it draws from, and their weights, `taps` apart:
+            struct coefficients_t {
+                std::vector<int> first;
+                std::vector<int> count;
+                std::vector<float> weights;
+                std::vector<int16_t> fixed;
+                std::size_t taps = 0;
+            };
+            
+            coefficients_t coefficients(filter kernel, std::size_t insize, std::size_t outsize,
+                                        double offset, double extent) {
+                coefficients_t out;
+                const double scale = extent / double(outsize);
+                const double filterscale = std::max(scale, 1.0);    /// widen the filter when shrinking
+                const double radius = support(kernel) * filterscale;
+                const int limit = int(insize);
+                
+                out.taps = std::size_t(std::ceil(radius * 2.0)) + 1;
+                out.first.resize(outsize);
+                out.count.resize(outsize);
+                out.weights.assign(outsize * out.taps, 0.0f);
+                out.fixed.assign(outsize * out.taps, 0);
+                std::vector<double> raw(out.taps);
+                
+                for (std::size_t xx = 0; xx < outsize; ++xx) {
+                    const double center = offset + (double(xx) + 0.5) * scale;
+                    int lo = std::max(int(std::floor(center - radius + 0.5)), 0);
+                    int hi = std::min(int(std::floor(center + radius + 0.5)), limit);
+                    hi = std::min(hi, lo + int(out.taps));
+                    double total = 0.0;
+                    int n = 0;
+                    
+                    for (int x = lo; x < hi; ++x, ++n) {
+                        raw[n] = weight(kernel, (double(x) - center + 0.5) / filterscale);
+                        total += raw[n];
+                    }
+                    
+                    if (n == 0 || total == 0.0) {
+                        /// nothing within reach -- take the nearest sample:
+                        lo = std::min(std::max(int(std::floor(center)), 0), limit - 1);
+                        n = 1;
+                        raw[0] = total = 1.0;
+                    }
+                    
+                    out.first[xx] = lo;
+                    out.count[xx] = n;
+                    float* w = &out.weights[xx * out.taps];
+                    int16_t* f = &out.fixed[xx * out.taps];
+                    int32_t sum = 0;
+                    int peak = 0;
+                    
+                    for (int k = 0; k < n; ++k) {
+                        const double normal = raw[k] / total;
+                        w[k] = float(normal);
+                        f[k] = int16_t(std::lround(normal * (1 << precision)));
+                        sum += f[k];
+                        if (std::abs(f[k]) > std::abs(f[peak])) { peak = k; }
+                    }
+                    
+                    /// rounding error goes to the heaviest tap, so flat areas stay flat:
+                    f[peak] = int16_t(f[peak] + ((1 << precision) - sum));
+                }
+                
+                return out;
+            }
+            
+            inline uint8_t clamp8(int32_t value) noexcept {
+                return uint8_t(std::min(255, std::max(0, value)));
+            }
+            
+            /// Vector kernels: as with the pixel-transfer kernels, each one handles
+            /// what it can and returns how many output pixels (horizontally)
+            /// or samples (vertically) that was -- the scalar loops do the rest.
+            
+#if defined(OBJC_RESAMPLE_SSE2)
+            
+            inline __m128i pair(int16_t w0, int16_t w1) noexcept {
+                return _mm_set1_epi32(int32_t((uint32_t(uint16_t(w1)) << 16) | uint16_t(w0)));
+            }
+            
+            std::size_t horizontal_rgba(uint8_t const* in, uint8_t* out,
+                                        coefficients_t const& co, std::size_t width) noexcept {
+                const __m128i zero = _mm_setzero_si128();
+                for (std::size_t xx = 0; xx < width; ++xx) {
+                    int16_t const* w = &co.fixed[xx * co.taps];
+                    uint8_t const* s = in + co.first[xx] * 4;
+                    const int n = co.count[xx];
+                    __m128i acc = _mm_set1_epi32(half);
+                    int k = 0;
+                    
+                    /// two pixels per madd: [r0 r1 g0 g1 b0 b1 a0 a1] x [w0 w1 w0 w1 ...]
+                    for (; k + 1 < n; k += 2) {
+                        __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(s + k * 4)), zero);
+                        pixels = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+                        acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels, pair(w[k], w[k + 1])));
+                    }
+                    if (k < n) {
+                        int32_t last;
+                        std::memcpy(&last, s + k * 4, 4);
+                        __m128i pixels = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+                        pixels = _mm_unpacklo_epi16(pixels, zero);
+                        acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels, pair(w[k], 0)));
+                    }
+                    
+                    acc = _mm_srai_epi32(acc, precision);
+                    acc = _mm_packs_epi32(acc, acc);
+                    acc = _mm_packus_epi16(acc, acc);
+                    const int32_t pixel = _mm_cvtsi128_si32(acc);
+                    std::memcpy(out + xx * 4, &pixel, 4);
+                }
+                return width;
+            }
+            
+            std::size_t horizontal_rgba(float const* in, float* out,
+                                        coefficients_t const& co, std::size_t width) noexcept {
+                for (std::size_t xx = 0; xx < width; ++xx) {
+                    float const* w = &co.weights[xx * co.taps];
+                    float const* s = in + co.first[xx] * 4;
+                    const int n = co.count[xx];
+                    __m128 acc = _mm_setzero_ps();
+                    for (int k = 0; k < n; ++k) {
+                        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + k * 4), _mm_set1_ps(w[k])));
+                    }
+                    _mm_storeu_ps(out + xx * 4, acc);
+                }
+                return width;
+            }
+            
+            std::size_t vertical(uint8_t const* rows, std::size_t stride,
+                                 int16_t const* w, int n,
+                                 uint8_t* out, std::size_t length) noexcept {
+                const __m128i zero = _mm_setzero_si128();
+                std::size_t i = 0;
+                for (; i + 16 <= length; i += 16) {
+                    __m128i acc0 = _mm_set1_epi32(half);
+                    __m128i acc1 = acc0, acc2 = acc0, acc3 = acc0;
+                    int k = 0;
+                    
+                    /// two rows per madd, their samples interleaved:
+                    for (; k + 1 < n; k += 2) {
+                        const __m128i upper = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + k * stride + i));
+                        const __m128i lower = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + (k + 1) * stride + i));
+                        const __m128i lo = _mm_unpacklo_epi8(upper, lower);
+                        const __m128i hi = _mm_unpackhi_epi8(upper, lower);
+                        const __m128i weights = pair(w[k], w[k + 1]);
+                        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weights));
+                        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weights));
+                        acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weights));
+                        acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weights));
+                    }
+                    if (k < n) {
+                        const __m128i upper = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + k * stride + i));
+                        const __m128i lo = _mm_unpacklo_epi8(upper, zero);
+                        const __m128i hi = _mm_unpackhi_epi8(upper, zero);
+                        const __m128i weights = pair(w[k], 0);
+                        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(lo, zero), weights));
+                        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(lo, zero), weights));
+                        acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(hi, zero), weights));
+                        acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(hi, zero), weights));
+                    }
+                    
+                    const __m128i lo = _mm_packs_epi32(_mm_srai_epi32(acc0, precision),
+                                                       _mm_srai_epi32(acc1, precision));
+                    const __m128i hi = _mm_packs_epi32(_mm_srai_epi32(acc2, precision),
+                                                       _mm_srai_epi32(acc3, precision));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(lo, hi));
+                }
+                return i;
+            }
+            
+            std::size_t vertical(float const* rows, std::size_t stride,
+                                 float const* w, int n,
+                                 float* out, std::size_t length) noexcept {
+                std::size_t i = 0;
+                for (; i + 4 <= length; i += 4) {
+                    __m128 acc = _mm_setzero_ps();
+                    for (int k = 0; k < n; ++k) {
+                        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows + k * stride + i), _mm_set1_ps(w[k])));
+                    }
+                    _mm_storeu_ps(out + i, acc);
+                }
+                return i;
+            }
+            
+#elif defined(OBJC_RESAMPLE_NEON)
+            
+            std::size_t horizontal_rgba(uint8_t const* in, uint8_t* out,
+                                        coefficients_t const& co, std::size_t width) noexcept {
+                for (std::size_t xx = 0; xx < width; ++xx) {
+                    int16_t const* w = &co.fixed[xx * co.taps];
+                    uint8_t const* s = in + co.first[xx] * 4;
+                    const int n = co.count[xx];
+                    int32x4_t acc = vdupq_n_s32(half);
+                    for (int k = 0; k < n; ++k) {
+                        uint32_t pixel;
+                        std::memcpy(&pixel, s + k * 4, 4);
+                        const int16x8_t wide = vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel))));
+                        acc = vmlal_n_s16(acc, vget_low_s16(wide), w[k]);
+                    }
+                    const int16x4_t narrow = vqshrn_n_s32(acc, precision);
+                    const uint8x8_t bytes = vqmovun_s16(vcombine_s16(narrow, narrow));
+                    const uint32_t pixel = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+                    std::memcpy(out + xx * 4, &pixel, 4);
+                }
+                return width;
+            }
+            
+            std::size_t horizontal_rgba(float const* in, float* out,
+                                        coefficients_t const& co, std::size_t width) noexcept {
+                for (std::size_t xx = 0; xx < width; ++xx) {
+                    float const* w = &co.weights[xx * co.taps];
+                    float const* s = in + co.first[xx] * 4;
+                    const int n = co.count[xx];
+                    float32x4_t acc = vdupq_n_f32(0.0f);
+                    for (int k = 0; k < n; ++k) {
+                        acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(s + k * 4), w[k]));
+                    }
+                    vst1q_f32(out + xx * 4, acc);
+                }
+                return width;
+            }
+            
+            std::size_t vertical(uint8_t const* rows, std::size_t stride,
+                                 int16_t const* w, int n,
+                                 uint8_t* out, std::size_t length) noexcept {
+                std::size_t i = 0;
+                for (; i + 8 <= length; i += 8) {
+                    int32x4_t lo = vdupq_n_s32(half);
+                    int32x4_t hi = lo;
+                    for (int k = 0; k < n; ++k) {
+                        const int16x8_t wide = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows + k * stride + i)));
+                        lo = vmlal_n_s16(lo, vget_low_s16(wide), w[k]);
+                        hi = vmlal_n_s16(hi, vget_high_s16(wide), w[k]);
+                    }
+                    vst1_u8(out + i, vqmovun_s16(vcombine_s16(vqshrn_n_s32(lo, precision),
+                                                              vqshrn_n_s32(hi, precision))));
+                }
+                return i;
+            }
+            
+            std::size_t vertical(float const* rows, std::size_t stride,
+                                 float const* w, int n,
+                                 float* out, std::size_t length) noexcept {
+                std::size_t i = 0;
+                for (; i + 4 <= length; i += 4) {
+                    float32x4_t acc = vdupq_n_f32(0.0f);
+                    for (int k = 0; k < n; ++k) {
+                        acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(rows + k * stride + i), w[k]));
+                    }
+                    vst1q_f32(out + i, acc);
+                }
+                return i;
+            }
+            
+#else
+            
+            std::size_t horizontal_rgba(uint8_t const*, uint8_t*, coefficients_t const&, std::size_t) noexcept { return 0; }
+            std::size_t horizontal_rgba(float const*, float*, coefficients_t const&, std::size_t) noexcept { return 0; }
+            std::size_t vertical(uint8_t const*, std::size_t, int16_t const*, int, uint8_t*, std::size_t) noexcept { return 0; }
+            std::size_t vertical(float const*, std::size_t, float const*, int, float*, std::size_t) noexcept { return 0; }
+            
+#endif /// OBJC_RESAMPLE_SSE2 / OBJC_RESAMPLE_NEON
+            
+            /// Scalar passes -- the 8-bit ones do exactly the vector kernels' arithmetic:
+            
+            void horizontal(uint8_t const* in, uint8_t* out, std::size_t channels,
+                            coefficients_t const& co, std::size_t width, bool vectorize) noexcept {
+                std::size_t xx = (vectorize && channels == 4) ? horizontal_rgba(in, out, co, width) : 0;
+                for (; xx < width; ++xx) {
+                    int16_t const* w = &co.fixed[xx * co.taps];
+                    uint8_t const* s = in + co.first[xx] * channels;
+                    const int n = co.count[xx];
+                    for (std::size_t c = 0; c < channels; ++c) {
+                        int32_t acc = half;
+                        for (int k = 0; k < n; ++k) { acc += int32_t(s[k * channels + c]) * w[k]; }
+                        out[xx * channels + c] = clamp8(acc >> precision);
+                    }
+                }
+            }
+            
+            void horizontal(float const* in, float* out, std::size_t channels,
+                            coefficients_t const& co, std::size_t width, bool vectorize) noexcept {
+                std::size_t xx = (vectorize && channels == 4) ? horizontal_rgba(in, out, co, width) : 0;
+                for (; xx < width; ++xx) {
+                    float const* w = &co.weights[xx * co.taps];
+                    float const* s = in + co.first[xx] * channels;
+                    const int n = co.count[xx];
+                    for (std::size_t c = 0; c < channels; ++c) {
+                        float acc = 0.0f;
+                        for (int k = 0; k < n; ++k) { acc += s[k * channels + c] * w[k]; }
+                        out[xx * channels + c] = acc;
+                    }
+                }
+            }
+            
+            void vertical(uint8_t const* rows, std::size_t stride,
+                          coefficients_t const& co, std::size_t yy,
+                          uint8_t* out, std::size_t length, bool vectorize) noexcept {
+                int16_t const* w = &co.fixed[yy * co.taps];
+                const int n = co.count[yy];
+                std::size_t i = vectorize ? vertical(rows, stride, w, n, out, length) : 0;
+                for (; i < length; ++i) {
+                    int32_t acc = half;
+                    for (int k = 0; k < n; ++k) { acc += int32_t(rows[k * stride + i]) * w[k]; }
+                    out[i] = clamp8(acc >> precision);
+                }
+            }
+            
+            void vertical(float const* rows, std::size_t stride,
+                          coefficients_t const& co, std::size_t yy,
+                          float* out, std::size_t length, bool vectorize) noexcept {
+                float const* w = &co.weights[yy * co.taps];
+                const int n = co.count[yy];
+                std::size_t i = vectorize ? vertical(rows, stride, w, n, out, length) : 0;
+                for (; i < length; ++i) {
+                    float acc = 0.0f;
+                    for (int k = 0; k < n; ++k) { acc += rows[k * stride + i] * w[k]; }
+                    out[i] = acc;
+                }
+            }
+            
+            /// One band of output rows: run the horizontal pass over just the source
+            /// rows the band needs, into scratch, then the vertical pass out of it:
+            template <typename T>
+            void band(buffer_t const& source, buffer_t const& destination,
+                      coefficients_t const& across, coefficients_t const& down,
+                      std::size_t top, std::size_t bottom, bool vectorize) {
+                const std::size_t stride = destination.width * destination.channels;
+                const int first = down.first[top];
+                int last = first;
+                for (std::size_t yy = top; yy < bottom; ++yy) {
+                    last = std::max(last, down.first[yy] + down.count[yy]);
+                }
+                
+                std::vector<T> scratch(std::size_t(last - first) * stride);
+                for (int row = first; row < last; ++row) {
+                    horizontal(reinterpret_cast<T const*>(source.data + row * source.rowbytes),
+                               scratch.data() + std::size_t(row - first) * stride,
+                               source.channels, across, destination.width, vectorize);
+                }
+                for (std::size_t yy = top; yy < bottom; ++yy) {
+                    vertical(scratch.data() + std::size_t(down.first[yy] - first) * stride, stride,
+                             down, yy,
+                             reinterpret_cast<T*>(destination.data + yy * destination.rowbytes),
+                             stride, vectorize);
+                }
+            }
+            
+            /// bands shorter than this would spend most of their time
+            /// on the horizontal pass over rows they share with their neighbors:
+            constexpr std::size_t minimum_band = 32;
+            
+        } /// namespace (anon.)
+        
+        double support(filter kernel) noexcept {
+            switch (kernel) {
+                case filter::box:       return 0.5;
+                case filter::bilinear:  return 1.0;
+                case filter::lanczos3:  return 3.0;
+                case filter::mitchell:  return 2.0;
+            }
+            return 1.0;
+        }
+        
+        double weight(filter kernel, double x) noexcept {
+            switch (kernel) {
+                case filter::box:
+                    return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+                case filter::bilinear:
+                    x = std::fabs(x);
+                    return x < 1.0 ? 1.0 - x : 0.0;
+                case filter::lanczos3:
+                    return std::fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+                case filter::mitchell: {
+                    constexpr double B = 1.0 / 3.0;
+                    constexpr double C = 1.0 / 3.0;
+                    x = std::fabs(x);
+                    if (x < 1.0) {
+                        return ((12.0 - 9.0 * B - 6.0 * C) * x * x * x +
+                                (-18.0 + 12.0 * B + 6.0 * C) * x * x +
+                                (6.0 - 2.0 * B)) / 6.0;
+                    }
+                    if (x < 2.0) {
+                        return ((-B - 6.0 * C) * x * x * x +
+                                (6.0 * B + 30.0 * C) * x * x +
+                                (-12.0 * B - 48.0 * C) * x +
+                                (8.0 * B + 24.0 * C)) / 6.0;
+                    }
+                    return 0.0;
+                }
+            }
+            return 0.0;
+        }
+        
+        bool resize(buffer_t const& source, buffer_t const& destination) {
+            return resize(source, destination, options{});
+        }
+        
+        bool resize(buffer_t const& source, buffer_t const& destination,
+                    options const& opts) {
+            if (source.kind != destination.kind ||
+                source.channels != destination.channels ||
+                source.kind == pixels::sample::u16) { return false; }
+            if (!source.data || !destination.data || !source.channels ||
+                !source.width || !source.height ||
+                !destination.width || !destination.height) { return false; }
+                
+            const std::ptrdiff_t samplesize = static_cast<std::ptrdiff_t>(source.kind);
+            buffer_t src = source;
+            buffer_t dst = destination;
+            if (!src.rowbytes) { src.rowbytes = src.width * src.channels * samplesize; }
+            if (!dst.rowbytes) { dst.rowbytes = dst.width * dst.channels * samplesize; }
+            
+            region_t region = opts.region;
+            if (region.width <= 0.0 || region.height <= 0.0) {
+                region = region_t{ 0.0, 0.0, double(src.width), double(src.height) };
+            }
+            if (region.x < 0.0 || region.y < 0.0 ||
+                region.x + region.width > double(src.width) ||
+                region.y + region.height > double(src.height)) { return false; }
+                
+            const coefficients_t across = coefficients(opts.kernel, src.width, dst.width,
+                                                       region.x, region.width);
+            const coefficients_t down = coefficients(opts.kernel, src.height, dst.height,
+                                                     region.y, region.height);
+                                                     
+            const unsigned workers = opts.threads ? opts.threads
+                                                  : std::max(1u, std::thread::hardware_concurrency());
+            const std::size_t bands = std::max<std::size_t>(1,
+                                      std::min<std::size_t>(workers, dst.height / minimum_band));
+                                      
+            auto run = [&](auto t) {
+                using T = decltype(t);
+                if (bands == 1) {
+                    band<T>(src, dst, across, down, 0, dst.height, opts.vectorize);
+                    return;
+                }
+                std::vector<std::thread> threads;
+                threads.reserve(bands);
+                for (std::size_t idx = 0; idx < bands; ++idx) {
+                    threads.emplace_back(band<T>, std::cref(src), std::cref(dst),
+                                                  std::cref(across), std::cref(down),
+                                                  dst.height * idx / bands,
+                                                  dst.height * (idx + 1) / bands,
+                                                  opts.vectorize);
+                }
+                for (std::thread& thread : threads) { thread.join(); }
+            };
+            
+            if (src.kind == pixels::sample::u8) {
+                run(uint8_t{});
+            } else {
+                run(float{});
+            }
+            return true;
+        }
+        
+    } /// namespace resample
+    
+} /// namespace objc
@@ -1,7 +1,9 @@
 /// Copyright 2014 Alexander Böhn <fish2000@gmail.com>
 /// License: MIT (see COPYING.MIT file)
 
+#include <cstring>
 #include <subjective-c/selector.hh>
+#include <subjective-c/rehash.hh>
 
 namespace objc {
     
@@ -61,10 +63,10 @@ namespace objc {
         return objc::bridge<CFStringRef>(ns_str());
     }
     
-    static std::hash<std::string> stringhasher;
-    
     std::size_t selector::hash() const {
-        return stringhasher(str());
+        /// the name's bytes, as they are -- without a std::string in between:
+        char const* name = c_str();
+        return static_cast<std::size_t>(::hash::hash_bytes(name, std::strlen(name)));
     }
     
     void selector::swap(objc::selector& other) noexcept {
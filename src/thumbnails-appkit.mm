@@ -0,0 +1,115 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <subjective-c/thumbnails.hh>
+
+#if defined(__APPLE__)
+
+#include <subjective-c/encoder.hh>
+#import  <Cocoa/Cocoa.h>
+#import  <ImageIO/ImageIO.h>
+
+namespace objc {
+    
+    namespace thumbnails {
+        
+        namespace {
+            
+            /// an image source over `data` -- which has to outlive it:
+            __attribute__((cf_returns_retained))
+            CGImageSourceRef source_for(bytevec_t const& data) {
+                CFDataRef bytes = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault,
+                                                              data.data(), data.size(),
+                                                              kCFAllocatorNull);
+                if (!bytes) { return nullptr; }
+                CGImageSourceRef source = CGImageSourceCreateWithData(bytes, nullptr);
+                CFRelease(bytes);
+                return source;
+            }
+            
+        } /// namespace (anon.)
+        
+        codec_t appkit_codec(format kind, float quality) {
+            codec_t codec;
+            
+            /// ImageIO reads the header, without decoding anything:
+            codec.measure = [](bytevec_t const& data, std::size_t& width, std::size_t& height) {
+                CGImageSourceRef source = source_for(data);
+                if (!source) { return false; }
+                CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(source, 0, nullptr);
+                CFRelease(source);
+                if (!properties) { return false; }
+                NSDictionary* dict = (__bridge NSDictionary*)properties;
+                NSNumber* pixelwidth = dict[(__bridge NSString*)kCGImagePropertyPixelWidth];
+                NSNumber* pixelheight = dict[(__bridge NSString*)kCGImagePropertyPixelHeight];
+                bool ok = pixelwidth && pixelheight;
+                if (ok) {
+                    width = pixelwidth.unsignedIntegerValue;
+                    height = pixelheight.unsignedIntegerValue;
+                }
+                CFRelease(properties);
+                return ok;
+            };
+            
+            /// ... and decodes, drawn into premultiplied RGBA:
+            codec.decode = [](bytevec_t const& data, frame_t& frame) {
+                @autoreleasepool {
+                    CGImageSourceRef source = source_for(data);
+                    if (!source) { return false; }
+                    CGImageRef image = CGImageSourceCreateImageAtIndex(source, 0, nullptr);
+                    CFRelease(source);
+                    if (!image) { return false; }
+                    
+                    frame.width = CGImageGetWidth(image);
+                    frame.height = CGImageGetHeight(image);
+                    frame.pixels.resize(frame.width * frame.height * 4);
+                    CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+                    CGContextRef context = CGBitmapContextCreate(frame.pixels.data(),
+                                                                 frame.width, frame.height,
+                                                                 8, frame.width * 4, colorspace,
+                                                                 kCGImageAlphaPremultipliedLast);
+                    CGColorSpaceRelease(colorspace);
+                    if (!context) {
+                        CGImageRelease(image);
+                        return false;
+                    }
+                    CGContextSetBlendMode(context, kCGBlendModeCopy);
+                    CGContextDrawImage(context, CGRectMake(0, 0, frame.width, frame.height), image);
+                    CGContextRelease(context);
+                    CGImageRelease(image);
+                    return true;
+                }
+            };
+            
+            /// ... and this thread's objc::cg::encoder encodes, from a CGImage
+            /// over the frame's pixels, straight into `data`:
+            codec.encode = [kind, quality](frame_t const& frame, bytevec_t& data) {
+                @autoreleasepool {
+                    CGDataProviderRef provider = CGDataProviderCreateWithData(nullptr, frame.pixels.data(),
+                                                                              frame.width * frame.height * 4,
+                                                                              nullptr);
+                    CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+                    CGImageRef image = CGImageCreate(frame.width, frame.height, 8, 32, frame.width * 4,
+                                                     colorspace, kCGImageAlphaPremultipliedLast,
+                                                     provider, nullptr, false, kCGRenderingIntentDefault);
+                    CGColorSpaceRelease(colorspace);
+                    CGDataProviderRelease(provider);
+                    if (!image) { return false; }
+                    
+                    data.clear();
+                    bool ok = cg::encoder::local().encode(image, kind == format::jpeg ? cg::encoding::jpeg
+                                                                                      : cg::encoding::png,
+                                                          quality, data);
+                    CGImageRelease(image);
+                    return ok;
+                }
+            };
+            
+            return codec;
+        }
+        
+    } /// namespace thumbnails
+    
+} /// namespace objc
+
+#endif /// __APPLE__
@@ -0,0 +1,559 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <subjective-c/thumbnails.hh>
+#include <subjective-c/pixels.hh>
+
+namespace objc {
+    
+    namespace thumbnails {
+        
+        namespace {
+            
+            using steady = std::chrono::steady_clock;
+            using seconds_t = std::chrono::duration<double>;
+            
+            /// A FIFO that blocks producers when full and consumers when empty --
+            /// until it's closed, after which pop() drains what's left and then
+            /// returns false:
+            template <typename T>
+            class queue_t {
+                
+                public:
+                    explicit queue_t(std::size_t capacity)
+                        :limit(std::max<std::size_t>(capacity, 1))
+                        {}
+                        
+                    void push(T&& item) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        notfull.wait(lock, [this]() { return items.size() < limit; });
+                        items.push_back(std::move(item));
+                        notempty.notify_one();
+                    }
+                    
+                    bool pop(T& out) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        notempty.wait(lock, [this]() { return !items.empty() || closed; });
+                        if (items.empty()) { return false; }
+                        out = std::move(items.front());
+                        items.pop_front();
+                        notfull.notify_one();
+                        return true;
+                    }
+                    
+                    void close() {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        closed = true;
+                        notempty.notify_all();
+                    }
+                    
+                private:
+                    std::mutex mutex;
+                    std::condition_variable notfull;
+                    std::condition_variable notempty;
+                    std::deque<T> items;
+                    std::size_t limit;
+                    bool closed = false;
+            };
+            
+            /// Bytes in flight. Only admission -- acquire() -- waits; everything
+            /// after that adjusts its holdings without waiting, so nothing
+            /// downstream can deadlock on memory held upstream. Something too big
+            /// for the whole budget is let in once everything else has drained:
+            class budget_t {
+                
+                public:
+                    explicit budget_t(std::size_t bytes)
+                        :limit(bytes)
+                        {}
+                        
+                    void acquire(std::size_t bytes) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        released.wait(lock, [&]() { return used == 0 || used + bytes <= limit; });
+                        used += bytes;
+                        peak = std::max(peak, used);
+                    }
+                    
+                    void adjust(std::size_t& held, std::size_t bytes) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        used = used - held + bytes;
+                        peak = std::max(peak, used);
+                        if (bytes < held) { released.notify_all(); }
+                        held = bytes;
+                    }
+                    
+                    void release(std::size_t& held) { adjust(held, 0); }
+                    
+                    std::size_t high_water() {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        return peak;
+                    }
+                    
+                private:
+                    std::mutex mutex;
+                    std::condition_variable released;
+                    std::size_t limit;
+                    std::size_t used = 0;
+                    std::size_t peak = 0;
+            };
+            
+            struct item_t {
+                std::size_t index = 0;
+                steady::time_point start;
+                bytevec_t encoded;                  /// the file as read, then as it'll be written
+                frame_t frame;
+                std::size_t held = 0;               /// what `budget` has on this item
+            };
+            
+            /// Everything the stages share:
+            struct state_t {
+                std::vector<job_t> const& jobs;
+                codec_t const& codec;
+                options const& opts;
+                budget_t budget;
+                queue_t<item_t> decoding;
+                queue_t<item_t> resampling;
+                queue_t<item_t> encoding;
+                queue_t<item_t> writing;
+                std::mutex mutex;                   /// guards `report` and `latencies`
+                report_t report;
+                std::vector<double> latencies;
+                
+                state_t(std::vector<job_t> const& j, codec_t const& c, options const& o)
+                    :jobs(j), codec(c), opts(o), budget(o.budget)
+                    ,decoding(o.depth), resampling(o.depth)
+                    ,encoding(o.depth), writing(o.depth)
+                    {}
+                    
+                void fail(item_t& item, std::string const& why) {
+                    budget.release(item.held);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    report.failures.emplace_back(jobs[item.index].source, why);
+                }
+            };
+            
+            std::size_t bytesize(frame_t const& frame) {
+                return frame.width * frame.height * 4;
+            }
+            
+            /// Run a codec function, treating exceptions as failures:
+            template <typename F>
+            bool guarded(F&& function, std::string& why) {
+                try {
+                    return function();
+                } catch (std::exception const& exc) {
+                    why = exc.what();
+                } catch (...) {
+                    why = "unknown exception";
+                }
+                return false;
+            }
+            
+            /// Ask the OS to start reading a file we'll want shortly:
+            void readahead(std::string const& path) {
+                int descriptor = ::open(path.c_str(), O_RDONLY);
+                if (descriptor < 0) { return; }
+                #if defined(F_RDADVISE)
+                    struct stat info;
+                    if (::fstat(descriptor, &info) == 0 && info.st_size > 0) {
+                        struct radvisory advice;
+                        advice.ra_offset = 0;
+                        advice.ra_count = int(std::min<off_t>(info.st_size, INT_MAX));
+                        ::fcntl(descriptor, F_RDADVISE, &advice);
+                    }
+                #elif defined(POSIX_FADV_WILLNEED)
+                    ::posix_fadvise(descriptor, 0, 0, POSIX_FADV_WILLNEED);
+                #endif
+                ::close(descriptor);
+            }
+            
+            bool slurp(std::string const& path, bytevec_t& out) {
+                std::FILE* file = std::fopen(path.c_str(), "rb");
+                if (!file) { return false; }
+                struct stat info;
+                bool ok = ::fstat(::fileno(file), &info) == 0 && info.st_size >= 0;
+                if (ok) {
+                    out.resize(std::size_t(info.st_size));
+                    ok = std::fread(out.data(), 1, out.size(), file) == out.size();
+                }
+                std::fclose(file);
+                return ok;
+            }
+            
+            bool spit(std::string const& path, bytevec_t const& data) {
+                std::FILE* file = std::fopen(path.c_str(), "wb");
+                if (!file) { return false; }
+                bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+                return std::fclose(file) == 0 && ok;
+            }
+            
+            /// Start `count` threads running `work`, the last of which to finish
+            /// closes `output` -- so the next stage knows there's no more coming:
+            template <typename F>
+            void stage(std::vector<std::thread>& threads, unsigned count,
+                       queue_t<item_t>* output, F work) {
+                auto remaining = std::make_shared<std::atomic<unsigned>>(count);
+                for (unsigned idx = 0; idx < count; ++idx) {
+                    threads.emplace_back([=]() {
+                        work();
+                        if (remaining->fetch_sub(1) == 1 && output) { output->close(); }
+                    });
+                }
+            }
+            
+            void reader(state_t& state) {
+                double busy = 0.0;
+                std::size_t bytes = 0;
+                std::size_t const count = state.jobs.size();
+                
+                for (std::size_t idx = 0; idx < std::min(state.opts.readahead, count); ++idx) {
+                    readahead(state.jobs[idx].source);
+                }
+                
+                for (std::size_t idx = 0; idx < count; ++idx) {
+                    if (idx + state.opts.readahead < count) {
+                        readahead(state.jobs[idx + state.opts.readahead].source);
+                    }
+                    
+                    item_t item;
+                    item.index = idx;
+                    item.start = steady::now();
+                    if (!slurp(state.jobs[idx].source, item.encoded)) {
+                        state.fail(item, "couldn't read the file");
+                        continue;
+                    }
+                    bytes += item.encoded.size();
+                    
+                    /// admission: the file and its pixels-to-be have to fit --
+                    std::size_t width = 0, height = 0;
+                    std::string why;
+                    std::size_t estimate = item.encoded.size();
+                    if (state.codec.measure &&
+                        guarded([&]() { return state.codec.measure(item.encoded, width, height); }, why)) {
+                        std::size_t pixelcount, decoded;
+                        if (__builtin_mul_overflow(width, height, &pixelcount) ||
+                            __builtin_mul_overflow(pixelcount, std::size_t(4), &decoded) ||
+                            __builtin_add_overflow(estimate, decoded, &estimate)) {
+                            state.fail(item, "image dimensions are too large");
+                            continue;
+                        }
+                    }
+                    busy += seconds_t(steady::now() - item.start).count();
+                    
+                    state.budget.acquire(estimate);
+                    item.held = estimate;
+                    state.decoding.push(std::move(item));
+                }
+                
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.report.read_seconds += busy;
+                state.report.bytes_read += bytes;
+            }
+            
+            void decoder(state_t& state) {
+                double busy = 0.0, megapixels = 0.0;
+                item_t item;
+                while (state.decoding.pop(item)) {
+                    auto start = steady::now();
+                    std::string why = "couldn't decode the image";
+                    bool decoded = guarded([&]() { return state.codec.decode(item.encoded, item.frame); }, why);
+                    if (decoded && (!item.frame.width || !item.frame.height ||
+                                    item.frame.pixels.size() < bytesize(item.frame))) {
+                        decoded = false;
+                        why = "decoder returned an empty or short frame";
+                    }
+                    bytevec_t().swap(item.encoded);
+                    busy += seconds_t(steady::now() - start).count();
+                    if (!decoded) {
+                        state.fail(item, why);
+                        continue;
+                    }
+                    megapixels += double(item.frame.width * item.frame.height) / 1e6;
+                    state.budget.adjust(item.held, bytesize(item.frame));
+                    state.resampling.push(std::move(item));
+                }
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.report.decode_seconds += busy;
+                state.report.input_megapixels += megapixels;
+            }
+            
+            void resampler(state_t& state) {
+                double busy = 0.0;
+                resample::options ropts;
+                ropts.kernel = state.opts.kernel;
+                ropts.threads = 1;                  /// the parallelism is across images
+                item_t item;
+                while (state.resampling.pop(item)) {
+                    auto start = steady::now();
+                    auto size = fit(item.frame.width, item.frame.height, state.opts.size);
+                    if (size.first != item.frame.width || size.second != item.frame.height) {
+                        frame_t thumbnail;
+                        thumbnail.width = size.first;
+                        thumbnail.height = size.second;
+                        thumbnail.pixels.resize(bytesize(thumbnail));
+                        
+                        resample::buffer_t in, out;
+                        in.data = item.frame.pixels.data();
+                        in.width = item.frame.width;
+                        in.height = item.frame.height;
+                        in.channels = 4;
+                        out = in;
+                        out.data = thumbnail.pixels.data();
+                        out.width = thumbnail.width;
+                        out.height = thumbnail.height;
+                        
+                        if (!resample::resize(in, out, ropts)) {
+                            busy += seconds_t(steady::now() - start).count();
+                            state.fail(item, "couldn't resample the image");
+                            continue;
+                        }
+                        item.frame = std::move(thumbnail);
+                    }
+                    busy += seconds_t(steady::now() - start).count();
+                    state.budget.adjust(item.held, bytesize(item.frame));
+                    state.encoding.push(std::move(item));
+                }
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.report.resample_seconds += busy;
+            }
+            
+            void encoder(state_t& state) {
+                double busy = 0.0;
+                item_t item;
+                while (state.encoding.pop(item)) {
+                    auto start = steady::now();
+                    std::string why = "couldn't encode the thumbnail";
+                    bool encoded = guarded([&]() { return state.codec.encode(item.frame, item.encoded); }, why);
+                    item.frame = frame_t{};
+                    busy += seconds_t(steady::now() - start).count();
+                    if (!encoded) {
+                        state.fail(item, why);
+                        continue;
+                    }
+                    state.budget.adjust(item.held, item.encoded.size());
+                    state.writing.push(std::move(item));
+                }
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.report.encode_seconds += busy;
+            }
+            
+            void writer(state_t& state) {
+                double busy = 0.0;
+                std::size_t bytes = 0, completed = 0;
+                std::vector<double> latencies;
+                item_t item;
+                while (state.writing.pop(item)) {
+                    auto start = steady::now();
+                    if (!spit(state.jobs[item.index].destination, item.encoded)) {
+                        busy += seconds_t(steady::now() - start).count();
+                        state.fail(item, "couldn't write the thumbnail");
+                        continue;
+                    }
+                    auto end = steady::now();
+                    busy += seconds_t(end - start).count();
+                    bytes += item.encoded.size();
+                    ++completed;
+                    latencies.push_back(std::chrono::duration<double, std::milli>(end - item.start).count());
+                    state.budget.release(item.held);
+                    bytevec_t().swap(item.encoded);
+                }
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.report.write_seconds += busy;
+                state.report.bytes_written += bytes;
+                state.report.completed += completed;
+                state.latencies.insert(state.latencies.end(), latencies.begin(), latencies.end());
+            }
+            
+            /// nearest-rank percentile of sorted values:
+            double percentile(std::vector<double> const& sorted, double p) {
+                if (sorted.empty()) { return 0.0; }
+                std::size_t rank = std::size_t(std::ceil(p * double(sorted.size())));
+                return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+            }
+            
+            unsigned workers(unsigned requested) {
+                return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+            }
+            
+        } /// namespace (anon.)
+        
+        std::pair<std::size_t, std::size_t> fit(std::size_t width, std::size_t height,
+                                                std::size_t size) noexcept {
+            if (!width || !height) { return { 0, 0 }; }
+            const double scale = std::min(1.0, std::min(double(size) / double(width),
+                                                        double(size) / double(height)));
+            return { std::max<std::size_t>(1, std::size_t(std::lround(width * scale))),
+                     std::max<std::size_t>(1, std::size_t(std::lround(height * scale))) };
+        }
+        
+        report_t generate(std::vector<job_t> const& jobs, codec_t const& codec,
+                          options const& opts) {
+            state_t state(jobs, codec, opts);
+            state.latencies.reserve(jobs.size());
+            auto start = steady::now();
+            
+            if (!codec.decode || !codec.encode) {
+                for (job_t const& job : jobs) {
+                    state.report.failures.emplace_back(job.source, "codec can't decode and encode");
+                }
+                return state.report;
+            }
+            
+            std::vector<std::thread> threads;
+            stage(threads, 1,                           &state.decoding,   [&]() { reader(state); });
+            stage(threads, workers(opts.decoders),      &state.resampling, [&]() { decoder(state); });
+            stage(threads, workers(opts.resamplers),    &state.encoding,   [&]() { resampler(state); });
+            stage(threads, workers(opts.encoders),      &state.writing,    [&]() { encoder(state); });
+            stage(threads, 1,                           nullptr,           [&]() { writer(state); });
+            for (std::thread& thread : threads) { thread.join(); }
+            
+            report_t& report = state.report;
+            report.seconds = seconds_t(steady::now() - start).count();
+            report.per_second = report.seconds > 0.0 ? double(report.completed) / report.seconds : 0.0;
+            report.peak_bytes = state.budget.high_water();
+            
+            std::sort(state.latencies.begin(), state.latencies.end());
+            report.latency_p50 = percentile(state.latencies, 0.50);
+            report.latency_p90 = percentile(state.latencies, 0.90);
+            report.latency_p99 = percentile(state.latencies, 0.99);
+            report.latency_max = state.latencies.empty() ? 0.0 : state.latencies.back();
+            return report;
+        }
+        
+        namespace {
+            
+            /// PAM headers: "P7", then KEY VALUE lines (and #-comments) up to ENDHDR
+            struct pam_header_t {
+                std::size_t width = 0;
+                std::size_t height = 0;
+                std::size_t depth = 0;
+                std::size_t maxval = 0;
+                std::string tupltype;
+                std::size_t offset = 0;             /// where the samples start
+            };
+            
+            bool parse_pam(bytevec_t const& data, pam_header_t& header) {
+                const std::size_t size = data.size();
+                char const* text = reinterpret_cast<char const*>(data.data());
+                if (size < 3 || std::strncmp(text, "P7\n", 3) != 0) { return false; }
+                std::size_t position = 3;
+                while (position < size) {
+                    std::size_t end = position;
+                    while (end < size && text[end] != '\n') { ++end; }
+                    if (end == size) { return false; }
+                    std::string line(text + position, end - position);
+                    position = end + 1;
+                    if (line.empty() || line[0] == '#') { continue; }
+                    if (line == "ENDHDR") {
+                        header.offset = position;
+                        if (!header.width || !header.height || !header.depth ||
+                            header.maxval != 255) { return false; }
+                        /// the dimensions come from the file: neither the samples nor
+                        /// the RGBA frame they decode into may overflow a size_t --
+                        std::size_t pixelcount, samples, decoded;
+                        if (__builtin_mul_overflow(header.width, header.height, &pixelcount) ||
+                            __builtin_mul_overflow(pixelcount, header.depth, &samples) ||
+                            __builtin_mul_overflow(pixelcount, std::size_t(4), &decoded)) { return false; }
+                        return size - position >= samples;
+                    }
+                    std::size_t space = line.find(' ');
+                    if (space == std::string::npos) { return false; }
+                    std::size_t start = line.find_first_not_of(' ', space);
+                    if (start == std::string::npos) { return false; }
+                    std::string key = line.substr(0, space);
+                    std::string value = line.substr(start);
+                    if (key == "TUPLTYPE") { header.tupltype = value; continue; }
+                    char* last = nullptr;
+                    unsigned long number = std::strtoul(value.c_str(), &last, 10);
+                    if (!last || *last) { return false; }
+                    if (key == "WIDTH")         { header.width = number;  }
+                    else if (key == "HEIGHT")   { header.height = number; }
+                    else if (key == "DEPTH")    { header.depth = number;  }
+                    else if (key == "MAXVAL")   { header.maxval = number; }
+                }
+                return false;
+            }
+            
+        } /// namespace (anon.)
+        
+        codec_t pam_codec() {
+            codec_t codec;
+            
+            codec.measure = [](bytevec_t const& data, std::size_t& width, std::size_t& height) {
+                pam_header_t header;
+                if (!parse_pam(data, header)) { return false; }
+                width = header.width;
+                height = header.height;
+                return true;
+            };
+            
+            codec.decode = [](bytevec_t const& data, frame_t& frame) {
+                pam_header_t header;
+                if (!parse_pam(data, header)) { return false; }
+                if (header.depth != 3 && header.depth != 4) { return false; }
+                frame.width = header.width;
+                frame.height = header.height;
+                frame.pixels.resize(header.width * header.height * 4);
+                byte* samples = const_cast<byte*>(data.data()) + header.offset;
+                
+                if (header.depth == 4) {
+                    return pixels::transfer(pixels::layout::interleaved(samples, 4, pixels::sample::u8,
+                                                                        header.width * 4, 4,
+                                                                        pixels::alpha::straight),
+                                            pixels::layout::interleaved(frame.pixels.data(), 4, pixels::sample::u8,
+                                                                        frame.width * 4, 4,
+                                                                        pixels::alpha::premultiplied),
+                                            frame.width, frame.height);
+                }
+                byte* out = frame.pixels.data();
+                for (std::size_t idx = 0; idx < header.width * header.height; ++idx) {
+                    out[4 * idx + 0] = samples[3 * idx + 0];
+                    out[4 * idx + 1] = samples[3 * idx + 1];
+                    out[4 * idx + 2] = samples[3 * idx + 2];
+                    out[4 * idx + 3] = 255;
+                }
+                return true;
+            };
+            
+            codec.encode = [](frame_t const& frame, bytevec_t& data) {
+                char header[128];
+                int length = std::snprintf(header, sizeof(header),
+                                           "P7\nWIDTH %zu\nHEIGHT %zu\nDEPTH 4\nMAXVAL 255\n"
+                                           "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+                                           frame.width, frame.height);
+                if (length <= 0 || std::size_t(length) >= sizeof(header)) { return false; }
+                data.resize(std::size_t(length) + frame.width * frame.height * 4);
+                std::memcpy(data.data(), header, length);
+                return pixels::transfer(pixels::layout::interleaved(const_cast<byte*>(frame.pixels.data()),
+                                                                    4, pixels::sample::u8,
+                                                                    frame.width * 4, 4,
+                                                                    pixels::alpha::premultiplied),
+                                        pixels::layout::interleaved(data.data() + length, 4, pixels::sample::u8,
+                                                                    frame.width * 4, 4,
+                                                                    pixels::alpha::straight),
+                                        frame.width, frame.height);
+            };
+            
+            return codec;
+        }
+        
+    } /// namespace thumbnails
+    
+} /// namespace objc
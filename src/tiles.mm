@@ -0,0 +1,319 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <cmath>
+#include <algorithm>
+
+#include <subjective-c/tiles.hh>
+#include <subjective-c/rehash.hh>
+#include <libimread/errors.hh>
+
+namespace objc {
+    
+    namespace cg {
+        
+        namespace {
+            
+            /// levels keep RGB images' color spaces, to spare a conversion per draw:
+            CGColorSpaceRef colorspace_for(CGImageRef image) {
+                CGColorSpaceRef colorspace = CGImageGetColorSpace(image);
+                if (colorspace && CGColorSpaceGetModel(colorspace) == kCGColorSpaceModelRGB) {
+                    return CGColorSpaceRetain(colorspace);
+                }
+                return CGColorSpaceCreateDeviceRGB();
+            }
+            
+            /// Renders all of `source` into a new `width` x `height` 8-bit RGBA image
+            /// with its own pixels -- scaling with high-quality interpolation, if need be:
+            __attribute__((cf_returns_retained))
+            CGImageRef render(CGImageRef source, std::size_t width, std::size_t height) {
+                CGColorSpaceRef colorspace = colorspace_for(source);
+                CGContextRef context = CGBitmapContextCreate(nullptr, width, height, 8, 0,
+                                                             colorspace, kCGImageAlphaPremultipliedLast);
+                CGColorSpaceRelease(colorspace);
+                if (!context) { return nullptr; }
+                
+                CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+                CGContextSetBlendMode(context, kCGBlendModeCopy);
+                CGContextDrawImage(context, CGRectMake(0, 0, width, height), source);
+                CGImageRef out = CGBitmapContextCreateImage(context);
+                CGContextRelease(context);
+                return out;
+            }
+            
+        } /// namespace (anon.)
+        
+        constexpr std::size_t tile_cache::default_budget;
+        constexpr std::size_t mip_pyramid::default_tile_size;
+        constexpr std::size_t mip_pyramid::default_threshold;
+        
+        bool tile_cache::key_t::operator==(key_t const& rhs) const noexcept {
+            return owner == rhs.owner && level == rhs.level &&
+                   column == rhs.column && row == rhs.row;
+        }
+        
+        std::size_t tile_cache::hasher_t::operator()(key_t const& key) const noexcept {
+            return hash::combine(key.owner, key.level, key.column, key.row);
+        }
+        
+        tile_cache& tile_cache::shared() {
+            /// never destroyed: pyramids purge their tiles during exit-time teardown
+            static tile_cache* cache = new tile_cache();
+            return *cache;
+        }
+        
+        tile_cache::tile_cache(std::size_t budget)
+            :limit(budget)
+            {}
+            
+        tile_cache::~tile_cache() {
+            for (entry_t& entry : entries) { CGImageRelease(entry.tile); }
+        }
+        
+        CGImageRef tile_cache::copy(key_t const& key) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = lookup.find(key);
+            if (found == lookup.end()) {
+                ++misscount;
+                return nullptr;
+            }
+            ++hitcount;
+            entries.splice(entries.begin(), entries, found->second);
+            return CGImageRetain(found->second->tile);
+        }
+        
+        void tile_cache::insert(key_t const& key, CGImageRef tile) {
+            if (!tile) { return; }
+            const std::size_t size = CGImageGetBytesPerRow(tile) * CGImageGetHeight(tile);
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = lookup.find(key);
+            if (found != lookup.end()) {
+                /// someone else rendered the same tile meanwhile:
+                total -= found->second->bytes;
+                CGImageRelease(found->second->tile);
+                entries.erase(found->second);
+                lookup.erase(found);
+            }
+            entries.push_front(entry_t{ key, CGImageRetain(tile), size });
+            lookup.emplace(key, entries.begin());
+            total += size;
+            trim();
+        }
+        
+        void tile_cache::trim() {
+            while (total > limit && !entries.empty()) {
+                entry_t& last = entries.back();
+                total -= last.bytes;
+                CGImageRelease(last.tile);
+                lookup.erase(last.key);
+                entries.pop_back();
+            }
+        }
+        
+        void tile_cache::purge(void const* owner) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (it->key.owner == owner) {
+                    total -= it->bytes;
+                    CGImageRelease(it->tile);
+                    lookup.erase(it->key);
+                    it = entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        
+        void tile_cache::clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (entry_t& entry : entries) { CGImageRelease(entry.tile); }
+            entries.clear();
+            lookup.clear();
+            total = 0;
+        }
+        
+        std::size_t tile_cache::size() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.size();
+        }
+        
+        std::size_t tile_cache::bytes() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return total;
+        }
+        
+        std::size_t tile_cache::budget() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return limit;
+        }
+        
+        void tile_cache::budget(std::size_t newbudget) {
+            std::lock_guard<std::mutex> lock(mutex);
+            limit = newbudget;
+            trim();
+        }
+        
+        std::size_t tile_cache::hits() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return hitcount;
+        }
+        
+        std::size_t tile_cache::misses() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return misscount;
+        }
+        
+        mip_pyramid::mip_pyramid(CGImageRef base, std::size_t tilesize, tile_cache& tilecache)
+            :image(CGImageRetain(base))
+            ,side(tilesize ? tilesize : default_tile_size)
+            ,cache(tilecache)
+            {
+                imread_assert(base != nullptr,
+                              "objc::cg::mip_pyramid: base image is NULL");
+                std::size_t w = CGImageGetWidth(base);
+                std::size_t h = CGImageGetHeight(base);
+                widths.push_back(w);
+                heights.push_back(h);
+                while (w > side || h > side) {
+                    w = std::max<std::size_t>(1, (w + 1) / 2);
+                    h = std::max<std::size_t>(1, (h + 1) / 2);
+                    widths.push_back(w);
+                    heights.push_back(h);
+                }
+            }
+            
+        mip_pyramid::~mip_pyramid() {
+            cache.purge(this);
+            CGImageRelease(image);
+        }
+        
+        std::size_t mip_pyramid::levels() const noexcept            { return widths.size(); }
+        std::size_t mip_pyramid::width(std::size_t lvl) const noexcept  { return widths[lvl]; }
+        std::size_t mip_pyramid::height(std::size_t lvl) const noexcept { return heights[lvl]; }
+        std::size_t mip_pyramid::tilesize() const noexcept          { return side; }
+        CGImageRef mip_pyramid::base() const noexcept               { return image; }
+        
+        std::size_t mip_pyramid::columns(std::size_t lvl) const noexcept {
+            return (widths[lvl] + side - 1) / side;
+        }
+        
+        std::size_t mip_pyramid::rows(std::size_t lvl) const noexcept {
+            return (heights[lvl] + side - 1) / side;
+        }
+        
+        std::size_t mip_pyramid::level_for(double scale) const noexcept {
+            /// never pick a level smaller than the destination --
+            /// i.e. round down, so CoreGraphics only ever shrinks a level:
+            if (!(scale > 0.0) || scale >= 1.0) { return 0; }
+            const double lvl = std::floor(std::log2(1.0 / scale));
+            return std::min(static_cast<std::size_t>(lvl), widths.size() - 1);
+        }
+        
+        CGImageRef mip_pyramid::level(std::size_t lvl) {
+            if (lvl == 0) { return CGImageRetain(image); }
+            
+            /// one renderer at a time, so that simultaneous misses don't all render:
+            std::lock_guard<std::mutex> lock(mutex);
+            if (CGImageRef cached = cache.copy({ this, lvl, 0, 0 })) { return cached; }
+            
+            /// start from the nearest larger level still in the cache (or level 0),
+            /// caching each one rendered on the way down:
+            std::size_t idx = lvl - 1;
+            CGImageRef previous = nullptr;
+            while (idx > 0 && !(previous = cache.copy({ this, idx, 0, 0 }))) { --idx; }
+            if (!previous) { previous = CGImageRetain(image); }
+            while (idx < lvl) {
+                ++idx;
+                CGImageRef next = render(previous, widths[idx], heights[idx]);
+                CGImageRelease(previous);
+                if (!next) { return nullptr; }
+                cache.insert({ this, idx, 0, 0 }, next);
+                previous = next;
+            }
+            return previous;
+        }
+        
+        CGImageRef mip_pyramid::crop(CGImageRef source, std::size_t lvl,
+                                     std::size_t column, std::size_t row) const {
+            const std::size_t x = column * side;
+            const std::size_t y = row * side;
+            const std::size_t w = std::min(side, widths[lvl] - x);
+            const std::size_t h = std::min(side, heights[lvl] - y);
+            
+            /// CGImageCreateWithImageInRect() counts rows from the top --
+            /// and its result shares the source's pixels:
+            return CGImageCreateWithImageInRect(source, CGRectMake(x, y, w, h));
+        }
+            
+        CGImageRef mip_pyramid::tile(std::size_t lvl, std::size_t column, std::size_t row) {
+            CGImageRef source = level(lvl);
+            if (!source) { return nullptr; }
+            CGImageRef out = crop(source, lvl, column, row);
+            CGImageRelease(source);
+            return out;
+        }
+        
+        std::size_t mip_pyramid::draw(CGContextRef context, CGRect destination) {
+            destination = CGRectStandardize(destination);
+            if (!context || CGRectIsEmpty(destination)) { return 0; }
+            CGRect visible = CGRectIntersection(destination, CGContextGetClipBoundingBox(context));
+            if (CGRectIsEmpty(visible)) { return 0; }
+            
+            /// device pixels per image pixel, along whichever axis needs more:
+            const CGSize device = CGSizeApplyAffineTransform(destination.size,
+                                  CGContextGetUserSpaceToDeviceSpaceTransform(context));
+            const double scale = std::max(std::fabs(device.width) / widths[0],
+                                          std::fabs(device.height) / heights[0]);
+            const std::size_t lvl = level_for(scale);
+            
+            /// level pixels per user-space unit, and the visible part
+            /// of the destination in level pixels (from the top left):
+            const double sx = double(widths[lvl]) / destination.size.width;
+            const double sy = double(heights[lvl]) / destination.size.height;
+            const double left   = (CGRectGetMinX(visible) - CGRectGetMinX(destination)) * sx;
+            const double right  = (CGRectGetMaxX(visible) - CGRectGetMinX(destination)) * sx;
+            const double top    = (CGRectGetMaxY(destination) - CGRectGetMaxY(visible)) * sy;
+            const double bottom = (CGRectGetMaxY(destination) - CGRectGetMinY(visible)) * sy;
+            
+            const std::size_t firstcolumn = std::size_t(std::max(0.0, std::floor(left / side)));
+            const std::size_t lastcolumn  = std::min(columns(lvl), std::size_t(std::ceil(right / side)));
+            const std::size_t firstrow    = std::size_t(std::max(0.0, std::floor(top / side)));
+            const std::size_t lastrow     = std::min(rows(lvl), std::size_t(std::ceil(bottom / side)));
+            
+            /// the level is fetched once -- a cache miss renders it, and this
+            /// reference keeps it alive through the draw, evicted or not:
+            CGImageRef source = level(lvl);
+            if (!source) { return 0; }
+            
+            std::size_t drawn = 0;
+            CGContextSaveGState(context);
+            
+            /// tiles meet exactly at their edges -- antialiasing those would show the seams:
+            CGContextSetShouldAntialias(context, false);
+            
+            for (std::size_t row = firstrow; row < lastrow; ++row) {
+                for (std::size_t column = firstcolumn; column < lastcolumn; ++column) {
+                    CGImageRef piece = crop(source, lvl, column, row);
+                    if (!piece) { continue; }
+                    const double x = double(column * side);
+                    const double y = double(row * side);
+                    const double w = double(CGImageGetWidth(piece));
+                    const double h = double(CGImageGetHeight(piece));
+                    CGContextDrawImage(context,
+                                       CGRectMake(CGRectGetMinX(destination) + x / sx,
+                                                  CGRectGetMaxY(destination) - (y + h) / sy,
+                                                  w / sx, h / sy),
+                                       piece);
+                    CGImageRelease(piece);
+                    ++drawn;
+                }
+            }
+            
+            CGContextRestoreGState(context);
+            CGImageRelease(source);
+            return drawn;
+        }
+        
+    } /// namespace cg
+    
+} /// namespace objc
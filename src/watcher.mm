@@ -0,0 +1,239 @@
+/// Copyright 2017 Alexander Böhn <fish2000@gmail.com>
+/// License: MIT (see COPYING.MIT file)
+
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <subjective-c/watcher.hh>
+
+#if defined(__OBJC__)
+#include <subjective-c/appkit.hh>
+#endif
+
+namespace objc {
+    
+    namespace appkit {
+        
+        using steady = std::chrono::steady_clock;
+        
+        watcher::watcher(counter_t c, typer_t t)
+            :watcher(std::move(c), std::move(t), options{})
+            {}
+            
+        watcher::watcher(counter_t c, typer_t t, options o)
+            :counter(std::move(c))
+            ,typer(std::move(t))
+            ,opts(o)
+            {
+                opts.fastest = std::max(opts.fastest, ms_t(1));
+                opts.slowest = std::max(opts.slowest, opts.fastest);
+                opts.backoff = std::max(opts.backoff, 1.0);
+                opts.workers = std::max(opts.workers, 1u);
+            }
+            
+        #if defined(__OBJC__)
+        
+        namespace {
+            
+            NSPasteboard* or_general(NSPasteboard* board) {
+                return board ? board : [NSPasteboard generalPasteboard];
+            }
+            
+            watcher::types_t types_of(NSArray<NSPasteboardType>* types) {
+                watcher::types_t out;
+                out.reserve(types.count);
+                for (NSPasteboardType type in types) {
+                    out.emplace_back(type.UTF8String);
+                }
+                return out;
+            }
+            
+        } /// namespace (anon.)
+        
+        watcher::watcher(NSPasteboard* board)
+            :watcher(board, options{})
+            {}
+            
+        watcher::watcher(NSPasteboard* board, options o)
+            :watcher([board = or_general(board)]() -> long { return [board changeCount]; },
+                     [board = or_general(board)]()         { return types_of([board types]); },
+                     o)
+            {}
+            
+        watcher::watcher(stand_in& board)
+            :watcher(board, options{})
+            {}
+            
+        watcher::watcher(stand_in& board, options o)
+            :watcher([&board]() -> long { return board.changecount(); },
+                     [&board]()         { return types_of(board.types()); },
+                     o)
+            {}
+            
+        #endif
+        
+        watcher::~watcher() {
+            stop();
+        }
+        
+        std::size_t watcher::subscribe(callback_t callback) {
+            std::lock_guard<std::mutex> lock(mutex);
+            callbacks.emplace(next_token, std::move(callback));
+            return next_token++;
+        }
+        
+        void watcher::unsubscribe(std::size_t token) {
+            std::lock_guard<std::mutex> lock(mutex);
+            callbacks.erase(token);
+        }
+        
+        void watcher::start() {
+            /// changes from before starting don't count:
+            const long baseline = counter();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (poller.joinable()) { return; }
+            stopping = false;
+            retiring = false;
+            poked = false;
+            for (unsigned idx = 0; idx < opts.workers; ++idx) {
+                workers.emplace_back(&watcher::work, this);
+            }
+            poller = std::thread(&watcher::poll, this, baseline);
+        }
+        
+        void watcher::poll(long baseline) {
+            std::unique_lock<std::mutex> lock(mutex);
+            long last = baseline;
+            bool pending = false;
+            steady::time_point burststart, lastchange;
+            ms_t interval = opts.fastest;
+            counts.interval = interval;
+            
+            while (true) {
+                wakeup.wait_for(lock, interval, [this]() { return stopping || poked; });
+                if (stopping) {
+                    /// a burst still settling when stopped gets reported as it stands:
+                    if (pending) {
+                        lock.unlock();
+                        notify(last);
+                        lock.lock();
+                    }
+                    break;
+                }
+                const bool waspoked = poked;
+                poked = false;
+                
+                lock.unlock();
+                const long changecount = counter();
+                const steady::time_point now = steady::now();
+                lock.lock();
+                ++counts.polls;
+                
+                if (changecount != last) {
+                    ++counts.changes;
+                    last = changecount;
+                    if (!pending) { burststart = now; }
+                    pending = true;
+                    lastchange = now;
+                    interval = opts.fastest;
+                } else if (waspoked) {
+                    interval = opts.fastest;
+                } else if (!pending) {
+                    ms_t grown(static_cast<ms_t::rep>(interval.count() * opts.backoff));
+                    interval = std::min(opts.slowest, std::max(grown, interval + ms_t(1)));
+                }
+                
+                /// a burst is over when it's gone quiet, or gone on too long:
+                if (pending && (now - lastchange >= opts.settle ||
+                                now - burststart >= opts.patience)) {
+                    pending = false;
+                    lock.unlock();
+                    notify(last);
+                    lock.lock();
+                }
+                counts.interval = interval;
+            }
+        }
+        
+        void watcher::stop() {
+            std::thread stopped;
+            std::vector<std::thread> stoppedworkers;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!poller.joinable()) { return; }
+                stopping = true;
+                stopped = std::move(poller);
+                stoppedworkers = std::move(workers);
+                workers.clear();
+            }
+            wakeup.notify_all();
+            stopped.join();
+            
+            /// the poll thread may have queued a last notification on its way out --
+            /// the workers hang on until that's been run too:
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                retiring = true;
+            }
+            ready.notify_all();
+            for (std::thread& worker : stoppedworkers) { worker.join(); }
+        }
+        
+        bool watcher::running() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return poller.joinable();
+        }
+        
+        void watcher::poke() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                poked = true;
+            }
+            wakeup.notify_all();
+        }
+        
+        watcher::stats_t watcher::stats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return counts;
+        }
+        
+        void watcher::notify(long changecount) {
+            /// read once per notification, and shared by every callback:
+            auto types = std::make_shared<const types_t>(typer());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++counts.notifications;
+                for (auto const& entry : callbacks) {
+                    callback_t callback = entry.second;
+                    tasks.emplace_back([callback, changecount, types]() {
+                        callback(changecount, *types);
+                    });
+                }
+            }
+            ready.notify_all();
+        }
+        
+        void watcher::work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                ready.wait(lock, [this]() { return retiring || !tasks.empty(); });
+                
+                /// queued callbacks still run, stopping or not:
+                if (tasks.empty()) { return; }
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                try {
+                    task();
+                } catch (std::exception const&) {
+                    /// a throwing callback loses its notification, not the worker
+                } catch (...) {}
+                lock.lock();
+                ++counts.callbacks;
+            }
+        }
+        
+    } /// namespace appkit
+    
+} /// namespace objc
@@ -1,11 +1,14 @@
 
+#include <chrono>
 #include <algorithm>
 #include <unordered_map>
 
 #include <subjective-c/subjective-c.hpp>
 #include <subjective-c/appkit.hh>
 #import  <subjective-c/categories/NSURL+IM.hh>
+#import  <subjective-c/categories/NSImage+ResizeBestFit.h>
 #include <libimread/ext/filesystem/path.h>
+#include <libimread/errors.hh>
 
 #include "include/test_data.hpp"
 #include "include/catch.hpp"
@@ -14,6 +17,33 @@ namespace {
     
     using filesystem::path;
     
+    /// a screenshot-sized opaque gradient, made in memory:
+    NSImage* gradient_image(std::size_t width, std::size_t height) {
+        NSBitmapImageRep* rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                        pixelsWide:width
+                                                                        pixelsHigh:height
+                                                                     bitsPerSample:8
+                                                                   samplesPerPixel:4
+                                                                          hasAlpha:YES
+                                                                          isPlanar:NO
+                                                                    colorSpaceName:NSDeviceRGBColorSpace
+                                                                       bytesPerRow:width * 4
+                                                                      bitsPerPixel:32];
+        objc::byte* pixels = [rep bitmapData];
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                objc::byte* pixel = pixels + (y * width + x) * 4;
+                pixel[0] = objc::byte(x * 255 / width);
+                pixel[1] = objc::byte(y * 255 / height);
+                pixel[2] = objc::byte((x ^ y) & 0xff);
+                pixel[3] = 255;
+            }
+        }
+        NSImage* image = [[NSImage alloc] initWithSize:NSMakeSize(width, height)];
+        [image addRepresentation:rep];
+        return image;
+    }
+    
     TEST_CASE("[appkit-copy-paste] Copy and paste PNG image data",
               "[appkit-copy-paste-png-image-data]")
     {
@@ -109,5 +139,258 @@ namespace {
         
     }
     
+    TEST_CASE("[appkit-copy-paste] Lazy copies encode each type once, on demand",
+              "[appkit-copy-paste-lazy-copies-encode-each-type-once-on-demand]")
+    {
+        @autoreleasepool {
+            NSImage* image = gradient_image(640, 480);
+            objc::appkit::stand_in board;
+            objc::appkit::promise_ptr promised = objc::appkit::image_promise(image);
+            
+            REQUIRE(objc::appkit::copy_lazy(board, promised));
+            CHECK(board.changecount() == 1);
+            CHECK(promised->encodes() == 0);
+            CHECK(objc::to_bool([board.types() isEqualToArray:@[ NSPasteboardTypePNG,
+                                                                 NSPasteboardTypeTIFF ]]));
+            
+            NSData* png = board.data(NSPasteboardTypePNG);
+            REQUIRE(png != nil);
+            CHECK(promised->encodes() == 1);
+            CHECK(promised->cached(NSPasteboardTypePNG));
+            CHECK(!promised->cached(NSPasteboardTypeTIFF));
+            CHECK(board.data(NSPasteboardTypePNG) == png);
+            CHECK(promised->data(NSPasteboardTypePNG) == png);
+            CHECK(promised->encodes() == 1);
+            
+            NSBitmapImageRep* decoded = [NSBitmapImageRep imageRepWithData:png];
+            REQUIRE(decoded != nil);
+            CHECK([decoded pixelsWide] == 640);
+            CHECK(board.data(NSPasteboardTypeTIFF) != nil);
+            CHECK(promised->encodes() == 2);
+            CHECK(board.data(NSPasteboardTypeString) == nil);
+            
+            /// clearing drops the promise, as a new copy does:
+            CHECK(board.clear() == 2);
+            CHECK(board.types().count == 0);
+            CHECK(board.data(NSPasteboardTypePNG) == nil);
+        };
+    }
+    
+    TEST_CASE("[appkit-copy-paste] Lazy copies through NSPasteboard",
+              "[appkit-copy-paste-lazy-copies-through-nspasteboard]")
+    {
+        @autoreleasepool {
+            NSImage* image = gradient_image(640, 480);
+            NSPasteboard* board = [NSPasteboard pasteboardWithUniqueName];
+            objc::appkit::promise_ptr promised = objc::appkit::image_promise(image);
+            
+            REQUIRE(objc::appkit::copy_lazy(board, promised));
+            CHECK([[board types] containsObject:NSPasteboardTypePNG]);
+            CHECK(!promised->cached(NSPasteboardTypeTIFF));
+            
+            NSData* png = [board dataForType:NSPasteboardTypePNG];
+            REQUIRE(png != nil);
+            CHECK(promised->cached(NSPasteboardTypePNG));
+            CHECK(objc::to_bool([png isEqualToData:[image dataForImageFileType:NSPNGFileType]]));
+            CHECK(objc::appkit::can_paste<NSImage>(board));
+            
+            [board releaseGlobally];
+        };
+    }
+    
+    TEST_CASE("[appkit-copy-paste] Benchmark time-to-copy, eager and lazy",
+              "[appkit-copy-paste-benchmark-time-to-copy-eager-lazy]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 4;
+        
+        @autoreleasepool {
+            NSImage* image = gradient_image(5120, 2880);
+            objc::appkit::stand_in board;
+            ms_t eagertime{ 0 }, lazytime{ 0 }, firsttime{ 0 }, cachedtime{ 0 };
+            
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    /// everything materialized, as copy_to() has it:
+                    auto eagerstart = clock_t::now();
+                    board.clear();
+                    board.write(NSPasteboardTypePNG, [image dataForImageFileType:NSPNGFileType]);
+                    board.write(NSPasteboardTypeTIFF, [image dataForImageFileType:NSTIFFFileType]);
+                    eagertime += clock_t::now() - eagerstart;
+                    
+                    auto lazystart = clock_t::now();
+                    objc::appkit::copy_lazy(board, image);
+                    lazytime += clock_t::now() - lazystart;
+                    
+                    auto firststart = clock_t::now();
+                    NSData* first = board.data(NSPasteboardTypePNG);
+                    firsttime += clock_t::now() - firststart;
+                    
+                    auto cachedstart = clock_t::now();
+                    NSData* cached = board.data(NSPasteboardTypePNG);
+                    cachedtime += clock_t::now() - cachedstart;
+                    CHECK(first == cached);
+                };
+            }
+            
+            WTF(FF("5120x2880 RGBA on a stand-in pasteboard, per copy (of %i):", runs),
+                FF("\tcopy, eager (PNG + TIFF): %.2fms", eagertime.count() / runs),
+                FF("\tcopy_lazy(): %.3fms", lazytime.count() / runs),
+                FF("\tfirst PNG read, lazy: %.2fms", firsttime.count() / runs),
+                FF("\tlater PNG reads, lazy: %.3fms", cachedtime.count() / runs));
+        };
+    }
+    
+    TEST_CASE("[appkit-copy-paste] Several types in one pass",
+              "[appkit-copy-paste-several-types-one-pass]")
+    {
+        path basedir(im::test::basedir);
+        const std::vector<path> pngs = basedir.list("*.png");
+        REQUIRE(!pngs.empty());
+        
+        @autoreleasepool {
+            NSPasteboard* board = [NSPasteboard pasteboardWithUniqueName];
+            NSURL* url = [[NSURL alloc] initFileURLWithFilesystemPath:basedir/pngs.front()];
+            NSImage* image = [[NSImage alloc] initWithContentsOfURL:url];
+            REQUIRE(objc::appkit::copy_to(board, image, url));
+            
+            auto [boardurl, boardimage] = objc::appkit::paste<NSURL, NSImage>(board);
+            REQUIRE(boardurl);
+            REQUIRE(boardimage);
+            CHECK(objc::to_bool([*boardurl isEqual:url]));
+            CHECK(objc::to_bool([[*boardimage TIFFRepresentation] isEqualToData:[image TIFFRepresentation]]));
+            
+            /// uncached, every read is its own -- no caller sees another's objects:
+            auto [againurl, againimage] = objc::appkit::paste<NSURL, NSImage>(board);
+            REQUIRE(againimage);
+            CHECK(*againimage != *boardimage);
+            CHECK(objc::to_bool([*againurl isEqual:*boardurl]));
+            
+            REQUIRE(objc::appkit::copy_to(board, image));
+            auto [newurl, newimage] = objc::appkit::paste<NSURL, NSImage>(board);
+            CHECK(!newurl);
+            CHECK(newimage);
+            CHECK(objc::appkit::paste<NSImage>(board) != nil);
+            CHECK(objc::appkit::paste<NSURL>(board) == nil);
+            
+            [board releaseGlobally];
+        };
+    }
+    
+    TEST_CASE("[appkit-copy-paste] A paste_cache, keyed by pasteboard and change count",
+              "[appkit-copy-paste-paste-cache-keyed-pasteboard-change-count]")
+    {
+        path basedir(im::test::basedir);
+        const std::vector<path> pngs = basedir.list("*.png");
+        REQUIRE(!pngs.empty());
+        
+        @autoreleasepool {
+            NSPasteboard* board = [NSPasteboard pasteboardWithUniqueName];
+            NSPasteboard* other = [NSPasteboard pasteboardWithUniqueName];
+            NSURL* url = [[NSURL alloc] initFileURLWithFilesystemPath:basedir/pngs.front()];
+            NSImage* image = [[NSImage alloc] initWithContentsOfURL:url];
+            REQUIRE(objc::appkit::copy_to(board, image, url));
+            REQUIRE(objc::appkit::copy_to(other, image));
+            
+            objc::appkit::paste_cache<NSURL, NSImage> cache;
+            auto [boardurl, boardimage] = cache.paste(board);
+            REQUIRE(boardurl);
+            REQUIRE(boardimage);
+            
+            /// same change count, same objects:
+            auto [againurl, againimage] = cache.paste(board);
+            CHECK(*againurl == *boardurl);
+            CHECK(*againimage == *boardimage);
+            
+            /// another pasteboard gets its own entry, and leaves the first one be:
+            auto [otherurl, otherimage] = cache.paste(other);
+            CHECK(!otherurl);
+            REQUIRE(otherimage);
+            CHECK(*otherimage != *boardimage);
+            CHECK(cache.size() == 2);
+            CHECK(*std::get<1>(cache.paste(board)) == *boardimage);
+            
+            /// a new copy invalidates them:
+            REQUIRE(objc::appkit::copy_to(board, image));
+            auto [newurl, newimage] = cache.paste(board);
+            CHECK(!newurl);
+            REQUIRE(newimage);
+            CHECK(*newimage != *boardimage);
+            
+            /// ... and clearing lets go of everything:
+            cache.clear();
+            CHECK(cache.size() == 0);
+            CHECK(*std::get<1>(cache.paste(board)) != *newimage);
+            
+            [board releaseGlobally];
+            [other releaseGlobally];
+        };
+    }
+    
+    TEST_CASE("[appkit-copy-paste] Benchmark probing for NSURL and NSImage",
+              "[appkit-copy-paste-benchmark-probing-nsurl-nsimage]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 1000;
+        
+        @autoreleasepool {
+            NSPasteboard* board = [NSPasteboard pasteboardWithUniqueName];
+            NSImage* image = gradient_image(640, 480);
+            NSURL* url = [NSURL fileURLWithPath:@"/tmp/gradient.png"];
+            REQUIRE(objc::appkit::copy_to(board, image, url));
+            
+            /// what paste<NSURL>() then paste<NSImage>() used to cost:
+            auto legacy = [board](Class cls) -> id {
+                if (![board canReadObjectForClasses:@[ cls ] options:@{ }]) { return nil; }
+                NSArray* out = [board readObjectsForClasses:@[ cls ] options:@{ }];
+                return out.count ? out[0] : nil;
+            };
+            
+            auto legacystart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    CHECK(legacy([NSURL class]) != nil);
+                    CHECK(legacy([NSImage class]) != nil);
+                };
+            }
+            ms_t legacytime = clock_t::now() - legacystart;
+            
+            auto onepassstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    auto [onepassurl, onepassimage] = objc::appkit::paste<NSURL, NSImage>(board);
+                    CHECK(onepassurl);
+                    CHECK(onepassimage);
+                };
+            }
+            ms_t onepasstime = clock_t::now() - onepassstart;
+            
+            objc::appkit::paste_cache<NSURL, NSImage> cache;
+            auto firststart = clock_t::now();
+            auto [firsturl, firstimage] = cache.paste(board);
+            ms_t firsttime = clock_t::now() - firststart;
+            CHECK(firsturl);
+            CHECK(firstimage);
+            
+            auto cachedstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                auto [cachedurl, cachedimage] = cache.paste(board);
+                CHECK(cachedurl);
+                CHECK(cachedimage);
+            }
+            ms_t cachedtime = clock_t::now() - cachedstart;
+            
+            [board releaseGlobally];
+            
+            WTF(FF("Reading an NSURL and an NSImage, per read (of %i):", runs),
+                FF("\tcan_paste + paste, for each type: %.3fms", legacytime.count() / runs),
+                FF("\tpaste<NSURL, NSImage>(): %.3fms", onepasstime.count() / runs),
+                FF("\tpaste_cache, first read: %.3fms", firsttime.count()),
+                FF("\tpaste_cache, unchanged pasteboard: %.4fms", cachedtime.count() / runs));
+        };
+    }
+    
 }
 
@@ -0,0 +1,181 @@
+
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/resource.h>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/appkit.hh>
+#include <subjective-c/watcher.hh>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using ms_t = objc::appkit::watcher::ms_t;
+    
+    /// user plus system CPU time for the process, so far:
+    double cpu_seconds() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+               double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+    
+    /// waits (a while, at most) for a predicate to come true:
+    template <typename Predicate> inline
+    bool eventually(Predicate&& predicate, ms_t timeout = ms_t(5000)) {
+        auto until = std::chrono::steady_clock::now() + timeout;
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() > until) { return false; }
+            std::this_thread::sleep_for(ms_t(5));
+        }
+        return true;
+    }
+    
+    TEST_CASE("[appkit-watcher] Coalesce a burst of changes into one notification",
+              "[appkit-watcher-coalesce-burst]")
+    {
+        @autoreleasepool {
+            objc::appkit::stand_in board;
+            objc::appkit::watcher::options options;
+            options.fastest = ms_t(5);
+            options.slowest = ms_t(50);
+            options.settle = ms_t(100);
+            options.patience = ms_t(2000);
+            objc::appkit::watcher watcher(board, options);
+            
+            std::mutex mutex;
+            std::vector<long> seen;
+            objc::appkit::watcher::types_t seentypes;
+            watcher.subscribe([&](long changecount, auto const& types) {
+                std::lock_guard<std::mutex> lock(mutex);
+                seen.push_back(changecount);
+                seentypes = types;
+            });
+            
+            /// changes from before starting don't get reported:
+            board.clear();
+            watcher.start();
+            CHECK(watcher.running());
+            
+            /// ... whereas a copy in several steps gets reported once:
+            long changecount = 0;
+            for (NSPasteboardType type : @[ NSPasteboardTypeString,
+                                            NSPasteboardTypeTIFF,
+                                            NSPasteboardTypePNG ]) {
+                changecount = board.clear();
+                board.write(type, [type dataUsingEncoding:NSUTF8StringEncoding]);
+                std::this_thread::sleep_for(ms_t(10));
+            }
+            
+            CHECK(eventually([&]() { return watcher.stats().callbacks == 1; }));
+            std::this_thread::sleep_for(options.settle * 3);
+            watcher.stop();
+            CHECK(!watcher.running());
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(seen.size() == 1);
+            CHECK(seen.front() == changecount);
+            REQUIRE(seentypes.size() == 1);
+            CHECK(seentypes.front() == std::string(NSPasteboardTypePNG.UTF8String));
+            CHECK(watcher.stats().notifications == 1);
+        };
+    }
+    
+    TEST_CASE("[appkit-watcher] Unsubscribe, poke, and survive a throwing callback",
+              "[appkit-watcher-unsubscribe-poke-throw]")
+    {
+        @autoreleasepool {
+            objc::appkit::stand_in board;
+            objc::appkit::watcher::options options;
+            options.fastest = ms_t(5);
+            options.slowest = ms_t(500);
+            options.settle = ms_t(0);
+            objc::appkit::watcher watcher(board, options);
+            
+            std::atomic<int> kept{ 0 };
+            std::atomic<int> dropped{ 0 };
+            watcher.subscribe([&](long, auto const&) {
+                ++kept;
+                throw std::runtime_error("callbacks that throw don't stop the watcher");
+            });
+            std::size_t token = watcher.subscribe([&](long, auto const&) { ++dropped; });
+            watcher.start();
+            
+            board.clear();
+            CHECK(eventually([&]() { return kept == 1 && dropped == 1; }));
+            watcher.unsubscribe(token);
+            
+            /// let the poll interval back off, all the way --
+            /// then a poke gets the next change noticed right away:
+            CHECK(eventually([&]() { return watcher.stats().interval == options.slowest; }));
+            board.clear();
+            watcher.poke();
+            CHECK(eventually([&]() { return kept == 2; }, options.slowest / 2));
+            CHECK(dropped == 1);
+            watcher.stop();
+        };
+    }
+    
+    TEST_CASE("[appkit-watcher] Report a burst that's still settling when stopped",
+              "[appkit-watcher-report-burst-settling-when-stopped]")
+    {
+        @autoreleasepool {
+            objc::appkit::stand_in board;
+            objc::appkit::watcher::options options;
+            options.fastest = ms_t(5);
+            options.settle = ms_t(60000);
+            options.patience = ms_t(60000);
+            objc::appkit::watcher watcher(board, options);
+            
+            std::atomic<long> seen{ 0 };
+            watcher.subscribe([&](long changecount, auto const&) { seen = changecount; });
+            watcher.start();
+            
+            const long changecount = board.clear();
+            CHECK(eventually([&]() { return watcher.stats().changes == 1; }));
+            CHECK(watcher.stats().notifications == 0);
+            watcher.stop();
+            
+            CHECK(watcher.stats().notifications == 1);
+            CHECK(watcher.stats().callbacks == 1);
+            CHECK(seen == changecount);
+        };
+    }
+    
+    TEST_CASE("[appkit-watcher] Benchmark idle CPU use of a watcher on a stand-in pasteboard",
+              "[appkit-watcher-benchmark-idle-cpu]")
+    {
+        /// SUBJECTIVE_C_WATCHER_IDLE_SECONDS=3600 for the hour-long run:
+        const char* env = std::getenv("SUBJECTIVE_C_WATCHER_IDLE_SECONDS");
+        const int seconds = env ? std::max(std::atoi(env), 1) : 10;
+        
+        @autoreleasepool {
+            objc::appkit::stand_in board;
+            objc::appkit::watcher watcher(board);
+            watcher.subscribe([](long, auto const&) {});
+            
+            const double cpustart = cpu_seconds();
+            watcher.start();
+            std::this_thread::sleep_for(std::chrono::seconds(seconds));
+            watcher.stop();
+            const double cpu = cpu_seconds() - cpustart;
+            
+            auto stats = watcher.stats();
+            CHECK(stats.changes == 0);
+            CHECK(stats.interval == objc::appkit::watcher::options{}.slowest);
+            
+            WTF(FF("Watching an idle stand-in pasteboard for %is:", seconds),
+                FF("\tpolls: %zu (settled at every %lldms)", stats.polls, (long long)stats.interval.count()),
+                FF("\tCPU time: %.2fms (%.5f%% of one core)", cpu * 1000.0, cpu * 100.0 / seconds));
+        };
+    }
+    
+}
+
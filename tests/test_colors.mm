@@ -0,0 +1,231 @@
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/colors.hh>
+#include <subjective-c/categories/NSColor+IM.hh>
+#include <libimread/color.hh>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::colors::curve;
+    using im::color::RGB;
+    using im::color::RGBA;
+    using im::color::Monochrome;
+    
+    std::vector<byte> noise(std::size_t size, unsigned seed = 0x9e3779b9) {
+        std::mt19937 generator(seed);
+        std::vector<byte> out(size);
+        std::generate(out.begin(), out.end(),
+                  [&]() { return static_cast<byte>(generator()); });
+        return out;
+    }
+    
+    std::vector<RGBA> palette(std::size_t count, unsigned seed = 0x9e3779b9) {
+        std::vector<byte> samples = noise(count * 4, seed);
+        std::vector<RGBA> out;
+        out.reserve(count);
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            byte const* s = samples.data() + idx * 4;
+            out.push_back(RGBA{ s[0], s[1], s[2], s[3] });
+        }
+        return out;
+    }
+    
+    TEST_CASE("[colors] 8-bit to float and back is exact, both curves",
+              "[colors-8-bit-to-float-and-back-exact-both-curves]")
+    {
+        /// odd lengths, so the vector loops and the scalar tails both run:
+        for (std::size_t count : { std::size_t(1), std::size_t(7), std::size_t(1021) }) {
+            for (std::size_t stride : { std::size_t(1), std::size_t(3), std::size_t(4) }) {
+                auto source = noise(count * stride, unsigned(count + stride));
+                std::vector<float> floats(source.size());
+                std::vector<byte> roundtrip(source.size());
+                for (curve c : { curve::linear, curve::srgb }) {
+                    const std::size_t colors = std::min<std::size_t>(stride, 3);
+                    objc::colors::decode(source.data(), floats.data(), count, stride, colors, c);
+                    objc::colors::encode(floats.data(), roundtrip.data(), count, stride, colors, c);
+                    CHECK(roundtrip == source);
+                }
+            }
+        }
+    }
+    
+    TEST_CASE("[colors] Decoding sRGB, clamping, and alpha passing through",
+              "[colors-decoding-srgb-clamping-alpha-passing-through]")
+    {
+        const byte rgba[] = { 0, 128, 255, 128 };
+        float floats[4];
+        objc::colors::decode(rgba, floats, 1, 4, 3, curve::srgb);
+        CHECK(floats[0] == 0.0f);
+        CHECK(floats[1] == Approx(0.2158605f).epsilon(1e-4));
+        CHECK(floats[2] == 1.0f);
+        CHECK(floats[3] == Approx(128.0f / 255.0f));
+        
+        /// NaN and negatives to zero, and overshoot to 255 -- in both vector and scalar code:
+        std::vector<float> odd(35);
+        for (std::size_t idx = 0; idx < odd.size(); ++idx) {
+            odd[idx] = idx % 3 == 0 ? NAN : idx % 3 == 1 ? -2.0f : 7.0f;
+        }
+        std::vector<byte> bytes(odd.size());
+        for (curve c : { curve::linear, curve::srgb }) {
+            objc::colors::encode(odd.data(), bytes.data(), odd.size(), 1, 1, c);
+            for (std::size_t idx = 0; idx < odd.size(); ++idx) {
+                CHECK(bytes[idx] == (idx % 3 == 2 ? 255 : 0));
+            }
+        }
+        
+        /// 8-bit recoding, in place:
+        std::vector<byte> samples = noise(4 * 999);
+        std::vector<byte> recoded = samples;
+        objc::colors::recode(recoded.data(), recoded.data(), 999, 4, 3, curve::linear, curve::srgb);
+        objc::colors::recode(recoded.data(), recoded.data(), 999, 4, 3, curve::srgb, curve::linear);
+        for (std::size_t idx = 0; idx < samples.size(); ++idx) {
+            if (idx % 4 == 3) {
+                CHECK(recoded[idx] == samples[idx]);
+            } else {
+                CHECK(std::abs(int(recoded[idx]) - int(samples[idx])) <= 1);
+            }
+        }
+    }
+    
+    TEST_CASE("[colors] NSColor span methods agree with the one-at-a-time ones",
+              "[colors-nscolor-span-methods-agree-one-at-a-time-ones]")
+    {
+        @autoreleasepool {
+            std::vector<RGBA> colors = palette(300);
+            NSColorSpace* srgb = [NSColorSpace sRGBColorSpace];
+            NSArray<NSColor*>* nscolors = [NSColor colorsWithUniformRGBA:colors.data()
+                                                                   count:colors.size()
+                                                              colorSpace:srgb];
+            REQUIRE(nscolors.count == colors.size());
+            for (std::size_t idx = 0; idx < colors.size(); ++idx) {
+                CHECK([nscolors[idx] alphaComponent] == Approx(colors[idx].components[3] / 255.0));
+                RGBA single = [nscolors[idx] uniformRGBA];
+                CHECK(std::abs(int(single.components[0]) - int(colors[idx].components[0])) <= 1);
+            }
+            
+            std::vector<RGBA> back(colors.size());
+            REQUIRE([NSColor getUniformRGBA:back.data() fromColors:nscolors colorSpace:srgb]);
+            for (std::size_t idx = 0; idx < colors.size(); ++idx) {
+                for (std::size_t c = 0; c < 4; ++c) {
+                    CHECK(back[idx].components[c] == colors[idx].components[c]);
+                }
+            }
+            
+            std::vector<Monochrome> grays(colors.size());
+            NSArray<NSColor*>* nsgrays = [NSColor colorsWithUniformMonochrome:grays.data()
+                                                                        count:grays.size()
+                                                                   colorSpace:[NSColorSpace genericGrayColorSpace]];
+            CHECK(nsgrays.count == grays.size());
+            CHECK([NSColor colorsWithUniformMonochrome:grays.data()
+                                                 count:grays.size()
+                                            colorSpace:srgb] == nil);
+        };
+    }
+    
+    TEST_CASE("[colors] Converting spans between color spaces",
+              "[colors-converting-spans-between-color-spaces]")
+    {
+        @autoreleasepool {
+            std::vector<RGBA> colors = palette(5000);
+            NSColorSpace* srgb = [NSColorSpace sRGBColorSpace];
+            NSColorSpace* device = [NSColorSpace deviceRGBColorSpace];
+            NSColorSpace* generic = [NSColorSpace genericRGBColorSpace];
+            
+            /// a space to itself is a copy:
+            std::vector<RGBA> same(colors.size());
+            REQUIRE([NSColor convertUniformRGBA:colors.data() toUniformRGBA:same.data() count:colors.size()
+                                 fromColorSpace:device toColorSpace:device]);
+            for (std::size_t idx = 0; idx < colors.size(); ++idx) {
+                CHECK(std::equal(same[idx].components, same[idx].components + 4,
+                                 colors[idx].components));
+            }
+            
+            /// sRGB to generic RGB (vImage), tracking NSColor's own conversion:
+            std::vector<RGBA> converted(colors.size());
+            REQUIRE([NSColor convertUniformRGBA:colors.data() toUniformRGBA:converted.data() count:colors.size()
+                                 fromColorSpace:srgb toColorSpace:generic]);
+            NSArray<NSColor*>* nscolors = [NSColor colorsWithUniformRGBA:colors.data() count:100 colorSpace:srgb];
+            for (std::size_t idx = 0; idx < 100; ++idx) {
+                NSColor* matched = [nscolors[idx] colorUsingColorSpace:generic];
+                CGFloat components[4];
+                [matched getComponents:components];
+                for (std::size_t c = 0; c < 4; ++c) {
+                    CHECK(std::abs(int(converted[idx].components[c]) - int(std::lround(components[c] * 255.0))) <= 2);
+                }
+            }
+            
+            /// and in place, with RGB and Monochrome:
+            std::vector<RGB> rgb(colors.size());
+            for (std::size_t idx = 0; idx < colors.size(); ++idx) {
+                rgb[idx] = RGB{ colors[idx].components[0], colors[idx].components[1], colors[idx].components[2] };
+            }
+            CHECK([NSColor convertUniformRGB:rgb.data() toUniformRGB:rgb.data() count:rgb.size()
+                              fromColorSpace:srgb toColorSpace:generic]);
+            std::vector<Monochrome> grays(colors.size());
+            CHECK([NSColor convertUniformMonochrome:grays.data() toUniformMonochrome:grays.data() count:grays.size()
+                                     fromColorSpace:[NSColorSpace genericGrayColorSpace]
+                                       toColorSpace:[NSColorSpace deviceGrayColorSpace]]);
+            CHECK(![NSColor convertUniformMonochrome:grays.data() toUniformMonochrome:grays.data() count:grays.size()
+                                      fromColorSpace:srgb toColorSpace:generic]);
+        };
+    }
+    
+    TEST_CASE("[colors] Benchmark span conversion against NSColor per pixel",
+              "[colors-benchmark-span-conversion-against-nscolor-per-pixel]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        
+        const std::size_t count = 10000000, sampled = 100000;
+        std::vector<byte> source = noise(count * 4);
+        std::vector<float> floats(source.size());
+        std::vector<byte> destination(source.size());
+        
+        auto decodestart = clock_t::now();
+        objc::colors::decode(source.data(), floats.data(), count, 4, 3, curve::srgb);
+        ms_t decodetime = clock_t::now() - decodestart;
+        auto encodestart = clock_t::now();
+        objc::colors::encode(floats.data(), destination.data(), count, 4, 3, curve::srgb);
+        ms_t encodetime = clock_t::now() - encodestart;
+        CHECK(destination == source);
+        
+        @autoreleasepool {
+            RGBA const* colors = reinterpret_cast<RGBA const*>(source.data());
+            RGBA* converted = reinterpret_cast<RGBA*>(destination.data());
+            auto spanstart = clock_t::now();
+            [NSColor convertUniformRGBA:colors toUniformRGBA:converted count:count
+                         fromColorSpace:[NSColorSpace sRGBColorSpace]
+                           toColorSpace:[NSColorSpace genericRGBColorSpace]];
+            ms_t spantime = clock_t::now() - spanstart;
+            
+            /// one NSColor per pixel -- for a sample, scaled up:
+            NSColorSpace* generic = [NSColorSpace genericRGBColorSpace];
+            auto nscolorstart = clock_t::now();
+            for (std::size_t idx = 0; idx < sampled; ++idx) {
+                @autoreleasepool {
+                    converted[idx] = [[[NSColor colorWithUniformRGBA:colors[idx]]
+                                                colorUsingColorSpace:generic] uniformRGBA];
+                };
+            }
+            ms_t nscolortime = clock_t::now() - nscolorstart;
+            
+            WTF("10^7 RGBA pixels:",
+                FF("\tsRGB -> linear float (objc::colors::decode): %.2fms", decodetime.count()),
+                FF("\tlinear float -> sRGB (objc::colors::encode): %.2fms", encodetime.count()),
+                FF("\tsRGB -> generic RGB, +convertUniformRGBA:...: %.2fms", spantime.count()),
+                FF("\tsRGB -> generic RGB, an NSColor apiece: %.2fms (extrapolated from 10^5)",
+                   nscolortime.count() * double(count / sampled)));
+        };
+    }
+    
+}
+
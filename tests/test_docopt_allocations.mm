@@ -0,0 +1,85 @@
+
+#include <map>
+#include <new>
+#include <string>
+#include <cstdlib>
+#include <iterator>
+#include <algorithm>
+
+#include "docopt.h"
+#include "docopt_table.h"
+#include "test_impaste_usage.hh"
+
+#include <libimread/errors.hh>
+#include "include/catch.hpp"
+
+/// Counts allocations on this thread, while counting is switched on --
+/// replacing the global operator new is the one portable way to see them,
+/// which is why this file gets an executable of its own (q.v. the
+/// `subjective-c_allocation_tests` target) rather than joining the others:
+namespace {
+    thread_local bool counting = false;
+    thread_local std::size_t allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    if (counting) { ++allocations; }
+    if (void* out = std::malloc(size ? size : 1)) { return out; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+    
+    /// allocations made by a function, on this thread:
+    template <typename Function> inline
+    std::size_t allocations_in(Function&& function) {
+        allocations = 0;
+        counting = true;
+        function();
+        counting = false;
+        return allocations;
+    }
+    
+    using optmap_t = std::map<std::string, docopt::value>;
+    
+    TEST_CASE("[docopt-allocations] Count allocations per parse, into maps and into flat tables",
+              "[docopt-allocations-count-maps-flat-tables]")
+    {
+        char const* cargv[] = { "-b", "-j", "4", "-V", "-o", "out" };
+        const int cargc = int(std::size(cargv));
+        
+        /// the map alone, and with a filtered copy, as impaste used to do:
+        std::size_t mapped = allocations_in([&]() {
+            optmap_t raw = docopt::docopt_parse(IMPASTE_USAGE_grammar, { cargv, cargv + cargc });
+            CHECK(raw.at("--jobs").asStringList().front() == "4");
+        });
+        std::size_t filtered = allocations_in([&]() {
+            optmap_t raw = docopt::docopt_parse(IMPASTE_USAGE_grammar, { cargv, cargv + cargc });
+            optmap_t args;
+            std::copy_if(raw.begin(), raw.end(),
+                         std::inserter(args, args.begin()),
+                      [](auto const& p) { return p.first.substr(0, 1) == "-"; });
+            CHECK(args.at("--jobs").asStringList().front() == "4");
+        });
+        
+        /// ... versus the flat table, whose values view argv:
+        std::size_t tabled = allocations_in([&]() {
+            docopt::table args = docopt::docopt_table_parse(IMPASTE_USAGE_grammar, cargc, cargv);
+            CHECK(args["--jobs"].asStringList()[0] == "4");
+        });
+        
+        CHECK(tabled < mapped);
+        CHECK(mapped < filtered);
+        
+        WTF("Allocations per parse of impaste's argv:",
+            FF("\tstd::map: %zu", mapped),
+            FF("\tstd::map, plus a filtered copy: %zu", filtered),
+            FF("\tdocopt::table: %zu", tabled));
+    }
+    
+}
+
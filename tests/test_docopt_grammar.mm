@@ -0,0 +1,174 @@
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+#include "docopt.h"
+#include "docopt_table.h"
+#include "test_impaste_usage.hh"
+#include "test_config_usage.hh"
+
+#include <libimread/errors.hh>
+#include "include/catch.hpp"
+
+namespace {
+    
+    using argv_t = std::vector<std::string>;
+    using optmap_t = std::map<std::string, docopt::value>;
+    
+    /// the parse result (or the error) as a string, for comparison:
+    template <typename Usage> inline
+    std::string parsed(Usage const& usage, argv_t const& argv) {
+        try {
+            std::ostringstream out;
+            for (auto const& arg : docopt::docopt_parse(usage, argv, true, true)) {
+                out << arg.first << "=" << arg.second << ";";
+            }
+            return out.str();
+        } catch (docopt::DocoptArgumentError const&) {
+            return "<argument error>";
+        } catch (docopt::DocoptExitHelp const&) {
+            return "<help>";
+        } catch (docopt::DocoptExitVersion const&) {
+            return "<version>";
+        }
+    }
+    
+    const std::vector<argv_t> impaste_argvs = {
+        { },
+        { "-c" },
+        { "--dry-run", "-V" },
+        { "-V", "-i", "image.png" },
+        { "--output=pasted.jpg" },
+        { "-b", "-j", "4", "-l", "-o", "out" },
+        { "--batch", "--jobs=8" },
+        { "-w", "-V", "-o", "out" },
+        { "--watch", "--batch" },
+        { "-x" },
+        { "--help" },
+        { "--version" }
+    };
+    
+    const std::vector<argv_t> config_argvs = {
+        { "--prefix" },
+        { "--libs" },
+        { "--cflags", "--ldflags" },
+        { "-h" },
+        { "--version" },
+        { "--bogus" }
+    };
+    
+    TEST_CASE("[docopt-grammar] Precompiled grammars parse as their usage strings do",
+              "[docopt-grammar-precompiled-parse-as-usage-strings]")
+    {
+        CHECK(std::string(IMPASTE_USAGE_grammar.doc) == IMPASTE_USAGE);
+        CHECK(std::string(CONFIG_USAGE_grammar.doc) == CONFIG_USAGE);
+        
+        for (argv_t const& argv : impaste_argvs) {
+            CHECK(parsed(IMPASTE_USAGE_grammar, argv) == parsed(std::string(IMPASTE_USAGE), argv));
+        }
+        for (argv_t const& argv : config_argvs) {
+            CHECK(parsed(CONFIG_USAGE_grammar, argv) == parsed(std::string(CONFIG_USAGE), argv));
+        }
+    }
+    
+    TEST_CASE("[docopt-grammar] Generated source is stable",
+              "[docopt-grammar-generated-source-stable]")
+    {
+        std::string source = docopt::compile(IMPASTE_USAGE, "IMPASTE_USAGE");
+        CHECK(source == docopt::compile(IMPASTE_USAGE, "IMPASTE_USAGE"));
+        CHECK(source.find("static docopt::grammar const IMPASTE_USAGE_grammar") != std::string::npos);
+        CHECK_THROWS_AS(docopt::compile("No usage section here", "BROKEN"),
+                        docopt::DocoptLanguageError);
+    }
+    
+    TEST_CASE("[docopt-grammar] Flat tables hold what the maps do",
+              "[docopt-grammar-flat-tables-hold-what-maps-do]")
+    {
+        for (argv_t const& argv : impaste_argvs) {
+            std::vector<char const*> cargv;
+            for (std::string const& arg : argv) { cargv.push_back(arg.c_str()); }
+            
+            std::string fromtable;
+            try {
+                docopt::table args = docopt::docopt_table_parse(IMPASTE_USAGE_grammar,
+                                                                int(cargv.size()), cargv.data());
+                CHECK(std::is_sorted(args.begin(), args.end(),
+                                     [](auto const& a, auto const& b) { return a.name < b.name; }));
+                                     
+                std::ostringstream out;
+                for (auto const& arg : args.map()) {
+                    out << arg.first << "=" << arg.second << ";";
+                    REQUIRE(args.find(arg.first) != nullptr);
+                    CHECK(args[arg.first].toValue() == arg.second);
+                }
+                fromtable = out.str();
+                CHECK(args.find("--no-such-option") == nullptr);
+                
+                /// string values are views into argv itself:
+                for (auto const& arg : args) {
+                    if (!arg.isString()) { continue; }
+                    char const* data = arg.asString().data();
+                    CHECK(std::any_of(cargv.begin(), cargv.end(), [&](char const* a) {
+                        return data >= a && data < a + std::strlen(a);
+                    }));
+                }
+            } catch (docopt::DocoptArgumentError const&) {
+                fromtable = "<argument error>";
+            } catch (docopt::DocoptExitHelp const&) {
+                fromtable = "<help>";
+            } catch (docopt::DocoptExitVersion const&) {
+                fromtable = "<version>";
+            }
+            CHECK(fromtable == parsed(IMPASTE_USAGE_grammar, argv));
+        }
+    }
+    
+    TEST_CASE("[docopt-grammar] Benchmark startup parsing with usage strings and precompiled grammars",
+              "[docopt-grammar-benchmark-startup-parsing]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 1000;
+        const argv_t argv = { "-b", "-j", "4", "-V", "-o", "out" };
+        
+        /// every process pays for its first parse -- the usage-string
+        /// path builds its regexes then, and only then:
+        auto coldgrammarstart = clock_t::now();
+        optmap_t coldgrammar = docopt::docopt_parse(IMPASTE_USAGE_grammar, argv);
+        ms_t coldgrammartime = clock_t::now() - coldgrammarstart;
+        
+        auto coldstringstart = clock_t::now();
+        optmap_t coldstring = docopt::docopt_parse(std::string(IMPASTE_USAGE), argv);
+        ms_t coldstringtime = clock_t::now() - coldstringstart;
+        
+        CHECK(coldgrammar == coldstring);
+        
+        auto stringstart = clock_t::now();
+        for (int idx = 0; idx < runs; ++idx) {
+            optmap_t args = docopt::docopt_parse(std::string(IMPASTE_USAGE), argv);
+            CHECK(args.size() == coldstring.size());
+        }
+        ms_t stringtime = clock_t::now() - stringstart;
+        
+        auto grammarstart = clock_t::now();
+        for (int idx = 0; idx < runs; ++idx) {
+            optmap_t args = docopt::docopt_parse(IMPASTE_USAGE_grammar, argv);
+            CHECK(args.size() == coldgrammar.size());
+        }
+        ms_t grammartime = clock_t::now() - grammarstart;
+        
+        WTF(FF("Parsing impaste's argv at startup (of %i):", runs),
+            FF("\tusage string, first parse: %.3fms", coldstringtime.count()),
+            FF("\tusage string, per parse: %.4fms", stringtime.count() / runs),
+            FF("\tprecompiled grammar, first parse: %.3fms", coldgrammartime.count()),
+            FF("\tprecompiled grammar, per parse: %.4fms", grammartime.count() / runs));
+    }
+    
+}
+
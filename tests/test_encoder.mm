@@ -0,0 +1,300 @@
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/encoder.hh>
+#include <subjective-c/appkit.hh>
+#import  <subjective-c/categories/NSImage+ResizeBestFit.h>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::bytevec_t;
+    using objc::cg::encoder;
+    using objc::cg::encoding;
+    
+    /// opaque, smooth content -- so PNG round-trips exactly and JPEG has something to compress:
+    NSImage* smooth_image(std::size_t width, std::size_t height) {
+        NSBitmapImageRep* rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                        pixelsWide:width
+                                                                        pixelsHigh:height
+                                                                     bitsPerSample:8
+                                                                   samplesPerPixel:4
+                                                                          hasAlpha:YES
+                                                                          isPlanar:NO
+                                                                    colorSpaceName:NSDeviceRGBColorSpace
+                                                                       bytesPerRow:width * 4
+                                                                      bitsPerPixel:32];
+        byte* pixels = [rep bitmapData];
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                byte* pixel = pixels + (y * width + x) * 4;
+                pixel[0] = byte(127.5 + 127.0 * std::sin(x * 0.021));
+                pixel[1] = byte(127.5 + 127.0 * std::cos(y * 0.017));
+                pixel[2] = byte((x + y) & 0xff);
+                pixel[3] = 255;
+            }
+        }
+        NSImage* image = [[NSImage alloc] initWithSize:NSMakeSize(width, height)];
+        [image addRepresentation:rep];
+        return image;
+    }
+    
+    /// what -PNGData used to do:
+    NSData* legacy_png(NSImage* image) {
+        NSData* imageData = [image TIFFRepresentation];
+        NSBitmapImageRep* imageRep = [NSBitmapImageRep imageRepWithData:imageData];
+        imageData = [imageRep representationUsingType:NSPNGFileType
+                                           properties:@{}];
+        return [NSData dataWithData:imageData];
+    }
+    
+    /// what impaste used to do to save a pasted image, whatever the format:
+    NSData* legacy_save(NSImage* image, NSBitmapImageFileType type) {
+        NSBitmapImageRep* bitmap = [[NSBitmapImageRep alloc] initWithData:[image TIFFRepresentation]];
+        return [bitmap representationUsingType:type
+                                    properties:@{}];
+    }
+    
+    TEST_CASE("[encoder] PNG round-trips the image's pixels",
+              "[encoder-png-round-trips-image-pixels]")
+    {
+        @autoreleasepool {
+            NSImage* image = smooth_image(320, 240);
+            NSData* png = [image PNGData];
+            REQUIRE(png != nil);
+            REQUIRE(png.length > 8);
+            CHECK(std::memcmp(png.bytes, "\x89PNG", 4) == 0);
+            
+            NSBitmapImageRep* original = (NSBitmapImageRep*)[[image representations] firstObject];
+            NSBitmapImageRep* decoded = [NSBitmapImageRep imageRepWithData:png];
+            REQUIRE(decoded != nil);
+            REQUIRE([decoded pixelsWide] == 320);
+            REQUIRE([decoded pixelsHigh] == 240);
+            REQUIRE([decoded bitsPerPixel] == 32);
+            for (std::size_t y = 0; y < 240; ++y) {
+                CHECK(std::memcmp([original bitmapData] + y * [original bytesPerRow],
+                                  [decoded bitmapData] + y * [decoded bytesPerRow], 320 * 4) == 0);
+            }
+        };
+    }
+    
+    TEST_CASE("[encoder] JPEG compression factors, and appending to sinks",
+              "[encoder-jpeg-compression-factors-appending-sinks]")
+    {
+        @autoreleasepool {
+            NSImage* image = smooth_image(320, 240);
+            NSData* best = [image JPEGData];
+            NSData* worst = [image JPEGDataWithCompression:0.1f];
+            REQUIRE(best != nil);
+            REQUIRE(worst != nil);
+            CHECK(std::memcmp(best.bytes, "\xff\xd8", 2) == 0);
+            CHECK(worst.length < best.length);
+            
+            NSMutableData* sink = [NSMutableData dataWithBytes:"prefix" length:6];
+            REQUIRE([image appendPNGDataTo:sink]);
+            NSData* png = [image PNGData];
+            REQUIRE(sink.length == 6 + png.length);
+            CHECK(std::memcmp(sink.bytes, "prefix", 6) == 0);
+            CHECK(std::memcmp(static_cast<byte const*>(sink.bytes) + 6, png.bytes, png.length) == 0);
+            
+            REQUIRE([image appendJPEGDataTo:sink compression:0.1f]);
+            CHECK(sink.length == 6 + png.length + worst.length);
+            
+            /// nothing to encode: no change to the sink
+            NSImage* empty = [[NSImage alloc] initWithSize:NSMakeSize(10, 10)];
+            const NSUInteger length = sink.length;
+            CHECK(![empty appendPNGDataTo:sink]);
+            CHECK(sink.length == length);
+        };
+    }
+    
+    TEST_CASE("[encoder] Reused sinks stop growing",
+              "[encoder-reused-sinks-stop-growing]")
+    {
+        @autoreleasepool {
+            NSImage* image = smooth_image(640, 480);
+            CGImageRef cgimage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+            encoder& local = encoder::local();
+            bytevec_t sink;
+            
+            REQUIRE(local.encode(cgimage, encoding::png, 1.0f, sink));
+            const bytevec_t first = sink;
+            const std::size_t growths = local.growths();
+            for (int idx = 0; idx < 8; ++idx) {
+                sink.clear();
+                REQUIRE(local.encode(cgimage, encoding::png, 1.0f, sink));
+                CHECK(sink == first);
+            }
+            CHECK(local.growths() == growths);
+            
+            /// the scratch buffer behind -PNGData, likewise:
+            [image PNGData];
+            const std::size_t capacity = local.capacity();
+            CHECK(capacity >= first.size());
+            for (int idx = 0; idx < 8; ++idx) { [image PNGData]; }
+            CHECK(local.capacity() == capacity);
+        };
+    }
+    
+    TEST_CASE("[encoder] Benchmark allocations and latency per encode",
+              "[encoder-benchmark-allocations-latency-per-encode]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 16;
+        
+        @autoreleasepool {
+            NSImage* image = smooth_image(2048, 1536);
+            encoder& local = encoder::local();
+            
+            const std::size_t tiffbytes = [image TIFFRepresentation].length;
+            auto legacystart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    legacy_png(image);
+                };
+            }
+            ms_t legacytime = clock_t::now() - legacystart;
+            
+            auto directstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    [image PNGData];
+                };
+            }
+            ms_t directtime = clock_t::now() - directstart;
+            
+            NSMutableData* sink = [NSMutableData data];
+            auto sinkstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    sink.length = 0;
+                    [image appendPNGDataTo:sink];
+                };
+            }
+            ms_t sinktime = clock_t::now() - sinkstart;
+            
+            CGImageRef cgimage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+            bytevec_t vector;
+            std::size_t growths = local.growths();
+            auto vectorstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                vector.clear();
+                local.encode(cgimage, encoding::png, 1.0f, vector);
+            }
+            ms_t vectortime = clock_t::now() - vectorstart;
+            growths = local.growths() - growths;
+            
+            WTF(FF("2048x1536 RGBA to PNG, per encode (of %i):", runs),
+                FF("\tTIFFRepresentation round-trip: %.2fms (%.1fMB of TIFF serialized, then parsed)",
+                   legacytime.count() / runs, double(tiffbytes) / (1024.0 * 1024.0)),
+                FF("\t-PNGData: %.2fms", directtime.count() / runs),
+                FF("\t-appendPNGDataTo: (reused NSMutableData): %.2fms", sinktime.count() / runs),
+                FF("\tencoder::encode() (reused bytevec_t): %.2fms, %.2f sink growths",
+                   vectortime.count() / runs, double(growths) / runs));
+        };
+    }
+    
+    TEST_CASE("[encoder] Saving from the best existing representation",
+              "[encoder-saving-from-best-existing-representation]")
+    {
+        @autoreleasepool {
+            NSImage* image = smooth_image(320, 240);
+            NSBitmapImageRep* large = [image bestBitmapImageRep];
+            REQUIRE(large != nil);
+            
+            /// a smaller rep alongside doesn't get picked:
+            NSImage* small = smooth_image(80, 60);
+            [image addRepresentation:[[small representations] firstObject]];
+            CHECK([image bestBitmapImageRep] == large);
+            
+            NSData* png = [image dataForImageFileType:NSPNGFileType];
+            REQUIRE(png != nil);
+            NSBitmapImageRep* decoded = [NSBitmapImageRep imageRepWithData:png];
+            REQUIRE(decoded != nil);
+            REQUIRE([decoded pixelsWide] == 320);
+            for (std::size_t y = 0; y < 240; ++y) {
+                CHECK(std::memcmp([large bitmapData] + y * [large bytesPerRow],
+                                  [decoded bitmapData] + y * [decoded bytesPerRow], 320 * 4) == 0);
+            }
+            
+            NSData* tiff = [image dataForImageFileType:NSTIFFFileType];
+            NSData* jpeg = [image dataForImageFileType:NSJPEGFileType];
+            NSData* bmp = [image dataForImageFileType:NSBMPFileType];
+            REQUIRE(tiff != nil);
+            REQUIRE(jpeg != nil);
+            REQUIRE(bmp != nil);
+            CHECK((std::memcmp(tiff.bytes, "MM", 2) == 0 || std::memcmp(tiff.bytes, "II", 2) == 0));
+            CHECK(std::memcmp(jpeg.bytes, "\xff\xd8", 2) == 0);
+            CHECK(std::memcmp(bmp.bytes, "BM", 2) == 0);
+            
+            /// nothing to encode:
+            NSImage* empty = [[NSImage alloc] initWithSize:NSMakeSize(10, 10)];
+            CHECK([empty bestBitmapImageRep] == nil);
+            CHECK([empty dataForImageFileType:NSPNGFileType] == nil);
+        };
+    }
+    
+    TEST_CASE("[encoder] Benchmark saving a pasted 5K screenshot",
+              "[encoder-benchmark-saving-pasted-5k-screenshot]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 4;
+        
+        @autoreleasepool {
+            /// a pasteboard holding PNG data, as a screenshot leaves it:
+            NSData* png = [smooth_image(5120, 2880) PNGData];
+            NSPasteboard* board = [NSPasteboard pasteboardWithUniqueName];
+            [board declareTypes:@[ NSPasteboardTypePNG ] owner:nil];
+            REQUIRE([board setData:png forType:NSPasteboardTypePNG]);
+            
+            /// each encoder gets an image of its own, pasted before its timer starts --
+            /// so neither is timed reading the pasteboard, or on reps the other made:
+            ms_t pastetime{ 0 }, legacytime{ 0 }, besttime{ 0 }, throughtime{ 0 };
+            for (int idx = 0; idx < runs; ++idx) {
+                @autoreleasepool {
+                    auto pastestart = clock_t::now();
+                    NSImage* legacyimage = objc::appkit::paste<NSImage>(board);
+                    pastetime += clock_t::now() - pastestart;
+                    NSImage* bestimage = objc::appkit::paste<NSImage>(board);
+                    REQUIRE(legacyimage != nil);
+                    REQUIRE(bestimage != nil);
+                    REQUIRE(bestimage != legacyimage);
+                    
+                    auto legacystart = clock_t::now();
+                    NSData* legacy = legacy_save(legacyimage, NSPNGFileType);
+                    legacytime += clock_t::now() - legacystart;
+                    
+                    auto beststart = clock_t::now();
+                    NSData* best = [bestimage dataForImageFileType:NSPNGFileType];
+                    besttime += clock_t::now() - beststart;
+                    
+                    auto throughstart = clock_t::now();
+                    NSData* through = [board dataForType:NSPasteboardTypePNG];
+                    throughtime += clock_t::now() - throughstart;
+                    
+                    CHECK(legacy.length > 0);
+                    CHECK(best.length > 0);
+                    CHECK(objc::to_bool([through isEqualToData:png]));
+                };
+            }
+            [board releaseGlobally];
+            
+            WTF(FF("5120x2880 PNG on the pasteboard, saved as PNG, per save (of %i):", runs),
+                FF("\tpaste<NSImage>() alone: %.2fms", pastetime.count() / runs),
+                FF("\tTIFFRepresentation round-trip, encode: %.2fms", legacytime.count() / runs),
+                FF("\t-dataForImageFileType: (best rep): %.2fms", besttime.count() / runs),
+                FF("\tpasteboard PNG data, written through: %.2fms", throughtime.count() / runs));
+        };
+    }
+    
+}
+
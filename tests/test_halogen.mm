@@ -0,0 +1,420 @@
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/halogen.hh>
+#include <subjective-c/resample.hh>
+#import  <subjective-c/categories/NSBitmapImageRep+IM.hh>
+#import  <subjective-c/categories/NSImage+Resize.h>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::pixels::layout;
+    using objc::pixels::sample;
+    using objc::pixels::alpha;
+    using objc::resample::filter;
+    using objc::halogen::buffer_t;
+    using objc::halogen::colorspace;
+    
+    std::vector<byte> noise(std::size_t size, unsigned seed = 0x9e3779b9) {
+        std::mt19937 generator(seed);
+        std::vector<byte> out(size);
+        std::generate(out.begin(), out.end(),
+                  [&]() { return static_cast<byte>(generator()); });
+        return out;
+    }
+    
+    /// band-limited test content, as in test_resample.mm:
+    std::vector<byte> smooth(std::size_t width, std::size_t height) {
+        std::vector<byte> out(width * height * 4);
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                for (std::size_t c = 0; c < 4; ++c) {
+                    const double v = 127.5 + 60.0 * std::sin(x * 0.031 * (c + 1) + y * 0.017) +
+                                             60.0 * std::cos(y * 0.023 * (c + 1) - x * 0.011);
+                    out[(y * width + x) * 4 + c] = byte(std::lround(std::min(255.0, std::max(0.0, v))));
+                }
+            }
+        }
+        return out;
+    }
+    
+    buffer_t buffer(void* data, std::size_t width, std::size_t height,
+                    sample kind = sample::u8) {
+        buffer_t out;
+        out.data = static_cast<byte*>(data);
+        out.width = width;
+        out.height = height;
+        out.channels = 4;
+        out.kind = kind;
+        return out;
+    }
+    
+    layout rgba(std::vector<byte>& pixels, std::size_t width, alpha mode) {
+        return layout::interleaved(pixels.data(), 4, sample::u8, width * 4, 4, mode);
+    }
+    
+    int maxdelta(byte const* lhs, byte const* rhs, std::size_t size) {
+        int out = 0;
+        for (std::size_t idx = 0; idx < size; ++idx) {
+            out = std::max(out, std::abs(int(lhs[idx]) - int(rhs[idx])));
+        }
+        return out;
+    }
+    
+    NSBitmapImageRep* bitmap(NSInteger width, NSInteger height, NSBitmapFormat format) {
+        return [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                       pixelsWide:width
+                                                       pixelsHigh:height
+                                                    bitsPerSample:8
+                                                  samplesPerPixel:4
+                                                         hasAlpha:YES
+                                                         isPlanar:NO
+                                                   colorSpaceName:NSDeviceRGBColorSpace
+                                                     bitmapFormat:format
+                                                      bytesPerRow:0
+                                                     bitsPerPixel:0];
+    }
+    
+    /// copy packed pixels into a (possibly padded) rep, and back out:
+    void fill(NSBitmapImageRep* rep, std::vector<byte> const& pixels) {
+        const std::size_t row = [rep pixelsWide] * 4;
+        for (NSInteger y = 0; y < [rep pixelsHigh]; ++y) {
+            std::memcpy([rep bitmapData] + y * [rep bytesPerRow], pixels.data() + y * row, row);
+        }
+    }
+    
+    std::vector<byte> contents(NSBitmapImageRep* rep) {
+        const std::size_t row = [rep pixelsWide] * 4;
+        std::vector<byte> out(row * [rep pixelsHigh]);
+        for (NSInteger y = 0; y < [rep pixelsHigh]; ++y) {
+            std::memcpy(out.data() + y * row, [rep bitmapData] + y * [rep bytesPerRow], row);
+        }
+        return out;
+    }
+    
+    /// what -resizeImageToSize: did before objc::resample:
+    NSImage* legacy_resize(NSImage* image, NSSize size) {
+        NSImage* target = [[NSImage alloc] initWithSize:size];
+        [target lockFocus];
+        [image drawInRect:NSMakeRect(0, 0, size.width, size.height)
+                 fromRect:NSZeroRect
+                operation:NSCompositeCopy
+                 fraction:1.0f
+           respectFlipped:YES
+                    hints:@{ NSImageHintInterpolation : @(NSImageInterpolationHigh) }];
+        [target unlockFocus];
+        return target;
+    }
+    
+    TEST_CASE("[halogen] Premultiplication matches objc::pixels bit-for-bit",
+              "[halogen-premultiplication-matches-pixels]")
+    {
+        const std::size_t width = 613, height = 97;
+        auto straight = noise(width * height * 4);
+        std::vector<byte> expected(straight.size()), roundtrip(straight.size());
+        objc::pixels::transfer(rgba(straight, width, alpha::straight),
+                               rgba(expected, width, alpha::premultiplied),
+                               width, height, false);
+        objc::pixels::transfer(rgba(expected, width, alpha::premultiplied),
+                               rgba(roundtrip, width, alpha::straight),
+                               width, height, false);
+                               
+        if (objc::halogen::available()) {
+            std::vector<byte> premultiplied(straight.size()), unpremultiplied(straight.size());
+            CHECK(objc::halogen::premultiply(buffer(straight.data(), width, height),
+                                             buffer(premultiplied.data(), width, height)));
+            CHECK(premultiplied == expected);
+            CHECK(objc::halogen::unpremultiply(buffer(premultiplied.data(), width, height),
+                                               buffer(unpremultiplied.data(), width, height)));
+            CHECK(unpremultiplied == roundtrip);
+            
+            /// in place:
+            std::vector<byte> inplace = straight;
+            CHECK(objc::halogen::premultiply(buffer(inplace.data(), width, height),
+                                             buffer(inplace.data(), width, height)));
+            CHECK(inplace == expected);
+            
+            /// mismatched sizes and sample kinds are refused:
+            CHECK(!objc::halogen::premultiply(buffer(straight.data(), width, height),
+                                              buffer(premultiplied.data(), width - 1, height)));
+            CHECK(!objc::halogen::premultiply(buffer(straight.data(), width / 4, height, sample::f32),
+                                              buffer(premultiplied.data(), width / 4, height, sample::f32)));
+        } else {
+            CHECK(!objc::halogen::premultiply(buffer(straight.data(), width, height),
+                                              buffer(expected.data(), width, height)));
+        }
+        
+        /// the category methods, whichever way they go about it:
+        @autoreleasepool {
+            NSBitmapImageRep* rep = bitmap(width, height, NSAlphaNonpremultipliedBitmapFormat);
+            fill(rep, straight);
+            NSBitmapImageRep* premultiplied = [rep bitmapImageRepByPremultiplyingAlpha];
+            REQUIRE(premultiplied != nil);
+            CHECK(!([premultiplied bitmapFormat] & NSAlphaNonpremultipliedBitmapFormat));
+            CHECK(contents(premultiplied) == expected);
+            
+            NSBitmapImageRep* unpremultiplied = [premultiplied bitmapImageRepByUnpremultiplyingAlpha];
+            REQUIRE(unpremultiplied != nil);
+            CHECK([unpremultiplied bitmapFormat] & NSAlphaNonpremultipliedBitmapFormat);
+            CHECK(contents(unpremultiplied) == roundtrip);
+        };
+    }
+    
+    TEST_CASE("[halogen] Channel reordering",
+              "[halogen-channel-reordering]")
+    {
+        const std::size_t width = 301, height = 53;
+        auto source = noise(width * height * 4);
+        const std::array<uint8_t, 4> order = {{ 2, 1, 0, 3 }};
+        std::vector<byte> expected(source.size());
+        for (std::size_t idx = 0; idx < source.size(); idx += 4) {
+            for (std::size_t c = 0; c < 4; ++c) { expected[idx + c] = source[idx + order[c]]; }
+        }
+        
+        if (objc::halogen::available()) {
+            std::vector<byte> reordered(source.size());
+            CHECK(objc::halogen::reorder(buffer(source.data(), width, height),
+                                         buffer(reordered.data(), width, height), order));
+            CHECK(reordered == expected);
+            CHECK(!objc::halogen::reorder(buffer(source.data(), width, height),
+                                          buffer(source.data(), width, height), order));
+            CHECK(!objc::halogen::reorder(buffer(source.data(), width, height),
+                                          buffer(reordered.data(), width, height), {{ 0, 1, 2, 4 }}));
+        }
+        
+        @autoreleasepool {
+            NSBitmapImageRep* rep = bitmap(width, height, NSAlphaNonpremultipliedBitmapFormat);
+            fill(rep, source);
+            NSBitmapImageRep* reordered = [rep bitmapImageRepByReorderingChannels:order];
+            REQUIRE(reordered != nil);
+            CHECK([reordered bitmapFormat] == [rep bitmapFormat]);
+            CHECK(contents(reordered) == expected);
+            const std::array<uint8_t, 4> invalid = {{ 0, 1, 2, 7 }};
+            CHECK([rep bitmapImageRepByReorderingChannels:invalid] == nil);
+        };
+    }
+    
+    TEST_CASE("[halogen] Resampling agrees with objc::resample",
+              "[halogen-resampling-agrees-with-resample]")
+    {
+        if (!objc::halogen::available()) {
+            WTF("Built without the halogen pipelines -- skipping");
+            return;
+        }
+        
+        const std::size_t side = 512;
+        auto source = smooth(side, side);
+        const filter filters[] = { filter::box, filter::bilinear, filter::lanczos3, filter::mitchell };
+        const std::pair<std::size_t, std::size_t> sizes[] = { { 128, 200 }, { 511, 97 }, { 1031, 768 } };
+        
+        for (filter kernel : filters) {
+            for (auto const& size : sizes) {
+                std::vector<byte> expected(size.first * size.second * 4), resized(expected.size());
+                objc::resample::options opts;
+                opts.kernel = kernel;
+                REQUIRE(objc::resample::resize(buffer(source.data(), side, side),
+                                               buffer(expected.data(), size.first, size.second), opts));
+                REQUIRE(objc::halogen::resize(buffer(source.data(), side, side),
+                                              buffer(resized.data(), size.first, size.second), opts));
+                /// fixed-point vs. float weights:
+                CHECK(maxdelta(expected.data(), resized.data(), expected.size()) <= 2);
+            }
+        }
+        
+        /// floats, and a region:
+        std::vector<float> floats(source.begin(), source.end());
+        std::vector<float> expected(200 * 150 * 4), resized(expected.size());
+        objc::resample::options opts;
+        opts.region = objc::resample::region_t{ 10.5, 20.25, 300.0, 225.0 };
+        REQUIRE(objc::resample::resize(buffer(floats.data(), side, side, sample::f32),
+                                       buffer(expected.data(), 200, 150, sample::f32), opts));
+        REQUIRE(objc::halogen::resize(buffer(floats.data(), side, side, sample::f32),
+                                      buffer(resized.data(), 200, 150, sample::f32), opts));
+        for (std::size_t idx = 0; idx < expected.size(); ++idx) {
+            CHECK(std::fabs(expected[idx] - resized[idx]) < 1e-2f);
+        }
+        
+        /// what objc::halogen declines:
+        opts.vectorize = false;
+        CHECK(!objc::halogen::resize(buffer(floats.data(), side, side, sample::f32),
+                                     buffer(resized.data(), 200, 150, sample::f32), opts));
+    }
+    
+    TEST_CASE("[halogen] Color conversion round-trips, and tracks ColorSync",
+              "[halogen-color-conversion-round-trips-tracks-colorsync]")
+    {
+        const std::size_t width = 256, height = 256;
+        auto source = smooth(width, height);
+        
+        if (objc::halogen::available()) {
+            std::vector<byte> wide(source.size()), back(source.size()), same(source.size());
+            REQUIRE(objc::halogen::convert(buffer(source.data(), width, height),
+                                           buffer(wide.data(), width, height),
+                                           colorspace::srgb, colorspace::display_p3));
+            REQUIRE(objc::halogen::convert(buffer(wide.data(), width, height),
+                                           buffer(back.data(), width, height),
+                                           colorspace::display_p3, colorspace::srgb));
+            CHECK(maxdelta(source.data(), back.data(), source.size()) <= 2);
+            
+            /// sRGB to itself is the identity, give or take the encoding table:
+            REQUIRE(objc::halogen::convert(buffer(source.data(), width, height),
+                                           buffer(same.data(), width, height),
+                                           colorspace::srgb, colorspace::srgb));
+            CHECK(maxdelta(source.data(), same.data(), source.size()) <= 1);
+            
+            /// alpha passes through:
+            for (std::size_t idx = 3; idx < source.size(); idx += 4) {
+                if (wide[idx] != source[idx]) { FAIL("alpha changed"); }
+            }
+        }
+        
+        @autoreleasepool {
+            NSBitmapImageRep* rep = bitmap(width, height, NSAlphaNonpremultipliedBitmapFormat);
+            fill(rep, source);
+            rep = [rep bitmapImageRepByRetaggingWithColorSpace:[NSColorSpace sRGBColorSpace]];
+            NSColorSpace* p3 = [NSColorSpace displayP3ColorSpace];
+            NSBitmapImageRep* matched = [rep bitmapImageRepByMatchingToColorSpace:p3];
+            NSBitmapImageRep* colorsynced = [rep bitmapImageRepByConvertingToColorSpace:p3
+                                                                        renderingIntent:NSColorRenderingIntentDefault];
+            REQUIRE(matched != nil);
+            REQUIRE(colorsynced != nil);
+            CHECK([[matched colorSpace] isEqual:p3]);
+            
+            /// ColorSync may hand back a different layout -- compare by pixel:
+            double total = 0.0;
+            for (NSInteger y = 0; y < NSInteger(height); y += 7) {
+                for (NSInteger x = 0; x < NSInteger(width); x += 7) {
+                    NSUInteger lhs[4], rhs[4];
+                    [matched getPixel:lhs atX:x y:y];
+                    [colorsynced getPixel:rhs atX:x y:y];
+                    for (std::size_t c = 0; c < 3; ++c) {
+                        total += std::abs(long(lhs[c]) - long(rhs[c]));
+                    }
+                }
+            }
+            const double samples = 3.0 * ((width + 6) / 7) * ((height + 6) / 7);
+            CHECK(total / samples < 1.5);
+        };
+    }
+    
+    TEST_CASE("[halogen] Benchmark the pipelines against the AppKit paths",
+              "[halogen-benchmark-pipelines-against-appkit-paths]")
+    {
+        if (!objc::halogen::available()) {
+            WTF("Built without the halogen pipelines -- skipping");
+            return;
+        }
+        
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const std::size_t big = 4096, small = 1024;
+        auto source = noise(big * big * 4);
+        std::vector<byte> destination(source.size());
+        const double megapixels = double(big * big) / 1e6;
+        
+        auto time = [](auto&& work) {
+            auto start = clock_t::now();
+            work();
+            ms_t elapsed = clock_t::now() - start;
+            return elapsed.count();
+        };
+        
+        @autoreleasepool {
+            NSBitmapImageRep* rep = bitmap(big, big, NSAlphaNonpremultipliedBitmapFormat);
+            fill(rep, source);
+            
+            /// premultiplication: halogen, objc::pixels, and drawing into a CGBitmapContext
+            double halogentime = time([&]() {
+                objc::halogen::premultiply(buffer(source.data(), big, big),
+                                           buffer(destination.data(), big, big));
+            });
+            double pixelstime = time([&]() {
+                objc::pixels::transfer(rgba(source, big, alpha::straight),
+                                       rgba(destination, big, alpha::premultiplied),
+                                       big, big);
+            });
+            double appkittime = time([&]() {
+                CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+                CGContextRef context = CGBitmapContextCreate(destination.data(), big, big, 8, big * 4,
+                                                             colorspace, kCGImageAlphaPremultipliedLast);
+                CGContextSetBlendMode(context, kCGBlendModeCopy);
+                CGContextDrawImage(context, CGRectMake(0, 0, big, big), [rep CGImage]);
+                CGContextRelease(context);
+                CGColorSpaceRelease(colorspace);
+            });
+            WTF("4096x4096 RGBA, straight to premultiplied alpha:",
+                FF("\thalogen: %.2fms (%.1f MP/s)", halogentime, megapixels / halogentime * 1e3),
+                FF("\tobjc::pixels::transfer(): %.2fms (%.1f MP/s)", pixelstime, megapixels / pixelstime * 1e3),
+                FF("\tCGContextDrawImage(): %.2fms (%.1f MP/s)", appkittime, megapixels / appkittime * 1e3));
+                
+            /// RGBA to BGRA: halogen, and drawing into a BGRA context
+            halogentime = time([&]() {
+                objc::halogen::reorder(buffer(source.data(), big, big),
+                                       buffer(destination.data(), big, big), {{ 2, 1, 0, 3 }});
+            });
+            appkittime = time([&]() {
+                CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+                CGContextRef context = CGBitmapContextCreate(destination.data(), big, big, 8, big * 4, colorspace,
+                                                             kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+                CGContextSetBlendMode(context, kCGBlendModeCopy);
+                CGContextDrawImage(context, CGRectMake(0, 0, big, big), [rep CGImage]);
+                CGContextRelease(context);
+                CGColorSpaceRelease(colorspace);
+            });
+            WTF("4096x4096 RGBA to BGRA:",
+                FF("\thalogen: %.2fms (%.1f MP/s)", halogentime, megapixels / halogentime * 1e3),
+                FF("\tCGContextDrawImage(): %.2fms (%.1f MP/s)", appkittime, megapixels / appkittime * 1e3));
+                
+            /// sRGB to Display P3: halogen, and ColorSync
+            NSBitmapImageRep* srgb = [rep bitmapImageRepByRetaggingWithColorSpace:[NSColorSpace sRGBColorSpace]];
+            NSColorSpace* p3 = [NSColorSpace displayP3ColorSpace];
+            halogentime = time([&]() {
+                objc::halogen::convert(buffer(source.data(), big, big),
+                                       buffer(destination.data(), big, big),
+                                       colorspace::srgb, colorspace::display_p3);
+            });
+            appkittime = time([&]() {
+                CHECK([srgb bitmapImageRepByConvertingToColorSpace:p3
+                                                   renderingIntent:NSColorRenderingIntentDefault] != nil);
+            });
+            WTF("4096x4096 RGBA, sRGB to Display P3:",
+                FF("\thalogen: %.2fms (%.1f MP/s)", halogentime, megapixels / halogentime * 1e3),
+                FF("\t-bitmapImageRepByConvertingToColorSpace:: %.2fms (%.1f MP/s)", appkittime, megapixels / appkittime * 1e3));
+                
+            /// 4096x4096 down to 1024x1024: halogen, objc::resample and lockFocus
+            objc::resample::options opts;
+            halogentime = time([&]() {
+                objc::halogen::resize(buffer(source.data(), big, big),
+                                      buffer(destination.data(), small, small), opts);
+            });
+            double resampletime = time([&]() {
+                objc::resample::resize(buffer(source.data(), big, big),
+                                       buffer(destination.data(), small, small), opts);
+            });
+            NSImage* image = [[NSImage alloc] initWithSize:NSMakeSize(big, big)];
+            [image addRepresentation:rep];
+            appkittime = time([&]() {
+                CHECK(legacy_resize(image, NSMakeSize(small, small)) != nil);
+            });
+            double categorytime = time([&]() {
+                CHECK([image resizeImageToSize:NSMakeSize(small, small)] != nil);
+            });
+            WTF("4096x4096 -> 1024x1024 RGBA, lanczos3:",
+                FF("\thalogen: %.2fms (%.1f MP/s)", halogentime, megapixels / halogentime * 1e3),
+                FF("\tobjc::resample: %.2fms (%.1f MP/s)", resampletime, megapixels / resampletime * 1e3),
+                FF("\tNSImage lockFocus/drawInRect: %.2fms", appkittime),
+                FF("\t-resizeImageToSize: %.2fms", categorytime));
+        };
+    }
+    
+}
+
@@ -0,0 +1,202 @@
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/imageindex.hh>
+#import  <subjective-c/categories/NSURL+IM.hh>
+#import  <subjective-c/categories/NSString+STL.hh>
+#include <libimread/ext/filesystem/path.h>
+#include <libimread/ext/filesystem/temporary.h>
+#include <libimread/errors.hh>
+
+#include "include/test_data.hpp"
+#include "include/catch.hpp"
+
+namespace {
+    
+    using filesystem::path;
+    using filesystem::TemporaryDirectory;
+    using objc::image::index;
+    
+    TEST_CASE("[image-index] Index the test data directory",
+              "[image-index-index-test-data-directory]")
+    {
+        path basedir(im::test::basedir);
+        index idx = index::scan(basedir.str());
+        
+        std::vector<path> files = basedir.list("*.*", true); /// full_paths=true
+        std::size_t images = std::count_if(files.begin(), files.end(),
+                                       [](path const& p) {
+            return p.is_file() && objc::image::filetype(p.extension()) != -1;
+        });
+        
+        CHECK(idx.root() == basedir.str());
+        CHECK(idx.size() >= images);            /// the index also recurses
+        
+        for (std::size_t i = 0; i < idx.size(); ++i) {
+            path p = basedir/std::string(idx.path(i));
+            struct stat st;
+            REQUIRE(::stat(p.str().c_str(), &st) == 0);
+            CHECK(p.is_file());
+            CHECK(idx.filesize(i) == static_cast<uint64_t>(st.st_size));
+            CHECK(idx.typecode(i) == objc::image::filetype(objc::image::extension(idx.path(i))));
+            if (i > 0) { CHECK(idx.path(i - 1) < idx.path(i)); }
+            CHECK(idx.find(idx.path(i)) == i);
+        }
+        
+        CHECK(idx.find("yo-dogg-i-am-not-here.jpg") == index::npos);
+    }
+    
+    
+    TEST_CASE("[image-index] Save and memory-map an index",
+              "[image-index-save-and-memory-map]")
+    {
+        path basedir(im::test::basedir);
+        TemporaryDirectory td("test-image-index");
+        path indexpath = td.dirpath/"testdata.aximgidx";
+        
+        index::options opts;
+        opts.by = index::classify::either;
+        index idx = index::scan(basedir.str(), opts);
+        REQUIRE(idx.save(indexpath.str()));
+        
+        index mapped = index::map(indexpath.str());
+        CHECK(mapped.bytes() == idx.bytes());
+        CHECK(mapped.root() == idx.root());
+        REQUIRE(mapped.size() == idx.size());
+        for (std::size_t i = 0; i < mapped.size(); ++i) {
+            CHECK(mapped.path(i) == idx.path(i));
+            CHECK(mapped.typecode(i) == idx.typecode(i));
+            CHECK(mapped.filesize(i) == idx.filesize(i));
+        }
+        
+        /// moving takes the mapping along, leaving an empty index behind:
+        const std::size_t count = mapped.size();
+        index moved(std::move(mapped));
+        CHECK(moved.size() == count);
+        CHECK(mapped.empty());
+        CHECK(mapped.bytes() == 0);
+        CHECK(mapped.root().empty());
+        CHECK(mapped.path(0).empty());
+        
+        index assigned = index::map(indexpath.str());
+        assigned = std::move(moved);
+        CHECK(assigned.size() == count);
+        CHECK(assigned.path(0) == idx.path(0));
+        CHECK(moved.empty());
+    }
+    
+    
+    TEST_CASE("[image-index] Refuse to map truncated or corrupt index files",
+              "[image-index-refuse-truncated-corrupt-index-files]")
+    {
+        path basedir(im::test::basedir);
+        TemporaryDirectory td("test-image-index");
+        path indexpath = td.dirpath/"testdata.aximgidx";
+        path corruptpath = td.dirpath/"corrupt.aximgidx";
+        
+        index idx = index::scan(basedir.str());
+        REQUIRE(idx.size() > 1);
+        REQUIRE(idx.save(indexpath.str()));
+        
+        std::ifstream in(indexpath.str(), std::ios::binary);
+        const std::string original((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+        in.close();
+        
+        using header_t = index::header_t;
+        header_t header;
+        std::memcpy(&header, original.data(), sizeof(header_t));
+        const std::size_t rootend = sizeof(header_t) + header.rootsize;
+        const std::size_t offsetsat = sizeof(header_t) + ((header.rootsize + 1 + 7) & ~std::size_t(7));
+        
+        /// map() a copy of the index file after `corrupt` has had its way with it:
+        auto corrupted = [&](auto corrupt) {
+            std::string bytes = original;
+            corrupt(bytes);
+            std::ofstream out(corruptpath.str(), std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), bytes.size());
+            out.close();
+            return index::map(corruptpath.str());
+        };
+        
+        CHECK_NOTHROW(corrupted([](std::string&) {}));
+        CHECK_THROWS(corrupted([](std::string& bytes) { bytes.resize(sizeof(header_t) - 1); }));
+        CHECK_THROWS(corrupted([](std::string& bytes) { bytes.resize(bytes.size() - 8); }));
+        CHECK_THROWS(corrupted([](std::string& bytes) { bytes[0] = 'Z'; }));
+        
+        /// a count whose column sizes overflow, wrapping around to the right total:
+        CHECK_THROWS(corrupted([&](std::string& bytes) {
+            header_t bad = header;
+            bad.count = (uint64_t(1) << 61) + header.count;
+            std::memcpy(&bytes[0], &bad, sizeof(header_t));
+        }));
+        
+        /// an unterminated root, and offsets that run backwards or past the arena:
+        CHECK_THROWS(corrupted([&](std::string& bytes) { bytes[rootend] = 'x'; }));
+        CHECK_THROWS(corrupted([&](std::string& bytes) {
+            uint64_t second = std::numeric_limits<uint64_t>::max();
+            std::memcpy(&bytes[offsetsat + 8], &second, sizeof(uint64_t));
+        }));
+        CHECK_THROWS(corrupted([&](std::string& bytes) {
+            uint64_t first = 1;
+            std::memcpy(&bytes[offsetsat], &first, sizeof(uint64_t));
+        }));
+    }
+    
+    
+    TEST_CASE("[image-index] Benchmark indexing against NSDirectoryEnumerator",
+              "[image-index-benchmark-against-nsdirectoryenumerator]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        path basedir(im::test::basedir);
+        
+        auto serialstart = clock_t::now();
+        index::options serial;
+        serial.workers = 1;
+        index serialidx = index::scan(basedir.str(), serial);
+        ms_t serialtime = clock_t::now() - serialstart;
+        
+        auto parallelstart = clock_t::now();
+        index parallelidx = index::scan(basedir.str());
+        ms_t paralleltime = clock_t::now() - parallelstart;
+        
+        std::size_t enumerated = 0;
+        auto enumeratorstart = clock_t::now();
+        @autoreleasepool {
+            NSURL* baseurl = [NSURL fileURLWithFilesystemPath:basedir];
+            NSDirectoryEnumerator* enumerator = [[NSFileManager defaultManager]
+                                                 enumeratorAtURL:baseurl
+                                                 includingPropertiesForKeys:@[ NSURLFileSizeKey,
+                                                                               NSURLIsRegularFileKey ]
+                                                 options:static_cast<NSDirectoryEnumerationOptions>(0)
+                                                 errorHandler:nil];
+            for (NSURL* url in enumerator) {
+                NSNumber* regular;
+                [url getResourceValue:&regular forKey:NSURLIsRegularFileKey error:nil];
+                if (objc::to_bool([regular boolValue]) && objc::to_bool([url isImage])) {
+                    ++enumerated;
+                }
+            }
+        };
+        ms_t enumeratortime = clock_t::now() - enumeratorstart;
+        
+        CHECK(serialidx.size() == parallelidx.size());
+        CHECK(enumerated == parallelidx.size());
+        WTF("Indexing the test data directory:",
+            FF("\tone worker: %.2fms", serialtime.count()),
+            FF("\tall workers: %.2fms", paralleltime.count()),
+            FF("\tNSDirectoryEnumerator + isImage: %.2fms", enumeratortime.count()));
+    }
+    
+}
+
@@ -32,6 +32,7 @@ namespace {
     
     std::string copy_success_marker("Image successfully copied");
     std::string save_success_marker("Image successfully saved");
+    std::string batch_report_marker("[impaste] Batch: ");
     
     TEST_CASE("[impaste-clt] Test impaste copy execution",
               "[impaste-clt-test-impaste-copy-execution]")
@@ -91,4 +92,34 @@ namespace {
         };
     }
     
+    TEST_CASE("[impaste-clt] Test impaste batch execution",
+              "[impaste-clt-test-impaste-batch-execution]")
+    {
+        nowait_t nowait;
+        const std::vector<path> pngs = basedir.list("*.png");
+        const path impaste = path::join(wd, "impaste");
+        
+        /// once through uniquely-named pasteboards, and once through local stand-ins:
+        for (std::string const& flags : { std::string("-j 4"), std::string("-j 4 -l") }) {
+            TemporaryDirectory td("test-impaste-batch");
+            std::string command = fmt::format("find {0} -maxdepth 1 -name '*.png' -print0 | {1} -b {2} -o {3}",
+                                              basedir.str(), impaste.str(), flags, td.dirpath.str());
+            std::string output = filesystem::detail::execute(command, wd);
+            
+            WTF("OUTPUT:", output);
+            CHECK(output.find(batch_report_marker) != std::string::npos);
+            
+            @autoreleasepool {
+                std::for_each(pngs.begin(), pngs.end(), [&](path const& p) {
+                    NSURL* url = [[NSURL alloc] initFileURLWithFilesystemPath:basedir/p];
+                    NSURL* outurl = [[NSURL alloc] initFileURLWithFilesystemPath:td.dirpath/p];
+                    NSImage* image = [[NSImage alloc] initWithContentsOfURL:url];
+                    NSImage* saved = [[NSImage alloc] initWithContentsOfURL:outurl];
+                    REQUIRE(saved != nil);
+                    CHECK(objc::to_bool([[saved TIFFRepresentation] isEqualToData:[image TIFFRepresentation]]));
+                });
+            };
+        }
+    }
+    
 } /// namespace (anon.)
\ No newline at end of file
@@ -0,0 +1,286 @@
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/bufferpool.hh>
+#import  <subjective-c/classes/AXInterleavedImageRep.hh>
+#import  <AppKit/NSBitmapImageRep.h>
+#include <libimread/errors.hh>
+#include <mach/mach.h>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    
+    template <typename Color>
+    std::shared_ptr<im::InterleavedImage<Color>> frame(int width, int height, int seed = 0) {
+        auto out = std::make_shared<im::InterleavedImage<Color>>(width, height);
+        byte* pixels = (byte*)out->data();
+        std::size_t size = std::size_t(width) * height * objc::cg::color_traits<Color>::channels;
+        for (std::size_t idx = 0; idx < size; ++idx) { pixels[idx] = byte(idx * 31 + seed); }
+        return out;
+    }
+    
+    template <typename Color>
+    void check_image(CGImageRef imageref, im::InterleavedImage<Color> const& interleaved) {
+        using traits = objc::cg::color_traits<Color>;
+        const std::size_t rowbytes = std::size_t(interleaved.width()) * traits::channels;
+        REQUIRE(imageref != nullptr);
+        CHECK(CGImageGetWidth(imageref) == std::size_t(interleaved.width()));
+        CHECK(CGImageGetHeight(imageref) == std::size_t(interleaved.height()));
+        CHECK(CGImageGetBytesPerRow(imageref) == rowbytes);
+        CHECK(CGImageGetBitsPerPixel(imageref) == traits::channels * 8);
+        
+        CFDataRef data = CGDataProviderCopyData(CGImageGetDataProvider(imageref));
+        REQUIRE(std::size_t(CFDataGetLength(data)) == rowbytes * interleaved.height());
+        CHECK(std::memcmp(CFDataGetBytePtr(data), (byte const*)interleaved.data(),
+                          rowbytes * interleaved.height()) == 0);
+        CFRelease(data);
+    }
+    
+    /// the process' physical footprint -- compressed pages included,
+    /// which resident_size leaves out:
+    std::size_t footprint() {
+        task_vm_info_data_t info;
+        mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+        if (task_info(mach_task_self(), TASK_VM_INFO,
+                      reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) { return 0; }
+        return info.phys_footprint;
+    }
+    
+    /// the highest footprint seen since `start`, sampled as things go:
+    struct peak_t {
+        std::size_t start = footprint();
+        std::size_t highest = start;
+        void sample()                   { highest = std::max(highest, footprint()); }
+        std::size_t delta()             { sample(); return highest - start; }
+    };
+    
+    /// draw `rep` into a small offscreen bitmap:
+    BOOL draw(NSImageRep* rep) {
+        NSBitmapImageRep* canvas = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                           pixelsWide:32
+                                                                           pixelsHigh:32
+                                                                        bitsPerSample:8
+                                                                      samplesPerPixel:4
+                                                                             hasAlpha:YES
+                                                                             isPlanar:NO
+                                                                       colorSpaceName:NSDeviceRGBColorSpace
+                                                                          bytesPerRow:0
+                                                                         bitsPerPixel:0];
+        [NSGraphicsContext saveGraphicsState];
+        [NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithBitmapImageRep:canvas]];
+        BOOL drawn = [rep drawInRect:NSMakeRect(0, 0, 32, 32)];
+        [NSGraphicsContext restoreGraphicsState];
+        return drawn;
+    }
+    
+    TEST_CASE("[interleaved-image-rep] CGImages from interleaved RGB, RGBA and monochrome images",
+              "[interleaved-image-rep-cgimages-from-interleaved-rgb-rgba-monochrome]")
+    {
+        /// odd widths: rows are `width * channels` bytes, not `width`
+        auto rgb = frame<RGB>(33, 17);
+        auto rgba = frame<RGBA>(33, 17);
+        auto mono = frame<Monochrome>(33, 17);
+        
+        CGImageRef rgbimage = CGImageFromInterleaved(*rgb, CGColorSpaceCreateDeviceRGB());
+        CGImageRef rgbaimage = CGImageFromInterleaved(*rgba, CGColorSpaceCreateDeviceRGB());
+        CGImageRef monoimage = CGImageFromInterleaved(*mono, CGColorSpaceCreateDeviceRGB());
+        
+        check_image(rgbimage, *rgb);
+        check_image(rgbaimage, *rgba);
+        check_image(monoimage, *mono);
+        CHECK(CGColorSpaceGetNumberOfComponents(CGImageGetColorSpace(monoimage)) == 1);
+        CHECK(CGImageGetAlphaInfo(rgbaimage) == kCGImageAlphaLast);
+        
+        CGImageRelease(rgbimage);
+        CGImageRelease(rgbaimage);
+        CGImageRelease(monoimage);
+    }
+    
+    TEST_CASE("[interleaved-image-rep] Zero-copy CGImages keep their images alive",
+              "[interleaved-image-rep-zero-copy-cgimages-keep-images-alive]")
+    {
+        auto rgba = frame<RGBA>(64, 48, 7);
+        std::weak_ptr<im::InterleavedImage<RGBA>> watcher = rgba;
+        auto expected = frame<RGBA>(64, 48, 7);
+        
+        CGImageRef imageref = CGImageFromInterleaved(std::move(rgba), CGColorSpaceCreateDeviceRGB());
+        CHECK(!watcher.expired());
+        check_image(imageref, *expected);
+        CGImageRelease(imageref);
+        CHECK(watcher.expired());
+    }
+    
+    TEST_CASE("[interleaved-image-rep] Buffer pool recycles same-size buffers",
+              "[interleaved-image-rep-buffer-pool-recycles-same-size-buffers]")
+    {
+        objc::cg::buffer_pool pool(2);
+        byte* first = nullptr;
+        byte* second = nullptr;
+        
+        CGDataProviderRef provider = pool.provider(1024, &first);
+        CGDataProviderRelease(provider);
+        CHECK(pool.idle() == 1);
+        
+        provider = pool.provider(1024, &second);
+        CHECK(second == first);
+        CHECK(pool.idle() == 0);
+        CHECK(pool.allocations() == 1);
+        CGDataProviderRelease(provider);
+        
+        /// buffers can outlive the pool itself:
+        CGDataProviderRef outliving = nullptr;
+        {
+            objc::cg::buffer_pool ephemeral;
+            byte* orphan = nullptr;
+            outliving = ephemeral.provider(4096, &orphan);
+            std::memset(orphan, 0, 4096);
+        }
+        CGDataProviderRelease(outliving);
+    }
+    
+    TEST_CASE("[interleaved-image-rep] Benchmark CGImage creation over a 60-frame sequence",
+              "[interleaved-image-rep-benchmark-cgimage-creation-60-frame-sequence]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int width = 1920, height = 1080, frames = 60;
+        
+        std::vector<std::shared_ptr<im::InterleavedImage<RGBA>>> sequence;
+        for (int idx = 0; idx < frames; ++idx) { sequence.push_back(frame<RGBA>(width, height, idx)); }
+        
+        /// what CGImageFromInterleaved() used to do (less the bytes-per-row bug):
+        /// a fresh CGBitmapContext per frame
+        auto legacystart = clock_t::now();
+        for (auto const& interleaved : sequence) {
+            CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+            CGContextRef context = CGBitmapContextCreate(
+                (void*)interleaved->data(), width, height, 8, width * 4,
+                colorspace, kCGImageAlphaPremultipliedLast);
+            CGImageRef imageref = CGBitmapContextCreateImage(context);
+            CGContextRelease(context);
+            CGColorSpaceRelease(colorspace);
+            CGImageRelease(imageref);
+        }
+        ms_t legacytime = clock_t::now() - legacystart;
+        
+        std::size_t allocations = objc::cg::buffer_pool::shared().allocations();
+        auto pooledstart = clock_t::now();
+        for (auto const& interleaved : sequence) {
+            CGImageRef imageref = CGImageFromInterleaved(*interleaved, CGColorSpaceCreateDeviceRGB());
+            CGImageRelease(imageref);
+        }
+        ms_t pooledtime = clock_t::now() - pooledstart;
+        allocations = objc::cg::buffer_pool::shared().allocations() - allocations;
+        
+        auto zerocopystart = clock_t::now();
+        for (auto const& interleaved : sequence) {
+            CGImageRef imageref = CGImageFromInterleaved(interleaved, CGColorSpaceCreateDeviceRGB());
+            CGImageRelease(imageref);
+        }
+        ms_t zerocopytime = clock_t::now() - zerocopystart;
+        
+        CHECK(allocations <= 1);
+        WTF("CGImages from 60 1920x1080 RGBA frames:",
+            FF("\tCGBitmapContext per frame: %.2fms", legacytime.count()),
+            FF("\tpooled buffer copy: %.2fms (%zu allocations)", pooledtime.count(), allocations),
+            FF("\tzero-copy data provider: %.2fms", zerocopytime.count()));
+    }
+    
+    
+    TEST_CASE("[interleaved-image-rep] Lazy reps materialize their CGImage on first draw",
+              "[interleaved-image-rep-lazy-reps-materialize-cgimage-on-first-draw]")
+    {
+        @autoreleasepool {
+            auto rgb = frame<RGB>(40, 30, 3);
+            std::weak_ptr<Interleaved> watcher = rgb;
+            AXInterleavedImageRep* rep = [AXInterleavedImageRep lazyImageRepWithInterleaved:rgb];
+            rgb.reset();
+            
+            CHECK(objc::to_bool([rep isLazy]));
+            CHECK([rep pixelsWide] == 40);
+            CHECK([rep pixelsHigh] == 30);
+            CHECK(!objc::to_bool([rep hasAlpha]));
+            CHECK(!objc::to_bool([rep isMaterialized]));
+            
+            CHECK(objc::to_bool(draw(rep)));
+            CHECK(objc::to_bool([rep isMaterialized]));
+            check_image([rep CGImage], [rep interleaved]);
+            
+            [rep evictImage];
+            CHECK(!objc::to_bool([rep isMaterialized]));
+            CHECK(!watcher.expired());          /// eviction drops the CGImage, not the pixels
+            
+            CHECK(objc::to_bool(draw(rep)));
+            CHECK(objc::to_bool([rep isMaterialized]));
+            [AXInterleavedImageRep evictMaterializedImages];
+            CHECK(!objc::to_bool([rep isMaterialized]));
+            
+            /// eager reps keep their CGImage, and don't evict:
+            AXInterleavedImageRep* eager = [AXInterleavedImageRep imageRepWithInterleaved:[rep interleaved]];
+            CHECK(objc::to_bool([eager isMaterialized]));
+            [eager evictImage];
+            CHECK(objc::to_bool([eager isMaterialized]));
+            check_image([eager CGImage], [rep interleaved]);
+        };
+    }
+    
+    TEST_CASE("[interleaved-image-rep] Peak memory loading 1,000 reps, eager versus lazy",
+              "[interleaved-image-rep-peak-memory-loading-1000-reps-eager-versus-lazy]")
+    {
+        const int width = 256, height = 256, count = 1000;
+        std::size_t eagerpeak = 0, lazypeak = 0, drawnpeak = 0;
+        
+        /// what -initWithInterleaved: used to do: keep a copy of the image,
+        /// plus a CGImage holding a second copy of the pixels
+        @autoreleasepool {
+            std::vector<std::shared_ptr<Interleaved>> copies;
+            NSMutableArray* reps = [NSMutableArray arrayWithCapacity:count];
+            peak_t peak;
+            for (int idx = 0; idx < count; ++idx) {
+                auto interleaved = frame<RGB>(width, height, idx);
+                CGImageRef imageref = CGImageFromInterleaved(*interleaved, CGColorSpaceCreateDeviceRGB());
+                [reps addObject:[[AXCoreGraphicsImageRep alloc] initWithImageRef:imageref
+                                                                  colorSpaceName:NSDeviceRGBColorSpace]];
+                CGImageRelease(imageref);
+                copies.push_back(std::move(interleaved));
+                peak.sample();
+            }
+            eagerpeak = peak.delta();
+        };
+        objc::cg::buffer_pool::shared().clear();
+        
+        @autoreleasepool {
+            NSMutableArray* reps = [NSMutableArray arrayWithCapacity:count];
+            peak_t peak;
+            for (int idx = 0; idx < count; ++idx) {
+                [reps addObject:[AXInterleavedImageRep lazyImageRepWithInterleaved:frame<RGB>(width, height, idx)]];
+                peak.sample();
+            }
+            lazypeak = peak.delta();
+            
+            for (AXInterleavedImageRep* rep in reps) { draw(rep); peak.sample(); }
+            drawnpeak = peak.delta();
+            
+            for (AXInterleavedImageRep* rep in reps) { CHECK(objc::to_bool([rep isMaterialized])); }
+            [AXInterleavedImageRep evictMaterializedImages];
+            for (AXInterleavedImageRep* rep in reps) { CHECK(!objc::to_bool([rep isMaterialized])); }
+        };
+        
+        /// reported, not checked -- the footprint moves with whatever else the process is up to:
+        WTF("Peak footprint while loading 1,000 256x256 RGB reps:",
+            FF("\teager (image copy + CGImage copy): +%.2fMB", eagerpeak / 1048576.0),
+            FF("\tlazy, undrawn: +%.2fMB (%.2fx eager)", lazypeak / 1048576.0,
+                                                        eagerpeak ? double(lazypeak) / eagerpeak : 0.0),
+            FF("\tlazy, all drawn once: +%.2fMB", drawnpeak / 1048576.0));
+    }
+    
+}
+
@@ -1,5 +1,7 @@
 
 #include <string>
+#include <chrono>
+#include <memory>
 #include <iostream>
 #import  <BlockClosure.h>
 
@@ -7,6 +9,7 @@
 #include <libimread/ext/JSON/json11.h>
 #include <libimread/errors.hh>
 #include <subjective-c/subjective-c.hpp>
+#include <subjective-c/trampoline.hh>
 
 #include "include/catch.hpp"
 
@@ -49,5 +52,245 @@ namespace {
         #endif
     }
     
+    TEST_CASE("[json-block-traverse] Blocks with the same signature share prepared closures",
+              "[json-block-traverse-blocks-same-signature-share-prepared-closures]")
+    {
+        using intfptr_t = std::add_pointer_t<int(int, int)>;
+        using rectfptr_t = std::add_pointer_t<NSRect(CGFloat)>;
+        __block int bias = 10;
+        int (^add)(int, int) = ^(int x, int y) { return x + y + bias; };
+        int (^subtract)(int, int) = ^(int x, int y) { return x - y - bias; };
+        
+        @autoreleasepool {
+            MABlockClosure* adder = [[MABlockClosure alloc] initWithBlock:add];
+            const NSUInteger signatures = [MABlockClosure signatureCount];
+            MABlockClosure* subtracter = [[MABlockClosure alloc] initWithBlock:subtract];
+            CHECK([MABlockClosure signatureCount] == signatures);
+            CHECK(((intfptr_t)[adder fptr])(3, 4) == 17);
+            CHECK(((intfptr_t)[subtracter fptr])(3, 4) == -11);
+            bias = 0;
+            CHECK(((intfptr_t)[adder fptr])(3, 4) == 7);
+            
+            /// a closure goes back to its signature when its
+            /// MABlockClosure does, for the next block to reuse:
+            const NSUInteger closures = [MABlockClosure closureCount];
+            void* fptr = [adder fptr];
+            adder = nil;
+            MABlockClosure* another = [[MABlockClosure alloc] initWithBlock:subtract];
+            CHECK([another fptr] == fptr);
+            CHECK([MABlockClosure closureCount] == closures);
+            CHECK(((intfptr_t)[another fptr])(3, 4) == -1);
+            
+            /// ... whereas a new signature gets prepared once, struct returns and all:
+            NSRect (^square)(CGFloat) = ^(CGFloat side) { return NSMakeRect(0, 0, side, side); };
+            NSRect (^origin)(CGFloat) = ^(CGFloat at) { return NSMakeRect(at, at, 0, 0); };
+            MABlockClosure* squarer = [[MABlockClosure alloc] initWithBlock:square];
+            CHECK([MABlockClosure signatureCount] == signatures + 1);
+            MABlockClosure* originator = [[MABlockClosure alloc] initWithBlock:origin];
+            CHECK([MABlockClosure signatureCount] == signatures + 1);
+            CHECK(NSEqualRects(((rectfptr_t)[squarer fptr])(2.0), NSMakeRect(0, 0, 2.0, 2.0)));
+            CHECK(NSEqualRects(((rectfptr_t)[originator fptr])(3.0), NSMakeRect(3.0, 3.0, 0, 0)));
+        };
+    }
+    
+    TEST_CASE("[json-block-traverse] Benchmark wrapping and calling blocks via MABlockClosure",
+              "[json-block-traverse-benchmark-wrap-and-call]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ns_t = std::chrono::duration<double, std::nano>;
+        using Node = Json::JSONNode;
+        using fptr_t = std::add_pointer_t<void(const Node*, Type, NodeType)>;
+        using intfptr_t = std::add_pointer_t<long(long, int)>;
+        const int runs = 100000;
+        const int traversals = 10000;
+        Json dict;
+        dict["one"] = "one.";
+        dict["two"] = "two.";
+        dict["three"] = { 435, 345987, 238746, 21 };
+        
+        @autoreleasepool {
+            /// the first block with a signature pays to parse and prepare it:
+            double (^scale)(double, long, float) = ^(double x, long y, float z) { return x * y * z; };
+            auto coldstart = clock_t::now();
+            MABlockClosure* scaler = [[MABlockClosure alloc] initWithBlock:scale];
+            ns_t coldtime = clock_t::now() - coldstart;
+            CHECK(((double (*)(double, long, float))[scaler fptr])(0.5, 4, 2.0f) == 4.0);
+            
+            __block long offset = 1;
+            long (^step)(long, int) = ^(long total, int idx) { return total + idx + offset; };
+            
+            long direct = 0;
+            auto directstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                direct = step(direct, idx);
+            }
+            ns_t directtime = clock_t::now() - directstart;
+            
+            long kept = 0;
+            MABlockClosure* stepper = [[MABlockClosure alloc] initWithBlock:step];
+            intfptr_t stepfptr = (intfptr_t)[stepper fptr];
+            auto keptstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                kept = stepfptr(kept, idx);
+            }
+            ns_t kepttime = clock_t::now() - keptstart;
+            CHECK(kept == direct);
+            
+            /// wrap, call, and let go, every time -- recycling one closure:
+            long wrapped = 0;
+            const NSUInteger closures = [MABlockClosure closureCount];
+            auto wrapstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                MABlockClosure* closure = [[MABlockClosure alloc] initWithBlock:step];
+                wrapped = ((intfptr_t)[closure fptr])(wrapped, idx);
+            }
+            ns_t wraptime = clock_t::now() - wrapstart;
+            CHECK(wrapped == direct);
+            CHECK([MABlockClosure closureCount] == closures);
+            
+            /// a fresh block, and a fresh BlockFptr, for each traversal --
+            /// after a first, which may prepare the signature:
+            __block int nodes = 0;
+            @autoreleasepool {
+                id block = [^(void* node, Type jt, NodeType jnt) { nodes++; } copy];
+                dict.traverse((fptr_t)BlockFptr(block));
+            };
+            const int pertraversal = nodes;
+            const NSUInteger traverseclosures = [MABlockClosure closureCount];
+            auto traversestart = clock_t::now();
+            for (int idx = 0; idx < traversals; ++idx) {
+                @autoreleasepool {
+                    id block = [^(void* node, Type jt, NodeType jnt) { nodes++; } copy];
+                    dict.traverse((fptr_t)BlockFptr(block));
+                };
+            }
+            ns_t traversetime = clock_t::now() - traversestart;
+            CHECK(nodes == pertraversal * (traversals + 1));
+            CHECK([MABlockClosure closureCount] == traverseclosures);
+            
+            WTF(FF("Wrapping and calling blocks (of %i):", runs),
+                FF("\tfirst wrap of a new signature: %.0fns", coldtime.count()),
+                FF("\tcalling the block directly: %.1fns", directtime.count() / runs),
+                FF("\tcalling one wrapped closure: %.1fns", kepttime.count() / runs),
+                FF("\twrapping, calling, releasing: %.1fns", wraptime.count() / runs),
+                FF("\tBlockFptr() and traversal, per JSON tree: %.1fns", traversetime.count() / traversals),
+                FF("\tsignatures: %lu, closures: %lu", (unsigned long)[MABlockClosure signatureCount],
+                                                      (unsigned long)[MABlockClosure closureCount]));
+        };
+    }
+    
+    TEST_CASE("[json-block-traverse] Traverse JSON tree with a block via objc::block_trampoline",
+              "[json-block-traverse-with-block-trampoline]")
+    {
+        using Node = Json::JSONNode;
+        using trampoline_t = objc::block_trampoline<void(const Node*, Type, NodeType)>;
+        Json dict;
+        dict["one"] = "one.";
+        dict["two"] = "two.";
+        dict["three"] = { 435, 345987, 238746, 21 };
+        
+        __block int viaffi = 0;
+        __block int viathunk = 0;
+        @autoreleasepool {
+            id block = [^(void* node, Type jt, NodeType jnt) { viaffi++; } copy];
+            dict.traverse((trampoline_t::fptr_t)BlockFptr(block));
+        };
+        
+        const std::size_t available = trampoline_t::available();
+        {
+            trampoline_t trampoline(^(const Node* node, Type jt, NodeType jnt) { viathunk++; });
+            CHECK(trampoline.pooled());
+            CHECK(trampoline_t::available() == available - 1);
+            dict.traverse(trampoline.fptr());
+        }
+        CHECK(trampoline_t::available() == available);
+        CHECK(viathunk == viaffi);
+        CHECK(viathunk > 0);
+    }
+    
+    TEST_CASE("[json-block-traverse] Fall back to MABlockClosure once a trampoline pool runs out",
+              "[json-block-traverse-trampoline-pool-fallback]")
+    {
+        using trampoline_t = objc::block_trampoline<int(int, int), 2>;
+        __block int bias = 0;
+        
+        @autoreleasepool {
+            trampoline_t first(^(int x, int y) { return x + y + bias; });
+            auto second = std::make_unique<trampoline_t>(^(int x, int y) { return x - y - bias; });
+            trampoline_t third(^(int x, int y) { return x * y * (bias + 1); });
+            CHECK(first.pooled());
+            CHECK(second->pooled());
+            CHECK(!third.pooled());
+            CHECK(trampoline_t::available() == 0);
+            
+            bias = 1;
+            CHECK(first.fptr()(3, 4) == 8);
+            CHECK(second->fptr()(3, 4) == -2);
+            CHECK(third.fptr()(3, 4) == 24);
+            
+            /// a thunk goes back to the pool, and on to the next block:
+            trampoline_t::fptr_t thunk = second->fptr();
+            second.reset();
+            CHECK(trampoline_t::available() == 1);
+            trampoline_t fourth(^(int x, int y) { return x % y; });
+            CHECK(fourth.pooled());
+            CHECK(fourth.fptr() == thunk);
+            CHECK(fourth.fptr()(3, 4) == 3);
+            
+            /// moving a trampoline moves its thunk along with it:
+            trampoline_t moved(std::move(first));
+            CHECK(moved.fptr()(3, 4) == 8);
+            CHECK(first.fptr() == nullptr);
+        };
+    }
+    
+    TEST_CASE("[json-block-traverse] Benchmark call overhead of blocks, trampolines, and MABlockClosure",
+              "[json-block-traverse-benchmark-call-overhead]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ns_t = std::chrono::duration<double, std::nano>;
+        using trampoline_t = objc::block_trampoline<long(long, int)>;
+        const int runs = 1000000;
+        
+        __block long offset = 1;
+        long (^step)(long, int) = ^(long total, int idx) { return total + idx + offset; };
+        
+        @autoreleasepool {
+            long direct = 0;
+            auto directstart = clock_t::now();
+            for (int idx = 0; idx < runs; ++idx) {
+                direct = step(direct, idx);
+            }
+            ns_t directtime = clock_t::now() - directstart;
+            
+            /// function pointers read through volatiles, lest they be inlined away:
+            auto trampolinestart = clock_t::now();
+            trampoline_t trampoline(step);
+            trampoline_t::fptr_t volatile thunk = trampoline.fptr();
+            long viathunk = 0;
+            for (int idx = 0; idx < runs; ++idx) {
+                viathunk = thunk(viathunk, idx);
+            }
+            ns_t trampolinetime = clock_t::now() - trampolinestart;
+            CHECK(viathunk == direct);
+            
+            auto closurestart = clock_t::now();
+            MABlockClosure* closure = [[MABlockClosure alloc] initWithBlock:step];
+            trampoline_t::fptr_t volatile viaclosure = (trampoline_t::fptr_t)[closure fptr];
+            long viaffi = 0;
+            for (int idx = 0; idx < runs; ++idx) {
+                viaffi = viaclosure(viaffi, idx);
+            }
+            ns_t closuretime = clock_t::now() - closurestart;
+            CHECK(viaffi == direct);
+            
+            WTF(FF("Calling a block through a function pointer (of %i):", runs),
+                FF("\tcalling the block directly: %.2fns", directtime.count() / runs),
+                FF("\tobjc::block_trampoline thunk: %.2fns", trampolinetime.count() / runs),
+                FF("\tMABlockClosure (via ffi_call): %.2fns", closuretime.count() / runs));
+        };
+    }
+    
+    
 }
 
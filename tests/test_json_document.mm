@@ -0,0 +1,302 @@
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <string_view>
+
+#include <libimread/libimread.hpp>
+#include <libimread/errors.hh>
+#include <libimread/options.hh>
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/json.hh>
+#import  <Foundation/Foundation.h>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::json::document;
+    using objc::json::value;
+    
+    const std::string sample = R"json(
+        {
+            "name"      : "sample",
+            "width"     : 640,
+            "height"    : 480,
+            "scale"     : 1.5,
+            "exponent"  : -2.5e-3,
+            "big"       : 9223372036854775807,
+            "opaque"    : true,
+            "animated"  : false,
+            "profile"   : null,
+            "escapes"   : "tab\tquote\"slash\\/ \u00e9 \ud83d\ude00",
+            "tags"      : [ "one", "two", [ ], { } ],
+            "layers"    : [
+                { "name" : "background", "offset" : [ 0, 0 ] },
+                { "name" : "foreground", "offset" : [ 12, -7 ] }
+            ]
+        }
+    )json";
+    
+    /// a few megabytes of the kind of thing JSON APIs hand back:
+    std::string generate(int count) {
+        std::string out = "[";
+        char buffer[512];
+        for (int idx = 0; idx < count; ++idx) {
+            std::snprintf(buffer, sizeof(buffer),
+                "%s{\"id\":%i,\"name\":\"image-%05i.png\",\"width\":%i,\"height\":%i,"
+                "\"scale\":%.6f,\"coordinates\":[%.8f,%.8f,%.8f],"
+                "\"tags\":[\"tagged\",\"with \\\"escapes\\\"\",\"caf\\u00e9\"],"
+                "\"flags\":{\"opaque\":%s,\"animated\":false,\"profile\":null}}",
+                idx ? "," : "", idx, idx, 64 + idx % 1024, 48 + idx % 768,
+                1.0 + idx / 1e4, idx * 0.1234567, idx * -2.75, idx / 3.0,
+                idx % 2 ? "true" : "false");
+            out += buffer;
+        }
+        out += "]";
+        return out;
+    }
+    
+    NSData* data_for(std::string const& json) {
+        return [NSData dataWithBytesNoCopy:(void*)json.data()
+                                    length:json.size()
+                              freeWhenDone:NO];
+    }
+    
+    /// like isEqual: -- but NSJSONSerialization may hand back reals as NSDecimalNumbers,
+    /// whose last digits needn't agree with a double's, so numbers compare as doubles:
+    bool same(id lhs, id rhs) {
+        if ([lhs isKindOfClass:[NSDictionary class]]) {
+            if (![rhs isKindOfClass:[NSDictionary class]] || [lhs count] != [rhs count]) { return false; }
+            for (id key in lhs) {
+                if (!same(lhs[key], rhs[key])) { return false; }
+            }
+            return true;
+        }
+        if ([lhs isKindOfClass:[NSArray class]]) {
+            if (![rhs isKindOfClass:[NSArray class]] || [lhs count] != [rhs count]) { return false; }
+            for (NSUInteger idx = 0; idx < [lhs count]; ++idx) {
+                if (!same(lhs[idx], rhs[idx])) { return false; }
+            }
+            return true;
+        }
+        if ([lhs isKindOfClass:[NSNumber class]] && [rhs isKindOfClass:[NSNumber class]]) {
+            return [lhs doubleValue] == [rhs doubleValue];
+        }
+        return [lhs isEqual:rhs];
+    }
+    
+    TEST_CASE("[json-document] Parse JSON and iterate its tape lazily",
+              "[json-document-parse-iterate-tape-lazily]")
+    {
+        document doc = document::parse(sample);
+        value root = doc.root();
+        
+        REQUIRE(root.is_object());
+        CHECK(root.size() == 12);
+        CHECK(root["name"].as_string() == "sample");
+        CHECK(root["width"].as_integer() == 640);
+        CHECK(root["height"].as_double() == 480.0);
+        CHECK(root["scale"].as_double() == 1.5);
+        CHECK(root["exponent"].as_double() == -2.5e-3);
+        CHECK(root["big"].as_integer() == INT64_MAX);
+        CHECK(root["opaque"].as_bool());
+        CHECK(!root["animated"].as_bool());
+        CHECK(root["profile"].is_null());
+        CHECK(root["escapes"].as_string() == "tab\tquote\"slash\\/ \u00e9 \U0001F600");
+        
+        CHECK(root["tags"].size() == 4);
+        CHECK(root["tags"][1].as_string() == "two");
+        CHECK(root["tags"][2].is_array());
+        CHECK(root["tags"][2].size() == 0);
+        CHECK(root["tags"][3].is_object());
+        CHECK(root["layers"][1]["offset"][1].as_integer() == -7);
+        
+        CHECK(!root.find("no-such-key"));
+        CHECK_THROWS(root["no-such-key"]);
+        CHECK_THROWS(root["tags"][4]);
+        CHECK_THROWS(root["name"].as_integer());
+        
+        std::vector<std::string> names;
+        for (auto const& layer : root["layers"].elements()) {
+            names.emplace_back(layer["name"].as_string());
+        }
+        CHECK(names == std::vector<std::string>{ "background", "foreground" });
+        
+        std::size_t members = 0;
+        for (auto const& member : root.members()) {
+            CHECK(root.find(member.key).type() == member.val.type());
+            ++members;
+        }
+        CHECK(members == root.size());
+        
+        /// what comes back out parses back in as the same thing:
+        document again = document::parse(root.minified());
+        CHECK(again.root().minified() == root.minified());
+        CHECK(again.tapesize() == doc.tapesize());
+        
+        /// ... reals included, whole or not:
+        document reals = document::parse("[1.0, -2e3, 0.1, 1e300]");
+        CHECK(reals.root().minified() == "[1.0,-2000.0,0.1,1e+300]");
+        document reread = document::parse(reals.root().minified());
+        for (auto const& element : reread.root().elements()) {
+            CHECK(element.is_real());
+        }
+    }
+    
+    TEST_CASE("[json-document] Reject malformed JSON",
+              "[json-document-reject-malformed-json]")
+    {
+        const std::vector<std::string> malformed = {
+            "", "   ", "{", "}", "[1,]", "[1 2]", "{\"a\" 1}", "{\"a\":}", "{1:2}",
+            "[01]", "[1.]", "[.5]", "[1e]", "[-]", "[1e999]", "[tru]", "[nul]", "[True]",
+            "\"unterminated", "\"bad \\x escape\"", "\"\\ud800\"", "\"tab\tinside\"",
+            "\"\xC3\x28\"", "\"\xED\xA0\x80\"", "[1] [2]", "{\"a\":1,}"
+        };
+        for (std::string const& json : malformed) {
+            CHECK_THROWS(document::parse(json));
+        }
+        CHECK_THROWS(document::parse(std::string(1025, '[') + std::string(1025, ']')));
+        CHECK_NOTHROW(document::parse(std::string(1024, '[') + std::string(1024, ']')));
+        CHECK_NOTHROW(document::parse("\"\xF0\x9F\x98\x80\""));
+        CHECK_NOTHROW(document::parse(" 42 "));
+    }
+    
+    TEST_CASE("[json-document] Traverse JSON with a lambda and with a block",
+              "[json-document-traverse-with-lambda-and-block]")
+    {
+        document doc = document::parse(sample);
+        
+        std::vector<std::string> keys;
+        std::size_t count = 0, deepest = 0;
+        doc.root().traverse([&](value const& v, std::string_view key, std::size_t depth) {
+            if (!key.empty()) { keys.emplace_back(key); }
+            deepest = std::max(deepest, depth);
+            ++count;
+        });
+        
+        CHECK(count == 27);
+        CHECK(deepest == 4);
+        CHECK(keys.front() == "name");
+        CHECK(keys.back() == "offset");
+        
+        __block std::size_t integers = 0;
+        __block int64_t total = 0;
+        doc.root()["layers"].traverse(^(value const& v, std::string_view key, std::size_t depth) {
+            if (v.is_integer()) {
+                total += v.as_integer();
+                ++integers;
+            }
+        });
+        
+        CHECK(integers == 4);
+        CHECK(total == 5);
+    }
+    
+    TEST_CASE("[json-document] Materialize JSON as NSJSONSerialization would",
+              "[json-document-materialize-as-nsjsonserialization]")
+    {
+        @autoreleasepool {
+            for (std::string const& json : { sample, generate(100) }) {
+                NSError* error;
+                id expected = [NSJSONSerialization JSONObjectWithData:data_for(json)
+                                                              options:0
+                                                                error:&error];
+                REQUIRE(expected != nil);
+                
+                id materialized = document::parse(data_for(json)).root().materialize();
+                CHECK(same(materialized, expected));
+            }
+            
+            document doc = document::parse(sample);
+            NSDictionary* dict = doc.root().materialize();
+            CHECK([dict[@"width"] isEqual:@640]);
+            CHECK([dict[@"scale"] isEqual:@1.5]);
+            CHECK([dict[@"opaque"] isEqual:@YES]);
+            CHECK([dict[@"profile"] isEqual:[NSNull null]]);
+            CHECK([dict[@"layers"][1][@"name"] isEqual:@"foreground"]);
+            CHECK([doc.root()["tags"].materialize() count] == 4);
+            CHECK([doc.root()["name"].materialize() isEqual:@"sample"]);
+        }
+    }
+    
+    TEST_CASE("[json-document] Convert JSON objects to im::Options",
+              "[json-document-convert-json-objects-im-options]")
+    {
+        document doc = document::parse(sample);
+        im::Options opts = doc.root().options();
+        
+        CHECK(opts.cast<int>("width") == 640);
+        CHECK(opts.cast<float>("scale") == 1.5f);
+        CHECK(opts.get("name") == "sample");
+        CHECK(int(opts["layers"][1]["offset"][0]) == 12);
+        
+        CHECK_THROWS(doc.root()["tags"].options());
+    }
+    
+    TEST_CASE("[json-document] Benchmark parsing multi-megabyte JSON with NSJSONSerialization and objc::json",
+              "[json-document-benchmark-parsing-multi-megabyte-json]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int runs = 10;
+        const std::string json = generate(40000);
+        NSData* data = data_for(json);
+        const double megabytes = json.size() / (1024.0 * 1024.0);
+        
+        std::size_t expected = 0;
+        ms_t foundationtime{ 0 }, parsetime{ 0 }, traversetime{ 0 }, materializetime{ 0 };
+        
+        for (int idx = 0; idx < runs; ++idx) {
+            @autoreleasepool {
+                auto start = clock_t::now();
+                NSArray* array = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+                foundationtime += clock_t::now() - start;
+                expected = array.count;
+            }
+        }
+        
+        for (int idx = 0; idx < runs; ++idx) {
+            auto start = clock_t::now();
+            document doc = document::parse(data);
+            parsetime += clock_t::now() - start;
+            CHECK(doc.root().size() == expected);
+        }
+        
+        for (int idx = 0; idx < runs; ++idx) {
+            auto start = clock_t::now();
+            document doc = document::parse(data);
+            int64_t total = 0;
+            doc.root().traverse([&](value const& v, std::string_view key, std::size_t depth) {
+                if (v.is_integer()) { total += v.as_integer(); }
+            });
+            traversetime += clock_t::now() - start;
+            CHECK(total > 0);
+        }
+        
+        for (int idx = 0; idx < runs; ++idx) {
+            @autoreleasepool {
+                auto start = clock_t::now();
+                NSArray* array = document::parse(data).root().materialize();
+                materializetime += clock_t::now() - start;
+                CHECK(array.count == expected);
+            }
+        }
+        
+        auto throughput = [&](ms_t time) { return megabytes / (time.count() / runs / 1000.0); };
+        
+        WTF(FF("Parsing %.1fMB of JSON (average of %i):", megabytes, runs),
+            FF("\tNSJSONSerialization: %.2fms (%.0fMB/s)",
+                foundationtime.count() / runs, throughput(foundationtime)),
+            FF("\tobjc::json, tape only: %.2fms (%.0fMB/s)",
+                parsetime.count() / runs, throughput(parsetime)),
+            FF("\tobjc::json, tape and traversal: %.2fms (%.0fMB/s)",
+                traversetime.count() / runs, throughput(traversetime)),
+            FF("\tobjc::json, materialized: %.2fms (%.0fMB/s)",
+                materializetime.count() / runs, throughput(materializetime)));
+    }
+    
+}
+
@@ -1,12 +1,19 @@
 
 #include <array>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <unordered_map>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <subjective-c/subjective-c.hpp>
 #include <subjective-c/categories/NSURL+IM.hh>
+#import  <subjective-c/categories/NSString+STL.hh>
+#import  <subjective-c/categories/NSData+IM.hh>
 #include <libimread/ext/filesystem/path.h>
+#include <libimread/errors.hh>
 
 #include "include/test_data.hpp"
 #include "include/catch.hpp"
@@ -65,8 +72,191 @@ namespace {
                 // CHECK(objc::image::suffix([urlpath imageFileType]) == p.extension());
             });
             
+            /// ... and URLs without a file-system representation go by their path:
+            NSURL* remote = [NSURL URLWithString:@"http://example.com/images/yo-dogg.PNG"];
+            CHECK([remote isImage] == YES);
+            CHECK([remote imageFileType] == NSPNGFileType);
+            NSURL* data = [NSURL URLWithString:@"data:text/plain;base64,eW8gZG9nZw=="];
+            CHECK([data isImage] == NO);
+            CHECK(static_cast<NSInteger>([data imageFileType]) == -1);
+            
+        };
+        
+    }
+    
+    
+    TEST_CASE("[nsurl-image-types] Check case-insensitive suffix table lookups",
+              "[nsurl-check-case-insensitive-suffix-table-lookups]")
+    {
+        CHECK(objc::image::filetype("JPG")      == NSJPEGFileType);
+        CHECK(objc::image::filetype(".Jpeg")    == NSJPEGFileType);
+        CHECK(objc::image::filetype(".TIF")     == NSTIFFFileType);
+        CHECK(objc::image::filetype("PvRtC")    == AXPVRFileType);
+        CHECK(objc::image::filetype("txt")      == -1);
+        CHECK(objc::image::filetype("")         == -1);
+        CHECK(objc::image::filetype(".")        == -1);
+        CHECK(objc::image::filetype("jpegs")    == -1);
+        
+        CHECK(objc::image::extension("/yo/dogg.d/i-heard.PNG")  == "PNG");
+        CHECK(objc::image::extension("/yo/dogg.d/you-like")     == "");
+        CHECK(objc::image::extension("/yo/dogg.d/.hidden")      == "");
+        CHECK(objc::image::extension("plain.jp2")               == "jp2");
+    }
+    
+    
+    TEST_CASE("[nsurl-image-types] Benchmark suffix lookups over a 10^6-path listing",
+              "[nsurl-benchmark-suffix-lookups-million-path-listing]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        
+        /// the lowercase-through-NSString, compare-chain approach
+        /// that the suffix table replaced, for comparison:
+        auto legacy = [](NSString* pathstring) -> NSInteger {
+            std::string suffix = [[pathstring.pathExtension lowercaseString] STLString];
+            if (suffix == "tiff" || suffix == "tif")        { return NSTIFFFileType; }
+            if (suffix == "bmp")                            { return NSBMPFileType; }
+            if (suffix == "gif")                            { return NSGIFFileType; }
+            if (suffix == "jpg"  || suffix == "jpeg")       { return NSJPEGFileType; }
+            if (suffix == "png")                            { return NSPNGFileType; }
+            if (suffix == "jp2")                            { return NSJPEG2000FileType; }
+            if (suffix == "pvr"  || suffix == "pvrtc")      { return AXPVRFileType; }
+            return -1;
         };
         
+        std::vector<std::string> catalog;
+        for (int idx = 0; idx < im::test::num_jpg; ++idx) { catalog.push_back(im::test::jpg[idx]); }
+        for (int idx = 0; idx < im::test::num_png; ++idx) { catalog.push_back(im::test::png[idx]); }
+        for (int idx = 0; idx < im::test::num_tif; ++idx) { catalog.push_back(im::test::tif[idx]); }
+        for (int idx = 0; idx < im::test::num_pvr; ++idx) { catalog.push_back(im::test::pvr[idx]); }
+        catalog.push_back("README.TXT");
+        catalog.push_back("Makefile");
+        
+        const std::size_t count = 1000000;
+        std::vector<std::string> listing;
+        listing.reserve(count);
+        for (std::size_t idx = 0; listing.size() < count; ++idx) {
+            listing.push_back(im::test::basedir + "/" + catalog[idx % catalog.size()]);
+        }
+        
+        std::size_t tablehits = 0;
+        auto tablestart = clock_t::now();
+        for (std::string const& p : listing) {
+            tablehits += objc::image::filetype(objc::image::extension(p)) != -1;
+        }
+        ms_t tabletime = clock_t::now() - tablestart;
+        
+        std::size_t legacyhits = 0;
+        auto legacystart = clock_t::now();
+        @autoreleasepool {
+            for (std::string const& p : listing) {
+                legacyhits += legacy([NSString stringWithSTLString:p]) != -1;
+            }
+        };
+        ms_t legacytime = clock_t::now() - legacystart;
+        
+        CHECK(tablehits == legacyhits);
+        WTF("Suffix lookups over 10^6 paths:",
+            FF("\tperfect-hash table: %.2fms", tabletime.count()),
+            FF("\tNSString + compare chain: %.2fms", legacytime.count()));
+    }
+    
+    
+    TEST_CASE("[nsurl-image-types] Sniff image types from file contents",
+              "[nsurl-sniff-image-types-from-file-contents]")
+    {
+        path basedir(im::test::basedir);
+        std::vector<path> files = basedir.list("*.*", true); /// full_paths=true
+        
+        @autoreleasepool {
+            
+            std::for_each(files.begin(),
+                          files.end(),
+                      [&](path const& p) {
+                if (!p.is_file()) { return; }
+                NSURL* urlpath = [NSURL fileURLWithFilesystemPath:p];
+                NSData* data = [NSData dataWithContentsOfURL:urlpath
+                                                     options:NSDataReadingMappedIfSafe
+                                                       error:nil];
+                REQUIRE(data != nil);
+                NSInteger sniffed = objc::image::sniff(*[data dataSource]);
+                
+                /// headerless PVRTC dumps (e.g. apple_4bpp.pvr) carry no magic number:
+                if (p.basename().find("apple_") == 0) {
+                    CHECK(sniffed == -1);
+                    return;
+                }
+                CHECK(sniffed == [urlpath imageFileType]);
+            });
+            
+        };
+        
+    }
+    
+    
+    /// `size` bytes that end right where a PROT_NONE page begins --
+    /// reading so much as one byte past them faults:
+    struct guarded_t {
+        std::size_t pagesize;
+        objc::byte* pages;
+        objc::byte* data;
+        
+        guarded_t(objc::byte const* bytes, std::size_t size)
+            :pagesize(std::size_t(::getpagesize()))
+            ,pages(static_cast<objc::byte*>(::mmap(nullptr, 2 * pagesize, PROT_READ | PROT_WRITE,
+                                                   MAP_PRIVATE | MAP_ANON, -1, 0)))
+            ,data(pages + pagesize - size)
+            {
+                REQUIRE(pages != MAP_FAILED);
+                REQUIRE(::mprotect(pages + pagesize, pagesize, PROT_NONE) == 0);
+                std::copy(bytes, bytes + size, data);
+            }
+            
+        ~guarded_t() { ::munmap(pages, 2 * pagesize); }
+    };
+    
+    TEST_CASE("[nsurl-image-types] Sniff image types from short and misnamed buffers",
+              "[nsurl-sniff-image-types-short-misnamed-buffers]")
+    {
+        using objc::byte;
+        const byte png[]  = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+        const byte jpeg[] = { 0xFF, 0xD8, 0xFF };
+        const byte bmp[]  = { 'B', 'M', 0x36, 0x10, 0, 0, 0, 0, 0, 0, 0x36, 0, 0, 0 };
+        const byte jp2[]  = { 0, 0, 0, 0x0C, 'j', 'P', ' ', ' ', '\r', '\n', 0x87, '\n' };
+        const byte bm[]   = { 'B', 'M' };
+        const byte text[] = { 'y', 'o', ' ', 'd', 'o', 'g', 'g' };
+        
+        CHECK(objc::image::sniff(png,  sizeof(png))     == NSPNGFileType);
+        CHECK(objc::image::sniff(jpeg, sizeof(jpeg))    == NSJPEGFileType);
+        CHECK(objc::image::sniff(bmp,  sizeof(bmp))     == NSBMPFileType);
+        CHECK(objc::image::sniff(jp2,  sizeof(jp2))     == NSJPEG2000FileType);
+        CHECK(objc::image::sniff(bm,   sizeof(bm))      == -1);
+        CHECK(objc::image::sniff(text, sizeof(text))    == -1);
+        CHECK(objc::image::sniff(nullptr, 0)            == -1);
+        
+        /// the shortest inputs that the BMP and legacy PVR checks look at,
+        /// with nothing readable past their last byte:
+        const byte bmp10[10] = { 'B', 'M', 0x36, 0x10, 0, 0, 0, 0, 0, 0 };
+        byte pvr28[28] = { 52, 0, 0, 0 };
+        pvr28[24] = 4;                                  /// bits per pixel
+        guarded_t guardedbmp(bmp10, sizeof(bmp10));
+        guarded_t guardedpvr(pvr28, sizeof(pvr28));
+        CHECK(objc::image::sniff(guardedbmp.data, sizeof(bmp10)) == NSBMPFileType);
+        CHECK(objc::image::sniff(guardedpvr.data, sizeof(pvr28)) == AXPVRFileType);
+        CHECK(objc::image::sniff(guardedbmp.data + 1, sizeof(bmp10) - 1) == -1);
+        CHECK(objc::image::sniff(guardedpvr.data + 1, sizeof(pvr28) - 1) == -1);
+        
+        /// ... and the same through a mapped byte_source:
+        NSData* mappedpvr = [NSData dataWithBytesNoCopy:guardedpvr.data
+                                                 length:sizeof(pvr28)
+                                           freeWhenDone:NO];
+        CHECK(objc::image::sniff(*[mappedpvr dataSource]) == AXPVRFileType);
+        
+        /// contents win over a misleading filename:
+        NSData* pngdata = [NSData dataWithBytes:png length:sizeof(png)];
+        CHECK(objc::image::sniff(*[pngdata dataSource]) == NSPNGFileType);
+        CHECK(objc::image::filetype(
+              objc::image::extension("i-am-a-png.jpg")) == NSJPEGFileType);
     }
     
 }
@@ -0,0 +1,346 @@
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/pixels.hh>
+#import  <subjective-c/categories/NSBitmapImageRep+IM.hh>
+#include <libimread/image.hh>
+#include <libimread/errors.hh>
+#include <mach/mach.h>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::pixels::layout;
+    using objc::pixels::sample;
+    using objc::pixels::alpha;
+    
+    std::vector<byte> noise(std::size_t size, unsigned seed = 0x9e3779b9) {
+        std::mt19937 generator(seed);
+        std::vector<byte> out(size);
+        std::generate(out.begin(), out.end(),
+                  [&]() { return static_cast<byte>(generator()); });
+        return out;
+    }
+    
+    std::size_t resident() {
+        mach_task_basic_info_data_t info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                      reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) { return 0; }
+        return info.resident_size;
+    }
+    
+    NSBitmapImageRep* bitmap(NSInteger width, NSInteger height, BOOL planar) {
+        return [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                       pixelsWide:width
+                                                       pixelsHigh:height
+                                                    bitsPerSample:8
+                                                  samplesPerPixel:4
+                                                         hasAlpha:YES
+                                                         isPlanar:planar
+                                                   colorSpaceName:NSCalibratedRGBColorSpace
+                                                     bitmapFormat:NSAlphaNonpremultipliedBitmapFormat
+                                                      bytesPerRow:0
+                                                     bitsPerPixel:0];
+    }
+    
+    std::vector<byte*> planes_of(std::vector<byte>& buffer, std::size_t count) {
+        std::vector<byte*> out(count);
+        std::size_t planesize = buffer.size() / count;
+        for (std::size_t c = 0; c < count; ++c) { out[c] = buffer.data() + c * planesize; }
+        return out;
+    }
+    
+    TEST_CASE("[pixel-transfer] Interleaved <-> planar transfers respect row padding",
+              "[pixel-transfer-interleaved-planar-row-padding]")
+    {
+        const std::size_t height = 11;
+        for (std::size_t width : { 1, 15, 16, 17, 63, 100, 257 }) {
+            for (std::size_t count = 1; count <= objc::pixels::max_channels; ++count) {
+                const std::size_t rowbytes = width * count + 13;    /// deliberately unaligned
+                std::vector<byte> interleaved = noise(rowbytes * height);
+                std::vector<byte> vectorized(width * height * count);
+                std::vector<byte> scalar(width * height * count);
+                std::vector<byte*> vplanes = planes_of(vectorized, count);
+                std::vector<byte*> splanes = planes_of(scalar, count);
+                
+                layout source = layout::interleaved(interleaved.data(), count, sample::u8, rowbytes);
+                REQUIRE(objc::pixels::transfer(source, layout::planar(vplanes.data(), count, sample::u8, width),
+                                               width, height, true));
+                REQUIRE(objc::pixels::transfer(source, layout::planar(splanes.data(), count, sample::u8, width),
+                                               width, height, false));
+                CHECK(vectorized == scalar);
+                
+                for (std::size_t y = 0; y < height; ++y) {
+                    for (std::size_t x = 0; x < width; ++x) {
+                        for (std::size_t c = 0; c < count; ++c) {
+                            CHECK(vplanes[c][y * width + x] == interleaved[y * rowbytes + x * count + c]);
+                        }
+                    }
+                }
+                
+                std::vector<byte> roundtrip(rowbytes * height, 0);
+                REQUIRE(objc::pixels::transfer(layout::planar(vplanes.data(), count, sample::u8, width),
+                                               layout::interleaved(roundtrip.data(), count, sample::u8, rowbytes),
+                                               width, height));
+                for (std::size_t y = 0; y < height; ++y) {
+                    CHECK(std::equal(roundtrip.begin() + y * rowbytes,
+                                     roundtrip.begin() + y * rowbytes + width * count,
+                                     interleaved.begin() + y * rowbytes));
+                }
+            }
+        }
+    }
+    
+    TEST_CASE("[pixel-transfer] Vectorized alpha conversion is bit-exact for every 8-bit pair",
+              "[pixel-transfer-vectorized-alpha-conversion-bit-exact]")
+    {
+        /// one RGBA pixel per (color, alpha) pair:
+        const std::size_t width = 256 * 256;
+        std::vector<byte> pixels(width * 4);
+        for (std::size_t c = 0; c < 256; ++c) {
+            for (std::size_t a = 0; a < 256; ++a) {
+                byte* px = &pixels[(c * 256 + a) * 4];
+                px[0] = c; px[1] = 255 - c; px[2] = c / 2; px[3] = a;
+            }
+        }
+        
+        for (alpha from : { alpha::straight, alpha::premultiplied }) {
+            alpha to = from == alpha::straight ? alpha::premultiplied : alpha::straight;
+            layout source = layout::interleaved(pixels.data(), 4, sample::u8, width * 4, 0, from);
+            
+            std::vector<byte> vectorized(width * 4), scalar(width * 4);
+            REQUIRE(objc::pixels::transfer(source, layout::interleaved(vectorized.data(), 4, sample::u8,
+                                                                       width * 4, 0, to), width, 1, true));
+            REQUIRE(objc::pixels::transfer(source, layout::interleaved(scalar.data(), 4, sample::u8,
+                                                                       width * 4, 0, to), width, 1, false));
+            CHECK(vectorized == scalar);
+            
+            std::vector<byte> planar(width * 4);
+            std::vector<byte*> planes = planes_of(planar, 4);
+            REQUIRE(objc::pixels::transfer(source, layout::planar(planes.data(), 4, sample::u8, width, to),
+                                           width, 1, true));
+            for (std::size_t x = 0; x < width; ++x) {
+                for (std::size_t c = 0; c < 4; ++c) {
+                    CHECK(planes[c][x] == scalar[x * 4 + c]);
+                }
+            }
+            
+            /// spot-check the arithmetic itself:
+            for (std::size_t x = 0; x < width; ++x) {
+                unsigned c = pixels[x * 4], a = pixels[x * 4 + 3];
+                unsigned expected = to == alpha::premultiplied ? (c * a * 2 + 255) / 510
+                                  : a == 0 ? 0 : std::min(255u, (c * 255 + a / 2) / a);
+                CHECK(scalar[x * 4] == expected);
+                CHECK(scalar[x * 4 + 3] == a);
+            }
+        }
+    }
+    
+    TEST_CASE("[pixel-transfer] 16-bit, float and alpha-first layouts",
+              "[pixel-transfer-16-bit-float-alpha-first]")
+    {
+        std::vector<uint16_t> wide(64 * 3), back(64 * 3), planar(64 * 3);
+        std::mt19937 generator(1);
+        std::generate(wide.begin(), wide.end(),
+                  [&]() { return static_cast<uint16_t>(generator()); });
+        byte* planes[3] = { reinterpret_cast<byte*>(&planar[0]),
+                            reinterpret_cast<byte*>(&planar[64]),
+                            reinterpret_cast<byte*>(&planar[128]) };
+        REQUIRE(objc::pixels::transfer(layout::interleaved(reinterpret_cast<byte*>(wide.data()), 3, sample::u16, 64 * 3 * 2),
+                                       layout::planar(planes, 3, sample::u16, 64 * 2), 64, 1));
+        REQUIRE(objc::pixels::transfer(layout::planar(planes, 3, sample::u16, 64 * 2),
+                                       layout::interleaved(reinterpret_cast<byte*>(back.data()), 3, sample::u16, 64 * 3 * 2), 64, 1));
+        CHECK(wide == back);
+        CHECK(planar[64] == wide[1]);
+        
+        float straight[4] = { 0.25f, 0.5f, 1.0f, 0.5f }, premultiplied[4];
+        REQUIRE(objc::pixels::transfer(layout::interleaved(reinterpret_cast<byte*>(straight), 4, sample::f32, 16, 0, alpha::straight),
+                                       layout::interleaved(reinterpret_cast<byte*>(premultiplied), 4, sample::f32, 16, 0, alpha::premultiplied),
+                                       1, 1));
+        CHECK(premultiplied[0] == 0.125f);
+        CHECK(premultiplied[2] == 0.5f);
+        CHECK(premultiplied[3] == 0.5f);
+        
+        byte argb[8] = { 10, 1, 2, 3,   20, 4, 5, 6 };
+        byte rgba[8] = { 0 };
+        byte expected[8] = { 1, 2, 3, 10,   4, 5, 6, 20 };
+        REQUIRE(objc::pixels::transfer(layout::interleaved(argb, 4, sample::u8, 8, 0, alpha::straight, true),
+                                       layout::interleaved(rgba, 4, sample::u8, 8, 0, alpha::straight),
+                                       2, 1));
+        CHECK(std::equal(rgba, rgba + 8, expected));
+        
+        /// mismatched channel counts or sample formats are refused:
+        CHECK(!objc::pixels::transfer(layout::interleaved(argb, 4, sample::u8, 8),
+                                      layout::interleaved(rgba, 3, sample::u8, 8), 1, 1));
+        CHECK(!objc::pixels::transfer(layout::interleaved(argb, 2, sample::u8, 8),
+                                      layout::interleaved(rgba, 1, sample::u16, 8), 1, 1));
+    }
+    
+    TEST_CASE("[pixel-transfer] Transfer between padded and planar NSBitmapImageReps",
+              "[pixel-transfer-padded-planar-nsbitmapimagerep]")
+    {
+        const NSInteger width = 37, height = 19, rowbytes = 37 * 4 + 44;
+        
+        @autoreleasepool {
+            NSBitmapImageRep* padded = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                               pixelsWide:width
+                                                                               pixelsHigh:height
+                                                                            bitsPerSample:8
+                                                                          samplesPerPixel:4
+                                                                                 hasAlpha:YES
+                                                                                 isPlanar:NO
+                                                                           colorSpaceName:NSCalibratedRGBColorSpace
+                                                                             bitmapFormat:NSAlphaNonpremultipliedBitmapFormat
+                                                                              bytesPerRow:rowbytes
+                                                                             bitsPerPixel:32];
+            NSBitmapImageRep* planar = bitmap(width, height, YES);
+            REQUIRE(padded != nil);
+            REQUIRE(planar != nil);
+            
+            std::vector<byte> random = noise(rowbytes * height);
+            std::copy(random.begin(), random.end(), [padded bitmapData]);
+            
+            layout source = [padded pixelLayout];
+            layout destination = [planar pixelLayout];
+            CHECK(source.is_packed());
+            CHECK(destination.is_planar());
+            CHECK(source.channels[0].ystride == rowbytes);
+            REQUIRE(objc::pixels::transfer(source, destination, width, height));
+            
+            for (NSInteger y = 0; y < height; y += 3) {
+                for (NSInteger x = 0; x < width; x += 5) {
+                    NSUInteger expected[4], actual[4];
+                    [padded getPixel:expected atX:x y:y];
+                    [planar getPixel:actual atX:x y:y];
+                    CHECK(std::equal(expected, expected + 4, actual));
+                }
+            }
+        };
+    }
+    
+    TEST_CASE("[pixel-transfer] View NSBitmapImageRep samples as an im::Image and back, without copying",
+              "[pixel-transfer-view-nsbitmapimagerep-image-without-copying]")
+    {
+        @autoreleasepool {
+            for (BOOL isplanar : { NO, YES }) {
+                NSBitmapImageRep* rep = bitmap(64, 48, isplanar);
+                std::vector<byte> random = noise([rep bytesPerPlane] * ([rep isPlanar] ? 4 : 1));
+                std::copy(random.begin(), random.end(), [rep bitmapData]);
+                
+                std::unique_ptr<Image> view = [rep imageView];
+                REQUIRE(view.get() != nullptr);
+                CHECK(view->width() == 64);
+                CHECK(view->height() == 48);
+                CHECK(view->planes() == 4);
+                CHECK(view->rowp(0) == static_cast<void*>([rep bitmapData]));
+                
+                NSBitmapImageRep* wrapped = [[NSBitmapImageRep alloc] initWithSharedImage:std::shared_ptr<Image>(std::move(view))];
+                REQUIRE(wrapped != nil);
+                CHECK([wrapped bitmapData] == [rep bitmapData]);
+                CHECK([wrapped isPlanar] == [rep isPlanar]);
+                
+                for (NSInteger y = 0; y < 48; y += 7) {
+                    for (NSInteger x = 0; x < 64; x += 9) {
+                        NSUInteger expected[4], actual[4];
+                        [rep getPixel:expected atX:x y:y];
+                        [wrapped getPixel:actual atX:x y:y];
+                        CHECK(std::equal(expected, expected + 4, actual));
+                    }
+                }
+            }
+            
+            /// premultiplied reps can't be viewed as-is:
+            NSBitmapImageRep* premultiplied = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                                      pixelsWide:8
+                                                                                      pixelsHigh:8
+                                                                                   bitsPerSample:8
+                                                                                 samplesPerPixel:4
+                                                                                        hasAlpha:YES
+                                                                                        isPlanar:NO
+                                                                                  colorSpaceName:NSCalibratedRGBColorSpace
+                                                                                     bytesPerRow:0
+                                                                                    bitsPerPixel:0];
+            CHECK([premultiplied imageView].get() == nullptr);
+            
+            /// ... and there's nothing to wrap without an image:
+            CHECK([[NSBitmapImageRep alloc] initWithSharedImage:nullptr] == nil);
+        };
+    }
+    
+    TEST_CASE("[pixel-transfer] Benchmark copying vs. wrapping a 4K frame",
+              "[pixel-transfer-benchmark-copying-wrapping-4k-frame]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const NSInteger width = 3840, height = 2160;
+        
+        @autoreleasepool {
+            NSBitmapImageRep* rep = bitmap(width, height, YES);
+            std::vector<byte> random = noise([rep bytesPerPlane] * 4);
+            std::copy(random.begin(), random.end(), [rep bitmapData]);
+            std::shared_ptr<Image> frame([rep imageView]);
+            REQUIRE(frame.get() != nullptr);
+            
+            std::size_t copyresident = resident();
+            auto copystart = clock_t::now();
+            NSBitmapImageRep* copied = [[NSBitmapImageRep alloc] initWithImage:*frame];
+            ms_t copytime = clock_t::now() - copystart;
+            copyresident = resident() - copyresident;
+            
+            std::size_t wrapresident = resident();
+            auto wrapstart = clock_t::now();
+            NSBitmapImageRep* wrapped = [[NSBitmapImageRep alloc] initWithSharedImage:frame];
+            ms_t wraptime = clock_t::now() - wrapstart;
+            wrapresident = resident() - wrapresident;
+            
+            REQUIRE(copied != nil);
+            REQUIRE(wrapped != nil);
+            CHECK([wrapped bitmapData] == [rep bitmapData]);
+            CHECK([copied bitmapData] != [rep bitmapData]);
+            
+            WTF("Making an NSBitmapImageRep from a 3840x2160 RGBA im::Image:",
+                FF("\tcopying: %.2fms, resident size +%.2fMB", copytime.count(), copyresident / 1048576.0),
+                FF("\twrapping: %.2fms, resident size +%.2fMB", wraptime.count(), wrapresident / 1048576.0));
+        };
+    }
+    
+    TEST_CASE("[pixel-transfer] Benchmark 8-bit RGBA transfers",
+              "[pixel-transfer-benchmark-8-bit-rgba]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        
+        const std::size_t width = 4096, height = 2048, bytes = width * height * 4;
+        std::vector<byte> interleaved = noise(bytes);
+        std::vector<byte> planar(bytes);
+        std::vector<byte*> planes = planes_of(planar, 4);
+        layout source = layout::interleaved(interleaved.data(), 4, sample::u8, width * 4, 0, alpha::premultiplied);
+        layout destination = layout::planar(planes.data(), 4, sample::u8, width, alpha::straight);
+        
+        auto run = [&](bool vectorize) {
+            auto start = clock_t::now();
+            objc::pixels::transfer(source, destination, width, height, vectorize);
+            return ms_t(clock_t::now() - start);
+        };
+        
+        auto memcpystart = clock_t::now();
+        std::copy(interleaved.begin(), interleaved.end(), planar.begin());
+        ms_t memcpytime = clock_t::now() - memcpystart;
+        ms_t scalartime = run(false);
+        ms_t vectortime = run(true);
+        
+        WTF("Premultiplied RGBA -> straight planar, 4096x2048:",
+            FF("\tmemcpy (no conversion): %.2fms (%.2f GB/s)", memcpytime.count(), bytes / memcpytime.count() / 1e6),
+            FF("\tscalar: %.2fms (%.2f GB/s)", scalartime.count(), bytes / scalartime.count() / 1e6),
+            FF("\tvectorized: %.2fms (%.2f GB/s)", vectortime.count(), bytes / vectortime.count() / 1e6));
+    }
+    
+}
+
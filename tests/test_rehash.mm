@@ -0,0 +1,220 @@
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+#include <string_view>
+
+#include <libimread/libimread.hpp>
+#include <libimread/errors.hh>
+#include <subjective-c/rehash.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using bytevec_t = std::vector<uint8_t>;
+    
+    /// the boost mixer, as rehash.hh had it:
+    std::size_t boost_combine(std::size_t seed, std::size_t value) {
+        seed ^= std::hash<std::size_t>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+    
+    /// SMHasher-style avalanche: for random keys, flip one input bit at a time and
+    /// count how often each output bit flips with it -- which, for a good hash, is
+    /// half the time. Returns the worst deviation from that, from 0.0 (perfect)
+    /// to 1.0 (that output bit always, or never, hears about that input bit).
+    /// Keys longer than 32 bytes have 256 of their bits sampled:
+    template <typename Function> inline
+    double worst_bias(std::size_t length, int samples, Function&& function) {
+        std::mt19937_64 random(length);
+        const std::size_t bits = std::min<std::size_t>(length * 8, 256);
+        std::vector<std::size_t> positions(bits);
+        for (std::size_t idx = 0; idx < bits; ++idx) {
+            positions[idx] = bits == length * 8 ? idx : random() % (length * 8);
+        }
+        std::vector<int> flips(bits * 64, 0);
+        bytevec_t key(length);
+        for (int sample = 0; sample < samples; ++sample) {
+            for (uint8_t& byte : key) { byte = uint8_t(random()); }
+            const uint64_t original = function(key.data(), length);
+            for (std::size_t idx = 0; idx < bits; ++idx) {
+                const std::size_t bit = positions[idx];
+                key[bit / 8] ^= uint8_t(1 << (bit % 8));
+                const uint64_t flipped = original ^ function(key.data(), length);
+                key[bit / 8] ^= uint8_t(1 << (bit % 8));
+                for (int out = 0; out < 64; ++out) {
+                    flips[idx * 64 + out] += int((flipped >> out) & 1);
+                }
+            }
+        }
+        double worst = 0.0;
+        for (int count : flips) {
+            worst = std::max(worst, std::fabs(double(count) / samples - 0.5) * 2.0);
+        }
+        return worst;
+    }
+    
+    TEST_CASE("[rehash] Hash bytes the same way at every length, seed, and alignment",
+              "[rehash-hash-bytes-every-length-seed-alignment]")
+    {
+        std::mt19937_64 random(0);
+        bytevec_t data(2100);
+        for (uint8_t& byte : data) { byte = uint8_t(random()); }
+        
+        std::unordered_set<uint64_t> seen;
+        for (std::size_t length = 0; length <= 2048; ++length) {
+            const uint64_t hashed = hash::hash_bytes(data.data(), length);
+            
+            /// ... the same wherever the bytes happen to be:
+            bytevec_t copy(data.begin(), data.begin() + length + 3);
+            CHECK(hash::hash_bytes(copy.data(), length) == hashed);
+            std::memmove(copy.data() + 3, copy.data(), length);
+            CHECK(hash::hash_bytes(copy.data() + 3, length) == hashed);
+            
+            /// ... different with another seed:
+            CHECK(hash::hash_bytes(data.data(), length, 1) != hashed);
+            
+            /// ... and different for every prefix:
+            CHECK(seen.insert(hashed).second);
+        }
+        
+        std::string_view text = "yo dogg";
+        CHECK(hash::hash_of(text) == hash::hash_bytes(text.data(), text.size()));
+        CHECK(hash::hash_of(std::string(text)) == hash::hash_of(text));
+        CHECK(hash::hash_of("yo dogg") == hash::hash_of(text));
+    }
+    
+    TEST_CASE("[rehash] Combine values in order",
+              "[rehash-combine-values-in-order]")
+    {
+        const std::size_t level = 2, column = 3, row = 4;
+        int marker = 0;
+        void const* owner = &marker;
+        
+        std::size_t seed = 0;
+        hash::rehash(seed, owner);
+        hash::rehash(seed, level);
+        hash::rehash(seed, column);
+        hash::rehash(seed, row);
+        CHECK(hash::combine(owner, level, column, row) == seed);
+        
+        CHECK(hash::combine(column, row) != hash::combine(row, column));
+        CHECK(hash::combine(0, 0) != hash::combine(0));
+        CHECK(hash::combine(std::string("one"), "two") == hash::combine("one", std::string_view("two")));
+        CHECK(hash::combine(1.5, 1) != hash::combine(1.5, 2));
+        
+        const std::vector<std::size_t> values = { 1, 2, 3, 4, 5, 6, 7, 8 };
+        CHECK(std::accumulate(values.begin(), values.end(),
+                              std::size_t(0), hash::rehasher<std::size_t>())
+              == hash::combine(1, 2, 3, 4, 5, 6, 7, 8));
+              
+        /// small, sequential keys -- as tile coordinates are -- don't collide:
+        std::unordered_set<std::size_t> seen;
+        for (std::size_t x = 0; x < 64; ++x) {
+            for (std::size_t y = 0; y < 64; ++y) {
+                for (std::size_t z = 0; z < 8; ++z) {
+                    CHECK(seen.insert(hash::combine(owner, z, x, y)).second);
+                }
+            }
+        }
+    }
+    
+    TEST_CASE("[rehash] Measure avalanche of hash_bytes, hash::combine, and the boost mixer",
+              "[rehash-measure-avalanche-hash-bytes-combine-boost-mixer]")
+    {
+        /// with this many samples, chance alone makes for a worst bias of ~0.07:
+        const int samples = 4000;
+        const double threshold = 0.1;
+        
+        for (std::size_t length : { 4, 8, 12, 16, 24, 32, 64, 100, 256, 300, 1024, 4096 }) {
+            double bias = worst_bias(length, samples, [](uint8_t const* key, std::size_t n) {
+                return hash::hash_bytes(key, n);
+            });
+            WTF(FF("hash_bytes(), %zu bytes: worst bias %.3f", length, bias));
+            CHECK(bias < threshold);
+        }
+        
+        double combined = worst_bias(32, samples, [](uint8_t const* key, std::size_t) {
+            uint64_t words[4];
+            std::memcpy(words, key, sizeof(words));
+            return uint64_t(hash::combine(words[0], words[1], words[2], words[3]));
+        });
+        double boosted = worst_bias(16, samples, [](uint8_t const* key, std::size_t) {
+            uint64_t words[2];
+            std::memcpy(words, key, sizeof(words));
+            return uint64_t(boost_combine(std::hash<uint64_t>{}(words[0]), words[1]));
+        });
+        
+        WTF(FF("hash::combine(), four words: worst bias %.3f", combined),
+            FF("boost mixer, two words: worst bias %.3f", boosted));
+            
+        CHECK(combined < threshold);
+        CHECK(boosted > 0.5);
+    }
+    
+    TEST_CASE("[rehash] Benchmark hash_bytes against std::hash, and hash::combine against the boost mixer",
+              "[rehash-benchmark-hash-bytes-std-hash-combine-boost-mixer]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ns_t = std::chrono::duration<double, std::nano>;
+        std::mt19937_64 random(0);
+        
+        for (std::size_t length : { 8, 16, 64, 256, 1024, 65536, 1048576 }) {
+            std::string data(length, '\0');
+            for (char& byte : data) { byte = char(random()); }
+            const std::size_t runs = std::max<std::size_t>(1, (64u << 20) / length);
+            uint64_t total = 0;
+            
+            auto bytesstart = clock_t::now();
+            for (std::size_t idx = 0; idx < runs; ++idx) {
+                data[0] = char(idx);
+                total += hash::hash_bytes(data.data(), data.size());
+            }
+            ns_t bytestime = clock_t::now() - bytesstart;
+            
+            auto stdstart = clock_t::now();
+            for (std::size_t idx = 0; idx < runs; ++idx) {
+                data[0] = char(idx);
+                total += std::hash<std::string>{}(data);
+            }
+            ns_t stdtime = clock_t::now() - stdstart;
+            
+            CHECK(total != 0);
+            WTF(FF("Hashing %zu bytes (of %zu):", length, runs),
+                FF("\thash::hash_bytes(): %.1fns (%.2fGB/s)",
+                    bytestime.count() / runs, double(length * runs) / bytestime.count()),
+                FF("\tstd::hash<std::string>: %.1fns (%.2fGB/s)",
+                    stdtime.count() / runs, double(length * runs) / stdtime.count()));
+        }
+        
+        const std::size_t runs = 10000000;
+        std::size_t total = 0;
+        
+        auto combinestart = clock_t::now();
+        for (std::size_t idx = 0; idx < runs; ++idx) {
+            total += hash::combine(idx, idx >> 3, idx & 7);
+        }
+        ns_t combinetime = clock_t::now() - combinestart;
+        
+        auto booststart = clock_t::now();
+        for (std::size_t idx = 0; idx < runs; ++idx) {
+            total += boost_combine(boost_combine(std::hash<std::size_t>{}(idx), idx >> 3), idx & 7);
+        }
+        ns_t boosttime = clock_t::now() - booststart;
+        
+        CHECK(total != 0);
+        WTF(FF("Combining three words (of %zu):", runs),
+            FF("\thash::combine(): %.2fns", combinetime.count() / runs),
+            FF("\tboost mixer: %.2fns", boosttime.count() / runs));
+    }
+    
+}
+
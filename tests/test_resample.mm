@@ -0,0 +1,303 @@
+
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/resample.hh>
+#import  <subjective-c/categories/NSImage+Resize.h>
+#import  <subjective-c/categories/NSImage+ResizeBestFit.h>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::pixels::sample;
+    using objc::resample::filter;
+    using objc::resample::buffer_t;
+    using objc::resample::options;
+    
+    const filter filters[] = { filter::box, filter::bilinear, filter::lanczos3, filter::mitchell };
+    char const* const filternames[] = { "box", "bilinear", "lanczos3", "mitchell" };
+    
+    std::vector<byte> noise(std::size_t size, unsigned seed = 0x9e3779b9) {
+        std::mt19937 generator(seed);
+        std::vector<byte> out(size);
+        std::generate(out.begin(), out.end(),
+                  [&]() { return static_cast<byte>(generator()); });
+        return out;
+    }
+    
+    /// band-limited test content: a sum of gentle sinusoids on every channel
+    std::vector<byte> smooth(std::size_t width, std::size_t height, std::size_t channels) {
+        std::vector<byte> out(width * height * channels);
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                for (std::size_t c = 0; c < channels; ++c) {
+                    const double v = 127.5 + 60.0 * std::sin(x * 0.031 * (c + 1) + y * 0.017) +
+                                             60.0 * std::cos(y * 0.023 * (c + 1) - x * 0.011);
+                    out[(y * width + x) * channels + c] = byte(std::lround(std::min(255.0, std::max(0.0, v))));
+                }
+            }
+        }
+        return out;
+    }
+    
+    buffer_t buffer(void* data, std::size_t width, std::size_t height,
+                    std::size_t channels, sample kind = sample::u8) {
+        buffer_t out;
+        out.data = static_cast<byte*>(data);
+        out.width = width;
+        out.height = height;
+        out.channels = channels;
+        out.kind = kind;
+        return out;
+    }
+    
+    double psnr(std::vector<byte> const& lhs, std::vector<byte> const& rhs) {
+        double total = 0.0;
+        for (std::size_t idx = 0; idx < lhs.size(); ++idx) {
+            const double delta = double(lhs[idx]) - double(rhs[idx]);
+            total += delta * delta;
+        }
+        if (total == 0.0) { return INFINITY; }
+        return 10.0 * std::log10(255.0 * 255.0 / (total / lhs.size()));
+    }
+    
+    /// what -resizeImageToSize: used to do:
+    NSImage* legacy_resize(NSImage* image, NSSize size) {
+        NSImage* target = [[NSImage alloc] initWithSize:size];
+        [target lockFocus];
+        [image drawInRect:NSMakeRect(0, 0, size.width, size.height)
+                 fromRect:NSZeroRect
+                operation:NSCompositeCopy
+                 fraction:1.0f
+           respectFlipped:YES
+                    hints:@{ NSImageHintInterpolation : @(NSImageInterpolationHigh) }];
+        [target unlockFocus];
+        return target;
+    }
+    
+    TEST_CASE("[resample] Vector and threaded passes match the scalar ones",
+              "[resample-vector-threaded-passes-match-scalar]")
+    {
+        const std::size_t sizes[][4] = { { 97, 61, 33, 20 }, { 40, 30, 121, 77 },
+                                         { 300, 200, 7, 5 }, { 64, 64, 64, 64 } };
+        for (std::size_t channels : { 1, 3, 4 }) {
+            for (filter kernel : filters) {
+                for (auto const& dims : sizes) {
+                    auto source = noise(dims[0] * dims[1] * channels, unsigned(dims[2] + channels));
+                    std::vector<byte> scalar(dims[2] * dims[3] * channels);
+                    std::vector<byte> vectorized(scalar.size());
+                    std::vector<byte> threaded(scalar.size());
+                    options opts;
+                    opts.kernel = kernel;
+                    opts.threads = 1;
+                    opts.vectorize = false;
+                    REQUIRE(objc::resample::resize(buffer(source.data(), dims[0], dims[1], channels),
+                                                   buffer(scalar.data(), dims[2], dims[3], channels), opts));
+                    opts.vectorize = true;
+                    objc::resample::resize(buffer(source.data(), dims[0], dims[1], channels),
+                                           buffer(vectorized.data(), dims[2], dims[3], channels), opts);
+                    opts.threads = 7;
+                    objc::resample::resize(buffer(source.data(), dims[0], dims[1], channels),
+                                           buffer(threaded.data(), dims[2], dims[3], channels), opts);
+                    CHECK(vectorized == scalar);
+                    CHECK(threaded == scalar);
+                    
+                    std::vector<float> floatsource(source.begin(), source.end());
+                    std::vector<float> floatscalar(scalar.size());
+                    std::vector<float> floatvector(scalar.size());
+                    opts.threads = 1;
+                    opts.vectorize = false;
+                    objc::resample::resize(buffer(floatsource.data(), dims[0], dims[1], channels, sample::f32),
+                                           buffer(floatscalar.data(), dims[2], dims[3], channels, sample::f32), opts);
+                    opts.threads = 3;
+                    opts.vectorize = true;
+                    objc::resample::resize(buffer(floatsource.data(), dims[0], dims[1], channels, sample::f32),
+                                           buffer(floatvector.data(), dims[2], dims[3], channels, sample::f32), opts);
+                    for (std::size_t idx = 0; idx < floatscalar.size(); ++idx) {
+                        CHECK(floatvector[idx] == Approx(floatscalar[idx]).epsilon(1e-5));
+                    }
+                }
+            }
+        }
+    }
+    
+    TEST_CASE("[resample] Identity, flat fields, regions and mismatched buffers",
+              "[resample-identity-flat-fields-regions-mismatched-buffers]")
+    {
+        /// interpolating filters reproduce the source at 1:1 (Mitchell deliberately doesn't):
+        auto source = noise(50 * 40 * 4);
+        for (filter kernel : { filter::box, filter::bilinear, filter::lanczos3 }) {
+            std::vector<byte> same(source.size());
+            options opts;
+            opts.kernel = kernel;
+            objc::resample::resize(buffer(source.data(), 50, 40, 4),
+                                   buffer(same.data(), 50, 40, 4), opts);
+            CHECK(same == source);
+        }
+        
+        /// flat stays flat, up or down -- the fixed-point weights sum to exactly one:
+        std::vector<byte> flat(123 * 77 * 4, 200);
+        for (filter kernel : filters) {
+            std::vector<byte> down(31 * 19 * 4), up(400 * 300 * 4);
+            options opts;
+            opts.kernel = kernel;
+            objc::resample::resize(buffer(flat.data(), 123, 77, 4), buffer(down.data(), 31, 19, 4), opts);
+            objc::resample::resize(buffer(flat.data(), 123, 77, 4), buffer(up.data(), 400, 300, 4), opts);
+            CHECK(std::all_of(down.begin(), down.end(), [](byte b) { return b == 200; }));
+            CHECK(std::all_of(up.begin(), up.end(), [](byte b) { return b == 200; }));
+        }
+        
+        /// a whole-pixel region at 1:1 is a crop:
+        std::vector<byte> ramp(20 * 10);
+        for (std::size_t idx = 0; idx < ramp.size(); ++idx) { ramp[idx] = byte(idx); }
+        std::vector<byte> cropped(5 * 3);
+        options opts;
+        opts.kernel = filter::box;
+        opts.region = objc::resample::region_t{ 4.0, 2.0, 5.0, 3.0 };
+        REQUIRE(objc::resample::resize(buffer(ramp.data(), 20, 10, 1), buffer(cropped.data(), 5, 3, 1), opts));
+        for (std::size_t y = 0; y < 3; ++y) {
+            for (std::size_t x = 0; x < 5; ++x) {
+                CHECK(cropped[y * 5 + x] == ramp[(y + 2) * 20 + x + 4]);
+            }
+        }
+        
+        opts.region = objc::resample::region_t{ 18.0, 0.0, 5.0, 3.0 };
+        CHECK(!objc::resample::resize(buffer(ramp.data(), 20, 10, 1), buffer(cropped.data(), 5, 3, 1), opts));
+        CHECK(!objc::resample::resize(buffer(ramp.data(), 20, 10, 1), buffer(cropped.data(), 5, 3, 3)));
+        CHECK(!objc::resample::resize(buffer(ramp.data(), 20, 10, 1),
+                                      buffer(cropped.data(), 5, 3, 1, sample::f32)));
+    }
+    
+    TEST_CASE("[resample] NSImage category methods return bitmap-backed images",
+              "[resample-nsimage-category-methods-return-bitmap-backed-images]")
+    {
+        @autoreleasepool {
+            NSBitmapImageRep* rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                            pixelsWide:400
+                                                                            pixelsHigh:300
+                                                                         bitsPerSample:8
+                                                                       samplesPerPixel:4
+                                                                              hasAlpha:YES
+                                                                              isPlanar:NO
+                                                                        colorSpaceName:NSDeviceRGBColorSpace
+                                                                           bytesPerRow:0
+                                                                          bitsPerPixel:0];
+            auto content = smooth(400, 300, 4);
+            for (std::size_t idx = 3; idx < content.size(); idx += 4) { content[idx] = 255; }
+            std::memcpy([rep bitmapData], content.data(), content.size());
+            NSImage* image = [[NSImage alloc] initWithSize:NSMakeSize(400, 300)];
+            [image addRepresentation:rep];
+            
+            NSImage* resized = [image resizeImageToSize:NSMakeSize(100, 75)];
+            REQUIRE(resized != nil);
+            REQUIRE([[resized representations] count] == 1);
+            NSBitmapImageRep* bitmap = (NSBitmapImageRep*)[[resized representations] firstObject];
+            REQUIRE([bitmap isKindOfClass:[NSBitmapImageRep class]]);
+            CHECK([bitmap pixelsWide] == 100);
+            CHECK([bitmap pixelsHigh] == 75);
+            CHECK([bitmap bitsPerSample] == 8);
+            
+            NSImage* fitted = [image resizeImageWithMaxDimension:NSMakeSize(200, 200)];
+            CHECK([fitted size].width == Approx(200));
+            CHECK([fitted size].height == Approx(150));
+            
+            NSImage* cropped = [image imageByScalingAndCroppingForSize:CGSizeMake(120, 120)];
+            REQUIRE(cropped != nil);
+            CHECK([cropped size].width == Approx(120));
+            CHECK([cropped size].height == Approx(120));
+            
+            for (AXResizeFilter filter : { AXResizeFilterBox, AXResizeFilterBilinear,
+                                           AXResizeFilterLanczos3, AXResizeFilterMitchell }) {
+                CHECK([image resizeImageToSize:NSMakeSize(57, 33) filter:filter] != nil);
+            }
+        };
+    }
+    
+    TEST_CASE("[resample] Benchmark quality and throughput of each filter",
+              "[resample-benchmark-quality-throughput-each-filter]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        
+        /// quality: shrink smooth content by 2, grow it back, compare with the original
+        const std::size_t side = 1024;
+        auto original = smooth(side, side, 4);
+        std::vector<byte> half((side / 2) * (side / 2) * 4), roundtrip(original.size());
+        for (std::size_t idx = 0; idx < 4; ++idx) {
+            options opts;
+            opts.kernel = filters[idx];
+            objc::resample::resize(buffer(original.data(), side, side, 4),
+                                   buffer(half.data(), side / 2, side / 2, 4), opts);
+            objc::resample::resize(buffer(half.data(), side / 2, side / 2, 4),
+                                   buffer(roundtrip.data(), side, side, 4), opts);
+            WTF(FF("Round-trip PSNR, 1024x1024 RGBA by half and back, %s: %.2fdB",
+                   filternames[idx], psnr(original, roundtrip)));
+        }
+        
+        /// throughput: 4096x4096 RGBA down to 1024x1024
+        const std::size_t big = 4096, small = 1024;
+        auto source = noise(big * big * 4);
+        std::vector<byte> destination(small * small * 4);
+        const double megapixels = double(big * big) / 1e6;
+        
+        for (std::size_t idx = 0; idx < 4; ++idx) {
+            double times[3];
+            const std::pair<bool, unsigned> configurations[] = { { false, 1 }, { true, 1 }, { true, 0 } };
+            for (std::size_t run = 0; run < 3; ++run) {
+                options opts;
+                opts.kernel = filters[idx];
+                opts.vectorize = configurations[run].first;
+                opts.threads = configurations[run].second;
+                auto start = clock_t::now();
+                objc::resample::resize(buffer(source.data(), big, big, 4),
+                                       buffer(destination.data(), small, small, 4), opts);
+                ms_t elapsed = clock_t::now() - start;
+                times[run] = elapsed.count();
+            }
+            WTF(FF("4096x4096 -> 1024x1024 RGBA, %s:", filternames[idx]),
+                FF("\tscalar, one thread: %.2fms (%.1f MP/s)", times[0], megapixels / times[0] * 1e3),
+                FF("\tvectorized, one thread: %.2fms (%.1f MP/s)", times[1], megapixels / times[1] * 1e3),
+                FF("\tvectorized, all threads: %.2fms (%.1f MP/s)", times[2], megapixels / times[2] * 1e3));
+        }
+        
+        @autoreleasepool {
+            NSBitmapImageRep* rep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:nil
+                                                                            pixelsWide:big
+                                                                            pixelsHigh:big
+                                                                         bitsPerSample:8
+                                                                       samplesPerPixel:4
+                                                                              hasAlpha:YES
+                                                                              isPlanar:NO
+                                                                        colorSpaceName:NSDeviceRGBColorSpace
+                                                                           bytesPerRow:0
+                                                                          bitsPerPixel:0];
+            std::memcpy([rep bitmapData], source.data(), source.size());
+            NSImage* image = [[NSImage alloc] initWithSize:NSMakeSize(big, big)];
+            [image addRepresentation:rep];
+            
+            auto legacystart = clock_t::now();
+            NSImage* legacy = legacy_resize(image, NSMakeSize(small, small));
+            ms_t legacytime = clock_t::now() - legacystart;
+            
+            auto resamplestart = clock_t::now();
+            NSImage* resampled = [image resizeImageToSize:NSMakeSize(small, small)];
+            ms_t resampletime = clock_t::now() - resamplestart;
+            CHECK(legacy != nil);
+            CHECK(resampled != nil);
+            
+            WTF("NSImage 4096x4096 -> 1024x1024:",
+                FF("\tlockFocus/drawInRect: %.2fms", legacytime.count()),
+                FF("\t-resizeImageToSize: (lanczos3): %.2fms", resampletime.count()));
+        };
+    }
+    
+}
+
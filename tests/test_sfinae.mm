@@ -82,6 +82,26 @@ namespace {
         CHECK(check_two);
     }
     
+    TEST_CASE("[SFINAE] Confirm results of objc::traits::is_selector, is_class, and are_object_pointers",
+              "[sfinae-objc-traits-confirm-selector-class-object-pointers]") {
+        struct non_object {};
+        
+        static_assert(objc::traits::is_selector_v<SEL>,                 "SEL is a selector");
+        static_assert(!objc::traits::is_selector_v<char const*>,        "char const* is not a selector");
+        static_assert(objc::traits::is_class_v<Class>,                  "Class is a class");
+        static_assert(!objc::traits::is_class_v<NSObject*>,             "NSObject* is not a class");
+        static_assert(!objc::traits::is_object_v<int>,                  "int is not an object");
+        
+        bool check_one = objc::traits::is_selector<objc::types::selector>::value == true;
+        bool check_two = objc::traits::is_class<objc::types::cls>::value == true;
+        bool check_three = objc::traits::detail::are_object_pointers<NSString*, NSData*, id>::value == true;
+        bool check_four = objc::traits::detail::are_object_pointers<NSString*, non_object*>::value == false;
+        CHECK(check_one);
+        CHECK(check_two);
+        CHECK(check_three);
+        CHECK(check_four);
+    }
+    
     TEST_CASE("[SFINAE] Inspect the results from objc::traits::*ptr<T>::type and objc::traits::*ptr_t<T>",
               "[sfinae-inspect-results-objc-traits-null-specifier-traits]") {
         
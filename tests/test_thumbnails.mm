@@ -0,0 +1,221 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/thumbnails.hh>
+#include <libimread/ext/filesystem/path.h>
+#include <libimread/ext/filesystem/temporary.h>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::bytevec_t;
+    using filesystem::path;
+    using filesystem::TemporaryDirectory;
+    using objc::thumbnails::fit;
+    using objc::thumbnails::job_t;
+    using objc::thumbnails::frame_t;
+    using objc::thumbnails::codec_t;
+    using objc::thumbnails::options;
+    using objc::thumbnails::report_t;
+    
+    /// opaque -- so premultiplied and straight agree -- with gradients for the resampler:
+    frame_t gradient(std::size_t width, std::size_t height, unsigned seed) {
+        std::mt19937 generator(seed);
+        frame_t frame;
+        frame.width = width;
+        frame.height = height;
+        frame.pixels.resize(width * height * 4);
+        const byte tint = static_cast<byte>(generator());
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                byte* pixel = frame.pixels.data() + (y * width + x) * 4;
+                pixel[0] = static_cast<byte>(x * 255 / width);
+                pixel[1] = static_cast<byte>(y * 255 / height);
+                pixel[2] = tint;
+                pixel[3] = 255;
+            }
+        }
+        return frame;
+    }
+    
+    bool spit(path const& filepath, bytevec_t const& data) {
+        std::FILE* file = std::fopen(filepath.c_str(), "wb");
+        if (!file) { return false; }
+        bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        return std::fclose(file) == 0 && ok;
+    }
+    
+    bytevec_t slurp(path const& filepath) {
+        bytevec_t out;
+        std::FILE* file = std::fopen(filepath.c_str(), "rb");
+        if (!file) { return out; }
+        byte chunk[4096];
+        std::size_t count;
+        while ((count = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            out.insert(out.end(), chunk, chunk + count);
+        }
+        std::fclose(file);
+        return out;
+    }
+    
+    /// write `count` encoded gradients into `directory`, returning jobs for them:
+    std::vector<job_t> populate(path const& directory, codec_t const& codec,
+                                std::string const& extension, std::size_t count,
+                                std::size_t width, std::size_t height) {
+        std::vector<job_t> jobs;
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            bytevec_t encoded;
+            REQUIRE(codec.encode(gradient(width + idx, height, unsigned(idx)), encoded));
+            path source = directory/("source-" + std::to_string(idx) + extension);
+            path destination = directory/("thumbnail-" + std::to_string(idx) + extension);
+            REQUIRE(spit(source, encoded));
+            jobs.push_back({ source.str(), destination.str() });
+        }
+        return jobs;
+    }
+    
+    TEST_CASE("[thumbnails] Fitting sizes",
+              "[thumbnails-fitting-sizes]")
+    {
+        CHECK(fit(1024, 768, 256) == std::make_pair<std::size_t, std::size_t>(256, 192));
+        CHECK(fit(768, 1024, 256) == std::make_pair<std::size_t, std::size_t>(192, 256));
+        CHECK(fit(100, 50, 256) == std::make_pair<std::size_t, std::size_t>(100, 50));
+        CHECK(fit(10000, 1, 256) == std::make_pair<std::size_t, std::size_t>(256, 1));
+        CHECK(fit(0, 100, 256) == std::make_pair<std::size_t, std::size_t>(0, 0));
+    }
+    
+    TEST_CASE("[thumbnails] PAM files through the pipeline, within the budget",
+              "[thumbnails-pam-files-through-pipeline-within-budget]")
+    {
+        TemporaryDirectory td("test-thumbnails");
+        codec_t codec = objc::thumbnails::pam_codec();
+        std::vector<job_t> jobs = populate(td.dirpath, codec, ".pam", 24, 800, 600);
+        jobs.push_back({ (td.dirpath/"nonexistent.pam").str(),
+                         (td.dirpath/"nonexistent-thumbnail.pam").str() });
+                         
+        options opts;
+        opts.size = 128;
+        opts.budget = 4 * 1024 * 1024;      /// about two decoded images' worth
+        opts.depth = 2;
+        report_t report = objc::thumbnails::generate(jobs, codec, opts);
+        
+        CHECK(report.completed == 24);
+        REQUIRE(report.failures.size() == 1);
+        CHECK(report.failures.front().first == jobs.back().source);
+        CHECK(report.peak_bytes <= opts.budget);
+        CHECK(report.latency_p50 <= report.latency_p99);
+        CHECK(report.latency_p99 <= report.latency_max);
+        
+        for (std::size_t idx = 0; idx < 24; ++idx) {
+            bytevec_t thumbnail = slurp(jobs[idx].destination);
+            std::size_t width = 0, height = 0;
+            REQUIRE(codec.measure(thumbnail, width, height));
+            CHECK(std::make_pair(width, height) == fit(800 + idx, 600, 128));
+        }
+    }
+    
+    TEST_CASE("[thumbnails] PAM headers with overflowing dimensions are rejected",
+              "[thumbnails-pam-headers-overflowing-dimensions-rejected]")
+    {
+        codec_t codec = objc::thumbnails::pam_codec();
+        for (std::string dimensions : { "WIDTH 4294967296\nHEIGHT 4294967296\n",
+                                        "WIDTH 18446744073709551615\nHEIGHT 2\n",
+                                        "WIDTH 4611686018427387904\nHEIGHT 1\n" }) {
+            std::string text = "P7\n" + dimensions + "DEPTH 4\nMAXVAL 255\n"
+                                                     "TUPLTYPE RGB_ALPHA\nENDHDR\n";
+            bytevec_t data(text.begin(), text.end());
+            data.resize(data.size() + 64);
+            std::size_t width = 0, height = 0;
+            frame_t frame;
+            CHECK(!codec.measure(data, width, height));
+            CHECK(!codec.decode(data, frame));
+            CHECK(frame.pixels.empty());
+        }
+    }
+    
+    TEST_CASE("[thumbnails] A codec that throws fails its images, not the batch",
+              "[thumbnails-codec-that-throws-fails-images-not-batch]")
+    {
+        TemporaryDirectory td("test-thumbnails");
+        codec_t codec = objc::thumbnails::pam_codec();
+        std::vector<job_t> jobs = populate(td.dirpath, codec, ".pam", 8, 64, 64);
+        
+        codec_t unreliable = codec;
+        unreliable.decode = [&codec](bytevec_t const& data, frame_t& frame) {
+            std::size_t width = 0, height = 0;
+            codec.measure(data, width, height);
+            if (width % 2) { throw std::runtime_error("odd"); }
+            return codec.decode(data, frame);
+        };
+        
+        report_t report = objc::thumbnails::generate(jobs, unreliable);
+        CHECK(report.completed == 4);
+        CHECK(report.failures.size() == 4);
+        for (auto const& failure : report.failures) {
+            CHECK(failure.second == "odd");
+        }
+    }
+    
+    TEST_CASE("[thumbnails] PNG and JPEG through the AppKit codec",
+              "[thumbnails-png-jpeg-through-appkit-codec]")
+    {
+        using objc::thumbnails::format;
+        TemporaryDirectory td("test-thumbnails");
+        
+        for (format kind : { format::png, format::jpeg }) {
+            std::string extension = kind == format::png ? ".png" : ".jpg";
+            codec_t codec = objc::thumbnails::appkit_codec(kind);
+            std::vector<job_t> jobs = populate(td.dirpath, codec, extension, 8, 640, 480);
+            
+            options opts;
+            opts.size = 160;
+            report_t report = objc::thumbnails::generate(jobs, codec, opts);
+            CHECK(report.completed == 8);
+            CHECK(report.failures.empty());
+            
+            for (std::size_t idx = 0; idx < jobs.size(); ++idx) {
+                bytevec_t thumbnail = slurp(jobs[idx].destination);
+                std::size_t width = 0, height = 0;
+                REQUIRE(codec.measure(thumbnail, width, height));
+                CHECK(std::make_pair(width, height) == fit(640 + idx, 480, 160));
+            }
+        }
+    }
+    
+    TEST_CASE("[thumbnails] Benchmark throughput and latency",
+              "[thumbnails-benchmark-throughput-latency]")
+    {
+        TemporaryDirectory td("test-thumbnails");
+        codec_t codec = objc::thumbnails::appkit_codec(objc::thumbnails::format::jpeg);
+        std::vector<job_t> jobs = populate(td.dirpath, codec, ".jpg", 64, 2048, 1536);
+        
+        for (unsigned workers : { 1u, 0u }) {
+            options opts;
+            opts.decoders = opts.resamplers = opts.encoders = workers;
+            report_t report = objc::thumbnails::generate(jobs, codec, opts);
+            CHECK(report.completed == jobs.size());
+            
+            WTF(FF("64 JPEGs, 2048x1536 -> 256x192, %s:", workers ? "one thread per stage"
+                                                                  : "all threads"),
+                FF("\t%.2fs, %.1f thumbnails/s, %.1f MP/s decoded",
+                   report.seconds, report.per_second, report.input_megapixels / report.seconds),
+                FF("\tlatency: p50 %.2fms, p90 %.2fms, p99 %.2fms, max %.2fms",
+                   report.latency_p50, report.latency_p90, report.latency_p99, report.latency_max),
+                FF("\tbusy: read %.2fs, decode %.2fs, resample %.2fs, encode %.2fs, write %.2fs",
+                   report.read_seconds, report.decode_seconds, report.resample_seconds,
+                   report.encode_seconds, report.write_seconds),
+                FF("\tpeak in flight: %.1fMB", double(report.peak_bytes) / (1024.0 * 1024.0)));
+        }
+    }
+    
+}
+
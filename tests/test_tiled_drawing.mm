@@ -0,0 +1,278 @@
+
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+
+#include <subjective-c/subjective-c.hpp>
+#include <subjective-c/tiles.hh>
+#import  <subjective-c/classes/AXCoreGraphicsImageRep.h>
+#import  <AppKit/NSGraphicsContext.h>
+#include <libimread/errors.hh>
+
+#include "include/catch.hpp"
+
+namespace {
+    
+    using objc::byte;
+    using objc::cg::tile_cache;
+    using objc::cg::mip_pyramid;
+    
+    CGContextRef canvas(std::size_t width, std::size_t height) {
+        CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
+        CGContextRef context = CGBitmapContextCreate(nullptr, width, height, 8, width * 4,
+                                                     colorspace, kCGImageAlphaPremultipliedLast);
+        CGColorSpaceRelease(colorspace);
+        return context;
+    }
+    
+    /// an opaque image of smooth gradients -- smooth, so that downsampling
+    /// by way of a mip level and downsampling directly come out nearly the same:
+    CGImageRef pattern(std::size_t width, std::size_t height) {
+        CGContextRef context = canvas(width, height);
+        byte* pixels = static_cast<byte*>(CGBitmapContextGetData(context));
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                byte* pixel = pixels + (y * width + x) * 4;
+                pixel[0] = byte(x * 255 / width);
+                pixel[1] = byte(y * 255 / height);
+                pixel[2] = byte((x + y) * 255 / (width + height));
+                pixel[3] = 255;
+            }
+        }
+        CGImageRef out = CGBitmapContextCreateImage(context);
+        CGContextRelease(context);
+        return out;
+    }
+    
+    /// mean absolute difference between two same-size canvases:
+    double difference(CGContextRef lhs, CGContextRef rhs) {
+        byte const* a = static_cast<byte const*>(CGBitmapContextGetData(lhs));
+        byte const* b = static_cast<byte const*>(CGBitmapContextGetData(rhs));
+        std::size_t size = CGBitmapContextGetBytesPerRow(lhs) * CGBitmapContextGetHeight(lhs);
+        double total = 0.0;
+        for (std::size_t idx = 0; idx < size; ++idx) { total += std::abs(int(a[idx]) - int(b[idx])); }
+        return total / size;
+    }
+    
+    TEST_CASE("[tiled-drawing] Tile cache evicts least-recently-used tiles over its budget",
+              "[tiled-drawing-tile-cache-evicts-lru-tiles-over-budget]")
+    {
+        CGImageRef tile = pattern(16, 16);
+        const std::size_t tilebytes = CGImageGetBytesPerRow(tile) * CGImageGetHeight(tile);
+        tile_cache cache(tilebytes * 3);
+        int owner = 0, other = 0;
+        
+        cache.insert({ &owner, 0, 0, 0 }, tile);
+        cache.insert({ &owner, 0, 1, 0 }, tile);
+        cache.insert({ &other, 0, 0, 0 }, tile);
+        CHECK(cache.size() == 3);
+        CHECK(cache.bytes() == tilebytes * 3);
+        
+        /// touch the oldest, so the second one becomes least recently used:
+        CGImageRef hit = cache.copy({ &owner, 0, 0, 0 });
+        CHECK(hit == tile);
+        CGImageRelease(hit);
+        
+        cache.insert({ &owner, 1, 0, 0 }, tile);
+        CHECK(cache.size() == 3);
+        CHECK(cache.copy({ &owner, 0, 1, 0 }) == nullptr);
+        CHECK(cache.hits() == 1);
+        CHECK(cache.misses() == 1);
+        
+        cache.purge(&owner);
+        CHECK(cache.size() == 1);
+        cache.budget(0);
+        CHECK(cache.size() == 0);
+        CHECK(cache.bytes() == 0);
+        CGImageRelease(tile);
+    }
+    
+    TEST_CASE("[tiled-drawing] Mip pyramid levels and level selection",
+              "[tiled-drawing-mip-pyramid-levels-and-level-selection]")
+    {
+        CGImageRef image = pattern(1000, 600);
+        tile_cache cache;
+        mip_pyramid pyramid(image, 256, cache);
+        
+        REQUIRE(pyramid.levels() == 3);
+        CHECK(pyramid.width(1) == 500);
+        CHECK(pyramid.height(2) == 150);
+        CHECK(pyramid.columns(0) == 4);
+        CHECK(pyramid.rows(0) == 3);
+        CHECK(pyramid.level_for(1.0) == 0);
+        CHECK(pyramid.level_for(2.0) == 0);
+        CHECK(pyramid.level_for(0.5) == 1);
+        CHECK(pyramid.level_for(0.3) == 1);
+        CHECK(pyramid.level_for(0.01) == 2);
+        
+        CHECK(pyramid.base() == image);
+        CGImageRef smallest = pyramid.level(2);
+        REQUIRE(smallest != nullptr);
+        CHECK(CGImageGetWidth(smallest) == 250);
+        CHECK(CGImageGetHeight(smallest) == 150);
+        
+        /// both levels rendered on the way go in the cache, against its budget:
+        CGImageRef middle = pyramid.level(1);
+        REQUIRE(middle != nullptr);
+        CHECK(cache.size() == 2);
+        CHECK(cache.hits() == 1);
+        CHECK(cache.bytes() == CGImageGetBytesPerRow(middle) * CGImageGetHeight(middle) +
+                               CGImageGetBytesPerRow(smallest) * CGImageGetHeight(smallest));
+        CGImageRelease(middle);
+        CGImageRelease(smallest);
+        CGImageRelease(image);
+    }
+    
+    TEST_CASE("[tiled-drawing] Tiled drawing matches CGContextDrawImage(), and skips clipped tiles",
+              "[tiled-drawing-tiled-drawing-matches-cgcontextdrawimage-skips-clipped-tiles]")
+    {
+        CGImageRef image = pattern(600, 400);
+        tile_cache cache;
+        mip_pyramid pyramid(image, 256, cache);
+        const CGRect bounds = CGRectMake(0, 0, 600, 400);
+        
+        CGContextRef direct = canvas(600, 400);
+        CGContextRef tiled = canvas(600, 400);
+        CGContextDrawImage(direct, bounds, image);
+        CHECK(pyramid.draw(tiled, bounds) == 6);
+        CHECK(difference(direct, tiled) < 0.01);
+        
+        /// tiles of level 0 share the image's pixels, and stay out of the cache:
+        CHECK(cache.size() == 0);
+        CHECK(cache.bytes() == 0);
+        CGImageRef corner = pyramid.tile(0, 0, 0);
+        REQUIRE(corner != nullptr);
+        CHECK(CGImageGetWidth(corner) == 256);
+        CHECK(CGImageGetHeight(corner) == 256);
+        CHECK(cache.size() == 0);
+        CGImageRelease(corner);
+        
+        /// only the top-left tile intersects the top-left corner:
+        CGContextSaveGState(tiled);
+        CGContextClipToRect(tiled, CGRectMake(0, 300, 100, 100));
+        CHECK(pyramid.draw(tiled, bounds) == 1);
+        CGContextRestoreGState(tiled);
+        
+        /// scaled down by 4, the whole thing fits in one tile of level 1 --
+        /// which is rendered, and cached, and then comes from the cache:
+        CGContextRef small = canvas(150, 100);
+        CHECK(pyramid.draw(small, CGRectMake(0, 0, 150, 100)) == 1);
+        CHECK(cache.size() == 1);
+        CHECK(pyramid.draw(small, CGRectMake(0, 0, 150, 100)) == 1);
+        CHECK(cache.hits() == 1);
+        
+        /// ... its tiles alias the cached level, rather than copying it:
+        const std::size_t levelbytes = cache.bytes();
+        CGImageRef piece = pyramid.tile(1, 0, 0);
+        REQUIRE(piece != nullptr);
+        CHECK(CGImageGetWidth(piece) == 256);
+        CHECK(CGImageGetHeight(piece) == 200);
+        CHECK(cache.size() == 1);
+        CHECK(cache.bytes() == levelbytes);
+        CGImageRelease(piece);
+        
+        /// ... and with no budget at all, levels are rendered and drawn, but not kept:
+        cache.budget(0);
+        CHECK(cache.size() == 0);
+        CHECK(pyramid.draw(small, CGRectMake(0, 0, 150, 100)) == 1);
+        CHECK(cache.size() == 0);
+        CHECK(cache.bytes() == 0);
+        
+        CGContextRelease(direct);
+        CGContextRelease(tiled);
+        CGContextRelease(small);
+        CGImageRelease(image);
+    }
+    
+    TEST_CASE("[tiled-drawing] AXCoreGraphicsImageRep draws large images in tiles",
+              "[tiled-drawing-axcoregraphicsimagerep-draws-large-images-in-tiles]")
+    {
+        @autoreleasepool {
+            CGImageRef image = pattern(1200, 900);
+            AXCoreGraphicsImageRep* rep = [[AXCoreGraphicsImageRep alloc] initWithImageRef:image
+                                                                            colorSpaceName:NSDeviceRGBColorSpace];
+            AXCoreGraphicsImageRep* untiled = [[AXCoreGraphicsImageRep alloc] initWithImageRef:image
+                                                                                colorSpaceName:NSDeviceRGBColorSpace];
+            [untiled setTiled:NO];
+            CHECK(objc::to_bool([rep isTiled]));
+            CHECK(!objc::to_bool([untiled isTiled]));
+            CHECK([rep tileThreshold] == objc::cg::mip_pyramid::default_threshold);
+            
+            /// 1200x900 is under the default threshold:
+            [rep setTileThreshold:512];
+            
+            for (CGFloat scale : { 1.0, 0.5, 0.2 }) {
+                const std::size_t width = 1200 * scale, height = 900 * scale;
+                CGContextRef tiled = canvas(width, height);
+                CGContextRef direct = canvas(width, height);
+                
+                [NSGraphicsContext saveGraphicsState];
+                [NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithCGContext:tiled flipped:NO]];
+                CHECK(objc::to_bool([rep drawInRect:NSMakeRect(0, 0, width, height)]));
+                [NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithCGContext:direct flipped:NO]];
+                CHECK(objc::to_bool([untiled drawInRect:NSMakeRect(0, 0, width, height)]));
+                [NSGraphicsContext restoreGraphicsState];
+                
+                /// downsampling differs a little between a mip level and the full image:
+                CHECK(difference(tiled, direct) < (scale == 1.0 ? 0.01 : 2.0));
+                CGContextRelease(tiled);
+                CGContextRelease(direct);
+            }
+            CGImageRelease(image);
+        };
+    }
+    
+    TEST_CASE("[tiled-drawing] Benchmark scaled-down and partial draws of a 4096x4096 image",
+              "[tiled-drawing-benchmark-scaled-down-partial-draws-4096x4096-image]")
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+        using ms_t = std::chrono::duration<double, std::milli>;
+        const int iterations = 30;
+        
+        CGImageRef image = pattern(4096, 4096);
+        const CGRect full = CGRectMake(0, 0, 4096, 4096);
+        tile_cache cache;
+        mip_pyramid pyramid(image, 256, cache);
+        
+        CGContextRef thumbnail = canvas(256, 256);
+        auto directstart = clock_t::now();
+        for (int idx = 0; idx < iterations; ++idx) {
+            CGContextDrawImage(thumbnail, CGRectMake(0, 0, 256, 256), image);
+        }
+        ms_t directscaled = clock_t::now() - directstart;
+        
+        auto tiledstart = clock_t::now();
+        for (int idx = 0; idx < iterations; ++idx) {
+            pyramid.draw(thumbnail, CGRectMake(0, 0, 256, 256));
+        }
+        ms_t tiledscaled = clock_t::now() - tiledstart;
+        
+        /// a 512x512 window onto the middle of the full-size image:
+        CGContextRef window = canvas(512, 512);
+        const CGRect offset = CGRectOffset(full, -1792, -1792);
+        directstart = clock_t::now();
+        for (int idx = 0; idx < iterations; ++idx) {
+            CGContextDrawImage(window, offset, image);
+        }
+        ms_t directpartial = clock_t::now() - directstart;
+        
+        tiledstart = clock_t::now();
+        for (int idx = 0; idx < iterations; ++idx) {
+            pyramid.draw(window, offset);
+        }
+        ms_t tiledpartial = clock_t::now() - tiledstart;
+        
+        WTF("Drawing a 4096x4096 image 30 times (tiled times include building levels):",
+            FF("\tscaled to 256x256, CGContextDrawImage(): %.2fms", directscaled.count()),
+            FF("\tscaled to 256x256, mip pyramid: %.2fms", tiledscaled.count()),
+            FF("\t512x512 window, CGContextDrawImage(): %.2fms", directpartial.count()),
+            FF("\t512x512 window, mip pyramid: %.2fms (%zu levels, %.2fMB cached)",
+                tiledpartial.count(), cache.size(), cache.bytes() / 1048576.0));
+                
+        CGContextRelease(thumbnail);
+        CGContextRelease(window);
+        CGImageRelease(image);
+    }
+    
+}
+